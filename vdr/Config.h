@@ -53,6 +53,7 @@ namespace VDR
 #define ERROR_PES_GENERAL   0x01
 #define ERROR_PES_SCRAMBLE  0x02
 #define ERROR_PES_STARTCODE 0x04
+#define ERROR_PES_CONTINUITY 0x08
 #define ERROR_DEMUX_NODATA  0x10
 
 // TODO: Define these in a better place
@@ -23,6 +23,7 @@
 
 #include "channels/ChannelManager.h"
 #include "devices/DeviceManager.h"
+#include "devices/WarmTunerPool.h"
 #include "dvb/DiSEqC.h"
 #include "epg/ScheduleManager.h"
 #include "epg/EPGScanner.h"
@@ -33,7 +34,9 @@
 #include "settings/Settings.h"
 #include "timers/TimerManager.h"
 #include "utils/log/Log.h"
+#include "utils/metrics/MetricsExporter.h"
 #include "utils/Shutdown.h"
+#include "utils/ThreadPool.h"
 #include "vnsi/Server.h"
 
 #include <signal.h> // or #include <bits/signum.h>
@@ -44,6 +47,7 @@ namespace VDR
 #define MANUALSTART          600 // seconds the next timer must be in the future to assume manual start
 #define CHANNELSAVEDELTA     600 // seconds before saving channels.conf after automatic modifications
 #define DEVICEREADYTIMEOUT    30 // seconds to wait until all devices are ready
+#define STARTUPTHREADS         3 // threads used to load the configuration
 
 using namespace PLATFORM;
 
@@ -79,11 +83,16 @@ bool cVDRDaemon::LoadConfig(void)
   CDirectory::Create("special://home/system/");
   CDirectory::Create("special://home/video/");
 
+  // Settings contain the paths used by everything else
   cSettings::Get().Load();
-  cChannelManager::Get().Load();
-  cScheduleManager::Get().Load();
-  cRecordingManager::Get().Load();
-  CAllowedHosts::Get().Load();
+
+  // Recordings reference channels, the other files are independent. EPG
+  // schedules are only indexed here and continue loading in the background.
+  cThreadPool pool(STARTUPTHREADS);
+  pool.Submit([]() { cChannelManager::Get().Load(); cRecordingManager::Get().Load(); });
+  pool.Submit([]() { cScheduleManager::Get().Load(); });
+  pool.Submit([]() { CAllowedHosts::Get().Load(); });
+  pool.Wait();
 
 //  if (!Diseqcs.Load("special://home/system/diseqc.conf"))
 //    Diseqcs.Load("special://vdr/system/diseqc.conf");
@@ -106,14 +115,16 @@ bool cVDRDaemon::Init()
   if (!LoadConfig())
     return false;
 
+  // Accept clients while devices are being initialised
+  m_server = new cVNSIServer(cSettings::Get().m_ListenPort);
+
   if (cDeviceManager::Get().Initialise() == 0)
   {
     esyslog("no devices detected, exiting");
+    SAFE_DELETE(m_server);
     return false;
   }
 
-  m_server = new cVNSIServer(cSettings::Get().m_ListenPort);
-
   // Check for timers in automatic start time window:
   ShutdownHandler.CheckManualStart(MANUALSTART);
 
@@ -122,6 +133,9 @@ bool cVDRDaemon::Init()
     dsyslog("some devices are not ready after %d seconds", DEVICEREADYTIMEOUT);
 
   cTimerManager::Get().Start();
+  cRecordingManager::Get().Start();
+  cMetricsExporter::Get().Start();
+  cWarmTunerPool::Get().Start();
 
   return CreateThread(true);
 }
@@ -175,8 +189,12 @@ void cVDRDaemon::OnSignal(int signum)
 
 void cVDRDaemon::DeInit()
 {
+  cMetricsExporter::Get().Stop();
   cEPGScanner::Get().Stop(true);
+  cScheduleManager::Get().Stop();
   cTimerManager::Get().Stop();
+  cRecordingManager::Get().Stop();
+  cWarmTunerPool::Get().Stop();
   cDeviceManager::Get().Shutdown();
   cChannelManager::Get().Clear();
 
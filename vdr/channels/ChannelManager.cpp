@@ -32,12 +32,84 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <unordered_map>
 
 using namespace PLATFORM;
 using namespace VDR;
 using namespace std;
 
+namespace
+{
+  struct ChannelIDHash
+  {
+    size_t operator()(const cChannelID& id) const
+    {
+      return ((uint64_t)id.Nid() << 48 | (uint64_t)id.Tsid() << 32 | (uint64_t)id.Sid() << 16) ^ (uint32_t)id.ATSCSourceId();
+    }
+  };
+
+  inline uint32_t ServiceKey(uint16_t tsid, uint16_t sid)
+  {
+    return (uint32_t)tsid << 16 | sid;
+  }
+
+  inline uint64_t ATSCSourceKey(unsigned int frequency, uint32_t sourceId)
+  {
+    return (uint64_t)frequency << 32 | sourceId;
+  }
+}
+
+// --- cChannelManager::sChannelIndex ------------------------------------------
+
+struct cChannelManager::sChannelIndex
+{
+  ChannelVector                                         channels;
+  std::unordered_map<uint32_t, ChannelPtr>              byUid;
+  std::unordered_map<cChannelID, ChannelPtr, ChannelIDHash> byId;
+  std::unordered_map<uint32_t, ChannelVector>           byService;     // TSID and SID, for all transponders
+  std::unordered_map<uint64_t, ChannelPtr>              byATSCSource;  // frequency and ATSC source ID
+  std::unordered_map<const cChannel*, std::pair<cChannelID, unsigned int> > keys; // ID and frequency each channel was indexed by
+
+  // The first channel wins if keys collide, like the linear search did
+  explicit sChannelIndex(const ChannelVector& allChannels)
+   : channels(allChannels)
+  {
+    byUid.reserve(channels.size());
+    byId.reserve(channels.size());
+    byService.reserve(channels.size());
+    keys.reserve(channels.size());
+    for (ChannelVector::const_iterator itChannel = channels.begin(); itChannel != channels.end(); ++itChannel)
+    {
+      const ChannelPtr& channel = *itChannel;
+      byUid.insert(std::make_pair(channel->UID(), channel));
+      byId.insert(std::make_pair(channel->ID(), channel));
+      byService[ServiceKey(channel->ID().Tsid(), channel->ID().Sid())].push_back(channel);
+      byATSCSource.insert(std::make_pair(ATSCSourceKey(channel->GetTransponder().FrequencyHz(), channel->ID().ATSCSourceId()), channel));
+      keys.insert(std::make_pair(channel.get(), std::make_pair(channel->ID(), channel->GetTransponder().FrequencyHz())));
+    }
+  }
+
+  // True if the channel is still indexed under its current ID and frequency
+  bool IsCurrent(const cChannel* channel) const
+  {
+    std::unordered_map<const cChannel*, std::pair<cChannelID, unsigned int> >::const_iterator it = keys.find(channel);
+    return it != keys.end() &&
+           it->second.first == channel->ID() &&
+           it->second.second == channel->GetTransponder().FrequencyHz();
+  }
+
+  ChannelPtr FirstByService(uint16_t tsid, uint16_t sid) const
+  {
+    std::unordered_map<uint32_t, ChannelVector>::const_iterator it = byService.find(ServiceKey(tsid, sid));
+    return it != byService.end() ? it->second.front() : cChannel::EmptyChannel;
+  }
+};
+
+// --- cChannelManager ---------------------------------------------------------
+
 cChannelManager::cChannelManager(void)
+ : m_index(new sChannelIndex(ChannelVector())),
+   m_bIndexDirty(false)
 {
 }
 
@@ -53,26 +125,55 @@ cChannelManager &cChannelManager::Get()
   return instance;
 }
 
-void cChannelManager::AddChannel(const ChannelPtr& channel)
+cChannelManager::ChannelIndexPtr cChannelManager::Index(void) const
 {
-  assert(channel.get());
+  if (m_bIndexDirty)
+  {
+    CLockObject lock(m_mutex);
+    if (m_bIndexDirty)
+      UpdateIndex();
+  }
+  return std::atomic_load(&m_index);
+}
 
-  CLockObject lock(m_mutex);
+void cChannelManager::UpdateIndex(void) const
+{
+  std::atomic_store(&m_index, ChannelIndexPtr(new sChannelIndex(m_channels)));
+  m_bIndexDirty = false;
+}
+
+bool cChannelManager::Insert(const ChannelPtr& channel)
+{
+  assert(channel.get());
 
   // Avoid adding two of the same channel objects to the vector
   if (std::find(m_channels.begin(), m_channels.end(), channel) != m_channels.end())
-    return;
+    return false;
 
   channel->RegisterObserver(this);
   m_channels.push_back(channel);
   SetChanged();
   dsyslog("channel tsid=%d sid=%d freq=%d source=%d added", channel->Tsid(), channel->Sid(), channel->GetTransponder().FrequencyHz() , channel->ATSCSourceID());
+  return true;
+}
+
+void cChannelManager::AddChannel(const ChannelPtr& channel)
+{
+  CLockObject lock(m_mutex);
+  if (Insert(channel))
+    UpdateIndex();
 }
 
 void cChannelManager::AddChannels(const ChannelVector& channels)
 {
+  CLockObject lock(m_mutex);
+
+  bool bAdded = false;
   for (ChannelVector::const_iterator itChannel = channels.begin(); itChannel != channels.end(); ++itChannel)
-    AddChannel(*itChannel);
+    bAdded |= Insert(*itChannel);
+
+  if (bAdded)
+    UpdateIndex();
 }
 
 void cChannelManager::MergeChannelProps(const ChannelPtr& channel)
@@ -88,29 +189,22 @@ void cChannelManager::MergeChannelProps(const ChannelPtr& channel)
 
   CLockObject lock(m_mutex);
 
-  bool bFound = false;
-  for (ChannelVector::iterator itChannel = m_channels.begin(); itChannel != m_channels.end(); ++itChannel)
+  ChannelPtr existing = Index()->FirstByService(tsid, sid);
+  if (existing)
   {
-    if (tsid == (*itChannel)->ID().Tsid() &&
-        sid  == (*itChannel)->ID().Sid())
-    {
-      bool bChanged(false);
-      bFound = true;
-      bChanged = (*itChannel)->SetStreams(channel->GetVideoStream(),
-                               channel->GetAudioStreams(),
-                               channel->GetDataStreams(),
-                               channel->GetSubtitleStreams(),
-                               channel->GetTeletextStream());
-      bChanged |= (*itChannel)->SetCaDescriptors(channel->GetCaDescriptors());
-      if (bChanged) {
-        dsyslog("channel tsid=%d sid=%d updated", tsid, sid);
-        (*itChannel)->NotifyObservers();
-      }
-      break;
+    bool bChanged(false);
+    bChanged = existing->SetStreams(channel->GetVideoStream(),
+                                    channel->GetAudioStreams(),
+                                    channel->GetDataStreams(),
+                                    channel->GetSubtitleStreams(),
+                                    channel->GetTeletextStream());
+    bChanged |= existing->SetCaDescriptors(channel->GetCaDescriptors());
+    if (bChanged) {
+      dsyslog("channel tsid=%d sid=%d updated", tsid, sid);
+      existing->NotifyObservers();
     }
   }
-
-  if (!bFound)
+  else
     AddChannel(channel);
 }
 
@@ -124,44 +218,38 @@ void cChannelManager::MergeChannelNamesAndModulation(const ChannelPtr& channel)
 
   CLockObject lock(m_mutex);
 
-  bool bFound = false;
-  for (ChannelVector::iterator itChannel = m_channels.begin(); itChannel != m_channels.end(); ++itChannel)
+  ChannelPtr existing = Index()->FirstByService(tsid, sid);
+  if (existing)
   {
-    if (tsid == (*itChannel)->ID().Tsid() &&
-        sid  == (*itChannel)->ID().Sid())
+    existing->SetName(channel->Name(),
+                      channel->ShortName(),
+                      channel->Provider());
+
+    existing->SetNumber(channel->Number(), channel->SubNumber());
+
+    fe_modulation_t modulation = channel->GetTransponder().Modulation();
+    if (modulation != existing->GetTransponder().Modulation())
     {
-      bFound = true;
-      (*itChannel)->SetName(channel->Name(),
-                            channel->ShortName(),
-                            channel->Provider());
-
-      (*itChannel)->SetNumber(channel->Number(), channel->SubNumber());
-
-      fe_modulation_t modulation = channel->GetTransponder().Modulation();
-      if (modulation != (*itChannel)->GetTransponder().Modulation())
-      {
-        (*itChannel)->GetTransponder().SetModulation(modulation);
-        (*itChannel)->SetChanged();
-      }
-
-      if (channel->ATSCSourceID() != ATSC_SOURCE_ID_NONE)
-        (*itChannel)->SetATSCSourceId(channel->ATSCSourceID());
-
-      if ((*itChannel)->Changed())
-      {
-        dsyslog("updated channel: %s (%d-%d, TSID=%u, SID=%u, source=%u)",
-            (*itChannel)->ShortName().c_str(), (*itChannel)->Number(), (*itChannel)->SubNumber(),
-            (*itChannel)->ID().Tsid(), (*itChannel)->ID().Sid(), (*itChannel)->ATSCSourceID());
-        (*itChannel)->NotifyObservers();
-      }
-      break;
+      existing->GetTransponder().SetModulation(modulation);
+      existing->SetChanged();
     }
-  }
 
-  if (!bFound)
+    if (channel->ATSCSourceID() != ATSC_SOURCE_ID_NONE)
+      existing->SetATSCSourceId(channel->ATSCSourceID());
+
+    if (existing->Changed())
+    {
+      dsyslog("updated channel: %s (%d-%d, TSID=%u, SID=%u, source=%u)",
+          existing->ShortName().c_str(), existing->Number(), existing->SubNumber(),
+          existing->ID().Tsid(), existing->ID().Sid(), existing->ATSCSourceID());
+      existing->NotifyObservers();
+    }
+  }
+  else
   {
     channel->RegisterObserver(this);
     m_channels.push_back(channel);
+    UpdateIndex();
     dsyslog("added channel: %s (%d-%d, TSID=%u, SID=%u, source=%u)",
         channel->ShortName().c_str(), channel->Number(), channel->SubNumber(),
         channel->ID().Tsid(), channel->ID().Sid(), channel->ATSCSourceID());
@@ -171,45 +259,32 @@ void cChannelManager::MergeChannelNamesAndModulation(const ChannelPtr& channel)
 
 ChannelPtr cChannelManager::GetByChannelID(const cChannelID& channelID) const
 {
-  CLockObject lock(m_mutex);
-
-  // TODO: Search m_channelSids
-  //const uint16_t serviceID = channelID.Sid();
+  ChannelIndexPtr index = Index();
 
-  for (ChannelVector::const_iterator itChannel = m_channels.begin(); itChannel != m_channels.end(); ++itChannel)
-  {
-    if ((*itChannel)->ID() == channelID)
-      return (*itChannel);
-  }
-
-  return cChannel::EmptyChannel;
+  std::unordered_map<cChannelID, ChannelPtr, ChannelIDHash>::const_iterator it = index->byId.find(channelID);
+  return it != index->byId.end() ? it->second : cChannel::EmptyChannel;
 }
 
 ChannelPtr cChannelManager::GetByChannelUID(uint32_t channelUid) const
 {
-  CLockObject lock(m_mutex);
-
-  // maybe we need to use a lookup table
-
-  for (ChannelVector::const_iterator itChannel = m_channels.begin(); itChannel != m_channels.end(); ++itChannel)
-  {
-    if ((*itChannel)->UID() == channelUid)
-      return (*itChannel);
-  }
+  ChannelIndexPtr index = Index();
 
-  return cChannel::EmptyChannel;
+  std::unordered_map<uint32_t, ChannelPtr>::const_iterator it = index->byUid.find(channelUid);
+  return it != index->byUid.end() ? it->second : cChannel::EmptyChannel;
 }
 
 ChannelPtr cChannelManager::GetByTransportAndService(const cTransponder& transponder, uint16_t transport, uint16_t service)
 {
-  CLockObject lock(m_mutex);
+  ChannelIndexPtr index = Index();
 
-  for (ChannelVector::const_iterator itChannel = m_channels.begin(); itChannel != m_channels.end(); ++itChannel)
+  std::unordered_map<uint32_t, ChannelVector>::const_iterator it = index->byService.find(ServiceKey(transport, service));
+  if (it != index->byService.end())
   {
-    if ((*itChannel)->GetTransponder() == transponder &&
-        (*itChannel)->ID().Tsid() == transport &&
-        (*itChannel)->ID().Sid()  == service)
-      return (*itChannel);
+    for (ChannelVector::const_iterator itChannel = it->second.begin(); itChannel != it->second.end(); ++itChannel)
+    {
+      if ((*itChannel)->GetTransponder() == transponder)
+        return (*itChannel);
+    }
   }
 
   return cChannel::EmptyChannel;
@@ -217,29 +292,24 @@ ChannelPtr cChannelManager::GetByTransportAndService(const cTransponder& transpo
 
 ChannelPtr cChannelManager::GetByFrequencyAndATSCSourceId(unsigned int frequency, uint32_t sourceId)
 {
-  CLockObject lock(m_mutex);
-
-  for (ChannelVector::const_iterator itChannel = m_channels.begin(); itChannel != m_channels.end(); ++itChannel)
-  {
-    if ((*itChannel)->GetTransponder().FrequencyHz()  == frequency &&
-        (*itChannel)->ID().ATSCSourceId()  == sourceId)
-      return (*itChannel);
-  }
+  ChannelIndexPtr index = Index();
 
-  return cChannel::EmptyChannel;
+  std::unordered_map<uint64_t, ChannelPtr>::const_iterator it = index->byATSCSource.find(ATSCSourceKey(frequency, sourceId));
+  return it != index->byATSCSource.end() ? it->second : cChannel::EmptyChannel;
 }
 
-ChannelVector cChannelManager::GetCurrent(void) const
+ChannelVectorPtr cChannelManager::GetCurrent(void) const
 {
-  CLockObject lock(m_mutex);
-  return m_channels;
+  // Shares ownership with the index instead of copying the vector
+  ChannelIndexPtr index = Index();
+  return ChannelVectorPtr(index, &index->channels);
 }
 
 std::list<cTransponder> cChannelManager::GetCurrentTransponders(void) const
 {
   std::list<cTransponder> transponders;
-  CLockObject lock(m_mutex);
-  for (ChannelVector::const_iterator itChannel = m_channels.begin(); itChannel != m_channels.end(); ++itChannel)
+  ChannelIndexPtr index = Index();
+  for (ChannelVector::const_iterator itChannel = index->channels.begin(); itChannel != index->channels.end(); ++itChannel)
     transponders.push_back((*itChannel)->GetTransponder());
   transponders.unique();
   return transponders;
@@ -247,8 +317,7 @@ std::list<cTransponder> cChannelManager::GetCurrentTransponders(void) const
 
 size_t cChannelManager::ChannelCount() const
 {
-  CLockObject lock(m_mutex);
-  return m_channels.size();
+  return Index()->channels.size();
 }
 
 void cChannelManager::RemoveChannel(const ChannelPtr& channel)
@@ -260,6 +329,7 @@ void cChannelManager::RemoveChannel(const ChannelPtr& channel)
   {
     (*itChannel)->UnregisterObserver(this);
     m_channels.erase(itChannel);
+    UpdateIndex();
     SetChanged();
   }
 }
@@ -268,11 +338,20 @@ void cChannelManager::Clear(void)
 {
   CLockObject lock(m_mutex);
   m_channels.clear();
+  UpdateIndex();
   SetChanged();
 }
 
 void cChannelManager::Notify(const Observable &obs, const ObservableMessage msg)
 {
+  // Only channels are observed. They publish changes with or without a
+  // message. Most changes (streams, names, CA IDs) don't touch the lookup
+  // keys; if the ID or frequency did change, the index is rebuilt once on the
+  // next lookup instead of for every channel a scan updates
+  const cChannel* channel = dynamic_cast<const cChannel*>(&obs);
+  if (channel == NULL || !Index()->IsCurrent(channel))
+    m_bIndexDirty = true;
+
   switch (msg)
   {
   case ObservableMessageChannelChanged:
@@ -334,7 +413,7 @@ bool cChannelManager::Load(const std::string &file)
     ChannelPtr channel = ChannelPtr(new cChannel);
     if (channel && channel->Deserialise(channelNode))
     {
-      AddChannel(channel);
+      Insert(channel);
     }
     else
     {
@@ -344,6 +423,7 @@ bool cChannelManager::Load(const std::string &file)
     channelNode = channelNode->NextSibling(CHANNEL_XML_ELM_CHANNEL);
   }
 
+  UpdateIndex();
   SetChanged();
 
   // Don't continue if we didn't load any channels
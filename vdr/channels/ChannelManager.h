@@ -26,6 +26,7 @@
 #include "lib/platform/threads/mutex.h"
 #include "transponders/TransponderTypes.h"
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
@@ -74,7 +75,10 @@ public:
   ChannelPtr GetByTransportAndService(const cTransponder& transponder, uint16_t transport, uint16_t service);
   ChannelPtr GetByFrequencyAndATSCSourceId(unsigned int frequency, uint32_t sourceId);
 
-  ChannelVector GetCurrent(void) const;
+  /*!
+   * Immutable snapshot of all channels. Doesn't lock or copy the channel list.
+   */
+  ChannelVectorPtr GetCurrent(void) const;
   std::list<cTransponder> GetCurrentTransponders(void) const;
   size_t ChannelCount() const;
 
@@ -91,8 +95,24 @@ public:
   void CreateChannelGroups(bool automatic);
 
 private:
-  ChannelVector    m_channels;
-  std::string      m_strFilename;
-  PLATFORM::CMutex m_mutex;
+  /*!
+   * Lookup tables for the channels. A new index is built after channels are
+   * added or removed and published atomically, so readers don't lock unless
+   * a rebuild is pending. Channels that change their IDs or transponder must
+   * call NotifyObservers() to be re-indexed; this marks the index dirty and
+   * the next lookup rebuilds it.
+   */
+  struct sChannelIndex;
+  typedef std::shared_ptr<const sChannelIndex> ChannelIndexPtr;
+
+  bool Insert(const ChannelPtr& channel); // requires m_mutex
+  void UpdateIndex(void) const;            // requires m_mutex
+  ChannelIndexPtr Index(void) const;
+
+  ChannelVector             m_channels;
+  mutable ChannelIndexPtr   m_index;
+  mutable std::atomic<bool> m_bIndexDirty;
+  std::string               m_strFilename;
+  mutable PLATFORM::CMutex  m_mutex;
 };
 }
@@ -65,5 +65,6 @@ enum STREAM_TYPE
 class cChannel;
 typedef std::shared_ptr<cChannel> ChannelPtr;
 typedef std::vector<ChannelPtr>   ChannelVector;
+typedef std::shared_ptr<const ChannelVector> ChannelVectorPtr;
 
 }
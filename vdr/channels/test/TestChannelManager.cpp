@@ -39,4 +39,48 @@ TEST(ChannelManager, ChannelManager)
   }
 }
 
+TEST(ChannelManager, Lookup)
+{
+  cChannelManager channels;
+
+  ChannelPtr channel1 = ChannelPtr(new cChannel);
+  channel1->SetId(1, 2, 3);
+  ChannelPtr channel2 = ChannelPtr(new cChannel);
+  channel2->SetId(1, 2, 4);
+  channel2->SetATSCSourceId(10);
+
+  channels.AddChannel(channel1);
+  channels.AddChannel(channel2);
+  channels.AddChannel(channel1);
+  EXPECT_EQ(2u, channels.ChannelCount());
+
+  EXPECT_EQ(channel1, channels.GetByChannelID(cChannelID(1, 2, 3)));
+  EXPECT_EQ(channel2, channels.GetByChannelUID(channel2->UID()));
+  EXPECT_EQ(channel1, channels.GetByTransportAndService(channel1->GetTransponder(), 2, 3));
+  EXPECT_EQ(channel2, channels.GetByFrequencyAndATSCSourceId(channel2->GetTransponder().FrequencyHz(), 10));
+  EXPECT_FALSE(channels.GetByChannelID(cChannelID(1, 2, 5)));
+  EXPECT_FALSE(channels.GetByChannelUID(cChannelID(1, 2, 5).Hash()));
+
+  ChannelVectorPtr snapshot = channels.GetCurrent();
+
+  // Changes that don't touch the lookup keys keep the index
+  channel1->SetName("Channel 1", "Ch1", "Provider");
+  channel1->NotifyObservers();
+  EXPECT_EQ(snapshot.get(), channels.GetCurrent().get());
+
+  // Channels are re-indexed when they publish a change
+  channel1->SetId(1, 2, 5);
+  channel1->NotifyObservers();
+  EXPECT_EQ(channel1, channels.GetByChannelID(cChannelID(1, 2, 5)));
+  EXPECT_FALSE(channels.GetByChannelID(cChannelID(1, 2, 3)));
+
+  channels.RemoveChannel(channel2);
+  EXPECT_EQ(1u, channels.ChannelCount());
+  EXPECT_FALSE(channels.GetByChannelUID(channel2->UID()));
+
+  // Snapshots that are still held don't change
+  ASSERT_EQ(2u, snapshot->size());
+  EXPECT_EQ(channel2, snapshot->at(1));
+}
+
 }
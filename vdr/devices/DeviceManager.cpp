@@ -21,6 +21,8 @@
 
 #include "DeviceManager.h"
 #include "Transfer.h"
+#include "WarmTunerPool.h"
+#include "devices/file/FileDevice.h"
 #include "devices/linux/DVBDevice.h"
 #include "devices/commoninterface/CI.h"
 #include "devices/subsystems/DeviceChannelSubsystem.h"
@@ -64,6 +66,14 @@ size_t cDeviceManager::Initialise(void)
 
   isyslog("%u DVB devices found", devices.size());
 
+  // Replay TS captures as additional devices, if configured
+  DeviceVector captureDevices = cFileDevice::FindDevices();
+  if (!captureDevices.empty())
+  {
+    isyslog("%u capture devices found", captureDevices.size());
+    devices.insert(devices.end(), captureDevices.begin(), captureDevices.end());
+  }
+
   CLockObject lock(m_mutex);
 
   unsigned int index = 0;
@@ -104,6 +114,12 @@ DevicePtr cDeviceManager::GetDevice(unsigned int index)
   return (index < m_devices.size()) ? m_devices[index] : cDevice::EmptyDevice;
 }
 
+size_t cDeviceManager::DeviceCount(void)
+{
+  CLockObject lock(m_mutex);
+  return m_devices.size();
+}
+
 void cDeviceManager::Shutdown(void)
 {
   CLockObject lock(m_mutex);
@@ -117,7 +133,10 @@ TunerHandlePtr cDeviceManager::OpenVideoInput(iReceiver* receiver, device_tuning
   if (type == TUNING_TYPE_LIVE_TV   ||
       type == TUNING_TYPE_RECORDING)
   {
-    DevicePtr device = GetDevice(0); // TODO
+    // Take over a tuner that is pre-locked to the transponder, if there is one
+    DevicePtr device = cWarmTunerPool::Get().GetDevice(channel->GetTransponder());
+    if (!device)
+      device = GetDevice(0); // TODO
 
     if (device)
     {
@@ -132,6 +151,9 @@ TunerHandlePtr cDeviceManager::OpenVideoInput(iReceiver* receiver, device_tuning
         /** handle acquired and receiver attached */
         newHandle->SyncPids();
         handle = newHandle;
+
+        if (type == TUNING_TYPE_LIVE_TV)
+          cWarmTunerPool::Get().Watch(handle, channel);
       }
     }
   }
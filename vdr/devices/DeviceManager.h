@@ -68,6 +68,11 @@ public:
    */
   DevicePtr GetDevice(unsigned int index);
 
+  /*!
+   * \brief The number of devices, i.e. of channels that can be received at once
+   */
+  size_t DeviceCount(void);
+
   /*!
    * \brief Closes down all devices. Must be called at the end of the program.
    */
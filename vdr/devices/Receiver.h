@@ -21,6 +21,7 @@
 #pragma once
 
 #include "channels/ChannelTypes.h"
+#include "devices/TsPacketBlock.h"
 #include "devices/TunerHandle.h"
 
 #include <stdint.h>
@@ -66,6 +67,15 @@ public:
    */
   virtual void Receive(const uint16_t pid, const uint8_t* data, const size_t len, ts_crc_check_t& crcvalid) = 0;
 
+  /*!
+   * Receivers that buffer the TS packets of multiplexed PIDs can return true
+   * to get them through ReceivePacket() instead of Receive(). The packet is
+   * copied into a shared block once for all these receivers, and stays valid
+   * for as long as the receiver holds the reference.
+   */
+  virtual bool ReceivesPackets(void) const { return false; }
+  virtual void ReceivePacket(const uint16_t pid, const cTsPacketRef& packet) { }
+
   virtual void LockAcquired(void) {}
 
   virtual void LockLost(void) {}
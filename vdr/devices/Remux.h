@@ -68,6 +68,7 @@ public:
 #define TS_ADAPT_SPLICING     0x04
 #define TS_ADAPT_TP_PRIVATE   0x02
 #define TS_ADAPT_EXTENSION    0x01
+#define TS_CONT_CNT_UNKNOWN   0xFF // no packet of the PID has been seen yet
 
 #define PATPID 0x0000 // PAT PID (constant 0)
 #define MAXPID 0x2000 // for arrays that use a PID as the index
@@ -143,6 +144,33 @@ inline int TsContinuityCounter(const uint8_t *p)
   return p[3] & TS_CONT_CNT_MASK;
 }
 
+inline bool TsDiscontinuity(const uint8_t *p)
+{
+  return TsHasAdaptationField(p) && p[4] > 0 && (p[5] & TS_ADAPT_DISCONT);
+}
+
+enum eTsContinuity {
+  tcOk,
+  tcDuplicate,
+  tcDiscontinuity
+  };
+
+// Checks the continuity counter of p against Counter, the one of the previous
+// packet of the same PID (or TS_CONT_CNT_UNKNOWN), and updates Counter. A single
+// duplicate of a packet is allowed, but its payload must not be used twice.
+inline eTsContinuity TsCheckContinuity(const uint8_t *p, uint8_t &Counter)
+{
+  if (!TsHasPayload(p))
+     return tcOk; // the counter only increments for packets carrying a payload
+  uint8_t Last = Counter;
+  Counter = TsGetContinuityCounter(p);
+  if (Last == TS_CONT_CNT_UNKNOWN || TsDiscontinuity(p))
+     return tcOk;
+  if (Counter == Last)
+     return tcDuplicate;
+  return Counter == ((Last + 1) & TS_CONT_CNT_MASK) ? tcOk : tcDiscontinuity;
+}
+
 inline int64_t TsGetPcr(const uint8_t *p)
 {
   if (TsHasAdaptationField(p)) {
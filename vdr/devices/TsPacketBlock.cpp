@@ -0,0 +1,104 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "TsPacketBlock.h"
+#include "devices/Remux.h"
+
+#include <string.h>
+
+using namespace PLATFORM;
+
+#define TS_PACKET_BLOCK_POOL     64  // Released blocks kept for reuse (~4 MB)
+
+namespace VDR
+{
+
+// --- cTsPacketBlock ----------------------------------------------------------
+
+cTsPacketBlock::cTsPacketBlock(void)
+ : m_data(TS_PACKET_BLOCK_PACKETS * TS_SIZE),
+   m_capacity(TS_PACKET_BLOCK_PACKETS),
+   m_packets(0)
+{
+}
+
+const uint8_t* cTsPacketBlock::Append(const uint8_t* packet)
+{
+  if (Full())
+    return NULL;
+
+  uint8_t* data = m_data.data() + m_packets * TS_SIZE;
+  memcpy(data, packet, TS_SIZE);
+  m_packets++;
+  return data;
+}
+
+// --- cTsPacketBlockPool ------------------------------------------------------
+
+cTsPacketBlockPool& cTsPacketBlockPool::Get(void)
+{
+  static cTsPacketBlockPool _instance;
+  return _instance;
+}
+
+cTsPacketBlockPool::~cTsPacketBlockPool(void)
+{
+  for (std::vector<cTsPacketBlock*>::iterator it = m_freeBlocks.begin(); it != m_freeBlocks.end(); ++it)
+    delete *it;
+}
+
+TsPacketBlockPtr cTsPacketBlockPool::Allocate(void)
+{
+  cTsPacketBlock* block = NULL;
+  {
+    CLockObject lock(m_mutex);
+    if (!m_freeBlocks.empty())
+    {
+      block = m_freeBlocks.back();
+      m_freeBlocks.pop_back();
+    }
+  }
+
+  if (!block)
+    block = new cTsPacketBlock;
+
+  return TsPacketBlockPtr(block, Recycle);
+}
+
+size_t cTsPacketBlockPool::FreeBlocks(void) const
+{
+  CLockObject lock(m_mutex);
+  return m_freeBlocks.size();
+}
+
+void cTsPacketBlockPool::Recycle(cTsPacketBlock* block)
+{
+  cTsPacketBlockPool& pool = Get();
+
+  block->Clear();
+
+  CLockObject lock(pool.m_mutex);
+  if (pool.m_freeBlocks.size() < TS_PACKET_BLOCK_POOL)
+    pool.m_freeBlocks.push_back(block);
+  else
+    delete block;
+}
+
+}
@@ -0,0 +1,111 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "lib/platform/threads/mutex.h"
+
+#include <memory>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define TS_PACKET_BLOCK_PACKETS  348 // ~64 KB
+
+namespace VDR
+{
+
+class cTsPacketBlock;
+typedef std::shared_ptr<cTsPacketBlock> TsPacketBlockPtr;
+
+/*!
+ * A slab of TS packets (~64 KB) shared by the receivers holding packets in it.
+ * Packets are only ever appended by the receiver thread, a packet never changes
+ * once it has been handed out. The block returns to its pool when the last
+ * reference is dropped.
+ */
+class cTsPacketBlock
+{
+public:
+  cTsPacketBlock(void);
+
+  /*!
+   * Copy a TS packet into the block. Returns the copy, or NULL if the block is full.
+   */
+  const uint8_t* Append(const uint8_t* packet);
+
+  bool         Full(void) const    { return m_packets == m_capacity; }
+  unsigned int Packets(void) const { return m_packets; }
+  void         Clear(void)         { m_packets = 0; }
+
+private:
+  std::vector<uint8_t> m_data;
+  const unsigned int   m_capacity;
+  unsigned int         m_packets;
+};
+
+/*!
+ * A TS packet in a block. Holding the reference keeps the packet valid after
+ * iReceiver::ReceivePacket() returned, without copying it.
+ */
+class cTsPacketRef
+{
+public:
+  cTsPacketRef(void) : m_data(NULL) { }
+  cTsPacketRef(const TsPacketBlockPtr& block, const uint8_t* data) : m_block(block), m_data(data) { }
+
+  const uint8_t* Data(void) const { return m_data; }
+  bool IsValid(void) const        { return m_data != NULL; }
+
+  /*!
+   * The block the packet is in, which stays allocated while it's referenced
+   */
+  const cTsPacketBlock* Block(void) const { return m_block.get(); }
+
+private:
+  TsPacketBlockPtr m_block;
+  const uint8_t*   m_data;
+};
+
+class cTsPacketBlockPool
+{
+public:
+  static cTsPacketBlockPool& Get(void);
+  ~cTsPacketBlockPool(void);
+
+  /*!
+   * Get an empty block, reusing a released one if possible
+   */
+  TsPacketBlockPtr Allocate(void);
+
+  /*!
+   * Number of released blocks waiting to be reused
+   */
+  size_t FreeBlocks(void) const;
+
+private:
+  cTsPacketBlockPool(void) { }
+
+  static void Recycle(cTsPacketBlock* block);
+
+  std::vector<cTsPacketBlock*> m_freeBlocks;
+  mutable PLATFORM::CMutex     m_mutex;
+};
+
+}
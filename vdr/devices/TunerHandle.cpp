@@ -63,6 +63,9 @@ std::string cTunerHandle::ToString(void) const
   case TUNING_TYPE_EPG_SCAN:
     type = "epg scan";
     break;
+  case TUNING_TYPE_PRELOCK:
+    type = "pre-lock";
+    break;
   default:
     type = "unknown subscription";
     break;
@@ -37,6 +37,7 @@ typedef enum
   TUNING_TYPE_LIVE_TV,
   TUNING_TYPE_CHANNEL_SCAN,
   TUNING_TYPE_EPG_SCAN,
+  TUNING_TYPE_PRELOCK, // idle tuner kept locked for a predicted channel switch
   TUNING_TYPE_NONE,
 } device_tuning_type_t;
 
@@ -0,0 +1,388 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "WarmTunerPool.h"
+#include "DeviceManager.h"
+#include "channels/Channel.h"
+#include "channels/ChannelManager.h"
+#include "devices/subsystems/DeviceChannelSubsystem.h"
+#include "devices/subsystems/DeviceScanSubsystem.h"
+#include "dvb/filters/PAT.h"
+#include "scan/Scanner.h"
+#include "settings/Settings.h"
+#include "utils/log/Log.h"
+
+#include <algorithm>
+
+using namespace PLATFORM;
+
+// How often the pre-locked tuners are checked when no channel is opened
+#define WARMTUNERINTERVAL   10000 // milliseconds
+
+namespace VDR
+{
+
+static bool IsBefore(const ChannelPtr& a, const ChannelPtr& b)
+{
+  if (a->Number() != b->Number())
+    return a->Number() < b->Number();
+  return a->SubNumber() < b->SubNumber();
+}
+
+static bool OnTransponder(const ChannelVector& channels, const cTransponder& transponder)
+{
+  for (ChannelVector::const_iterator it = channels.begin(); it != channels.end(); ++it)
+  {
+    if ((*it)->GetTransponder() == transponder)
+      return true;
+  }
+  return false;
+}
+
+cWarmTunerPool& cWarmTunerPool::Get(void)
+{
+  static cWarmTunerPool _instance;
+  return _instance;
+}
+
+void cWarmTunerPool::Start(void)
+{
+  if (cSettings::Get().m_bWarmNeighbours && cDeviceManager::Get().DeviceCount() > 1)
+  {
+    isyslog("pre-locking neighbouring channels on idle tuners");
+    CreateThread(false);
+  }
+}
+
+void cWarmTunerPool::Stop(void)
+{
+  StopThread(-1);
+  m_event.Signal();
+  StopThread(0);
+}
+
+void cWarmTunerPool::Watch(const TunerHandlePtr& handle, const ChannelPtr& channel)
+{
+  if (!IsRunning() || !handle || !channel)
+    return;
+
+  CLockObject lock(m_mutex);
+  for (std::vector<sWatched>::iterator it = m_watched.begin(); it != m_watched.end();)
+  {
+    TunerHandlePtr watched = it->handle.lock();
+    if (!watched || watched == handle)
+      it = m_watched.erase(it);
+    else
+      ++it;
+  }
+
+  sWatched watched;
+  watched.handle  = handle;
+  watched.channel = channel;
+  m_watched.insert(m_watched.begin(), watched);
+  m_event.Signal();
+}
+
+DevicePtr cWarmTunerPool::GetDevice(const cTransponder& transponder)
+{
+  CLockObject lock(m_mutex);
+  for (std::vector<WarmTunerPtr>::const_iterator it = m_tuners.begin(); it != m_tuners.end(); ++it)
+  {
+    const WarmTunerPtr& tuner = *it;
+    if (tuner->m_handle && tuner->m_channel->GetTransponder() == transponder && tuner->m_device->Channel()->HasLock())
+      return tuner->m_device;
+  }
+  return cDevice::EmptyDevice;
+}
+
+void* cWarmTunerPool::Process(void)
+{
+  while (!IsStopped())
+  {
+    m_event.Wait(WARMTUNERINTERVAL);
+    if (IsStopped())
+      break;
+
+    // The channel scan needs every tuner, and would preempt them one by one
+    if (cScanner::Get().IsRunning())
+      ReleaseAll();
+    else
+      Update();
+  }
+
+  ReleaseAll();
+  return NULL;
+}
+
+ChannelVector cWarmTunerPool::Neighbours(void)
+{
+  ChannelVector watched;
+  {
+    CLockObject lock(m_mutex);
+    for (std::vector<sWatched>::iterator it = m_watched.begin(); it != m_watched.end();)
+    {
+      if (it->handle.expired())
+      {
+        it = m_watched.erase(it);
+      }
+      else
+      {
+        watched.push_back(it->channel);
+        ++it;
+      }
+    }
+  }
+
+  ChannelVectorPtr channels = cChannelManager::Get().GetCurrent();
+  ChannelVector neighbours;
+
+  for (ChannelVector::const_iterator it = watched.begin(); it != watched.end(); ++it)
+  {
+    const ChannelPtr& channel = *it;
+    if (!channel->Number())
+      continue;
+
+    ChannelPtr previous;
+    ChannelPtr next;
+    for (ChannelVector::const_iterator it2 = channels->begin(); it2 != channels->end(); ++it2)
+    {
+      const ChannelPtr& candidate = *it2;
+      if (!candidate->Number())
+        continue;
+
+      if (IsBefore(candidate, channel) && (!previous || IsBefore(previous, candidate)))
+        previous = candidate;
+      else if (IsBefore(channel, candidate) && (!next || IsBefore(candidate, next)))
+        next = candidate;
+    }
+
+    // Channels on a watched transponder don't need a tuner of their own
+    if (next && !OnTransponder(watched, next->GetTransponder()) && !OnTransponder(neighbours, next->GetTransponder()))
+      neighbours.push_back(next);
+    if (previous && !OnTransponder(watched, previous->GetTransponder()) && !OnTransponder(neighbours, previous->GetTransponder()))
+      neighbours.push_back(previous);
+  }
+
+  return neighbours;
+}
+
+void cWarmTunerPool::Update(void)
+{
+  ChannelVector wanted = Neighbours();
+  std::vector<DevicePtr> idle;
+
+  {
+    CLockObject lock(m_mutex);
+    m_lost.clear();
+
+    for (unsigned int index = 1; index < cDeviceManager::Get().DeviceCount(); ++index)
+    {
+      DevicePtr device = cDeviceManager::Get().GetDevice(index);
+      if (!device || !device->CanTune(TUNING_TYPE_PRELOCK))
+        continue;
+
+      // Leave tuners alone that are locked to a wanted transponder already
+      bool bWanted = false;
+      for (std::vector<WarmTunerPtr>::const_iterator it = m_tuners.begin(); !bWanted && it != m_tuners.end(); ++it)
+      {
+        if ((*it)->m_device != device || !(*it)->m_handle)
+          continue;
+
+        for (ChannelVector::iterator it2 = wanted.begin(); it2 != wanted.end(); ++it2)
+        {
+          if ((*it2)->GetTransponder() == (*it)->m_channel->GetTransponder())
+          {
+            wanted.erase(it2);
+            bWanted = true;
+            break;
+          }
+        }
+      }
+
+      if (!bWanted)
+        idle.push_back(device);
+    }
+  }
+
+  for (ChannelVector::const_iterator it = wanted.begin(); it != wanted.end() && !idle.empty() && !IsStopped(); ++it)
+  {
+    for (std::vector<DevicePtr>::iterator it2 = idle.begin(); it2 != idle.end(); ++it2)
+    {
+      if ((*it2)->Channel()->ProvidesTransponder(**it))
+      {
+        Tune(*it2, *it);
+        idle.erase(it2);
+        break;
+      }
+    }
+  }
+
+  // The neighbours have changed, don't keep the other tuners busy
+  std::vector<WarmTunerPtr> unwanted;
+  {
+    CLockObject lock(m_mutex);
+    for (std::vector<WarmTunerPtr>::const_iterator it = m_tuners.begin(); it != m_tuners.end(); ++it)
+    {
+      if (std::find(idle.begin(), idle.end(), (*it)->m_device) != idle.end())
+        unwanted.push_back(*it);
+    }
+  }
+
+  for (std::vector<WarmTunerPtr>::const_iterator it = unwanted.begin(); it != unwanted.end(); ++it)
+  {
+    if ((*it)->m_handle)
+      dsyslog("device %d no longer pre-locked", (*it)->m_device->Index());
+    Release(*it);
+  }
+}
+
+bool cWarmTunerPool::Tune(const DevicePtr& device, const ChannelPtr& channel)
+{
+  WarmTunerPtr previous;
+  {
+    CLockObject lock(m_mutex);
+    for (std::vector<WarmTunerPtr>::iterator it = m_tuners.begin(); it != m_tuners.end(); ++it)
+    {
+      if ((*it)->m_device == device)
+      {
+        previous = *it;
+        break;
+      }
+    }
+  }
+
+  if (previous)
+    Release(previous);
+
+  WarmTunerPtr tuner(new cWarmTuner(this, device, channel));
+  {
+    CLockObject lock(m_mutex);
+    m_tuners.push_back(tuner);
+  }
+
+  TunerHandlePtr handle = device->Acquire(tuner->m_channel, TUNING_TYPE_PRELOCK, tuner.get());
+
+  {
+    CLockObject lock(m_mutex);
+    if (!handle || tuner->m_bLost)
+    {
+      std::vector<WarmTunerPtr>::iterator it = std::find(m_tuners.begin(), m_tuners.end(), tuner);
+      if (it != m_tuners.end())
+        m_tuners.erase(it);
+      return false;
+    }
+
+    tuner->m_handle = handle;
+    m_bPatSettled = false;
+  }
+
+  // Keep the PMT of the transponder's services up to date
+  device->Scan()->PAT()->Attach(handle);
+  PatSettled();
+
+  dsyslog("device %d pre-locked to %s", device->Index(), handle->ToString().c_str());
+  return true;
+}
+
+void cWarmTunerPool::Release(const WarmTunerPtr& tuner)
+{
+  TunerHandlePtr handle;
+  {
+    CLockObject lock(m_mutex);
+    m_patSettledCondition.Wait(m_mutex, m_bPatSettled);
+
+    std::vector<WarmTunerPtr>::iterator it = std::find(m_tuners.begin(), m_tuners.end(), tuner);
+    if (it != m_tuners.end())
+      m_tuners.erase(it);
+
+    // Taken by LostPriority() if the tuner was preempted
+    handle = tuner->m_handle;
+    tuner->m_handle.reset();
+    if (handle)
+      m_bPatSettled = false;
+  }
+
+  if (handle)
+  {
+    tuner->m_device->Scan()->PAT()->Detach();
+    PatSettled();
+    tuner->m_device->Release(handle);
+  }
+}
+
+void cWarmTunerPool::ReleaseAll(void)
+{
+  std::vector<WarmTunerPtr> tuners;
+  {
+    CLockObject lock(m_mutex);
+    tuners = m_tuners;
+    m_lost.clear();
+  }
+
+  for (std::vector<WarmTunerPtr>::const_iterator it = tuners.begin(); it != tuners.end(); ++it)
+    Release(*it);
+}
+
+void cWarmTunerPool::PatSettled(void)
+{
+  CLockObject lock(m_mutex);
+  m_bPatSettled = true;
+  m_patSettledCondition.Broadcast();
+}
+
+void cWarmTunerPool::LostPriority(cWarmTuner* tuner)
+{
+  // Called from Acquire() of the subscription that takes over the tuner. The
+  // PAT must be detached before that subscription attaches its receivers, so
+  // wait for Tune() or Release() if they're attaching or detaching it.
+  TunerHandlePtr handle;
+  {
+    CLockObject lock(m_mutex);
+    m_patSettledCondition.Wait(m_mutex, m_bPatSettled);
+
+    // Tuners that aren't in m_tuners anymore are detached by Release()
+    for (std::vector<WarmTunerPtr>::iterator it = m_tuners.begin(); it != m_tuners.end(); ++it)
+    {
+      if (it->get() == tuner)
+      {
+        tuner->m_bLost = true;
+        handle = tuner->m_handle;
+        tuner->m_handle.reset();
+
+        m_lost.push_back(*it);
+        m_tuners.erase(it);
+        break;
+      }
+    }
+
+    if (handle)
+      m_bPatSettled = false;
+
+    m_event.Signal();
+  }
+
+  if (handle)
+  {
+    tuner->m_device->Scan()->PAT()->Detach();
+    PatSettled();
+  }
+}
+
+}
@@ -0,0 +1,124 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "Device.h"
+#include "TunerHandle.h"
+#include "channels/ChannelTypes.h"
+#include "lib/platform/threads/threads.h"
+
+#include <memory>
+#include <vector>
+
+namespace VDR
+{
+
+class cTransponder;
+
+/*!
+ * Keeps idle tuners locked to the channels numbered next to the ones being
+ * watched, with their PAT/PMT parsed, so that zapping to an adjacent channel
+ * takes over a tuner that is already locked instead of tuning from scratch.
+ *
+ * Pre-locked tuners hold TUNING_TYPE_PRELOCK handles, which any other
+ * subscription preempts. Device 0 is left alone, it remains the default
+ * tuner for live tv and the EPG scan.
+ */
+class cWarmTunerPool : protected PLATFORM::CThread
+{
+public:
+  static cWarmTunerPool& Get(void);
+  virtual ~cWarmTunerPool(void) { Stop(); }
+
+  /*!
+   * Start pre-locking if enabled in the settings and more than one device is available
+   */
+  void Start(void);
+  void Stop(void);
+
+  /*!
+   * Pre-lock the neighbours of a channel while the given handle is in use
+   */
+  void Watch(const TunerHandlePtr& handle, const ChannelPtr& channel);
+
+  /*!
+   * Get a device that is pre-locked to the given transponder
+   * @return The device, or cDevice::EmptyDevice if none is locked to it
+   */
+  DevicePtr GetDevice(const cTransponder& transponder);
+
+protected:
+  class cWarmTuner : public iTunerHandleCallbacks
+  {
+  public:
+    cWarmTuner(cWarmTunerPool* pool, const DevicePtr& device, const ChannelPtr& channel) : m_pool(pool), m_device(device), m_channel(channel), m_bLost(false) { }
+    virtual ~cWarmTuner(void) { }
+
+    void LockAcquired(void) { }
+    void LockLost(void) { }
+    void LostPriority(void) { m_pool->LostPriority(this); }
+
+    cWarmTunerPool* m_pool;
+    DevicePtr       m_device;
+    ChannelPtr      m_channel; // referenced by m_handle, must outlive it
+    TunerHandlePtr  m_handle;
+    bool            m_bLost;
+  };
+  typedef std::shared_ptr<cWarmTuner> WarmTunerPtr;
+
+  // The tests drive the pool without its thread
+  cWarmTunerPool(void) : m_bPatSettled(true) { }
+
+  virtual void* Process(void);
+
+  bool Tune(const DevicePtr& device, const ChannelPtr& channel);
+  void Release(const WarmTunerPtr& tuner);
+  void ReleaseAll(void);
+  void LostPriority(cWarmTuner* tuner);
+
+private:
+  struct sWatched
+  {
+    std::weak_ptr<cTunerHandle> handle;
+    ChannelPtr                  channel;
+  };
+
+  cWarmTunerPool(const cWarmTunerPool&); // no copy
+
+  void Update(void);
+  ChannelVector Neighbours(void);
+
+  /*!
+   * The PAT is attached and detached without holding m_mutex. Whoever takes
+   * a tuner's handle under m_mutex clears m_bPatSettled and calls
+   * PatSettled() when done, LostPriority() and Release() wait for it.
+   */
+  void PatSettled(void);
+
+  std::vector<sWatched>      m_watched; // most recent first
+  std::vector<WarmTunerPtr>  m_tuners;
+  std::vector<WarmTunerPtr>  m_lost;    // kept until the handle that preempted them is set up
+  PLATFORM::CMutex           m_mutex;
+  PLATFORM::CEvent           m_event;
+  bool                       m_bPatSettled;
+  PLATFORM::CCondition<bool> m_patSettledCondition;
+};
+
+}
@@ -0,0 +1,132 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FileDevice.h"
+#include "devices/file/subsystems/FileChannelSubsystem.h"
+#include "devices/file/subsystems/FileReceiverSubsystem.h"
+#include "devices/subsystems/DeviceCommonInterfaceSubsystem.h"
+#include "devices/subsystems/DeviceImageGrabSubsystem.h"
+#include "devices/subsystems/DevicePlayerSubsystem.h"
+#include "devices/subsystems/DeviceScanSubsystem.h"
+#include "devices/subsystems/DeviceSPUSubsystem.h"
+#include "devices/subsystems/DeviceTrackSubsystem.h"
+#include "devices/subsystems/DeviceVideoFormatSubsystem.h"
+#include "filesystem/Directory.h"
+#include "filesystem/File.h"
+#include "settings/Settings.h"
+#include "utils/log/Log.h"
+#include "utils/StringUtils.h"
+#include "utils/url/URLUtils.h"
+
+using namespace std;
+
+namespace VDR
+{
+
+cFileDevice::cFileDevice(const string& capturePath, bool bRealtime, bool bLoop)
+ : cDevice(CreateSubsystems(this)),
+   m_capturePath(capturePath),
+   m_bDirectory(CDirectory::Exists(capturePath)),
+   m_bRealtime(bRealtime),
+   m_bLoop(bLoop)
+{
+}
+
+cSubsystems cFileDevice::CreateSubsystems(cFileDevice* device)
+{
+  cSubsystems subsystems = { };
+
+  subsystems.Channel         = new cFileChannelSubsystem(device);
+  subsystems.Receiver        = new cFileReceiverSubsystem(device);
+
+  subsystems.CommonInterface = new cDeviceCommonInterfaceSubsystem(device);
+  subsystems.ImageGrab       = new cDeviceImageGrabSubsystem(device);
+  subsystems.Player          = new cDevicePlayerSubsystem(device);
+  subsystems.Scan            = new cDeviceScanSubsystem(device);
+  subsystems.SPU             = new cDeviceSPUSubsystem(device);
+  subsystems.Track           = new cDeviceTrackSubsystem(device);
+  subsystems.VideoFormat     = new cDeviceVideoFormatSubsystem(device);
+
+  return subsystems;
+}
+
+cFileDevice::~cFileDevice(void)
+{
+  Deinitialise();
+  m_subsystems.Free(); // TODO: Remove me if we switch cSubsystems to use shared_ptrs
+}
+
+DeviceVector cFileDevice::FindDevices(void)
+{
+  DeviceVector devices;
+
+  const string& capturePath = cSettings::Get().m_CapturePath;
+  if (capturePath.empty())
+    return devices;
+
+  if (!CDirectory::Exists(capturePath) && !CFile::Exists(capturePath))
+  {
+    esyslog("Capture path %s doesn't exist", capturePath.c_str());
+    return devices;
+  }
+
+  devices.push_back(DevicePtr(new cFileDevice(capturePath,
+                                              cSettings::Get().m_bCaptureRealtime,
+                                              cSettings::Get().m_bCaptureLoop)));
+  return devices;
+}
+
+string cFileDevice::Name(void) const
+{
+  return StringUtils::Format("TS capture (%s)", URLUtils::GetFileName(m_capturePath).c_str());
+}
+
+string cFileDevice::ID(void) const
+{
+  return m_capturePath;
+}
+
+string cFileDevice::GetCapture(unsigned int frequencyMHz) const
+{
+  if (!m_bDirectory)
+    return m_capturePath;
+
+  string strCapture = URLUtils::AddFileToFolder(m_capturePath, StringUtils::Format("%u%s", frequencyMHz, CAPTURE_FILE_EXTENSION));
+  if (CFile::Exists(strCapture))
+    return strCapture;
+
+  return "";
+}
+
+cFileChannelSubsystem *cFileDevice::FileChannel(void) const
+{
+  cFileChannelSubsystem *channel = dynamic_cast<cFileChannelSubsystem*>(Channel());
+  assert(channel);
+  return channel;
+}
+
+cFileReceiverSubsystem *cFileDevice::FileReceiver(void) const
+{
+  cFileReceiverSubsystem *receiver = dynamic_cast<cFileReceiverSubsystem*>(Receiver());
+  assert(receiver);
+  return receiver;
+}
+
+}
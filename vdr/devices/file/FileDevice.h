@@ -0,0 +1,85 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "devices/Device.h"
+#include "devices/DeviceTypes.h"
+
+#include <string>
+
+#define CAPTURE_FILE_EXTENSION  ".ts"
+
+namespace VDR
+{
+
+class cFileChannelSubsystem;
+class cFileReceiverSubsystem;
+
+/*!
+ * \brief A device that replays MPEG-TS captures instead of reading from
+ *        /dev/dvb hardware
+ *
+ * The capture path is either a single multi-program TS file, which "locks" to
+ * any transponder, or a directory containing one capture per transponder named
+ * after the transponder's frequency in MHz (e.g. 11494.ts, 482.ts). Packets are
+ * delivered at the rate given by the capture's PCR, or as fast as the receivers
+ * can consume them when real-time playback is disabled.
+ */
+class cFileDevice : public cDevice
+{
+public:
+  cFileDevice(const std::string& capturePath, bool bRealtime, bool bLoop);
+  virtual ~cFileDevice(void);
+
+  /*!
+   * \brief Create the capture devices configured in cSettings
+   * \return A vector of uninitialised devices, empty if no capture path is set
+   */
+  static DeviceVector FindDevices(void);
+
+  virtual std::string Name(void) const;
+  virtual std::string ID(void) const;
+
+  const std::string& CapturePath(void) const { return m_capturePath; }
+  bool IsDirectory(void) const { return m_bDirectory; }
+  bool Realtime(void) const { return m_bRealtime; }
+  bool Loop(void) const { return m_bLoop; }
+
+  /*!
+   * \brief Get the capture that provides the given frequency
+   * \return The path of the capture, or an empty string if the frequency isn't
+   *         present in the capture
+   */
+  std::string GetCapture(unsigned int frequencyMHz) const;
+
+  // Safely access subsystem subclasses
+  cFileChannelSubsystem  *FileChannel(void) const;
+  cFileReceiverSubsystem *FileReceiver(void) const;
+
+private:
+  static cSubsystems CreateSubsystems(cFileDevice* device);
+
+  const std::string m_capturePath;
+  const bool        m_bDirectory;
+  const bool        m_bRealtime;
+  const bool        m_bLoop;
+};
+
+}
@@ -0,0 +1,134 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FileChannelSubsystem.h"
+#include "FileReceiverSubsystem.h"
+#include "channels/Channel.h"
+#include "devices/file/FileDevice.h"
+#include "utils/log/Log.h"
+
+using namespace PLATFORM;
+using namespace std;
+
+namespace VDR
+{
+
+cFileChannelSubsystem::cFileChannelSubsystem(cDevice *device)
+ : cDeviceChannelSubsystem(device),
+   m_bLocked(false)
+{
+}
+
+bool cFileChannelSubsystem::ProvidesSource(TRANSPONDER_TYPE source) const
+{
+  // Captures are assumed to be DVB, so the scan subsystem attaches the DVB
+  // SI filters instead of the ATSC PSIP ones
+  return source != TRANSPONDER_ATSC;
+}
+
+bool cFileChannelSubsystem::ProvidesTransponder(const cChannel &channel) const
+{
+  const cTransponder& transponder = channel.GetTransponder();
+  if (!ProvidesSource(transponder.Type()))
+    return false;
+
+  return !Device<cFileDevice>()->GetCapture(transponder.FrequencyMHz()).empty();
+}
+
+bool cFileChannelSubsystem::SignalQuality(signal_quality_info_t& info) const
+{
+  const bool bLocked = HasLock();
+
+  info.status        = bLocked ? (signal_quality_status_t)(SIG_HAS_SIGNAL | SIG_HAS_CARRIER | SIG_HAS_VITERBI | SIG_HAS_SYNC | SIG_HAS_LOCK) :
+                                 (signal_quality_status_t)0;
+  info.status_string = bLocked ? "locked" : "no capture";
+  info.quality       = bLocked ? 100 : 0;
+  info.strength      = bLocked ? 100 : 0;
+  info.name          = Device()->Name();
+  info.snr           = bLocked ? 0xFFFF : 0;
+  info.signal        = bLocked ? 0xFFFF : 0;
+  info.ber           = 0;
+  info.unc           = 0;
+
+  return true;
+}
+
+cTransponder cFileChannelSubsystem::GetCurrentlyTunedTransponder(void) const
+{
+  CLockObject lock(m_mutex);
+  return m_transponder;
+}
+
+bool cFileChannelSubsystem::IsTunedToTransponder(const cTransponder& transponder) const
+{
+  CLockObject lock(m_mutex);
+  return m_bLocked && m_transponder == transponder;
+}
+
+bool cFileChannelSubsystem::HasLock(void) const
+{
+  CLockObject lock(m_mutex);
+  return m_bLocked;
+}
+
+bool cFileChannelSubsystem::Tune(const cTransponder& transponder)
+{
+  const string strCapture = Device<cFileDevice>()->GetCapture(transponder.FrequencyMHz());
+  if (strCapture.empty())
+  {
+    dsyslog("Capture device %s: no capture for %u MHz", Device()->ID().c_str(), transponder.FrequencyMHz());
+    return false;
+  }
+
+  if (!Device<cFileDevice>()->FileReceiver()->SetCapture(strCapture))
+    return false;
+
+  {
+    CLockObject lock(m_mutex);
+    m_transponder = transponder;
+    m_bLocked     = true;
+  }
+
+  dsyslog("Capture device %s: locked to %u MHz (%s)", Device()->ID().c_str(), transponder.FrequencyMHz(), strCapture.c_str());
+
+  SetChanged();
+  NotifyObservers(ObservableMessageChannelLock);
+
+  return true;
+}
+
+void cFileChannelSubsystem::ClearTransponder(const cTransponder& transponder)
+{
+  {
+    CLockObject lock(m_mutex);
+    if (!m_bLocked || m_transponder != transponder)
+      return;
+
+    m_transponder.Reset();
+    m_bLocked = false;
+  }
+
+  Device<cFileDevice>()->FileReceiver()->SetCapture("");
+
+  SetChanged();
+  NotifyObservers(ObservableMessageChannelLostLock);
+}
+
+}
@@ -0,0 +1,61 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "devices/subsystems/DeviceChannelSubsystem.h"
+#include "lib/platform/threads/mutex.h"
+#include "transponders/Transponder.h"
+
+namespace VDR
+{
+
+/*!
+ * \brief Tuner stub for cFileDevice. Tuning "locks" immediately when the
+ *        capture contains the requested transponder.
+ */
+class cFileChannelSubsystem : public cDeviceChannelSubsystem
+{
+public:
+  cFileChannelSubsystem(cDevice *device);
+  virtual ~cFileChannelSubsystem(void) { }
+
+  virtual bool ProvidesSource(TRANSPONDER_TYPE source) const;
+  virtual bool ProvidesTransponder(const cChannel &channel) const;
+  virtual bool ProvidesChannel(const cChannel &channel) const { return ProvidesTransponder(channel); }
+  virtual bool ProvidesEIT(void) const { return true; }
+  virtual unsigned int NumProvidedSystems(void) const { return 1; }
+  virtual int SignalStrength(void) const { return HasLock() ? 100 : 0; }
+  virtual int SignalQuality(void) const { return HasLock() ? 100 : 0; }
+  virtual bool SignalQuality(signal_quality_info_t& info) const;
+  virtual cTransponder GetCurrentlyTunedTransponder(void) const;
+  virtual bool IsTunedToTransponder(const cTransponder& transponder) const;
+  virtual bool HasLock(void) const;
+
+protected:
+  virtual bool Tune(const cTransponder& transponder);
+  virtual void ClearTransponder(const cTransponder& transponder);
+
+private:
+  cTransponder     m_transponder;
+  bool             m_bLocked;
+  PLATFORM::CMutex m_mutex;
+};
+
+}
@@ -0,0 +1,530 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FileReceiverSubsystem.h"
+#include "devices/file/FileDevice.h"
+#include "devices/Remux.h"
+#include "dvb/PsiBuffer.h"
+#include "lib/platform/util/timeutils.h"
+#include "utils/log/Log.h"
+#include "utils/StringUtils.h"
+
+#include <deque>
+#include <string.h>
+#include <time.h>
+
+using namespace PLATFORM;
+using namespace std;
+
+#define TS_PID_COUNT             0x2000
+#define CAPTURE_BUFFER_SIZE      (348 * TS_SIZE) // Read ~64 KB from the capture at a time
+#define MAX_SKIPPED_PACKETS      1024            // Return to the receiver loop after this many filtered packets
+#define MAX_PENDING_SECTIONS     64              // Sections queued per streaming resource before dropping
+#define POLL_TIMEOUT_MS          100
+#define PCR_TICKS_PER_MS         27000
+#define MAX_PCR_JUMP_MS          5000            // Larger PCR jumps are treated as a discontinuity
+
+namespace VDR
+{
+
+// --- cFileFilterTable --------------------------------------------------------
+
+class cFileStreamingResource;
+
+/*!
+ * PID -> filter lookup for the software demux. Shared between the subsystem
+ * and its resources so that resources outliving the subsystem (they are
+ * destroyed with the receiver table in ~cDeviceReceiverSubsystem) can still
+ * unregister themselves safely. Only accessed from the receiver thread.
+ */
+class cFileFilterTable
+{
+public:
+  cFileFilterTable(void) : m_multiplexed(TS_PID_COUNT), m_streaming(TS_PID_COUNT), m_pendingSections(0) { }
+
+  void AddMultiplexed(uint16_t pid)    { ++m_multiplexed[pid & (TS_PID_COUNT - 1)]; }
+  void RemoveMultiplexed(uint16_t pid) { --m_multiplexed[pid & (TS_PID_COUNT - 1)]; }
+  bool HasMultiplexed(uint16_t pid) const { return m_multiplexed[pid] > 0; }
+
+  void AddStreaming(cFileStreamingResource* resource);
+  void RemoveStreaming(cFileStreamingResource* resource);
+
+  /*!
+   * Feed a TS packet to the section filters of its PID
+   */
+  void FilterSections(uint16_t pid, const uint8_t* packet);
+
+  unsigned int PendingSections(void) const { return m_pendingSections; }
+  void SectionQueued(void)                 { ++m_pendingSections; }
+  void SectionsRemoved(unsigned int count) { m_pendingSections -= count; }
+
+private:
+  vector<unsigned int>                    m_multiplexed;
+  vector<vector<cFileStreamingResource*> > m_streaming;
+  unsigned int                            m_pendingSections;
+};
+
+// --- cFileResource -----------------------------------------------------------
+
+class cFileResource : public cPidResource
+{
+public:
+  cFileResource(uint16_t pid, RESOURCE_TYPE type, const FileFilterTablePtr& filters)
+   : cPidResource(pid),
+     m_filters(filters),
+     m_bOpen(false),
+     m_type(type)
+  {
+  }
+
+  virtual ~cFileResource(void) { }
+
+  RESOURCE_TYPE Type(void) const { return m_type; }
+  int Handle(void) const { return m_bOpen ? 0 : -1; }
+
+protected:
+  const FileFilterTablePtr m_filters;
+  bool                     m_bOpen;
+
+private:
+  const RESOURCE_TYPE      m_type;
+};
+
+// --- cFileStreamingResource --------------------------------------------------
+
+class cFileStreamingResource : public cFileResource
+{
+public:
+  cFileStreamingResource(uint16_t pid, uint8_t tid, uint8_t mask, const FileFilterTablePtr& filters)
+   : cFileResource(pid, RESOURCE_TYPE_STREAMING, filters),
+     m_tid(tid),
+     m_mask(mask)
+  {
+  }
+
+  virtual ~cFileStreamingResource(void) { Close(); }
+
+  virtual bool Equals(const cPidResource* other) const;
+  virtual bool Equals(uint16_t pid) const { return false; }
+
+  virtual bool Open(void);
+  virtual void Close(void);
+
+  virtual bool Read(const uint8_t** outdata, size_t* outlen);
+
+  /*!
+   * Assemble sections from the TS packet and queue the ones passing the filter
+   */
+  void AddTsData(const uint8_t* packet);
+  bool HasSection(void) const { return !m_sections.empty(); }
+
+  uint8_t Tid(void) const  { return m_tid; }
+  uint8_t Mask(void) const { return m_mask; }
+
+  virtual std::string ToString(void) const;
+
+private:
+  const uint8_t               m_tid;
+  const uint8_t               m_mask;
+  std::deque<vector<uint8_t> > m_sections;
+  vector<uint8_t>             m_section; // Section returned by the last Read()
+};
+
+bool cFileStreamingResource::Equals(const cPidResource* other) const
+{
+  const cFileStreamingResource* fileOther = dynamic_cast<const cFileStreamingResource*>(other);
+  return fileOther                   &&
+         Pid()  == fileOther->Pid()  &&
+         Tid()  == fileOther->Tid()  &&
+         Mask() == fileOther->Mask();
+}
+
+bool cFileStreamingResource::Open(void)
+{
+  if (!m_bOpen)
+  {
+    m_filters->AddStreaming(this);
+    m_bOpen = true;
+  }
+  return true;
+}
+
+void cFileStreamingResource::Close(void)
+{
+  if (m_bOpen)
+  {
+    m_filters->RemoveStreaming(this);
+    m_filters->SectionsRemoved(m_sections.size());
+    m_sections.clear();
+    m_bOpen = false;
+  }
+}
+
+void cFileStreamingResource::AddTsData(const uint8_t* packet)
+{
+  cPsiBuffer* buffer = Buffer();
+  if (!buffer)
+    return;
+
+  const uint8_t* section;
+  size_t sectionLen;
+  if (buffer->AddTsData(packet, TS_SIZE, &section, &sectionLen) && sectionLen > 0)
+  {
+    if ((section[0] & m_mask) != (m_tid & m_mask))
+      return;
+
+    if (m_sections.size() >= MAX_PENDING_SECTIONS)
+    {
+      dsyslog("Dropped section on %s: receiver too slow", ToString().c_str());
+      return;
+    }
+
+    m_sections.push_back(vector<uint8_t>(section, section + sectionLen));
+    m_filters->SectionQueued();
+  }
+}
+
+bool cFileStreamingResource::Read(const uint8_t** outdata, size_t* outlen)
+{
+  if (m_sections.empty())
+    return false;
+
+  m_section.swap(m_sections.front());
+  m_sections.pop_front();
+  m_filters->SectionsRemoved(1);
+
+  *outdata = m_section.data();
+  *outlen  = m_section.size();
+  return true;
+}
+
+std::string cFileStreamingResource::ToString(void) const
+{
+  return StringUtils::Format("[PID %04d, TID 0x%02X, MASK 0x%02X]", Pid(), m_tid, m_mask);
+}
+
+// --- cFileMultiplexedResource ------------------------------------------------
+
+class cFileMultiplexedResource : public cFileResource
+{
+public:
+  cFileMultiplexedResource(uint16_t pid, STREAM_TYPE streamType, const FileFilterTablePtr& filters)
+   : cFileResource(pid, RESOURCE_TYPE_MULTIPLEXING, filters),
+     m_streamType(streamType)
+  {
+  }
+
+  virtual ~cFileMultiplexedResource(void) { Close(); }
+
+  virtual bool Equals(const cPidResource* other) const;
+  virtual bool Equals(uint16_t pid) const { return Pid() == pid; }
+
+  virtual bool Open(void);
+  virtual void Close(void);
+
+  uint8_t StreamType(void) const { return m_streamType; }
+  std::string ToString(void) const;
+
+private:
+  const STREAM_TYPE m_streamType;
+};
+
+bool cFileMultiplexedResource::Equals(const cPidResource* other) const
+{
+  const cFileMultiplexedResource* fileOther = dynamic_cast<const cFileMultiplexedResource*>(other);
+  return fileOther && Pid() == fileOther->Pid();
+}
+
+bool cFileMultiplexedResource::Open(void)
+{
+  if (!m_bOpen)
+  {
+    m_filters->AddMultiplexed(Pid());
+    m_bOpen = true;
+  }
+  return true;
+}
+
+void cFileMultiplexedResource::Close(void)
+{
+  if (m_bOpen)
+  {
+    m_filters->RemoveMultiplexed(Pid());
+    m_bOpen = false;
+  }
+}
+
+std::string cFileMultiplexedResource::ToString(void) const
+{
+  return StringUtils::Format("[PID %04d, Type 0x%02X]", Pid(), StreamType());
+}
+
+// --- cFileFilterTable --------------------------------------------------------
+
+void cFileFilterTable::AddStreaming(cFileStreamingResource* resource)
+{
+  m_streaming[resource->Pid() & (TS_PID_COUNT - 1)].push_back(resource);
+}
+
+void cFileFilterTable::RemoveStreaming(cFileStreamingResource* resource)
+{
+  vector<cFileStreamingResource*>& filters = m_streaming[resource->Pid() & (TS_PID_COUNT - 1)];
+  for (vector<cFileStreamingResource*>::iterator it = filters.begin(); it != filters.end(); ++it)
+  {
+    if (*it == resource)
+    {
+      filters.erase(it);
+      break;
+    }
+  }
+}
+
+void cFileFilterTable::FilterSections(uint16_t pid, const uint8_t* packet)
+{
+  const vector<cFileStreamingResource*>& filters = m_streaming[pid];
+  for (vector<cFileStreamingResource*>::const_iterator it = filters.begin(); it != filters.end(); ++it)
+    (*it)->AddTsData(packet);
+}
+
+// --- cFileReceiverSubsystem --------------------------------------------------
+
+cFileReceiverSubsystem::cFileReceiverSubsystem(cDevice *device)
+ : cDeviceReceiverSubsystem(device),
+   m_filters(new cFileFilterTable),
+   m_bCaptureChanged(false),
+   m_bEof(false),
+   m_buffer(CAPTURE_BUFFER_SIZE),
+   m_bufferPos(0),
+   m_bufferLen(0),
+   m_pcrBase(-1),
+   m_clockBase(0),
+   m_bTimestamps(false),
+   m_packetReadNs(0)
+{
+}
+
+bool cFileReceiverSubsystem::SetCapture(const string& strCapture)
+{
+  CLockObject lock(m_captureMutex);
+  m_strNextCapture  = strCapture;
+  m_bCaptureChanged = true;
+  return true;
+}
+
+bool cFileReceiverSubsystem::Initialise(void)
+{
+  // The capture is opened when a transponder is tuned
+  return true;
+}
+
+void cFileReceiverSubsystem::Deinitialise(void)
+{
+  m_file.Close();
+  m_bEof      = false;
+  m_bufferPos = 0;
+  m_bufferLen = 0;
+  ResetClock();
+}
+
+void cFileReceiverSubsystem::UpdateCapture(void)
+{
+  string strCapture;
+  {
+    CLockObject lock(m_captureMutex);
+    if (!m_bCaptureChanged)
+      return;
+    strCapture = m_strNextCapture;
+    m_bCaptureChanged = false;
+  }
+
+  Deinitialise();
+
+  if (!strCapture.empty())
+  {
+    if (m_file.Open(strCapture))
+      dsyslog("Replaying capture %s on device %d", strCapture.c_str(), Device()->Index());
+    else
+      esyslog("Failed to open capture %s", strCapture.c_str());
+  }
+}
+
+bool cFileReceiverSubsystem::FillBuffer(void)
+{
+  // Keep the remainder of a partial packet
+  const size_t remaining = m_bufferLen - m_bufferPos;
+  if (remaining > 0 && m_bufferPos > 0)
+    memmove(m_buffer.data(), m_buffer.data() + m_bufferPos, remaining);
+  m_bufferPos = 0;
+  m_bufferLen = remaining;
+
+  int64_t bytesRead = m_file.Read(m_buffer.data() + m_bufferLen, m_buffer.size() - m_bufferLen);
+  if (bytesRead <= 0 && Device<cFileDevice>()->Loop() && m_file.Seek(0, SEEK_SET) == 0)
+  {
+    // Start over, the PCR will jump back to the start of the capture
+    m_bufferLen = 0;
+    ResetClock();
+    bytesRead = m_file.Read(m_buffer.data(), m_buffer.size());
+  }
+
+  if (bytesRead <= 0)
+  {
+    dsyslog("End of capture reached on device %d", Device()->Index());
+    m_bEof = true;
+    return false;
+  }
+
+  m_bufferLen += bytesRead;
+  return m_bufferLen >= TS_SIZE;
+}
+
+void cFileReceiverSubsystem::ResetClock(void)
+{
+  m_pcrBase   = -1;
+  m_clockBase = 0;
+}
+
+unsigned int cFileReceiverSubsystem::GetDelay(const uint8_t* packet)
+{
+  const int64_t pcr = TsGetPcr(packet);
+  if (pcr < 0)
+    return 0;
+
+  const int64_t now = GetTimeMs();
+  if (m_pcrBase < 0)
+  {
+    m_pcrBase   = pcr;
+    m_clockBase = now;
+    return 0;
+  }
+
+  const int64_t pcrMs = (pcr - m_pcrBase) / PCR_TICKS_PER_MS;
+  if (pcrMs < 0 || pcrMs - (now - m_clockBase) > MAX_PCR_JUMP_MS)
+  {
+    // PCR discontinuity or wrap around, resynchronise the clock
+    m_pcrBase   = pcr;
+    m_clockBase = now;
+    return 0;
+  }
+
+  const int64_t delay = pcrMs - (now - m_clockBase);
+  return delay > 0 ? (unsigned int)delay : 0;
+}
+
+cDeviceReceiverSubsystem::PidResourcePtr cFileReceiverSubsystem::GetPendingResource(void) const
+{
+  for (ReceiverPidTable::const_iterator it = m_receiverPidTable.begin(); it != m_receiverPidTable.end(); ++it)
+  {
+    for (ReceiverList::const_iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2)
+    {
+      if (it2->second->Type() == RESOURCE_TYPE_STREAMING &&
+          static_cast<cFileStreamingResource*>(it2->second.get())->HasSection())
+        return it2->second;
+    }
+  }
+  return PidResourcePtr();
+}
+
+POLL_RESULT cFileReceiverSubsystem::Poll(PidResourcePtr& streamingResource)
+{
+  if (m_filters->PendingSections() > 0)
+  {
+    streamingResource = GetPendingResource();
+    if (streamingResource)
+      return POLL_RESULT_STREAMING_READY;
+  }
+
+  UpdateCapture();
+
+  if (!m_file.IsOpen() || m_bEof)
+  {
+    Sleep(POLL_TIMEOUT_MS);
+    return POLL_RESULT_NOT_READY;
+  }
+
+  return POLL_RESULT_MULTIPLEXED_READY;
+}
+
+TsPacket cFileReceiverSubsystem::ReadMultiplexed(void)
+{
+  for (unsigned int i = 0; i < MAX_SKIPPED_PACKETS; i++)
+  {
+    if (m_bufferLen - m_bufferPos < TS_SIZE && !FillBuffer())
+      return NULL;
+
+    uint8_t* packet = m_buffer.data() + m_bufferPos;
+
+    // Check for TS sync byte
+    if (packet[0] != TS_SYNC_BYTE)
+    {
+      size_t skipped = 1;
+      while (m_bufferPos + skipped < m_bufferLen && packet[skipped] != TS_SYNC_BYTE)
+        ++skipped;
+      m_bufferPos += skipped;
+      esyslog("Skipped %u bytes to sync on TS packet on device %d", (unsigned int)skipped, Device()->Index());
+      continue;
+    }
+
+    if (Device<cFileDevice>()->Realtime())
+    {
+      // Not due yet, leave it in the buffer and let the receiver loop process changes
+      unsigned int delay = GetDelay(packet);
+      if (delay > 0)
+      {
+        Sleep(min(delay, (unsigned int)POLL_TIMEOUT_MS));
+        return NULL;
+      }
+    }
+
+    const uint16_t pid = TsPid(packet);
+    m_filters->FilterSections(pid, packet);
+
+    if (m_filters->HasMultiplexed(pid))
+    {
+      if (m_bTimestamps)
+      {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        m_packetReadNs = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+      }
+      return packet; // Removed from the buffer by Consumed()
+    }
+
+    m_bufferPos += TS_SIZE;
+  }
+
+  return NULL;
+}
+
+void cFileReceiverSubsystem::Consumed(void)
+{
+  m_bufferPos += TS_SIZE;
+}
+
+cDeviceReceiverSubsystem::PidResourcePtr cFileReceiverSubsystem::CreateStreamingResource(uint16_t pid, uint8_t tid, uint8_t mask)
+{
+  return PidResourcePtr(new cFileStreamingResource(pid, tid, mask, m_filters));
+}
+
+cDeviceReceiverSubsystem::PidResourcePtr cFileReceiverSubsystem::CreateMultiplexedResource(uint16_t pid, STREAM_TYPE streamType)
+{
+  return PidResourcePtr(new cFileMultiplexedResource(pid, streamType, m_filters));
+}
+
+}
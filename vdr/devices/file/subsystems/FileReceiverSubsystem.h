@@ -0,0 +1,111 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "devices/subsystems/DeviceReceiverSubsystem.h"
+#include "filesystem/File.h"
+#include "lib/platform/threads/mutex.h"
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace VDR
+{
+
+class cFileFilterTable;
+typedef std::shared_ptr<cFileFilterTable> FileFilterTablePtr;
+
+/*!
+ * \brief Receiver subsystem for cFileDevice
+ *
+ * Reads TS packets from the capture selected by cFileChannelSubsystem::Tune()
+ * and applies the PID and section filters in software: packets are only handed
+ * to multiplexed receivers if their PID has been requested, and sections are
+ * assembled and matched against (tid, mask) for streaming receivers, just like
+ * the kernel demux would do for cDvbReceiverSubsystem.
+ */
+class cFileReceiverSubsystem : public cDeviceReceiverSubsystem
+{
+public:
+  cFileReceiverSubsystem(cDevice *device);
+  virtual ~cFileReceiverSubsystem(void) { }
+
+  /*!
+   * \brief Switch to another capture. Takes effect on the receiver thread.
+   * \param strCapture The capture to replay, or empty to stop replaying
+   */
+  bool SetCapture(const std::string& strCapture);
+
+  /*!
+   * \brief Note the time each multiplexed packet is read from the capture, to
+   *        measure how long it takes to reach the receivers
+   */
+  void SetTimestamps(bool bEnabled) { m_bTimestamps = bEnabled; }
+
+  /*!
+   * \brief Monotonic time (ns) the packet being dispatched was read, if
+   *        timestamps are enabled. Only valid on the receiver thread.
+   */
+  uint64_t PacketReadNs(void) const { return m_packetReadNs; }
+
+protected:
+  virtual bool Initialise(void);
+  virtual void Deinitialise(void);
+
+  virtual POLL_RESULT Poll(PidResourcePtr& streamingResource);
+  virtual TsPacket ReadMultiplexed(void);
+  virtual void Consumed(void);
+  virtual PidResourcePtr CreateStreamingResource(uint16_t pid, uint8_t tid, uint8_t mask);
+  virtual PidResourcePtr CreateMultiplexedResource(uint16_t pid, STREAM_TYPE streamType);
+
+private:
+  void UpdateCapture(void);
+  bool FillBuffer(void);
+  PidResourcePtr GetPendingResource(void) const;
+
+  /*!
+   * \brief Number of milliseconds to wait before the packet is due according to
+   *        the capture's PCR, or 0 if it can be delivered now
+   */
+  unsigned int GetDelay(const uint8_t* packet);
+  void ResetClock(void);
+
+  FileFilterTablePtr   m_filters;
+
+  PLATFORM::CMutex     m_captureMutex;
+  std::string          m_strNextCapture;
+  bool                 m_bCaptureChanged;
+
+  CFile                m_file;
+  bool                 m_bEof;
+  std::vector<uint8_t> m_buffer;
+  size_t               m_bufferPos;
+  size_t               m_bufferLen;
+
+  int64_t              m_pcrBase;   // PCR of the first packet since ResetClock(), or -1
+  int64_t              m_clockBase; // Wall clock (ms) at m_pcrBase
+
+  bool                 m_bTimestamps;
+  uint64_t             m_packetReadNs;
+};
+
+}
@@ -0,0 +1,170 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "devices/Receiver.h"
+#include "devices/Remux.h"
+#include "devices/file/FileDevice.h"
+#include "devices/file/subsystems/FileReceiverSubsystem.h"
+#include "filesystem/File.h"
+#include "lib/platform/threads/mutex.h"
+#include "settings/Settings.h"
+
+#include "gtest/gtest.h"
+
+#include <string.h>
+#include <vector>
+
+using namespace PLATFORM;
+
+#define CAPTURE_FILE        "special://temp/TestFileDevice.ts"
+#define REPLAY_TIMEOUT_MS   5000
+
+namespace VDR
+{
+
+namespace
+{
+  class cCollectingReceiver : public iReceiver
+  {
+  public:
+    cCollectingReceiver(size_t expected) : m_expected(expected), m_bDone(false) { }
+
+    virtual bool Start(void) { return true; }
+    virtual void Stop(void) { }
+
+    virtual void Receive(const uint16_t pid, const uint8_t* data, const size_t len, ts_crc_check_t& crcvalid)
+    {
+      CLockObject lock(m_mutex);
+      m_data.insert(m_data.end(), data, data + len);
+      if (m_data.size() / TS_SIZE >= m_expected)
+      {
+        m_bDone = true;
+        m_condition.Signal();
+      }
+    }
+
+    bool WaitForPackets(uint32_t iTimeoutMs)
+    {
+      CLockObject lock(m_mutex);
+      return m_condition.Wait(m_mutex, m_bDone, iTimeoutMs);
+    }
+
+    std::vector<uint8_t> Data(void)
+    {
+      CLockObject lock(m_mutex);
+      return m_data;
+    }
+
+  private:
+    const size_t         m_expected;
+    std::vector<uint8_t> m_data;
+    CMutex               m_mutex;
+    CCondition<bool>     m_condition;
+    bool                 m_bDone;
+  };
+
+  void AppendPacket(std::vector<uint8_t>& data, uint16_t pid, uint8_t counter)
+  {
+    uint8_t packet[TS_SIZE];
+    memset(packet, counter, TS_SIZE);
+    packet[0] = TS_SYNC_BYTE;
+    packet[1] = (pid >> 8) & TS_PID_MASK_HI;
+    packet[2] = pid & 0xFF;
+    packet[3] = TS_PAYLOAD_EXISTS | (counter & TS_CONT_CNT_MASK);
+    data.insert(data.end(), packet, packet + TS_SIZE);
+  }
+
+  bool WriteCapture(const std::vector<uint8_t>& data)
+  {
+    CFile file;
+    return file.OpenForWrite(CAPTURE_FILE, true) && file.Write(data.data(), data.size()) == (int64_t)data.size();
+  }
+}
+
+TEST(FileDevice, FindDevices)
+{
+  const std::string capturePath = cSettings::Get().m_CapturePath;
+
+  cSettings::Get().m_CapturePath = "";
+  EXPECT_TRUE(cFileDevice::FindDevices().empty());
+
+  cSettings::Get().m_CapturePath = "special://temp/missing.ts";
+  EXPECT_TRUE(cFileDevice::FindDevices().empty());
+
+  std::vector<uint8_t> data;
+  AppendPacket(data, 0x100, 0);
+  ASSERT_TRUE(WriteCapture(data));
+
+  cSettings::Get().m_CapturePath = CAPTURE_FILE;
+  DeviceVector devices = cFileDevice::FindDevices();
+  ASSERT_EQ(1u, devices.size());
+  cFileDevice* device = dynamic_cast<cFileDevice*>(devices[0].get());
+  ASSERT_TRUE(device != NULL);
+  EXPECT_EQ(CAPTURE_FILE, device->CapturePath());
+  EXPECT_FALSE(device->IsDirectory());
+
+  // A single file provides every transponder
+  EXPECT_EQ(CAPTURE_FILE, device->GetCapture(482));
+
+  cSettings::Get().m_CapturePath = capturePath;
+  CFile::Delete(CAPTURE_FILE);
+}
+
+TEST(FileDevice, Replay)
+{
+  // Two PIDs interleaved, only one of them is received
+  std::vector<uint8_t> data;
+  for (unsigned int i = 0; i < 20; i++)
+  {
+    AppendPacket(data, 0x100, i);
+    if (i % 2)
+      AppendPacket(data, 0x200, i);
+  }
+  ASSERT_TRUE(WriteCapture(data));
+
+  cFileDevice device(CAPTURE_FILE, false, false);
+  ASSERT_TRUE(device.Initialise(0));
+
+  cCollectingReceiver receiver(20);
+  device.Receiver()->AttachMultiplexedReceiver(&receiver, 0x100);
+  device.Receiver()->SyncPids(true);
+
+  device.FileReceiver()->SetCapture(CAPTURE_FILE);
+  const bool bFinished = receiver.WaitForPackets(REPLAY_TIMEOUT_MS);
+
+  device.Receiver()->DetachAllReceivers(true);
+  device.Deinitialise();
+  CFile::Delete(CAPTURE_FILE);
+
+  ASSERT_TRUE(bFinished);
+
+  // The packets of the PID arrive complete and in order
+  const std::vector<uint8_t> received = receiver.Data();
+  ASSERT_EQ(20 * TS_SIZE, received.size());
+  for (unsigned int i = 0; i < 20; i++)
+  {
+    const uint8_t* packet = received.data() + i * TS_SIZE;
+    EXPECT_EQ(0x100, TsPid(packet));
+    EXPECT_EQ(i & TS_CONT_CNT_MASK, TsGetContinuityCounter(packet));
+    EXPECT_EQ(i, packet[TS_SIZE - 1]);
+  }
+}
+
+}
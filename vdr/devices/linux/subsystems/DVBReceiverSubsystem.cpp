@@ -23,6 +23,7 @@
 #include "devices/Remux.h"
 #include "devices/linux/DVBDevice.h"
 #include "dvb/PsiBuffer.h" // for PSI_MAX_SIZE
+#include "dvb/SectionAssembler.h"
 #include "filesystem/File.h"
 #include "filesystem/Poller.h"
 #include "utils/log/Log.h"
@@ -30,6 +31,7 @@
 #include "utils/StringUtils.h"
 #include "utils/Tools.h"
 
+#include <algorithm>
 #include <fcntl.h>
 #include <poll.h>
 #include <string>
@@ -39,10 +41,15 @@
 
 using namespace std;
 
-#define TS_PACKET_BUFFER_SIZE    (25 * TS_SIZE) // Buffer up to 25 TS packets
+#define TS_PACKET_BUFFER_SIZE    (348 * TS_SIZE) // Read up to ~64 KB from the DVR at a time
 #define FILE_DESCRIPTOR_INVALID  (-1)
 #define POLL_TIMEOUT_MS          100
 
+#define TS_PID_FULL_TS           0x2000 // Demux filter PID that passes the full TS
+#define MAX_KERNEL_FILTERS       32     // Switch to software filtering above this many filters...
+#define MIN_KERNEL_FILTERS       24     // ...and back below this many
+#define MAX_FILTERED_PACKETS     1024   // Return to the receiver loop after this many filtered packets
+
 #define PID_DEBUGGING(x...) dsyslog(x)
 //#define PID_DEBUGGING(x...) {}
 
@@ -54,10 +61,11 @@ namespace VDR
 class cDvbResource : public cPidResource
 {
 public:
-  cDvbResource(uint16_t pid, RESOURCE_TYPE type, const cDvbDevice* device)
+  cDvbResource(uint16_t pid, RESOURCE_TYPE type, const cDvbDevice* device, bool bSoftware)
    : cPidResource(pid),
      m_handle(FILE_DESCRIPTOR_INVALID),
      m_device(device),
+     m_bSoftware(bSoftware),
      m_type(type)
   {
   }
@@ -69,9 +77,17 @@ public:
 
   virtual void Close(void);
 
+  /*!
+   * In software mode no kernel filter is opened, the resource is fed from the
+   * full TS instead. Reopens the resource if the mode changed.
+   */
+  bool SetSoftware(bool bSoftware);
+  bool Software(void) const { return m_bSoftware; }
+
 protected:
   int                     m_handle;
   const cDvbDevice* const m_device;
+  bool                    m_bSoftware;
   PLATFORM::CMutex        m_mutex;
 
 private:
@@ -92,20 +108,33 @@ void cDvbResource::Close(void)
   }
 }
 
+bool cDvbResource::SetSoftware(bool bSoftware)
+{
+  if (bSoftware == m_bSoftware)
+    return true;
+
+  Close();
+  m_bSoftware = bSoftware;
+  return Open();
+}
+
 // --- cDvbStreamingResource ------------------------------------------------
 
 class cDvbStreamingResource : public cDvbResource
 {
 public:
-  cDvbStreamingResource(uint16_t pid, uint8_t tid, uint8_t mask, const cDvbDevice* device)
-   : cDvbResource(pid, RESOURCE_TYPE_STREAMING, device),
+  cDvbStreamingResource(uint16_t pid, uint8_t tid, uint8_t mask, const cDvbDevice* device, bool bSoftware)
+   : cDvbResource(pid, RESOURCE_TYPE_STREAMING, device, bSoftware),
      m_tid(tid),
-     m_mask(mask)
+     m_mask(mask),
+     m_assembler(tid, mask)
   {
   }
 
   virtual ~cDvbStreamingResource(void) { Close(); }
 
+  virtual void Close(void);
+
   virtual bool Equals(const cPidResource* other) const;
   virtual bool Equals(uint16_t pid) const { return false; }
 
@@ -113,14 +142,21 @@ public:
 
   virtual bool Read(const uint8_t** outdata, size_t* outlen);
 
+  /*!
+   * Software mode: assembles the sections from the TS packets of the PID
+   */
+  cSectionAssembler& Assembler(void) { return m_assembler; }
+
   uint8_t Tid(void) const  { return m_tid; }
   uint8_t Mask(void) const { return m_mask; }
 
   virtual std::string ToString(void) const;
 
 private:
-  uint8_t m_tid;
-  uint8_t m_mask;
+  uint8_t              m_tid;
+  uint8_t              m_mask;
+  cSectionAssembler    m_assembler; // Software mode
+  std::vector<uint8_t> m_section;   // Last section read in software mode
 };
 
 bool cDvbStreamingResource::Equals(const cPidResource* other) const
@@ -136,6 +172,13 @@ bool cDvbStreamingResource::Open(void)
 {
   // Calculate strings
   PLATFORM::CLockObject lock(m_mutex);
+  if (m_bSoftware)
+  {
+    m_assembler.Reset();
+    PID_DEBUGGING("Opened %s in software", ToString().c_str());
+    return true;
+  }
+
   if (m_handle == FILE_DESCRIPTOR_INVALID)
   {
     m_handle = open(m_device->DvbPath(DEV_DVB_DEMUX).c_str(), O_RDWR | O_NONBLOCK);
@@ -167,14 +210,32 @@ bool cDvbStreamingResource::Open(void)
   return true;
 }
 
+void cDvbStreamingResource::Close(void)
+{
+  cDvbResource::Close();
+
+  PLATFORM::CLockObject lock(m_mutex);
+  m_assembler.Reset();
+}
+
 bool cDvbStreamingResource::Read(const uint8_t** outdata, size_t* outlen)
 {
+  if (m_bSoftware)
+  {
+    if (!m_assembler.GetSection(m_section))
+      return false;
+
+    *outdata = m_section.data();
+    *outlen  = m_section.size();
+    return true;
+  }
+
   cPsiBuffer* buffer = Buffer();
   if (!buffer)
     return false;
 
   ssize_t bytesRead = safe_read(m_handle, buffer->Data(), PSI_MAX_SIZE);
-  if (read > 0)
+  if (bytesRead > 0)
   {
     *outdata = buffer->Data();
     *outlen  = bytesRead;
@@ -193,8 +254,8 @@ std::string cDvbStreamingResource::ToString(void) const
 class cDvbMultiplexedResource : public cDvbResource
 {
 public:
-  cDvbMultiplexedResource(uint16_t pid, STREAM_TYPE streamType, const cDvbDevice* device)
-   : cDvbResource(pid, RESOURCE_TYPE_MULTIPLEXING, device),
+  cDvbMultiplexedResource(uint16_t pid, STREAM_TYPE streamType, const cDvbDevice* device, bool bSoftware)
+   : cDvbResource(pid, RESOURCE_TYPE_MULTIPLEXING, device, bSoftware),
      m_streamType(streamType)
   {
   }
@@ -223,6 +284,12 @@ bool cDvbMultiplexedResource::Open(void)
 {
   // Calculate strings
   PLATFORM::CLockObject lock(m_mutex);
+  if (m_bSoftware)
+  {
+    PID_DEBUGGING("Opened %s in software", ToString().c_str());
+    return true;
+  }
+
   if (m_handle == FILE_DESCRIPTOR_INVALID)
   {
     m_handle = open(m_device->DvbPath(DEV_DVB_DEMUX).c_str(), O_RDWR | O_NONBLOCK);
@@ -264,7 +331,14 @@ std::string cDvbMultiplexedResource::ToString(void) const
 cDvbReceiverSubsystem::cDvbReceiverSubsystem(cDevice *device)
  : cDeviceReceiverSubsystem(device),
    m_fd_dvr(FILE_DESCRIPTOR_INVALID),
-   m_ringBuffer(TS_PACKET_BUFFER_SIZE, TS_SIZE, false, "TS")
+   m_ringBuffer(TS_PACKET_BUFFER_SIZE, TS_SIZE, false, "TS"),
+   m_bMultiplexedReady(false),
+   m_bPollSetChanged(true),
+   m_fd_ts(FILE_DESCRIPTOR_INVALID),
+   m_bSoftwareFilter(false),
+   m_bFullTsUnsupported(false),
+   m_bHeadFiltered(false),
+   m_multiplexedPids(MAXPID)
 {
 }
 
@@ -276,11 +350,16 @@ bool cDvbReceiverSubsystem::Initialise(void)
   if (m_fd_dvr == FILE_DESCRIPTOR_INVALID)
     return false;
 
+  m_bFullTsUnsupported = false;
+  m_bPollSetChanged = true;
   return true;
 }
 
 void cDvbReceiverSubsystem::Deinitialise(void)
 {
+  CloseFullTs();
+  m_bSoftwareFilter = false;
+
   if (m_fd_dvr >= 0)
   {
     close(m_fd_dvr);
@@ -288,82 +367,248 @@ void cDvbReceiverSubsystem::Deinitialise(void)
   }
 
   m_ringBuffer.Clear();
+  m_bHeadFiltered = false;
+  m_bPollSetChanged = true;
 }
 
-POLL_RESULT cDvbReceiverSubsystem::Poll(PidResourcePtr& streamingResource)
+bool cDvbReceiverSubsystem::OpenFullTs(void)
+{
+  if (m_fd_ts != FILE_DESCRIPTOR_INVALID)
+    return true;
+
+  m_fd_ts = open(Device<cDvbDevice>()->DvbPath(DEV_DVB_DEMUX).c_str(), O_RDWR | O_NONBLOCK);
+  if (m_fd_ts == FILE_DESCRIPTOR_INVALID)
+  {
+    esyslog("Couldn't open the full TS on device %d: invalid handle", Device()->Index());
+    return false;
+  }
+
+  dmx_pes_filter_params pesFilterParams = { };
+
+  pesFilterParams.pid     = TS_PID_FULL_TS;
+  pesFilterParams.input   = DMX_IN_FRONTEND;
+  pesFilterParams.output  = DMX_OUT_TS_TAP;
+  pesFilterParams.pes_type= DMX_PES_OTHER;
+  pesFilterParams.flags   = DMX_IMMEDIATE_START;
+
+  if (ioctl(m_fd_ts, DMX_SET_PES_FILTER, &pesFilterParams) < 0)
+  {
+    esyslog("Couldn't open the full TS on device %d: ioctl failed - %s", Device()->Index(), strerror(errno));
+    close(m_fd_ts);
+    m_fd_ts = FILE_DESCRIPTOR_INVALID;
+    m_bFullTsUnsupported = true; // Don't try again until the device is reinitialised
+    return false;
+  }
+
+  return true;
+}
+
+void cDvbReceiverSubsystem::CloseFullTs(void)
+{
+  if (m_fd_ts != FILE_DESCRIPTOR_INVALID)
+  {
+    if (ioctl(m_fd_ts, DMX_STOP) < 0)
+      LOG_ERROR;
+
+    close(m_fd_ts);
+    m_fd_ts = FILE_DESCRIPTOR_INVALID;
+  }
+}
+
+void cDvbReceiverSubsystem::UpdateFilterMode(const vector<PidResourcePtr>& resources)
+{
+  bool bSoftware = resources.size() > (m_bSoftwareFilter ? MIN_KERNEL_FILTERS : MAX_KERNEL_FILTERS);
+
+  if (bSoftware != m_bSoftwareFilter)
+  {
+    if (bSoftware)
+    {
+      bSoftware = !m_bFullTsUnsupported && OpenFullTs();
+      if (bSoftware)
+        isyslog("Device %d needs %u demux filters, filtering the full TS in software", Device()->Index(), (unsigned int)resources.size());
+    }
+    else
+    {
+      isyslog("Device %d needs %u demux filters, returning to kernel filters", Device()->Index(), (unsigned int)resources.size());
+    }
+
+    // Packets already in the buffer were filtered for the old set of filters
+    m_bHeadFiltered = false;
+  }
+
+  // Resources created while the mode was switching might still be in the old mode
+  for (vector<PidResourcePtr>::const_iterator it = resources.begin(); it != resources.end(); ++it)
+  {
+    if (!static_cast<cDvbResource*>(it->get())->SetSoftware(bSoftware))
+      esyslog("Couldn't reopen %s", (*it)->ToString().c_str());
+  }
+
+  // Close the full TS only once the kernel filters are back
+  if (!bSoftware)
+    CloseFullTs();
+
+  m_bSoftwareFilter = bSoftware;
+}
+
+void cDvbReceiverSubsystem::ResourcesChanged(void)
+{
+  // Don't keep detached resources, and their filters, open until the next poll
+  m_pollResources.clear();
+  m_readyResources.clear();
+  m_sectionFilters.Clear();
+  m_bPollSetChanged = true;
+}
+
+void cDvbReceiverSubsystem::UpdatePollSet(void)
 {
   bool bMultiplexedResources = false; // Set to true if any resources are multiplexed
+  vector<PidResourcePtr> resources;   // Every resource once, each needs a kernel filter
 
-  // Build a list of file descriptors to poll
-  vector<pollfd> vecPfds;
+  m_pollfds.clear();
+  m_pollResources.clear();
+  m_readyResources.clear();
+  m_bMultiplexedReady = false;
 
-  // Add the file descriptors of all streaming resources
   for (ReceiverPidTable::const_iterator it = m_receiverPidTable.begin(); it != m_receiverPidTable.end(); ++it)
   {
     for (ReceiverList::const_iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2)
     {
-      switch (it2->second->Type())
-      {
-        case RESOURCE_TYPE_STREAMING:
-          {
-            pollfd pfd = { it2->second->Handle(), POLLIN | POLLERR, 0 };
-            vecPfds.push_back(pfd);
-          }
-          break;
-        case RESOURCE_TYPE_MULTIPLEXING:
-          bMultiplexedResources = true;
-          break;
-        default:
-          break;
-      }
+      if (std::find(resources.begin(), resources.end(), it2->second) == resources.end())
+        resources.push_back(it2->second);
     }
   }
 
-  // Add the file descriptor for the multiplexed resources
-  if (bMultiplexedResources)
+  UpdateFilterMode(resources);
+
+  m_sectionFilters.Clear();
+  m_multiplexedPids.assign(MAXPID, false);
+
+  // Add the file descriptors of all streaming resources, or their section
+  // filters in software mode. Sections they assembled but weren't read yet
+  // are queued again.
+  for (vector<PidResourcePtr>::const_iterator it = resources.begin(); it != resources.end(); ++it)
+  {
+    switch ((*it)->Type())
+    {
+      case RESOURCE_TYPE_STREAMING:
+        if (m_bSoftwareFilter)
+        {
+          m_sectionFilters.AddFilter(*it, static_cast<cDvbStreamingResource*>(it->get())->Assembler());
+        }
+        else
+        {
+          pollfd pfd = { (*it)->Handle(), POLLIN | POLLERR, 0 };
+          m_pollfds.push_back(pfd);
+          m_pollResources.push_back(*it);
+        }
+        break;
+      case RESOURCE_TYPE_MULTIPLEXING:
+        m_multiplexedPids[(*it)->Pid() & (MAXPID - 1)] = true;
+        bMultiplexedResources = true;
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Add the file descriptor for the multiplexed resources last
+  if ((bMultiplexedResources || m_bSoftwareFilter) && m_fd_dvr != FILE_DESCRIPTOR_INVALID)
   {
     pollfd pfd = { m_fd_dvr, POLLIN | POLLERR, 0 };
-    vecPfds.push_back(pfd);
+    m_pollfds.push_back(pfd);
   }
 
-  if (!vecPfds.empty())
+  m_bPollSetChanged = false;
+}
+
+POLL_RESULT cDvbReceiverSubsystem::Poll(PidResourcePtr& streamingResource)
+{
+  if (m_bPollSetChanged)
+    UpdatePollSet();
+
+  if (m_bSoftwareFilter)
+    return PollSoftware(streamingResource);
+
+  // Only poll again when everything poll() reported last time has been read
+  if (m_readyResources.empty() && !m_bMultiplexedReady && !m_pollfds.empty())
   {
-    if (poll(vecPfds.data(), vecPfds.size(), POLL_TIMEOUT_MS) > 0)
+    if (poll(m_pollfds.data(), m_pollfds.size(), POLL_TIMEOUT_MS) > 0)
     {
-      // Look for file descriptor that signaled poll()
-      for (unsigned int i = 0; i < vecPfds.size(); i++)
+      for (unsigned int i = 0; i < m_pollfds.size(); i++)
       {
-        if (vecPfds[i].revents & (POLLIN | POLLERR))
+        if (m_pollfds[i].revents & (POLLIN | POLLERR))
         {
-          const int signaledFd = vecPfds[i].fd;
-
-          // Check if the multiplexed resource is ready
-          if (signaledFd == m_fd_dvr)
-            return POLL_RESULT_MULTIPLEXED_READY;
-
-          // Check if a streaming resource is ready
-          for (ReceiverPidTable::const_iterator it = m_receiverPidTable.begin(); it != m_receiverPidTable.end(); ++it)
-          {
-            for (ReceiverList::const_iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2)
-            {
-              if (it2->second->Handle() == signaledFd)
-              {
-                streamingResource = it2->second;
-                return POLL_RESULT_STREAMING_READY;
-              }
-            }
-          }
+          if (i < m_pollResources.size())
+            m_readyResources.push_back(m_pollResources[i]);
+          else
+            m_bMultiplexedReady = true;
         }
       }
     }
   }
 
+  if (!m_readyResources.empty())
+  {
+    streamingResource = m_readyResources.front();
+    m_readyResources.pop_front();
+    return POLL_RESULT_STREAMING_READY;
+  }
+
+  if (m_bMultiplexedReady)
+  {
+    m_bMultiplexedReady = false;
+    return POLL_RESULT_MULTIPLEXED_READY;
+  }
+
+  return POLL_RESULT_NOT_READY;
+}
+
+POLL_RESULT cDvbReceiverSubsystem::PollSoftware(PidResourcePtr& streamingResource)
+{
+  for (unsigned int i = 0; i < MAX_FILTERED_PACKETS && m_sectionFilters.Empty(); i++)
+  {
+    int count = 0;
+    if (!m_ringBuffer.Get(count) || count < TS_SIZE)
+    {
+      // Only wait for the DVR before the first packet
+      if (m_pollfds.empty() || poll(m_pollfds.data(), m_pollfds.size(), i == 0 ? POLL_TIMEOUT_MS : 0) <= 0)
+        break;
+    }
+
+    TsPacket packet = ReadMultiplexed();
+    if (!packet)
+      break;
+
+    const uint16_t pid = TsPid(packet);
+
+    // Feed the section filters only once, the packet stays at the head of the
+    // buffer until the multiplexed receivers consumed it
+    if (!m_bHeadFiltered)
+    {
+      m_sectionFilters.AddTsPacket(packet);
+      m_bHeadFiltered = true;
+    }
+
+    if (m_multiplexedPids[pid])
+    {
+      if (m_sectionFilters.Empty())
+        return POLL_RESULT_MULTIPLEXED_READY; // Removed from the buffer by Consumed()
+      break;
+    }
+
+    Consumed();
+  }
+
+  if (m_sectionFilters.Pop(streamingResource))
+    return POLL_RESULT_STREAMING_READY;
+
   return POLL_RESULT_NOT_READY;
 }
 
 void cDvbReceiverSubsystem::Consumed(void)
 {
   m_ringBuffer.Del(TS_SIZE);
+  m_bHeadFiltered = false;
 }
 
 TsPacket cDvbReceiverSubsystem::ReadMultiplexed(void)
@@ -374,7 +619,10 @@ TsPacket cDvbReceiverSubsystem::ReadMultiplexed(void)
     if (m_ringBuffer.Read(m_fd_dvr) <= 0)
     {
       if (errno == EOVERFLOW)
+      {
         esyslog("Driver buffer overflow on device %d", Device()->Index());
+        ReportOverflow();
+      }
       else if (errno != 0 && errno != EAGAIN && errno != EINTR)
         esyslog("Error reading dvr device: %m");
       return NULL;
@@ -397,6 +645,7 @@ TsPacket cDvbReceiverSubsystem::ReadMultiplexed(void)
       }
 
       m_ringBuffer.Del(count);
+      m_bHeadFiltered = false;
       esyslog("Skipped %d bytes to sync on TS packet on device %d", count, Device()->Index());
       return NULL;
     }
@@ -409,12 +658,12 @@ TsPacket cDvbReceiverSubsystem::ReadMultiplexed(void)
 
 cDeviceReceiverSubsystem::PidResourcePtr cDvbReceiverSubsystem::CreateStreamingResource(uint16_t pid, uint8_t tid, uint8_t mask)
 {
-  return PidResourcePtr(new cDvbStreamingResource(pid, tid, mask, Device<cDvbDevice>()));
+  return PidResourcePtr(new cDvbStreamingResource(pid, tid, mask, Device<cDvbDevice>(), m_bSoftwareFilter));
 }
 
 cDeviceReceiverSubsystem::PidResourcePtr cDvbReceiverSubsystem::CreateMultiplexedResource(uint16_t pid, STREAM_TYPE streamType)
 {
-  return PidResourcePtr(new cDvbMultiplexedResource(pid, streamType, Device<cDvbDevice>()));
+  return PidResourcePtr(new cDvbMultiplexedResource(pid, streamType, Device<cDvbDevice>(), m_bSoftwareFilter));
 }
 
 }
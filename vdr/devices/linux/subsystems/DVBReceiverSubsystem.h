@@ -21,8 +21,13 @@
 #pragma once
 
 #include "devices/subsystems/DeviceReceiverSubsystem.h"
+#include "dvb/SectionFilterTable.h"
 #include "utils/Ringbuffer.h"
 
+#include <deque>
+#include <poll.h>
+#include <vector>
+
 namespace VDR
 {
 class cDvbReceiverSubsystem : public cDeviceReceiverSubsystem
@@ -40,12 +45,42 @@ protected:
   virtual void Consumed(void);
   virtual PidResourcePtr CreateStreamingResource(uint16_t pid, uint8_t tid, uint8_t mask);
   virtual PidResourcePtr CreateMultiplexedResource(uint16_t pid, STREAM_TYPE streamType);
+  virtual void ResourcesChanged(void);
 
 private:
+  void UpdatePollSet(void);
+
+  /*!
+   * Switch between kernel section/PID filters and software filtering of the
+   * full TS, depending on the number of filters the receivers need
+   */
+  void UpdateFilterMode(const std::vector<PidResourcePtr>& resources);
+  bool OpenFullTs(void);
+  void CloseFullTs(void);
+  POLL_RESULT PollSoftware(PidResourcePtr& streamingResource);
+
   // The DVR device (will be opened and closed as needed)
   int  m_fd_dvr;
 
   // We need a buffer because we might read partial packets
   cRingBufferLinear m_ringBuffer;
+
+  // The file descriptors to poll, rebuilt only after receivers were attached
+  // or detached. Streaming resources come first, in the order of
+  // m_pollResources, followed by the DVR if any resources are multiplexed.
+  std::vector<pollfd>         m_pollfds;
+  std::vector<PidResourcePtr> m_pollResources;
+  std::deque<PidResourcePtr>  m_readyResources; // Reported by the last poll() and not read yet
+  bool                        m_bMultiplexedReady;
+  bool                        m_bPollSetChanged;
+
+  // Software filtering: a single demux filter passes the full TS to the DVR
+  // and the PID and section filters are applied to the packets read from it
+  int                                        m_fd_ts;
+  bool                                       m_bSoftwareFilter;
+  bool                                       m_bFullTsUnsupported; // The driver refused PID 0x2000
+  bool                                       m_bHeadFiltered;      // The packet at the head of m_ringBuffer was fed to the section filters
+  cSectionFilterTable                        m_sectionFilters;
+  std::vector<bool>                          m_multiplexedPids;    // Indexed by PID
 };
 }
@@ -120,6 +120,7 @@ TunerHandlePtr cDeviceChannelSubsystem::Acquire(cDevice* device, const ChannelPt
 {
   bool valid(true);
   bool switchNeeded(true);
+  bool handover(false);
   bool startChannelScan(false);
   bool startEpgScan(false);
   TunerHandlePtr handle = TunerHandlePtr(new cTunerHandle(type, device, callbacks, channel));
@@ -167,6 +168,15 @@ TunerHandlePtr cDeviceChannelSubsystem::Acquire(cDevice* device, const ChannelPt
       }
     }
 
+    if (valid && switchNeeded && !lowerPrio.empty() && lowerPrio.size() == m_activeTransponders.size())
+    {
+      /** take over a tuner that is already pre-locked to this transponder without retuning */
+      handover = IsTunedToTransponder(channel->GetTransponder()) && HasLock();
+      for (std::vector<TunerHandlePtr>::iterator it = lowerPrio.begin(); handover && it != lowerPrio.end(); ++it)
+        handover = (*it)->Type() == TUNING_TYPE_PRELOCK && (*it)->Channel()->GetTransponder() == channel->GetTransponder();
+      switchNeeded = !handover;
+    }
+
     if (valid)
     {
       /** remove lower prio registrations */
@@ -177,8 +187,8 @@ TunerHandlePtr cDeviceChannelSubsystem::Acquire(cDevice* device, const ChannelPt
           m_activeTransponders.erase(it2);
       }
 
-      /** add new registration */
-      handle = TunerHandlePtr(new cTunerHandle(type, device, callbacks, channel));
+      /** add new registration. Replacing the handle would release it while no
+       *  subscription is active, which clears the channel of a handover */
       handle->StartChannelScanAfterRelease(startChannelScan);
       handle->StartEPGScanAfterRelease(startEpgScan);
       m_activeTransponders.push_back(handle);
@@ -204,6 +214,12 @@ TunerHandlePtr cDeviceChannelSubsystem::Acquire(cDevice* device, const ChannelPt
         handle = cTunerHandle::EmptyHandle;
       }
     }
+    else if (handover)
+    {
+      dsyslog("handed over to %s", handle->ToString().c_str());
+      if (CommonInterface()->m_camSlot)
+        CommonInterface()->m_camSlot->AddChannel(*channel);
+    }
   }
   else
   {
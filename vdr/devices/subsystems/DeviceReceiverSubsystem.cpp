@@ -20,6 +20,7 @@
  */
 
 #include "DeviceReceiverSubsystem.h"
+#include "DeviceChannelSubsystem.h"
 #include "DeviceCommonInterfaceSubsystem.h"
 #include "Config.h"
 #include "devices/commoninterface/CI.h"
@@ -27,8 +28,10 @@
 #include "devices/Receiver.h"
 #include "devices/Remux.h"
 #include "dvb/PsiBuffer.h"
+#include "dvb/SectionCache.h"
 #include "utils/CommonMacros.h"
 #include "utils/log/Log.h"
+#include "utils/metrics/Metrics.h"
 
 using namespace PLATFORM;
 using namespace std;
@@ -105,13 +108,36 @@ void cDeviceReceiverSubsystem::ProcessDetachAll(void)
 void cDeviceReceiverSubsystem::ProcessAttachMultiplexed(cDeviceReceiverSubsystem::cReceiverChange& change)
 {
   DEBUG_RCV_CHANGE("ProcessChanges: attaching multiplexed receiver for pid %d", change.m_pid);
-  AttachReceiver(change.m_receiver, CreateMultiplexedResource(change.m_pid, change.m_streamType));
+  if (AttachReceiver(change.m_receiver, CreateMultiplexedResource(change.m_pid, change.m_streamType)) &&
+      change.m_receiver->IsPsiReceiver())
+    ReplaySections(change.m_receiver, change.m_pid, 0, 0);
+
+  // Don't count the gap since the PID was last received as an error
+  if (change.m_pid < m_continuityCounters.size())
+    m_continuityCounters[change.m_pid] = TS_CONT_CNT_UNKNOWN;
 }
 
 void cDeviceReceiverSubsystem::ProcessAttachStreaming(cDeviceReceiverSubsystem::cReceiverChange& change)
 {
   DEBUG_RCV_CHANGE("ProcessChanges: attaching streaming receiver for pid %d tid %d mask %d", change.m_pid, change.m_tid, change.m_mask);
-  AttachReceiver(change.m_receiver, CreateStreamingResource(change.m_pid, change.m_tid, change.m_mask));
+  if (AttachReceiver(change.m_receiver, CreateStreamingResource(change.m_pid, change.m_tid, change.m_mask)))
+    ReplaySections(change.m_receiver, change.m_pid, change.m_tid, change.m_mask);
+}
+
+void cDeviceReceiverSubsystem::ReplaySections(iReceiver* receiver, uint16_t pid, uint8_t tid, uint8_t mask)
+{
+  if (!Channel()->HasLock())
+    return;
+
+  // Hand the tables we already know to the new receiver, the changes follow live
+  SectionVector sections = cSectionCache::Get().GetSections(Channel()->GetCurrentlyTunedTransponder(), pid, tid, mask);
+  for (SectionVector::const_iterator it = sections.begin(); it != sections.end(); ++it)
+  {
+    ts_crc_check_t crcCheck = TS_CRC_CHECKED_VALID;
+    receiver->Receive(pid, (*it)->data(), (*it)->size(), crcCheck);
+  }
+
+  DEBUG_RCV_CHANGE("ProcessChanges: replayed %u cached sections for pid %d tid %d mask %d", (unsigned int)sections.size(), pid, tid, mask);
 }
 
 void cDeviceReceiverSubsystem::ProcessDetachReceiver(cDeviceReceiverSubsystem::cReceiverChange& change)
@@ -218,6 +244,8 @@ void cDeviceReceiverSubsystem::ProcessReceiverChange(cDeviceReceiverSubsystem::c
     case RCV_CHANGE_NOOP:
       break;
   }
+  if (change->m_type != RCV_CHANGE_NOOP)
+    ResourcesChanged();
   if (change->m_processed_cb)
     change->m_processed_cb->ChangeProcessed();
 }
@@ -243,21 +271,86 @@ bool cDeviceReceiverSubsystem::ProcessChanges(void)
   return m_receiverPidTable.empty();
 }
 
+void cDeviceReceiverSubsystem::RegisterMetrics(void)
+{
+  const std::string strLabels = cMetrics::Label("device", Device()->Index());
+
+  m_packetsMetric   = cMetrics::Get().Counter("vdr_device_packets_total", "TS packets dispatched to receivers", strLabels);
+  m_overflowsMetric = cMetrics::Get().Counter("vdr_device_overflows_total", "Times the device dropped data before it was read", strLabels);
+  m_ccErrorsMetric  = cMetrics::Get().Counter("vdr_device_continuity_errors_total", "TS packets with an unexpected continuity counter", strLabels);
+  m_teiErrorsMetric = cMetrics::Get().Counter("vdr_device_transport_errors_total", "TS packets with the transport error indicator set", strLabels);
+
+  m_ccErrorMetrics.assign(MAXPID, MetricCounterPtr());
+  m_teiErrorMetrics.assign(MAXPID, MetricCounterPtr());
+  m_continuityCounters.assign(MAXPID, TS_CONT_CNT_UNKNOWN);
+}
+
+void cDeviceReceiverSubsystem::ReportOverflow(void)
+{
+  if (m_overflowsMetric)
+    m_overflowsMetric->Increment();
+}
+
+eTsContinuity cDeviceReceiverSubsystem::CheckPacket(const uint8_t* packet, uint16_t pid)
+{
+  // The rest of the header can't be trusted either, don't let it update the counter
+  if (TsError(packet))
+  {
+    MetricCounterPtr& metric = m_teiErrorMetrics[pid];
+    if (!metric)
+    {
+      metric = cMetrics::Get().Counter("vdr_pid_transport_errors_total", "TS packets with the transport error indicator set",
+          cMetrics::Label("device", Device()->Index()) + "," + cMetrics::Label("pid", pid));
+    }
+    metric->Increment();
+    m_teiErrorsMetric->Increment();
+    return tcDiscontinuity;
+  }
+
+  const eTsContinuity continuity = TsCheckContinuity(packet, m_continuityCounters[pid]);
+  if (continuity == tcDiscontinuity)
+  {
+    MetricCounterPtr& metric = m_ccErrorMetrics[pid];
+    if (!metric)
+    {
+      metric = cMetrics::Get().Counter("vdr_pid_continuity_errors_total", "TS packets with an unexpected continuity counter",
+          cMetrics::Label("device", Device()->Index()) + "," + cMetrics::Label("pid", pid));
+    }
+    metric->Increment();
+    m_ccErrorsMetric->Increment();
+  }
+
+  return continuity;
+}
+
+cTsPacketRef cDeviceReceiverSubsystem::SharePacket(const uint8_t* packet)
+{
+  if (!m_packetBlock || m_packetBlock->Full())
+    m_packetBlock = cTsPacketBlockPool::Get().Allocate();
+
+  return cTsPacketRef(m_packetBlock, m_packetBlock->Append(packet));
+}
+
 void *cDeviceReceiverSubsystem::Process()
 {
   if (!Initialise())
     return NULL;
 
+  RegisterMetrics();
+
   TsPacket packet;
   uint16_t pid;
   uint8_t tid;
   const uint8_t* psidata;
   size_t psidatalen;
   bool validpsi, psichecked;
+  eTsContinuity continuity;
   PidResourcePtr resource;
   ts_crc_check_t crcCheck;
   iReceiver* receiver;
   PidResourcePtr pidPtr;
+  cTsPacketRef packetRef;
+  bool packetShared;
   bool empty = true;
   ReceiverList::const_iterator itRcvList;
   ReceiverPidTable::const_iterator itReceiverLists;
@@ -283,6 +376,8 @@ void *cDeviceReceiverSubsystem::Process()
         {
           for (itRcvList = itReceiverLists->second.begin(); itRcvList != itReceiverLists->second.end(); ++itRcvList)
             itRcvList->first->receiver->Receive(resource->Pid(), psidata, psidatalen, crcCheck);
+
+          cSectionCache::Get().Put(Channel()->GetCurrentlyTunedTransponder(), resource->Pid(), psidata, psidatalen, crcCheck);
         }
       }
       break;
@@ -294,7 +389,12 @@ void *cDeviceReceiverSubsystem::Process()
         itReceiverLists = m_receiverPidTable.find(PID_TID_TO_UINT32(pid, 0xFF));
         if (itReceiverLists != m_receiverPidTable.end())
         {
+          m_packetsMetric->Increment();
+          continuity = CheckPacket(packet, pid);
+
           psichecked = false;
+          packetShared = false;
+          crcCheck = TS_CRC_NOT_CHECKED;
 
           for (itRcvList = itReceiverLists->second.begin(); itRcvList != itReceiverLists->second.end(); ++itRcvList)
           {
@@ -306,16 +406,31 @@ void *cDeviceReceiverSubsystem::Process()
               {
                 psichecked = true;
                 pidPtr = GetMultiplexedResource(pid);
-                validpsi = pidPtr ? pidPtr->AllocateBuffer()->AddTsData(packet, TS_SIZE, &psidata, &psidatalen) : false;
+                if (pidPtr && continuity == tcDiscontinuity)
+                  pidPtr->AllocateBuffer()->Reset(); // Don't assemble a section with a hole in it
+                validpsi = pidPtr && continuity != tcDuplicate ? pidPtr->AllocateBuffer()->AddTsData(packet, TS_SIZE, &psidata, &psidatalen) : false;
               }
               if (validpsi)
                 receiver->Receive(pid, psidata, psidatalen, crcCheck);
             }
+            else if (receiver->ReceivesPackets())
+            {
+              /** copy the packet once for all receivers holding on to it */
+              if (!packetShared)
+              {
+                packetShared = true;
+                packetRef = SharePacket(packet);
+              }
+              receiver->ReceivePacket(pid, packetRef);
+            }
             else
             {
               receiver->Receive(pid, packet, TS_SIZE, crcCheck);
             }
           }
+
+          if (psichecked && validpsi)
+            cSectionCache::Get().Put(Channel()->GetCurrentlyTunedTransponder(), pid, psidata, psidatalen, crcCheck);
         }
         Consumed();
       }
@@ -328,6 +443,7 @@ void *cDeviceReceiverSubsystem::Process()
   }
 
   Deinitialise();
+  m_packetBlock.reset();
 
   return NULL;
 }
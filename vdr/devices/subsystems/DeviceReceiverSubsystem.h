@@ -25,8 +25,10 @@
 #include "devices/DeviceTypes.h"
 #include "devices/PIDResource.h"
 #include "devices/Receiver.h"
+#include "devices/Remux.h"
 #include "lib/platform/threads/mutex.h"
 #include "lib/platform/threads/threads.h"
+#include "utils/metrics/Metrics.h"
 
 #include <set>
 #include <stdint.h>
@@ -35,6 +37,7 @@
 #include <list>
 #include <map>
 #include <queue>
+#include <vector>
 
 namespace VDR
 {
@@ -205,6 +208,18 @@ protected:
    */
   virtual void Consumed(void) = 0;
 
+  /*!
+   * Called on the receiver thread after receivers were attached or detached,
+   * i.e. after m_receiverPidTable changed.
+   */
+  virtual void ResourcesChanged(void) { }
+
+  /*!
+   * Report that the device dropped data before it could be read, e.g. when the
+   * driver's buffer overflowed.
+   */
+  void ReportOverflow(void);
+
   bool ProcessChanges(void);
   bool WaitForPidChange(void);
   void ProcessReceiverChange(cReceiverChange* change);
@@ -220,10 +235,26 @@ protected:
   void ProcessDetachAll(void);
   void ProcessAttachMultiplexed(cReceiverChange& change);
   void ProcessAttachStreaming(cReceiverChange& change);
+  void ReplaySections(iReceiver* receiver, uint16_t pid, uint8_t tid, uint8_t mask);
   void ProcessDetachReceiver(cReceiverChange& change);
   void ProcessDetachMultiplexed(cReceiverChange& change);
   void ProcessDetachStreaming(cReceiverChange& change);
 
+  void RegisterMetrics(void);
+
+  /*!
+   * Validate a TS packet before it is dispatched: count packets with the
+   * transport error indicator set or with a gap in the continuity counter, per
+   * PID and per device. Returns tcDiscontinuity if data was lost before or in
+   * the packet, and tcDuplicate if its payload was already received.
+   */
+  eTsContinuity CheckPacket(const uint8_t* packet, uint16_t pid);
+
+  /*!
+   * Copy a TS packet into the current shared block
+   */
+  cTsPacketRef SharePacket(const uint8_t* packet);
+
   ReceiverPidTable m_receiverPidTable;// Receiver <-> PID associations
 
   PLATFORM::CMutex             m_mutex;
@@ -232,6 +263,16 @@ protected:
   PLATFORM::CCondition<bool>   m_pidChangeProcessed;
   bool                         m_changed;
   bool                         m_changeProcessed;
+
+  TsPacketBlockPtr              m_packetBlock; // Packets for receivers that hold on to them are copied here
+
+  MetricCounterPtr              m_packetsMetric;
+  MetricCounterPtr              m_overflowsMetric;
+  MetricCounterPtr              m_ccErrorsMetric;
+  MetricCounterPtr              m_teiErrorsMetric;
+  std::vector<MetricCounterPtr> m_ccErrorMetrics;     // Indexed by PID, registered on the first error
+  std::vector<MetricCounterPtr> m_teiErrorMetrics;    // Indexed by PID, registered on the first error
+  std::vector<uint8_t>          m_continuityCounters; // Indexed by PID, last seen continuity counter
 };
 
 }
@@ -0,0 +1,102 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "devices/Remux.h"
+
+#include "gtest/gtest.h"
+
+#include <string.h>
+
+namespace VDR
+{
+
+namespace
+{
+  // Build a TS packet on PID 100 with the given continuity counter
+  void MakePacket(uint8_t* packet, uint8_t counter, bool payload = true, bool discontinuity = false)
+  {
+    memset(packet, 0xFF, TS_SIZE);
+    packet[0] = TS_SYNC_BYTE;
+    packet[1] = 0x00;
+    packet[2] = 100;
+    packet[3] = (payload ? TS_PAYLOAD_EXISTS : 0) | (counter & TS_CONT_CNT_MASK);
+    if (discontinuity)
+    {
+      packet[3] |= TS_ADAPT_FIELD_EXISTS;
+      packet[4] = 1;
+      packet[5] = TS_ADAPT_DISCONT;
+    }
+  }
+}
+
+TEST(Remux, TsCheckContinuity)
+{
+  uint8_t packet[TS_SIZE];
+  uint8_t counter = TS_CONT_CNT_UNKNOWN;
+
+  // The first packet of a PID is always accepted
+  MakePacket(packet, 7);
+  EXPECT_EQ(tcOk, TsCheckContinuity(packet, counter));
+  EXPECT_EQ(7, counter);
+
+  MakePacket(packet, 8);
+  EXPECT_EQ(tcOk, TsCheckContinuity(packet, counter));
+
+  MakePacket(packet, 8);
+  EXPECT_EQ(tcDuplicate, TsCheckContinuity(packet, counter));
+
+  // Packets without payload don't increment the counter
+  MakePacket(packet, 8, false);
+  EXPECT_EQ(tcOk, TsCheckContinuity(packet, counter));
+
+  MakePacket(packet, 10);
+  EXPECT_EQ(tcDiscontinuity, TsCheckContinuity(packet, counter));
+  EXPECT_EQ(10, counter);
+
+  // The gap was reported once, counting continues from the new value
+  MakePacket(packet, 11);
+  EXPECT_EQ(tcOk, TsCheckContinuity(packet, counter));
+}
+
+TEST(Remux, TsCheckContinuityWraps)
+{
+  uint8_t packet[TS_SIZE];
+  uint8_t counter = 15;
+
+  MakePacket(packet, 0);
+  EXPECT_EQ(tcOk, TsCheckContinuity(packet, counter));
+
+  MakePacket(packet, 2);
+  EXPECT_EQ(tcDiscontinuity, TsCheckContinuity(packet, counter));
+}
+
+TEST(Remux, TsCheckContinuityDiscontinuityIndicator)
+{
+  uint8_t packet[TS_SIZE];
+  uint8_t counter = 3;
+
+  // A signalled discontinuity isn't an error
+  MakePacket(packet, 12, true, true);
+  EXPECT_TRUE(TsDiscontinuity(packet));
+  EXPECT_EQ(tcOk, TsCheckContinuity(packet, counter));
+  EXPECT_EQ(12, counter);
+}
+
+}
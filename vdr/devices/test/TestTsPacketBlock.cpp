@@ -0,0 +1,89 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "devices/TsPacketBlock.h"
+#include "devices/Remux.h"
+
+#include "gtest/gtest.h"
+
+#include <string.h>
+#include <vector>
+
+namespace VDR
+{
+
+namespace
+{
+  std::vector<uint8_t> MakePacket(uint8_t counter)
+  {
+    std::vector<uint8_t> packet(TS_SIZE, counter);
+    packet[0] = TS_SYNC_BYTE;
+    return packet;
+  }
+}
+
+TEST(TsPacketBlock, Append)
+{
+  TsPacketBlockPtr block = cTsPacketBlockPool::Get().Allocate();
+  ASSERT_TRUE(block.get() != NULL);
+  EXPECT_EQ(0, block->Packets());
+
+  std::vector<uint8_t> packet1 = MakePacket(1);
+  std::vector<uint8_t> packet2 = MakePacket(2);
+  const uint8_t* copy1 = block->Append(packet1.data());
+  const uint8_t* copy2 = block->Append(packet2.data());
+  ASSERT_TRUE(copy1 != NULL);
+  ASSERT_TRUE(copy2 != NULL);
+  EXPECT_EQ(2, block->Packets());
+  EXPECT_EQ(0, memcmp(copy1, packet1.data(), TS_SIZE));
+  EXPECT_EQ(0, memcmp(copy2, packet2.data(), TS_SIZE));
+
+  // Fill the block
+  while (!block->Full())
+    ASSERT_TRUE(block->Append(packet1.data()) != NULL);
+  EXPECT_TRUE(block->Append(packet2.data()) == NULL);
+
+  // Appending doesn't move the packets handed out before
+  EXPECT_EQ(0, memcmp(copy2, packet2.data(), TS_SIZE));
+}
+
+TEST(TsPacketBlock, Recycle)
+{
+  std::vector<uint8_t> packet = MakePacket(3);
+  TsPacketBlockPtr block = cTsPacketBlockPool::Get().Allocate();
+  cTsPacketRef ref(block, block->Append(packet.data()));
+  block.reset();
+
+  // The reference keeps the block, and the packet, alive
+  const size_t freeBlocks = cTsPacketBlockPool::Get().FreeBlocks();
+  ASSERT_TRUE(ref.IsValid());
+  EXPECT_EQ(0, memcmp(ref.Data(), packet.data(), TS_SIZE));
+
+  // Dropping the last reference returns the block to the pool, empty
+  ref = cTsPacketRef();
+  EXPECT_FALSE(ref.IsValid());
+  EXPECT_EQ(freeBlocks + 1, cTsPacketBlockPool::Get().FreeBlocks());
+
+  block = cTsPacketBlockPool::Get().Allocate();
+  EXPECT_EQ(0, block->Packets());
+  EXPECT_EQ(freeBlocks, cTsPacketBlockPool::Get().FreeBlocks());
+}
+
+}
@@ -0,0 +1,169 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "channels/Channel.h"
+#include "devices/Remux.h"
+#include "devices/WarmTunerPool.h"
+#include "devices/file/FileDevice.h"
+#include "devices/subsystems/DeviceChannelSubsystem.h"
+#include "filesystem/File.h"
+#include "transponders/Transponder.h"
+
+#include "gtest/gtest.h"
+
+#include <string.h>
+#include <vector>
+
+#define CAPTURE_FILE  "special://temp/TestWarmTunerPool.ts"
+
+namespace VDR
+{
+
+namespace
+{
+  class cTestWarmTunerPool : public cWarmTunerPool
+  {
+  public:
+    using cWarmTunerPool::Tune;
+    using cWarmTunerPool::ReleaseAll;
+  };
+
+  ChannelPtr MakeChannel(uint16_t sid, unsigned int frequencyMHz)
+  {
+    cTransponder transponder(TRANSPONDER_TERRESTRIAL);
+    transponder.SetFrequencyMHz(frequencyMHz);
+
+    ChannelPtr channel = ChannelPtr(new cChannel);
+    channel->SetId(cChannelID(1, 2, sid));
+    channel->SetTransponder(transponder);
+    return channel;
+  }
+
+  // A capture file provides every transponder, and locks as soon as it's tuned
+  class WarmTunerPool : public ::testing::Test
+  {
+  protected:
+    virtual void SetUp(void)
+    {
+      uint8_t packet[TS_SIZE];
+      memset(packet, 0xFF, TS_SIZE);
+      packet[0] = TS_SYNC_BYTE;
+      packet[1] = 0x1F;
+
+      CFile file;
+      ASSERT_TRUE(file.OpenForWrite(CAPTURE_FILE, true));
+      ASSERT_EQ(TS_SIZE, file.Write(packet, TS_SIZE));
+      file.Close();
+
+      for (unsigned int index = 0; index < 2; index++)
+      {
+        DevicePtr device = DevicePtr(new cFileDevice(CAPTURE_FILE, false, true));
+        ASSERT_TRUE(device->Initialise(index));
+        m_devices.push_back(device);
+      }
+
+      m_channelA = MakeChannel(1, 482);
+      m_channelB = MakeChannel(2, 490);
+    }
+
+    virtual void TearDown(void)
+    {
+      m_pool.ReleaseAll();
+      for (std::vector<DevicePtr>::iterator it = m_devices.begin(); it != m_devices.end(); ++it)
+        (*it)->Deinitialise();
+      CFile::Delete(CAPTURE_FILE);
+    }
+
+    bool Idle(const DevicePtr& device)
+    {
+      return device->Channel()->CanTune(TUNING_TYPE_NONE);
+    }
+
+    cTestWarmTunerPool     m_pool;
+    std::vector<DevicePtr> m_devices;
+    ChannelPtr             m_channelA;
+    ChannelPtr             m_channelB;
+  };
+}
+
+TEST_F(WarmTunerPool, GetDevice)
+{
+  ASSERT_TRUE(m_pool.Tune(m_devices[1], m_channelA));
+
+  // Device 0 provides the transponder too, but isn't locked to it
+  EXPECT_EQ(m_devices[1], m_pool.GetDevice(m_channelA->GetTransponder()));
+  EXPECT_FALSE(m_pool.GetDevice(m_channelB->GetTransponder()));
+
+  // Retuning replaces the pre-lock
+  ASSERT_TRUE(m_pool.Tune(m_devices[1], m_channelB));
+  EXPECT_FALSE(m_pool.GetDevice(m_channelA->GetTransponder()));
+  EXPECT_EQ(m_devices[1], m_pool.GetDevice(m_channelB->GetTransponder()));
+
+  m_pool.ReleaseAll();
+  EXPECT_FALSE(m_pool.GetDevice(m_channelB->GetTransponder()));
+  EXPECT_TRUE(Idle(m_devices[1]));
+}
+
+TEST_F(WarmTunerPool, LostPriority)
+{
+  const DevicePtr& device = m_devices[1];
+  ASSERT_TRUE(m_pool.Tune(device, m_channelA));
+
+  // Live tv takes the tuner over without retuning, the pre-lock gives it up
+  TunerHandlePtr handle = device->Acquire(m_channelA, TUNING_TYPE_LIVE_TV, NULL);
+  ASSERT_TRUE(handle.get() != NULL);
+  EXPECT_TRUE(device->Channel()->IsTunedToTransponder(m_channelA->GetTransponder()));
+  EXPECT_FALSE(m_pool.GetDevice(m_channelA->GetTransponder()));
+  EXPECT_FALSE(device->Channel()->CanTune(TUNING_TYPE_PRELOCK));
+
+  // The preempted tuner isn't released again
+  m_pool.ReleaseAll();
+  EXPECT_FALSE(Idle(device));
+
+  device->Release(handle);
+  EXPECT_TRUE(Idle(device));
+
+  // Free to be pre-locked again
+  EXPECT_TRUE(m_pool.Tune(device, m_channelB));
+}
+
+TEST_F(WarmTunerPool, ReleaseAllDuringScan)
+{
+  ASSERT_TRUE(m_pool.Tune(m_devices[0], m_channelA));
+  ASSERT_TRUE(m_pool.Tune(m_devices[1], m_channelB));
+
+  // The channel scan preempts the first tuner
+  TunerHandlePtr scan = m_devices[0]->Acquire(m_channelB, TUNING_TYPE_CHANNEL_SCAN, NULL);
+  ASSERT_TRUE(scan.get() != NULL);
+  EXPECT_FALSE(m_pool.GetDevice(m_channelA->GetTransponder()));
+
+  // Only the pre-locks are released, the scan keeps its tuner
+  m_pool.ReleaseAll();
+  EXPECT_FALSE(m_pool.GetDevice(m_channelB->GetTransponder()));
+  EXPECT_TRUE(Idle(m_devices[1]));
+  EXPECT_FALSE(Idle(m_devices[0]));
+  EXPECT_FALSE(m_devices[0]->Channel()->CanTune(TUNING_TYPE_EPG_SCAN));
+  EXPECT_TRUE(m_devices[0]->Channel()->IsTunedToTransponder(m_channelB->GetTransponder()));
+
+  m_devices[0]->Release(scan);
+  EXPECT_TRUE(Idle(m_devices[0]));
+}
+
+}
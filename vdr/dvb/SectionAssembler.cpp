@@ -0,0 +1,159 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SectionAssembler.h"
+#include "PsiBuffer.h" // for PSI_MAX_SIZE
+#include "devices/Remux.h"
+
+#include <algorithm>
+
+// Sections that nobody reads are dropped beyond this
+#define SECTIONASSEMBLER_MAXQUEUED  256
+
+namespace VDR
+{
+
+// The length is only known once the 3 header bytes are there
+static size_t SectionLength(const std::vector<uint8_t>& section)
+{
+  return section.size() < 3 ? 3 : 3 + (((section[1] & 0x0F) << 8) | section[2]);
+}
+
+cSectionAssembler::cSectionAssembler(uint8_t tid, uint8_t mask)
+ : m_tid(tid),
+   m_mask(mask),
+   m_counter(TS_CONT_CNT_UNKNOWN),
+   m_bSynced(false)
+{
+}
+
+unsigned int cSectionAssembler::AddTsPacket(const uint8_t* packet)
+{
+  if (TsError(packet))
+  {
+    m_current.clear();
+    m_bSynced = false;
+    m_counter = TS_CONT_CNT_UNKNOWN;
+    return 0;
+  }
+
+  switch (TsCheckContinuity(packet, m_counter))
+  {
+    case tcDuplicate:
+      return 0;
+    case tcDiscontinuity:
+      // The rest of the current section is lost
+      m_current.clear();
+      m_bSynced = false;
+      break;
+    default:
+      break;
+  }
+
+  if (!TsHasPayload(packet))
+    return 0;
+
+  const int offset = TsPayloadOffset(packet);
+  const uint8_t* payload = packet + offset;
+  size_t len = TS_SIZE - offset;
+  if (len == 0)
+    return 0;
+
+  if (!TsPayloadStart(packet))
+    return m_bSynced ? AddPayload(payload, len) : 0;
+
+  // The bytes up to where the pointer field points end the current section
+  const size_t pointer = payload[0];
+  if (1 + pointer > len)
+  {
+    m_current.clear();
+    m_bSynced = false;
+    return 0;
+  }
+
+  unsigned int count = 0;
+  if (m_bSynced && pointer > 0)
+    count += AddPayload(payload + 1, pointer);
+
+  m_current.clear();
+  m_bSynced = true;
+  return count + AddPayload(payload + 1 + pointer, len - 1 - pointer);
+}
+
+unsigned int cSectionAssembler::AddPayload(const uint8_t* data, size_t len)
+{
+  unsigned int count = 0;
+
+  while (len > 0)
+  {
+    // The rest of the packet is stuffing
+    if (m_current.empty() && data[0] == 0xFF)
+    {
+      m_bSynced = false;
+      break;
+    }
+
+    const size_t needed = SectionLength(m_current);
+    if (needed > PSI_MAX_SIZE)
+    {
+      m_current.clear();
+      m_bSynced = false;
+      break;
+    }
+
+    const size_t chunk = std::min(needed - m_current.size(), len);
+    m_current.insert(m_current.end(), data, data + chunk);
+    data += chunk;
+    len  -= chunk;
+
+    if (m_current.size() < SectionLength(m_current))
+      continue;
+
+    if ((m_current[0] & m_mask) == (m_tid & m_mask) && m_sections.size() < SECTIONASSEMBLER_MAXQUEUED)
+    {
+      m_sections.push_back(std::vector<uint8_t>());
+      m_sections.back().swap(m_current);
+      count++;
+    }
+    m_current.clear();
+  }
+
+  return count;
+}
+
+bool cSectionAssembler::GetSection(std::vector<uint8_t>& section)
+{
+  if (m_sections.empty())
+    return false;
+
+  section.swap(m_sections.front());
+  m_sections.pop_front();
+  return true;
+}
+
+void cSectionAssembler::Reset(void)
+{
+  m_current.clear();
+  m_sections.clear();
+  m_bSynced = false;
+  m_counter = TS_CONT_CNT_UNKNOWN;
+}
+
+}
@@ -0,0 +1,75 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <deque>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace VDR
+{
+
+/*!
+ * Assembles the PSI/SI sections of one PID from its TS packets, the way the
+ * kernel's section filter does when a device filters the full TS in software.
+ *
+ * A packet with the payload unit start indicator set may end the current
+ * section before its pointer field points at the next one, and may carry more
+ * sections after it until the payload is padded with 0xFF. Sections passing
+ * the table id filter are queued without the pointer field.
+ */
+class cSectionAssembler
+{
+public:
+  cSectionAssembler(uint8_t tid, uint8_t mask);
+  ~cSectionAssembler(void) { }
+
+  /*!
+   * Add a TS packet of the PID
+   * @return The number of sections it completed and queued
+   */
+  unsigned int AddTsPacket(const uint8_t* packet);
+
+  /*!
+   * Take the oldest queued section
+   * @return False if no section is queued
+   */
+  bool GetSection(std::vector<uint8_t>& section);
+
+  size_t Queued(void) const { return m_sections.size(); }
+
+  /*!
+   * Drop the queued sections and the one being assembled
+   */
+  void Reset(void);
+
+private:
+  unsigned int AddPayload(const uint8_t* data, size_t len);
+
+  const uint8_t                     m_tid;
+  const uint8_t                     m_mask;
+  uint8_t                           m_counter;  // Continuity counter of the last packet
+  bool                              m_bSynced;  // m_current starts at a section start
+  std::vector<uint8_t>              m_current;
+  std::deque<std::vector<uint8_t> > m_sections;
+};
+
+}
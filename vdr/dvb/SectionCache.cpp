@@ -0,0 +1,236 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SectionCache.h"
+
+#include <libsi/util.h>
+#include <string.h>
+
+using namespace PLATFORM;
+
+#define SECTIONCACHE_TRANSPONDERS   32
+#define SECTIONCACHE_SIZE           (4 * 1024 * 1024) // bytes per transponder
+#define SECTIONCACHE_TTL            600 // seconds
+
+namespace VDR
+{
+
+bool cSectionCache::sSectionKey::operator<(const sSectionKey& rhs) const
+{
+  if (pid       != rhs.pid)       return pid       < rhs.pid;
+  if (tid       != rhs.tid)       return tid       < rhs.tid;
+  if (extension != rhs.extension) return extension < rhs.extension;
+  if (network   != rhs.network)   return network   < rhs.network;
+  if (section   != rhs.section)   return section   < rhs.section;
+  return version < rhs.version;
+}
+
+cSectionCache& cSectionCache::Get(void)
+{
+  static cSectionCache _instance(SECTIONCACHE_TRANSPONDERS, SECTIONCACHE_SIZE, SECTIONCACHE_TTL);
+  return _instance;
+}
+
+cSectionCache::cSectionCache(size_t maxTransponders, size_t maxBytes, time_t ttl)
+ : m_maxTransponders(maxTransponders),
+   m_maxBytes(maxBytes),
+   m_ttl(ttl)
+{
+}
+
+bool cSectionCache::Put(const cTransponder& transponder, uint16_t pid, const uint8_t* data, size_t len, ts_crc_check_t& crcvalid)
+{
+  // Long section syntax only: table id, length, extension, version, section number
+  if (len < 12 || !(data[1] & 0x80))
+    return false;
+
+  const size_t sectionLength = (((data[1] & 0x0F) << 8) | data[2]) + 3;
+  if (sectionLength < 12 || sectionLength > len)
+    return false;
+
+  // Skip sections that aren't applicable yet
+  if (!(data[5] & 0x01))
+    return false;
+
+  if (crcvalid == TS_CRC_NOT_CHECKED)
+    crcvalid = SI::CRC32::isValid((const char *)data, sectionLength) ? TS_CRC_CHECKED_VALID : TS_CRC_CHECKED_INVALID;
+  if (crcvalid == TS_CRC_CHECKED_INVALID)
+    return false;
+
+  sSectionKey key;
+  key.pid       = pid;
+  key.tid       = data[0];
+  key.extension = (data[3] << 8) | data[4];
+  key.network   = 0;
+  if (data[0] >= 0x4E && data[0] <= 0x6F)
+  {
+    // EIT sub-tables are identified by service id, transport stream id and
+    // original network id, the latter two follow the section number
+    key.network = (data[8] << 24) | (data[9] << 16) | (data[10] << 8) | data[11];
+  }
+  key.section   = data[6];
+  key.version   = (data[5] >> 1) & 0x1F;
+
+  const time_t now = time(NULL);
+
+  CLockObject lock(m_mutex);
+
+  TransponderSectionsPtr entry = Find(transponder);
+  if (!entry)
+  {
+    if (m_transponders.size() >= m_maxTransponders)
+    {
+      std::vector<TransponderSectionsPtr>::iterator oldest = m_transponders.begin();
+      for (std::vector<TransponderSectionsPtr>::iterator it = m_transponders.begin(); it != m_transponders.end(); ++it)
+      {
+        if ((*it)->used < (*oldest)->used)
+          oldest = it;
+      }
+      m_transponders.erase(oldest);
+    }
+
+    entry = TransponderSectionsPtr(new sTransponderSections);
+    entry->transponder = transponder;
+    entry->bytes       = 0;
+    m_transponders.push_back(entry);
+  }
+  entry->used = now;
+
+  // Same section again, most of the time
+  std::map<sSectionKey, sSection>::iterator it = entry->sections.find(key);
+  if (it != entry->sections.end() && it->second.data->size() == sectionLength &&
+      memcmp(it->second.data->data(), data, sectionLength) == 0)
+  {
+    it->second.received = now;
+    return true;
+  }
+
+  // A new version replaces all sections of the sub-table
+  sSectionKey first = key;
+  first.section = 0;
+  first.version = 0;
+  for (it = entry->sections.lower_bound(first); it != entry->sections.end() && it->first.SameTable(key);)
+  {
+    if (it->first.version != key.version || it->first.section == key.section)
+    {
+      entry->bytes -= it->second.data->size();
+      entry->sections.erase(it++);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  if (entry->bytes + sectionLength > m_maxBytes)
+  {
+    Expire(*entry, now);
+    if (entry->bytes + sectionLength > m_maxBytes)
+      return false;
+  }
+
+  sSection section;
+  section.data     = SectionPtr(new std::vector<uint8_t>(data, data + sectionLength));
+  section.received = now;
+  entry->sections.insert(std::make_pair(key, section));
+  entry->bytes += sectionLength;
+
+  return true;
+}
+
+SectionVector cSectionCache::GetSections(const cTransponder& transponder, uint16_t pid, uint8_t tid, uint8_t mask)
+{
+  SectionVector sections;
+  const time_t now = time(NULL);
+
+  CLockObject lock(m_mutex);
+
+  TransponderSectionsPtr entry = Find(transponder);
+  if (!entry)
+    return sections;
+
+  entry->used = now;
+
+  sSectionKey first = { };
+  first.pid = pid;
+  for (std::map<sSectionKey, sSection>::const_iterator it = entry->sections.lower_bound(first); it != entry->sections.end() && it->first.pid == pid; ++it)
+  {
+    if ((it->first.tid & mask) == (tid & mask) && it->second.received + m_ttl > now)
+      sections.push_back(it->second.data);
+  }
+
+  return sections;
+}
+
+void cSectionCache::Clear(const cTransponder& transponder)
+{
+  CLockObject lock(m_mutex);
+  for (std::vector<TransponderSectionsPtr>::iterator it = m_transponders.begin(); it != m_transponders.end(); ++it)
+  {
+    if ((*it)->transponder == transponder)
+    {
+      m_transponders.erase(it);
+      break;
+    }
+  }
+}
+
+void cSectionCache::Clear(void)
+{
+  CLockObject lock(m_mutex);
+  m_transponders.clear();
+}
+
+size_t cSectionCache::Size(void) const
+{
+  size_t bytes = 0;
+  CLockObject lock(m_mutex);
+  for (std::vector<TransponderSectionsPtr>::const_iterator it = m_transponders.begin(); it != m_transponders.end(); ++it)
+    bytes += (*it)->bytes;
+  return bytes;
+}
+
+cSectionCache::TransponderSectionsPtr cSectionCache::Find(const cTransponder& transponder) const
+{
+  for (std::vector<TransponderSectionsPtr>::const_iterator it = m_transponders.begin(); it != m_transponders.end(); ++it)
+  {
+    if ((*it)->transponder == transponder)
+      return *it;
+  }
+  return TransponderSectionsPtr();
+}
+
+void cSectionCache::Expire(sTransponderSections& entry, time_t now)
+{
+  for (std::map<sSectionKey, sSection>::iterator it = entry.sections.begin(); it != entry.sections.end();)
+  {
+    if (it->second.received + m_ttl <= now)
+    {
+      entry.bytes -= it->second.data->size();
+      entry.sections.erase(it++);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+}
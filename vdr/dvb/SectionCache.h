@@ -0,0 +1,123 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "devices/Receiver.h"
+#include "transponders/Transponder.h"
+#include "lib/platform/threads/mutex.h"
+
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+
+namespace VDR
+{
+
+typedef std::shared_ptr<const std::vector<uint8_t> > SectionPtr;
+typedef std::vector<SectionPtr>                      SectionVector;
+
+/*!
+ * Keeps the PSI/SI sections seen on recently tuned transponders, so that a
+ * filter attaching to a known transponder gets the current tables right away
+ * instead of waiting for the next repetition of the carousel.
+ *
+ * Only CRC-checked sections with the long section syntax are kept, keyed by
+ * pid, table id, table id extension, section number and version, and for EIT
+ * also the transport stream and original network id. A section with a new
+ * version replaces the sub-table it belongs to.
+ */
+class cSectionCache
+{
+public:
+  static cSectionCache& Get(void);
+
+  /*!
+   * @param maxTransponders The number of transponders to keep sections of, the least recently used one is dropped
+   * @param maxBytes        The maximum size of the sections kept for one transponder
+   * @param ttl             Seconds after which a section that wasn't received again is no longer returned
+   */
+  cSectionCache(size_t maxTransponders, size_t maxBytes, time_t ttl);
+  ~cSectionCache(void) { }
+
+  /*!
+   * Add a section received on the given pid. If crcvalid is TS_CRC_NOT_CHECKED,
+   * the CRC is checked and crcvalid is updated.
+   * @return True if the section is in the cache
+   */
+  bool Put(const cTransponder& transponder, uint16_t pid, const uint8_t* data, size_t len, ts_crc_check_t& crcvalid);
+
+  /*!
+   * Get the current sections on a pid with (table id & mask) == (tid & mask),
+   * ordered by table id, extension and section number
+   */
+  SectionVector GetSections(const cTransponder& transponder, uint16_t pid, uint8_t tid, uint8_t mask);
+
+  /*!
+   * Drop all sections of a transponder, e.g. after a channel scan found it changed
+   */
+  void Clear(const cTransponder& transponder);
+  void Clear(void);
+
+  size_t Size(void) const;
+
+private:
+  struct sSectionKey
+  {
+    uint16_t pid;
+    uint8_t  tid;
+    uint16_t extension;
+    uint32_t network;   // EIT: transport_stream_id << 16 | original_network_id
+    uint8_t  section;
+    uint8_t  version;
+
+    bool operator<(const sSectionKey& rhs) const;
+    bool SameTable(const sSectionKey& rhs) const { return pid == rhs.pid && tid == rhs.tid && extension == rhs.extension && network == rhs.network; }
+  };
+
+  struct sSection
+  {
+    SectionPtr data;
+    time_t     received;
+  };
+
+  struct sTransponderSections
+  {
+    cTransponder                     transponder;
+    std::map<sSectionKey, sSection>  sections;
+    size_t                           bytes;
+    time_t                           used;
+  };
+  typedef std::shared_ptr<sTransponderSections> TransponderSectionsPtr;
+
+  cSectionCache(const cSectionCache&); // no copy
+
+  TransponderSectionsPtr Find(const cTransponder& transponder) const; // requires m_mutex
+  void Expire(sTransponderSections& entry, time_t now);                // requires m_mutex
+
+  const size_t                        m_maxTransponders;
+  const size_t                        m_maxBytes;
+  const time_t                        m_ttl;
+  std::vector<TransponderSectionsPtr> m_transponders;
+  mutable PLATFORM::CMutex            m_mutex;
+};
+
+}
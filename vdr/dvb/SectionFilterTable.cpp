@@ -0,0 +1,78 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SectionFilterTable.h"
+#include "SectionAssembler.h"
+#include "devices/PIDResource.h"
+#include "devices/Remux.h"
+
+namespace VDR
+{
+
+cSectionFilterTable::cSectionFilterTable(void)
+ : m_filters(MAXPID)
+{
+}
+
+void cSectionFilterTable::Clear(void)
+{
+  for (std::vector<std::vector<sFilter> >::iterator it = m_filters.begin(); it != m_filters.end(); ++it)
+    it->clear();
+  m_ready.clear();
+}
+
+void cSectionFilterTable::AddFilter(const PidResourcePtr& resource, cSectionAssembler& assembler)
+{
+  sFilter filter = { resource, &assembler };
+  m_filters[resource->Pid() & (MAXPID - 1)].push_back(filter);
+
+  // Each section is read separately
+  for (size_t count = assembler.Queued(); count > 0; count--)
+    m_ready.push_back(resource);
+}
+
+unsigned int cSectionFilterTable::AddTsPacket(const uint8_t* packet)
+{
+  unsigned int total = 0;
+
+  const std::vector<sFilter>& filters = m_filters[TsPid(packet)];
+  for (std::vector<sFilter>::const_iterator it = filters.begin(); it != filters.end(); ++it)
+  {
+    for (unsigned int count = it->assembler->AddTsPacket(packet); count > 0; count--)
+    {
+      m_ready.push_back(it->resource);
+      total++;
+    }
+  }
+
+  return total;
+}
+
+bool cSectionFilterTable::Pop(PidResourcePtr& resource)
+{
+  if (m_ready.empty())
+    return false;
+
+  resource = m_ready.front();
+  m_ready.pop_front();
+  return true;
+}
+
+}
@@ -0,0 +1,85 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+namespace VDR
+{
+
+class cPidResource;
+class cSectionAssembler;
+
+/*!
+ * The section filters of a device that filters the full TS in software,
+ * indexed by PID, and the order in which the sections they assembled are to
+ * be read. A queued section is represented by the resource of its filter.
+ *
+ * The table is rebuilt whenever receivers are attached or detached. Sections
+ * that were assembled but not read yet stay in the filters' assemblers, so
+ * AddFilter() queues them again.
+ */
+class cSectionFilterTable
+{
+public:
+  typedef std::shared_ptr<cPidResource> PidResourcePtr;
+
+  cSectionFilterTable(void);
+  ~cSectionFilterTable(void) { }
+
+  /*!
+   * Remove every filter and the queued sections
+   */
+  void Clear(void);
+
+  /*!
+   * Add the filter of a resource, the assembler belongs to the resource
+   */
+  void AddFilter(const PidResourcePtr& resource, cSectionAssembler& assembler);
+
+  /*!
+   * Feed a TS packet to the filters of its PID
+   * @return The number of sections it completed
+   */
+  unsigned int AddTsPacket(const uint8_t* packet);
+
+  bool Empty(void) const { return m_ready.empty(); }
+
+  /*!
+   * Take the resource of the oldest queued section
+   * @return False if no section is queued
+   */
+  bool Pop(PidResourcePtr& resource);
+
+private:
+  struct sFilter
+  {
+    PidResourcePtr     resource;
+    cSectionAssembler* assembler;
+  };
+
+  std::vector<std::vector<sFilter> > m_filters; // Indexed by PID
+  std::deque<PidResourcePtr>         m_ready;
+};
+
+}
@@ -158,7 +158,7 @@ void cEit::ReceivePacket(uint16_t pid, const uint8_t* data)
            pEvent->SetTableID(tid);
            */
 
-          EventPtr thisEvent = EventPtr(new cEvent(eitEvent.getEventId()));
+          EventPtr thisEvent = std::make_shared<cEvent>(eitEvent.getEventId());
           thisEvent->SetStartTime(startTime);
           thisEvent->SetEndTime(startTime + CDateTimeSpan(0, 0, 0, iDuration));
           thisEvent->SetTableID(tsEIT.getTableId());
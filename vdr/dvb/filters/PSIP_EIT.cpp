@@ -91,7 +91,7 @@ void cPsipEit::ReceivePacket(uint16_t pid, const uint8_t* data)
     SI::PSIP_EIT::Event psipEitEvent;
     for (SI::Loop::Iterator it; psipEit.eventLoop.getNext(psipEitEvent, it); )
     {
-      EventPtr thisEvent = EventPtr(new cEvent(psipEitEvent.getEventId()));
+      EventPtr thisEvent = std::make_shared<cEvent>(psipEitEvent.getEventId());
 
       // Convert start time fom GPS to POSIX time system
       CDateTime posixEpoch;
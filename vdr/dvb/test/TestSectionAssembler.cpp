@@ -0,0 +1,191 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "dvb/SectionAssembler.h"
+#include "devices/Remux.h"
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace std;
+
+#define TEST_PID  0x12
+
+namespace VDR
+{
+
+namespace
+{
+  // Build a long syntax section with the given table id and size
+  vector<uint8_t> MakeSection(uint8_t tid, size_t size)
+  {
+    vector<uint8_t> data(size);
+    const size_t length = size - 3;
+    data[0] = tid;
+    data[1] = 0xB0 | ((length >> 8) & 0x0F);
+    data[2] = length & 0xFF;
+    for (size_t i = 3; i < size; i++)
+      data[i] = (uint8_t)(tid + i);
+    return data;
+  }
+
+  // Pack the sections back to back into TS packets, the first section
+  // starting in a packet is pointed at by its pointer field
+  vector<vector<uint8_t> > Packetize(const vector<vector<uint8_t> >& sections)
+  {
+    vector<uint8_t> stream;
+    vector<size_t> starts;
+    for (vector<vector<uint8_t> >::const_iterator it = sections.begin(); it != sections.end(); ++it)
+    {
+      starts.push_back(stream.size());
+      stream.insert(stream.end(), it->begin(), it->end());
+    }
+
+    vector<vector<uint8_t> > packets;
+    size_t pos = 0;
+    uint8_t counter = 0;
+    while (pos < stream.size())
+    {
+      vector<uint8_t> packet(TS_SIZE, 0xFF);
+      packet[0] = TS_SYNC_BYTE;
+      packet[1] = TEST_PID >> 8;
+      packet[2] = TEST_PID & 0xFF;
+      packet[3] = TS_PAYLOAD_EXISTS | (counter++ & TS_CONT_CNT_MASK);
+
+      size_t offset = 4;
+      for (vector<size_t>::const_iterator it = starts.begin(); it != starts.end(); ++it)
+      {
+        if (*it >= pos && *it < pos + TS_SIZE - 5)
+        {
+          packet[1] |= TS_PAYLOAD_START;
+          packet[offset++] = *it - pos;
+          break;
+        }
+      }
+
+      const size_t len = min((size_t)TS_SIZE - offset, stream.size() - pos);
+      copy(stream.begin() + pos, stream.begin() + pos + len, packet.begin() + offset);
+      pos += len;
+      packets.push_back(packet);
+    }
+    return packets;
+  }
+}
+
+TEST(SectionAssembler, PackedSections)
+{
+  vector<vector<uint8_t> > sections;
+  sections.push_back(MakeSection(0x42, 20));
+  sections.push_back(MakeSection(0x42, 30));
+  sections.push_back(MakeSection(0x42, 12));
+
+  vector<vector<uint8_t> > packets = Packetize(sections);
+  ASSERT_EQ(1u, packets.size());
+
+  // All sections of the packet are queued, up to the stuffing
+  cSectionAssembler assembler(0x42, 0xFF);
+  EXPECT_EQ(3u, assembler.AddTsPacket(packets[0].data()));
+
+  vector<uint8_t> section;
+  for (size_t i = 0; i < sections.size(); i++)
+  {
+    ASSERT_TRUE(assembler.GetSection(section));
+    EXPECT_EQ(sections[i], section);
+  }
+  EXPECT_FALSE(assembler.GetSection(section));
+}
+
+TEST(SectionAssembler, SplitSections)
+{
+  vector<vector<uint8_t> > sections;
+  sections.push_back(MakeSection(0x42, 300));
+  sections.push_back(MakeSection(0x46, 100));
+  sections.push_back(MakeSection(0x42, 500));
+
+  vector<vector<uint8_t> > packets = Packetize(sections);
+  ASSERT_EQ(5u, packets.size());
+
+  // The second and third packet end a section before their pointer field
+  // points at the next one, the last section ends in the last packet
+  cSectionAssembler assembler(0x40, 0xF0);
+  EXPECT_EQ(0u, assembler.AddTsPacket(packets[0].data()));
+  EXPECT_EQ(1u, assembler.AddTsPacket(packets[1].data()));
+  EXPECT_EQ(1u, assembler.AddTsPacket(packets[2].data()));
+  EXPECT_EQ(0u, assembler.AddTsPacket(packets[3].data()));
+  EXPECT_EQ(1u, assembler.AddTsPacket(packets[4].data()));
+  EXPECT_EQ(3u, assembler.Queued());
+
+  vector<uint8_t> section;
+  for (size_t i = 0; i < sections.size(); i++)
+  {
+    ASSERT_TRUE(assembler.GetSection(section));
+    EXPECT_EQ(sections[i], section);
+  }
+}
+
+TEST(SectionAssembler, Filter)
+{
+  vector<vector<uint8_t> > sections;
+  sections.push_back(MakeSection(0x42, 20));
+  sections.push_back(MakeSection(0x46, 20));
+  sections.push_back(MakeSection(0x42, 20));
+
+  vector<vector<uint8_t> > packets = Packetize(sections);
+  ASSERT_EQ(1u, packets.size());
+
+  cSectionAssembler assembler(0x46, 0xFF);
+  EXPECT_EQ(1u, assembler.AddTsPacket(packets[0].data()));
+
+  vector<uint8_t> section;
+  ASSERT_TRUE(assembler.GetSection(section));
+  EXPECT_EQ(sections[1], section);
+}
+
+TEST(SectionAssembler, Continuity)
+{
+  vector<vector<uint8_t> > sections;
+  sections.push_back(MakeSection(0x42, 500));
+  sections.push_back(MakeSection(0x42, 20));
+
+  vector<vector<uint8_t> > packets = Packetize(sections);
+  ASSERT_EQ(3u, packets.size());
+
+  // A duplicate packet doesn't add its payload twice
+  cSectionAssembler assembler(0x42, 0xFF);
+  EXPECT_EQ(0u, assembler.AddTsPacket(packets[0].data()));
+  EXPECT_EQ(0u, assembler.AddTsPacket(packets[1].data()));
+  EXPECT_EQ(0u, assembler.AddTsPacket(packets[1].data()));
+  EXPECT_EQ(2u, assembler.AddTsPacket(packets[2].data()));
+
+  vector<uint8_t> section;
+  ASSERT_TRUE(assembler.GetSection(section));
+  EXPECT_EQ(sections[0], section);
+
+  // A lost packet drops the section, the next one is assembled again
+  assembler.Reset();
+  EXPECT_EQ(0u, assembler.AddTsPacket(packets[0].data()));
+  EXPECT_EQ(1u, assembler.AddTsPacket(packets[2].data()));
+  ASSERT_TRUE(assembler.GetSection(section));
+  EXPECT_EQ(sections[1], section);
+  EXPECT_FALSE(assembler.GetSection(section));
+}
+
+}
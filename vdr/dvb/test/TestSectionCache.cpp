@@ -0,0 +1,236 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "dvb/SectionCache.h"
+
+#include "gtest/gtest.h"
+
+#include <libsi/util.h>
+#include <vector>
+
+using namespace std;
+
+namespace VDR
+{
+
+namespace
+{
+  void SetCRC(vector<uint8_t>& data)
+  {
+    const uint32_t crc = SI::CRC32::crc32((const char*)data.data(), data.size() - 4, 0xFFFFFFFF);
+    data[data.size() - 4] = crc >> 24;
+    data[data.size() - 3] = crc >> 16;
+    data[data.size() - 2] = crc >> 8;
+    data[data.size() - 1] = crc;
+  }
+
+  // Build a long syntax section with the given header fields and a valid CRC
+  vector<uint8_t> MakeSection(uint8_t tid, uint16_t extension, uint8_t version, uint8_t section, uint8_t lastSection, size_t payload = 4)
+  {
+    vector<uint8_t> data(8 + payload + 4, 0);
+    const size_t length = data.size() - 3;
+    data[0] = tid;
+    data[1] = 0xB0 | ((length >> 8) & 0x0F);
+    data[2] = length & 0xFF;
+    data[3] = extension >> 8;
+    data[4] = extension & 0xFF;
+    data[5] = 0xC1 | ((version & 0x1F) << 1);
+    data[6] = section;
+    data[7] = lastSection;
+    for (size_t i = 0; i < payload; i++)
+      data[8 + i] = (uint8_t)(tid + section + i);
+
+    SetCRC(data);
+    return data;
+  }
+
+  // Build an EIT section of a service on the given transport stream
+  vector<uint8_t> MakeEIT(uint8_t tid, uint16_t serviceId, uint16_t tsid, uint16_t onid, uint8_t version, uint8_t section)
+  {
+    vector<uint8_t> data = MakeSection(tid, serviceId, version, section, section, 6);
+    data[8]  = tsid >> 8;
+    data[9]  = tsid & 0xFF;
+    data[10] = onid >> 8;
+    data[11] = onid & 0xFF;
+    SetCRC(data);
+    return data;
+  }
+
+  cTransponder MakeTransponder(unsigned int frequencyMHz)
+  {
+    cTransponder transponder(TRANSPONDER_CABLE);
+    transponder.SetFrequencyMHz(frequencyMHz);
+    return transponder;
+  }
+
+  bool Put(cSectionCache& cache, const cTransponder& transponder, uint16_t pid, const vector<uint8_t>& section)
+  {
+    ts_crc_check_t crcvalid = TS_CRC_NOT_CHECKED;
+    return cache.Put(transponder, pid, section.data(), section.size(), crcvalid);
+  }
+}
+
+TEST(SectionCache, Put)
+{
+  cSectionCache cache(4, 1024 * 1024, 600);
+  const cTransponder transponder = MakeTransponder(474);
+
+  vector<uint8_t> pat = MakeSection(0x00, 1, 3, 0, 0);
+  EXPECT_TRUE(Put(cache, transponder, 0, pat));
+  EXPECT_EQ(pat.size(), cache.Size());
+
+  // The same section again doesn't take more space
+  EXPECT_TRUE(Put(cache, transponder, 0, pat));
+  EXPECT_EQ(pat.size(), cache.Size());
+
+  // Corrupted sections are rejected
+  vector<uint8_t> corrupt = MakeSection(0x02, 10, 0, 0, 0);
+  corrupt[9] ^= 0xFF;
+  ts_crc_check_t crcvalid = TS_CRC_NOT_CHECKED;
+  EXPECT_FALSE(cache.Put(transponder, 0x100, corrupt.data(), corrupt.size(), crcvalid));
+  EXPECT_EQ(TS_CRC_CHECKED_INVALID, crcvalid);
+
+  // So are short syntax sections (TDT) and sections that aren't applicable yet
+  vector<uint8_t> notCurrent = MakeSection(0x02, 10, 1, 0, 0);
+  notCurrent[5] &= ~0x01;
+  EXPECT_FALSE(Put(cache, transponder, 0x100, notCurrent));
+
+  const uint8_t tdt[] = { 0x70, 0x70, 0x05, 0xDE, 0xAD, 0x12, 0x34, 0x56 };
+  crcvalid = TS_CRC_NOT_CHECKED;
+  EXPECT_FALSE(cache.Put(transponder, 0x14, tdt, sizeof(tdt), crcvalid));
+
+  EXPECT_EQ(pat.size(), cache.Size());
+}
+
+TEST(SectionCache, GetSections)
+{
+  cSectionCache cache(4, 1024 * 1024, 600);
+  const cTransponder transponder = MakeTransponder(474);
+
+  // EIT present/following (0x4E) and two schedule sections (0x50) on pid 0x12
+  vector<uint8_t> pf        = MakeSection(0x4E, 100, 1, 0, 0);
+  vector<uint8_t> schedule1 = MakeSection(0x50, 100, 2, 1, 1);
+  vector<uint8_t> schedule0 = MakeSection(0x50, 100, 2, 0, 1);
+  EXPECT_TRUE(Put(cache, transponder, 0x12, pf));
+  EXPECT_TRUE(Put(cache, transponder, 0x12, schedule1));
+  EXPECT_TRUE(Put(cache, transponder, 0x12, schedule0));
+
+  SectionVector sections = cache.GetSections(transponder, 0x12, 0x00, 0x00);
+  ASSERT_EQ(3u, sections.size());
+  EXPECT_EQ(pf,        *sections[0]);
+  EXPECT_EQ(schedule0, *sections[1]); // in section number order
+  EXPECT_EQ(schedule1, *sections[2]);
+
+  sections = cache.GetSections(transponder, 0x12, 0x50, 0xF0);
+  EXPECT_EQ(2u, sections.size());
+
+  sections = cache.GetSections(transponder, 0x12, 0x4E, 0xFF);
+  ASSERT_EQ(1u, sections.size());
+  EXPECT_EQ(pf, *sections[0]);
+
+  EXPECT_TRUE(cache.GetSections(transponder, 0x11, 0x00, 0x00).empty());
+  EXPECT_TRUE(cache.GetSections(MakeTransponder(482), 0x12, 0x00, 0x00).empty());
+}
+
+TEST(SectionCache, EITTransportStreams)
+{
+  cSectionCache cache(4, 1024 * 1024, 600);
+  const cTransponder transponder = MakeTransponder(474);
+
+  // Other transport streams' EIT may use the same service id
+  vector<uint8_t> eit1 = MakeEIT(0x60, 100, 1, 1, 1, 0);
+  vector<uint8_t> eit2 = MakeEIT(0x60, 100, 2, 1, 1, 0);
+  vector<uint8_t> eit3 = MakeEIT(0x60, 100, 1, 2, 2, 0);
+  EXPECT_TRUE(Put(cache, transponder, 0x12, eit1));
+  EXPECT_TRUE(Put(cache, transponder, 0x12, eit2));
+  EXPECT_TRUE(Put(cache, transponder, 0x12, eit3));
+  EXPECT_EQ(3u, cache.GetSections(transponder, 0x12, 0x60, 0xFF).size());
+
+  // A new version only replaces the sub-table of its transport stream
+  vector<uint8_t> eit1v2 = MakeEIT(0x60, 100, 1, 1, 2, 0);
+  EXPECT_TRUE(Put(cache, transponder, 0x12, eit1v2));
+  SectionVector sections = cache.GetSections(transponder, 0x12, 0x60, 0xFF);
+  ASSERT_EQ(3u, sections.size());
+  EXPECT_EQ(eit1v2, *sections[0]);
+  EXPECT_EQ(eit3,   *sections[1]);
+  EXPECT_EQ(eit2,   *sections[2]);
+}
+
+TEST(SectionCache, NewVersion)
+{
+  cSectionCache cache(4, 1024 * 1024, 600);
+  const cTransponder transponder = MakeTransponder(474);
+
+  EXPECT_TRUE(Put(cache, transponder, 0x100, MakeSection(0x02, 10, 4, 0, 1)));
+  EXPECT_TRUE(Put(cache, transponder, 0x100, MakeSection(0x02, 10, 4, 1, 1)));
+  EXPECT_TRUE(Put(cache, transponder, 0x100, MakeSection(0x02, 11, 4, 0, 0)));
+
+  // A new version of programme 10 replaces all its sections, but not those of programme 11
+  vector<uint8_t> pmt = MakeSection(0x02, 10, 5, 0, 0);
+  EXPECT_TRUE(Put(cache, transponder, 0x100, pmt));
+
+  SectionVector sections = cache.GetSections(transponder, 0x100, 0x02, 0xFF);
+  ASSERT_EQ(2u, sections.size());
+  EXPECT_EQ(pmt, *sections[0]);
+  EXPECT_EQ(MakeSection(0x02, 11, 4, 0, 0), *sections[1]);
+  EXPECT_EQ(sections[0]->size() + sections[1]->size(), cache.Size());
+}
+
+TEST(SectionCache, Limits)
+{
+  const vector<uint8_t> section = MakeSection(0x42, 1, 0, 0, 0, 100);
+  cSectionCache cache(2, section.size() * 2, 600);
+
+  // Only two sections fit in a transponder
+  const cTransponder transponder = MakeTransponder(474);
+  EXPECT_TRUE(Put(cache, transponder, 0x11, section));
+  EXPECT_TRUE(Put(cache, transponder, 0x11, MakeSection(0x42, 2, 0, 0, 0, 100)));
+  EXPECT_FALSE(Put(cache, transponder, 0x11, MakeSection(0x42, 3, 0, 0, 0, 100)));
+  EXPECT_EQ(section.size() * 2, cache.Size());
+
+  // The least recently used transponder is dropped for a third one
+  const cTransponder transponder2 = MakeTransponder(482);
+  const cTransponder transponder3 = MakeTransponder(490);
+  EXPECT_TRUE(Put(cache, transponder2, 0x11, section));
+  EXPECT_TRUE(Put(cache, transponder3, 0x11, section));
+  EXPECT_FALSE(cache.GetSections(transponder3, 0x11, 0x42, 0xFF).empty());
+
+  size_t remaining = 0;
+  remaining += cache.GetSections(transponder,  0x11, 0x42, 0xFF).size();
+  remaining += cache.GetSections(transponder2, 0x11, 0x42, 0xFF).size();
+  EXPECT_EQ(1u, remaining);
+
+  cache.Clear(transponder3);
+  EXPECT_TRUE(cache.GetSections(transponder3, 0x11, 0x42, 0xFF).empty());
+  cache.Clear();
+  EXPECT_EQ(0u, cache.Size());
+}
+
+TEST(SectionCache, TimeToLive)
+{
+  cSectionCache cache(4, 1024 * 1024, 0);
+  const cTransponder transponder = MakeTransponder(474);
+
+  // Sections older than the time to live are kept but no longer returned
+  EXPECT_TRUE(Put(cache, transponder, 0, MakeSection(0x00, 1, 0, 0, 0)));
+  EXPECT_TRUE(cache.GetSections(transponder, 0, 0x00, 0xFF).empty());
+}
+
+}
@@ -0,0 +1,138 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "dvb/SectionAssembler.h"
+#include "dvb/SectionFilterTable.h"
+#include "devices/PIDResource.h"
+#include "devices/Remux.h"
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace std;
+
+#define TEST_PID  0x12
+
+namespace VDR
+{
+
+namespace
+{
+  class cTestResource : public cPidResource
+  {
+  public:
+    cTestResource(uint8_t tid) : cPidResource(TEST_PID, tid), m_assembler(tid, 0xFF) { }
+
+    virtual bool Equals(const cPidResource* other) const { return other == this; }
+    virtual bool Equals(uint16_t pid) const { return false; }
+    virtual bool Open(void) { return true; }
+    virtual void Close(void) { }
+    virtual RESOURCE_TYPE Type(void) const { return RESOURCE_TYPE_STREAMING; }
+    virtual int Handle(void) const { return -1; }
+    virtual std::string ToString(void) const { return "test"; }
+
+    cSectionAssembler& Assembler(void) { return m_assembler; }
+
+  private:
+    cSectionAssembler m_assembler;
+  };
+
+  // A TS packet carrying a single short section with the given table id
+  vector<uint8_t> MakePacket(uint8_t tid, uint8_t counter)
+  {
+    vector<uint8_t> packet(TS_SIZE, 0xFF);
+    packet[0] = TS_SYNC_BYTE;
+    packet[1] = TS_PAYLOAD_START | (TEST_PID >> 8);
+    packet[2] = TEST_PID & 0xFF;
+    packet[3] = TS_PAYLOAD_EXISTS | (counter & TS_CONT_CNT_MASK);
+    packet[4] = 0; // Pointer field
+    packet[5] = tid;
+    packet[6] = 0xB0;
+    packet[7] = 9;
+    for (unsigned int i = 8; i < 17; i++)
+      packet[i] = counter;
+    return packet;
+  }
+}
+
+TEST(SectionFilterTable, Order)
+{
+  cTestResource* pat = new cTestResource(0x00);
+  cTestResource* pmt = new cTestResource(0x02);
+  cSectionFilterTable::PidResourcePtr patPtr(pat);
+  cSectionFilterTable::PidResourcePtr pmtPtr(pmt);
+
+  cSectionFilterTable table;
+  table.AddFilter(patPtr, pat->Assembler());
+  table.AddFilter(pmtPtr, pmt->Assembler());
+  EXPECT_TRUE(table.Empty());
+
+  // Only the filter matching the table id queues the section
+  EXPECT_EQ(1u, table.AddTsPacket(MakePacket(0x02, 0).data()));
+  EXPECT_EQ(1u, table.AddTsPacket(MakePacket(0x00, 1).data()));
+  EXPECT_EQ(0u, table.AddTsPacket(MakePacket(0x42, 2).data()));
+
+  cSectionFilterTable::PidResourcePtr resource;
+  ASSERT_TRUE(table.Pop(resource));
+  EXPECT_EQ(pmtPtr, resource);
+  ASSERT_TRUE(table.Pop(resource));
+  EXPECT_EQ(patPtr, resource);
+  EXPECT_FALSE(table.Pop(resource));
+}
+
+TEST(SectionFilterTable, Rebuild)
+{
+  cTestResource* pat = new cTestResource(0x00);
+  cTestResource* pmt = new cTestResource(0x02);
+  cSectionFilterTable::PidResourcePtr patPtr(pat);
+  cSectionFilterTable::PidResourcePtr pmtPtr(pmt);
+
+  cSectionFilterTable table;
+  table.AddFilter(patPtr, pat->Assembler());
+  table.AddFilter(pmtPtr, pmt->Assembler());
+
+  EXPECT_EQ(1u, table.AddTsPacket(MakePacket(0x00, 0).data()));
+  EXPECT_EQ(1u, table.AddTsPacket(MakePacket(0x00, 1).data()));
+  EXPECT_EQ(1u, table.AddTsPacket(MakePacket(0x02, 2).data()));
+
+  // A receiver was attached or detached before the sections were read. The
+  // unread sections of the filters that are still wanted are queued again.
+  table.Clear();
+  EXPECT_TRUE(table.Empty());
+  table.AddFilter(patPtr, pat->Assembler());
+
+  vector<uint8_t> section;
+  cSectionFilterTable::PidResourcePtr resource;
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    ASSERT_TRUE(table.Pop(resource));
+    EXPECT_EQ(patPtr, resource);
+    ASSERT_TRUE(pat->Assembler().GetSection(section));
+    EXPECT_EQ(i, section[3]);
+  }
+  EXPECT_FALSE(table.Pop(resource));
+  EXPECT_EQ(0u, pat->Assembler().Queued());
+
+  // The detached filter isn't fed anymore
+  EXPECT_EQ(0u, table.AddTsPacket(MakePacket(0x02, 3).data()));
+}
+
+}
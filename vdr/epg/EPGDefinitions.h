@@ -23,6 +23,9 @@
 #define EPG_XML_ROOT              "epg"
 #define EPG_XML_ELM_SCHEDULE      "schedule"
 #define EPG_XML_ELM_EVENT         "event"
+#define EPG_XML_ELM_DELETED       "deleted"
+#define EPG_XML_ELM_JOURNAL       "journal"
+#define EPG_XML_ELM_GENERATION    "generation"
 #define EPG_XML_ELM_TITLE         "title"
 #define EPG_XML_ELM_PLOT_OUTLINE  "plot_outline"
 #define EPG_XML_ELM_PLOT          "plot"
@@ -32,6 +35,7 @@
 #define EPG_XML_ELM_CONTENT       "content"
 
 #define EPG_XML_ATTR_EVENT_ID     "id"
+#define EPG_XML_ATTR_GENERATION   "generation"
 #define EPG_XML_ATTR_ATSC_SOURCE_ID "atscsourceid"
 #define EPG_XML_ATTR_START_TIME   "start"
 #define EPG_XML_ATTR_END_TIME     "end"
@@ -26,6 +26,7 @@
 #include "utils/StringUtils.h"
 #include "utils/XBMCTinyXML.h"
 
+#include <algorithm>
 #include <stddef.h>
 
 #define TABLE_ID_INVALID           0xFF
@@ -39,6 +40,11 @@ namespace VDR
 
 const EventPtr cEvent::EmptyEvent;
 
+namespace
+{
+  const std::vector<CEpgComponent> EmptyComponents;
+}
+
 cEvent::cEvent(unsigned int eventID)
  : m_eventID(eventID)
 {
@@ -48,22 +54,35 @@ cEvent::cEvent(unsigned int eventID)
 void cEvent::Reset(void)
 {
   m_atscSourceId = 0;
-  m_strTitle.clear();
-  m_strPlotOutline.clear();
-  m_strPlot.clear();
+  m_strTitle = cInternedString();
+  m_strPlotOutline = cInternedString();
+  m_strPlot = cInternedString();
   m_channelID = cChannelID::InvalidID;
-  m_startTime.Reset();
-  m_endTime.Reset();
+  m_startTime = 0;
+  m_endTime = 0;
   m_genreType = EPG_GENRE_UNDEFINED;
   m_genreSubType = EPG_SUB_GENRE_DRAMA_OTHER;
-  m_strCustomGenre.clear();
+  m_strCustomGenre = cInternedString();
   m_parentalRating = 0;
   m_starRating = 0;
   m_tableID = TABLE_ID_INVALID;
   m_version = VERSION_INVALID;
-  m_vps.Reset();
-  m_components.clear();
-  m_contents.clear();
+  m_contentsCount = 0;
+  m_vps = 0;
+  m_components.reset();
+}
+
+uint32_t cEvent::PackTime(const CDateTime& time)
+{
+  time_t retval = 0;
+  if (time.IsValid())
+    time.GetAsTime(retval);
+  return retval;
+}
+
+CDateTime cEvent::UnpackTime(uint32_t time)
+{
+  return time != 0 ? CDateTime((time_t)time) : CDateTime();
 }
 
 cEvent& cEvent::operator=(const cEvent& rhs)
@@ -71,20 +90,40 @@ cEvent& cEvent::operator=(const cEvent& rhs)
   if (this != &rhs)
   {
     SetAtscSourceID(rhs.AtscSourceID());
-    SetTitle(rhs.Title());
-    SetPlotOutline(rhs.PlotOutline());
-    SetPlot(rhs.Plot());
+    if (m_strTitle != rhs.m_strTitle || m_strPlotOutline != rhs.m_strPlotOutline || m_strPlot != rhs.m_strPlot)
+    {
+      // Interned, so these are pointer copies
+      m_strTitle = rhs.m_strTitle;
+      m_strPlotOutline = rhs.m_strPlotOutline;
+      m_strPlot = rhs.m_strPlot;
+      SetChanged();
+    }
     SetChannelID(rhs.ChannelID());
-    SetStartTime(rhs.StartTime());
-    SetEndTime(rhs.EndTime());
+    if (m_startTime != rhs.m_startTime || m_endTime != rhs.m_endTime)
+    {
+      m_startTime = rhs.m_startTime;
+      m_endTime = rhs.m_endTime;
+      SetChanged();
+    }
     SetGenre(rhs.Genre(), rhs.SubGenre());
+    if (rhs.Genre() == EPG_GENRE_CUSTOM)
+      SetCustomGenre(rhs.CustomGenre());
     SetParentalRating(rhs.ParentalRating());
     SetStarRating(rhs.StarRating());
     SetTableID(rhs.TableID());
     SetVersion(rhs.Version());
-    SetVps(rhs.Vps());
+    if (m_vps != rhs.m_vps)
+    {
+      m_vps = rhs.m_vps;
+      SetChanged();
+    }
     SetComponents(rhs.Components());
-    SetContents(rhs.Contents());
+    if (m_contentsCount != rhs.m_contentsCount || !std::equal(m_contents, m_contents + m_contentsCount, rhs.m_contents))
+    {
+      m_contentsCount = rhs.m_contentsCount;
+      std::copy(rhs.m_contents, rhs.m_contents + rhs.m_contentsCount, m_contents);
+      SetChanged();
+    }
   }
   return *this;
 }
@@ -100,7 +139,7 @@ void cEvent::SetAtscSourceID(uint32_t atscSourceId)
 
 void cEvent::SetTitle(const std::string& strTitle)
 {
-  if (m_strTitle != strTitle)
+  if (Title() != strTitle)
   {
     m_strTitle = strTitle;
     SetChanged();
@@ -109,7 +148,7 @@ void cEvent::SetTitle(const std::string& strTitle)
 
 void cEvent::SetPlotOutline(const std::string& strPlotOutline)
 {
-  if (m_strPlotOutline != strPlotOutline)
+  if (PlotOutline() != strPlotOutline)
   {
     m_strPlotOutline = strPlotOutline;
     SetChanged();
@@ -118,7 +157,7 @@ void cEvent::SetPlotOutline(const std::string& strPlotOutline)
 
 void cEvent::SetPlot(const std::string& strPlot)
 {
-  if (m_strPlot != strPlot)
+  if (Plot() != strPlot)
   {
     m_strPlot = strPlot;
     SetChanged();
@@ -136,18 +175,20 @@ void cEvent::SetChannelID(const cChannelID& channelId)
 
 void cEvent::SetStartTime(const CDateTime& startTime)
 {
-  if (m_startTime != startTime)
+  const uint32_t time = PackTime(startTime);
+  if (m_startTime != time)
   {
-    m_startTime = startTime;
+    m_startTime = time;
     SetChanged();
   }
 }
 
 void cEvent::SetEndTime(const CDateTime& endTime)
 {
-  if (m_endTime != endTime)
+  const uint32_t time = PackTime(endTime);
+  if (m_endTime != time)
   {
-    m_endTime = endTime;
+    m_endTime = time;
     SetChanged();
   }
 }
@@ -164,7 +205,7 @@ void cEvent::SetGenre(EPG_GENRE genre, EPG_SUB_GENRE subGenre)
 
 void cEvent::SetCustomGenre(const std::string& strCustomGenre)
 {
-  if (m_genreType != EPG_GENRE_CUSTOM || m_strCustomGenre != strCustomGenre)
+  if (m_genreType != EPG_GENRE_CUSTOM || CustomGenre() != strCustomGenre)
   {
     m_genreType = EPG_GENRE_CUSTOM;
     m_strCustomGenre = strCustomGenre;
@@ -239,31 +280,54 @@ void cEvent::SetVersion(uint8_t version)
 
 void cEvent::SetVps(const CDateTime& vps)
 {
-  if (m_vps != vps)
+  const uint32_t time = PackTime(vps);
+  if (m_vps != time)
   {
-    m_vps = vps;
+    m_vps = time;
     SetChanged();
   }
 }
 
+const std::vector<CEpgComponent>& cEvent::Components(void) const
+{
+  return m_components ? *m_components : EmptyComponents;
+}
+
 void cEvent::SetComponents(const std::vector<CEpgComponent>& components)
 {
-  if (m_components != components)
+  if (Components() != components)
   {
-    m_components = components;
+    if (components.empty())
+      m_components.reset();
+    else
+      m_components.reset(new std::vector<CEpgComponent>(components));
     SetChanged();
   }
 }
 
 void cEvent::SetContents(const std::vector<uint8_t>& contents)
 {
-  if (m_contents != contents)
+  const size_t count = std::min(contents.size(), (size_t)EPG_MAX_CONTENTS);
+  if (m_contentsCount != count || !std::equal(m_contents, m_contents + count, contents.begin()))
   {
-    m_contents = contents;
+    m_contentsCount = count;
+    std::copy(contents.begin(), contents.begin() + count, m_contents);
     SetChanged();
   }
 }
 
+size_t cEvent::MemoryUsage(void) const
+{
+  size_t bytes = sizeof(*this) + Observable::m_observers.capacity() * sizeof(Observer*);
+  if (m_components)
+  {
+    bytes += sizeof(*m_components) + m_components->capacity() * sizeof(CEpgComponent);
+    for (std::vector<CEpgComponent>::const_iterator it = m_components->begin(); it != m_components->end(); ++it)
+      bytes += it->Language().capacity() + it->Description().capacity();
+  }
+  return bytes;
+}
+
 std::string cEvent::ToString(void) const
 {
   std::string strVps;
@@ -274,9 +338,14 @@ std::string cEvent::ToString(void) const
 
 void cEvent::FixEpgBugs(void)
 {
-  if (m_strTitle.empty()) {
+  // Interned strings are immutable, fix copies and store the result
+  std::string strTitle       = Title();
+  std::string strPlotOutline = PlotOutline();
+  std::string strPlot        = Plot();
+
+  if (strTitle.empty()) {
      // we don't want any "(null)" titles
-    m_strTitle = tr("No title");
+    strTitle = tr("No title");
   }
 
   if (cSettings::Get().m_iEPGBugfixLevel == 0)
@@ -291,9 +360,9 @@ void cEvent::FixEpgBugs(void)
   // Title
   // "PlotOutline". Plot
   //
-  if (m_strPlotOutline.empty() != !m_strPlot.empty())
+  if (strPlotOutline.empty() != !strPlot.empty())
   {
-    std::string strCheck = !m_strPlotOutline.empty() ? m_strPlotOutline : m_strPlot;
+    std::string strCheck = !strPlotOutline.empty() ? strPlotOutline : strPlot;
     if (!strCheck.empty() && strCheck.at(0) == '"')
     {
       const char *delim = "\".";
@@ -301,9 +370,9 @@ void cEvent::FixEpgBugs(void)
       size_t delimPos = strCheck.find(delim);
       if (delimPos != std::string::npos)
       {
-        m_strPlot = m_strPlotOutline = strCheck;
-        m_strPlot.erase(0, delimPos);
-        m_strPlotOutline.erase(delimPos);
+        strPlot = strPlotOutline = strCheck;
+        strPlot.erase(0, delimPos);
+        strPlotOutline.erase(delimPos);
       }
     }
   }
@@ -315,11 +384,11 @@ void cEvent::FixEpgBugs(void)
   // Title
   //  Plot
   //
-  if (!m_strPlotOutline.empty() && m_strPlot.empty())
+  if (!strPlotOutline.empty() && strPlot.empty())
   {
-    StringUtils::Trim(m_strPlotOutline);
-    m_strPlot = m_strPlotOutline;
-    m_strPlotOutline.clear();
+    StringUtils::Trim(strPlotOutline);
+    strPlot = strPlotOutline;
+    strPlotOutline.clear();
   }
 
   // Sometimes they repeat the Title in the PlotOutline:
@@ -327,8 +396,8 @@ void cEvent::FixEpgBugs(void)
   // Title
   // Title
   //
-  if (!m_strPlotOutline.empty() && m_strTitle == m_strPlotOutline)
-    m_strPlotOutline.clear();
+  if (!strPlotOutline.empty() && strTitle == strPlotOutline)
+    strPlotOutline.clear();
 
   // Some channels put the PlotOutline between double quotes, which is nothing
   // but annoying (some even put a '.' after the closing '"'):
@@ -336,18 +405,18 @@ void cEvent::FixEpgBugs(void)
   // Title
   // "PlotOutline"[.]
   //
-  if (!m_strPlotOutline.empty() && m_strPlotOutline.at(0) == '"')
+  if (!strPlotOutline.empty() && strPlotOutline.at(0) == '"')
   {
-    size_t len = m_strPlotOutline.size();
+    size_t len = strPlotOutline.size();
     if (len > 2 &&
-        (m_strPlotOutline.at(len - 1) == '"' ||
-            (m_strPlotOutline.at(len - 1) == '.' && m_strPlotOutline.at(len - 2) == '"')))
+        (strPlotOutline.at(len - 1) == '"' ||
+            (strPlotOutline.at(len - 1) == '.' && strPlotOutline.at(len - 2) == '"')))
     {
-      m_strPlotOutline.erase(0, 1);
-      const char* tmp = m_strPlotOutline.c_str();
+      strPlotOutline.erase(0, 1);
+      const char* tmp = strPlotOutline.c_str();
       const char *p = strrchr(tmp, '"');
       if (p)
-        m_strPlotOutline.erase(m_strPlotOutline.size() - (p - tmp));
+        strPlotOutline.erase(strPlotOutline.size() - (p - tmp));
     }
   }
 
@@ -358,45 +427,45 @@ void cEvent::FixEpgBugs(void)
   // which is a bad idea because they have no way of knowing the width
   // of the window that will actually display the text.
   // Remove excess whitespace:
-  StringUtils::Trim(m_strTitle);
-  StringUtils::Trim(m_strPlotOutline);
-  StringUtils::Trim(m_strPlot);
+  StringUtils::Trim(strTitle);
+  StringUtils::Trim(strPlotOutline);
+  StringUtils::Trim(strPlot);
 
   // Some channels put a whole lot of information in the PlotOutline and leave
   // the Plot totally empty. So if the PlotOutline length exceeds
   // MAX_USEFUL_EPISODE_LENGTH, let's put this into the Plot
   // instead:
-  if (!m_strPlotOutline.empty() && m_strPlot.empty())
+  if (!strPlotOutline.empty() && strPlot.empty())
   {
-    if (m_strPlotOutline.size() > MAX_USEFUL_EPISODE_LENGTH)
-      m_strPlot.swap(m_strPlotOutline);
+    if (strPlotOutline.size() > MAX_USEFUL_EPISODE_LENGTH)
+      strPlot.swap(strPlotOutline);
   }
 
   // Some channels put the same information into PlotOutline and Plot.
   // In that case we delete one of them:
-  if (!m_strPlotOutline.empty() && !m_strPlot.empty() && m_strPlotOutline == m_strPlot)
+  if (!strPlotOutline.empty() && !strPlot.empty() && strPlotOutline == strPlot)
   {
-    if (m_strPlotOutline.size() > MAX_USEFUL_EPISODE_LENGTH)
-      m_strPlotOutline.clear();
+    if (strPlotOutline.size() > MAX_USEFUL_EPISODE_LENGTH)
+      strPlotOutline.clear();
     else
-      m_strPlot.clear();
+      strPlot.clear();
   }
 
   // Some channels use the ` ("backtick") character, where a ' (single quote)
   // would be normally used. Actually, "backticks" in normal text don't make
   // much sense, so let's replace them:
-  StringUtils::Replace(m_strTitle, '`', '\'');
-  StringUtils::Replace(m_strPlotOutline, '`', '\'');
-  StringUtils::Replace(m_strPlot, '`', '\'');
+  StringUtils::Replace(strTitle, '`', '\'');
+  StringUtils::Replace(strPlotOutline, '`', '\'');
+  StringUtils::Replace(strPlot, '`', '\'');
 
   if (cSettings::Get().m_iEPGBugfixLevel <= 2)
     goto Final;
 
   // The stream components have a "plot" field which some channels
   // apparently have no idea of how to set correctly:
-  if (!m_components.empty())
+  if (m_components)
   {
-    for (vector<CEpgComponent>::iterator itComponent = m_components.begin(); itComponent != m_components.end(); ++itComponent)
+    for (vector<CEpgComponent>::iterator itComponent = m_components->begin(); itComponent != m_components->end(); ++itComponent)
     {
       CEpgComponent& component = *itComponent;
 
@@ -483,7 +552,9 @@ void cEvent::FixEpgBugs(void)
   }
 
 Final:
-  return;
+  m_strTitle       = strTitle;
+  m_strPlotOutline = strPlotOutline;
+  m_strPlot        = strPlot;
 }
 
 void AddEventElement(TiXmlElement* eventElement, const std::string& strElement, const std::string& strText)
@@ -512,11 +583,11 @@ bool cEvent::Serialise(TiXmlNode* node) const
     elem->SetAttribute(EPG_XML_ATTR_ATSC_SOURCE_ID, m_atscSourceId);
 
   if (!m_strTitle.empty())
-    AddEventElement(elem, EPG_XML_ELM_TITLE, m_strTitle);
+    AddEventElement(elem, EPG_XML_ELM_TITLE, Title());
   if (!m_strPlotOutline.empty())
-    AddEventElement(elem, EPG_XML_ELM_PLOT_OUTLINE, m_strPlotOutline);
+    AddEventElement(elem, EPG_XML_ELM_PLOT_OUTLINE, PlotOutline());
   if (!m_strPlot.empty())
-    AddEventElement(elem, EPG_XML_ELM_PLOT, m_strPlot);
+    AddEventElement(elem, EPG_XML_ELM_PLOT, Plot());
 
   if (!m_channelID.Serialise(node))
     return false;
@@ -530,15 +601,10 @@ bool cEvent::Serialise(TiXmlNode* node) const
     elem->SetAttribute(EPG_XML_ATTR_SUBGENRE, strSubGenre.c_str());
 
   if (m_genreType == EPG_GENRE_CUSTOM && !m_strCustomGenre.empty())
-    elem->SetAttribute(EPG_XML_ATTR_CUSTOM_GENRE, m_strCustomGenre.c_str());
-
-  time_t tmStart;
-  m_startTime.GetAsTime(tmStart);
-  elem->SetAttribute(EPG_XML_ATTR_START_TIME, tmStart);
+    elem->SetAttribute(EPG_XML_ATTR_CUSTOM_GENRE, CustomGenre().c_str());
 
-  time_t tmEnd;
-  m_endTime.GetAsTime(tmEnd);
-  elem->SetAttribute(EPG_XML_ATTR_END_TIME, tmEnd);
+  elem->SetAttribute(EPG_XML_ATTR_START_TIME, m_startTime);
+  elem->SetAttribute(EPG_XML_ATTR_END_TIME, m_endTime);
 
   if (m_parentalRating)
     elem->SetAttribute(EPG_XML_ATTR_PARENTAL, m_parentalRating);
@@ -552,20 +618,16 @@ bool cEvent::Serialise(TiXmlNode* node) const
   if (m_version != VERSION_INVALID)
     elem->SetAttribute(EPG_XML_ATTR_STAR, m_version);
 
-  if (m_vps.IsValid())
-  {
-    time_t tmVps;
-    m_vps.GetAsTime(tmVps);
-    elem->SetAttribute(EPG_XML_ATTR_VPS, tmVps);
-  }
+  if (m_vps != 0)
+    elem->SetAttribute(EPG_XML_ATTR_VPS, m_vps);
 
-  if (!m_components.empty())
+  if (m_components)
   {
     TiXmlElement componentsElement(EPG_XML_ELM_COMPONENTS);
     TiXmlNode* componentsNode = elem->InsertEndChild(componentsElement);
     if (componentsNode)
     {
-      for (vector<CEpgComponent>::const_iterator itComponent = m_components.begin(); itComponent != m_components.end(); ++itComponent)
+      for (vector<CEpgComponent>::const_iterator itComponent = m_components->begin(); itComponent != m_components->end(); ++itComponent)
       {
         TiXmlElement componentElement(EPG_XML_ELM_COMPONENT);
         TiXmlNode* componentNode = componentsNode->InsertEndChild(componentElement);
@@ -575,9 +637,9 @@ bool cEvent::Serialise(TiXmlNode* node) const
     }
   }
 
-  if (!m_contents.empty())
+  if (m_contentsCount > 0)
   {
-    for (std::vector<uint8_t>::const_iterator it = m_contents.begin(); it != m_contents.end(); ++it)
+    for (const uint8_t* it = m_contents; it != m_contents + m_contentsCount; ++it)
     {
       TiXmlElement contentsElement(EPG_XML_ELM_CONTENTS);
       TiXmlNode* contentsNode = elem->InsertEndChild(contentsElement);
@@ -609,7 +671,7 @@ bool cEvent::Deserialise(EventPtr& event, const TiXmlNode *eventNode)
   const char* strID = elem->Attribute(EPG_XML_ATTR_EVENT_ID);
   if (strID != NULL)
   {
-    event = EventPtr(new cEvent(StringUtils::IntVal(strID)));
+    event = std::make_shared<cEvent>(StringUtils::IntVal(strID));
     return event->Deserialise(eventNode);
   }
 
@@ -632,15 +694,15 @@ bool cEvent::Deserialise(const TiXmlNode* node)
     m_atscSourceId = StringUtils::IntVal(atscSourceId);
 
   const TiXmlNode* titleNode = elem->FirstChild(EPG_XML_ELM_TITLE);
-  if (titleNode != NULL)
+  if (titleNode != NULL && titleNode->ToElement()->GetText())
     m_strTitle = titleNode->ToElement()->GetText();
 
   const TiXmlNode* plotOutlineNode = elem->FirstChild(EPG_XML_ELM_PLOT_OUTLINE);
-  if (plotOutlineNode != NULL)
+  if (plotOutlineNode != NULL && plotOutlineNode->ToElement()->GetText())
     m_strPlotOutline = plotOutlineNode->ToElement()->GetText();
 
   const TiXmlNode* plotNode = elem->FirstChild(EPG_XML_ELM_PLOT);
-  if (plotNode)
+  if (plotNode && plotNode->ToElement()->GetText())
     m_strPlot = plotNode->ToElement()->GetText();
 
   if (!m_channelID.Deserialise(node))
@@ -648,11 +710,11 @@ bool cEvent::Deserialise(const TiXmlNode* node)
 
   const char* strStart = elem->Attribute(EPG_XML_ATTR_START_TIME);
   if (strStart != NULL)
-    m_startTime = CDateTime((time_t)StringUtils::IntVal(strStart));
+    m_startTime = StringUtils::IntVal(strStart);
 
   const char* strEnd = elem->Attribute(EPG_XML_ATTR_END_TIME);
   if (strEnd != NULL)
-    m_startTime = CDateTime((time_t)StringUtils::IntVal(strEnd));
+    m_endTime = StringUtils::IntVal(strEnd);
 
   const char* strGenre = elem->Attribute(EPG_XML_ATTR_GENRE);
   if (strGenre != NULL)
@@ -662,7 +724,7 @@ bool cEvent::Deserialise(const TiXmlNode* node)
   {
     const char* strCustomGenre = elem->Attribute(EPG_XML_ATTR_CUSTOM_GENRE);
     if (strCustomGenre != NULL)
-      m_strCustomGenre = strCustomGenre;
+      m_strCustomGenre = std::string(strCustomGenre);
   }
   else
   {
@@ -689,7 +751,7 @@ bool cEvent::Deserialise(const TiXmlNode* node)
 
   const char* strVps  = elem->Attribute(EPG_XML_ATTR_VPS);
   if (strVps)
-    m_vps = CDateTime((time_t)StringUtils::IntVal(strVps));
+    m_vps = StringUtils::IntVal(strVps);
 
   const TiXmlNode* componentsNode = elem->FirstChild(EPG_XML_ELM_COMPONENTS);
   if (componentsNode)
@@ -701,8 +763,15 @@ bool cEvent::Deserialise(const TiXmlNode* node)
       if (num)
       {
         CEpgComponent component;
+        const unsigned int index = StringUtils::IntVal(num);
         if (component.Deserialise(componentNode))
-          m_components[StringUtils::IntVal(num)] = component;
+        {
+          if (!m_components)
+            m_components.reset(new std::vector<CEpgComponent>);
+          if (m_components->size() <= index)
+            m_components->resize(index + 1);
+          (*m_components)[index] = component;
+        }
       }
       componentNode = componentNode->NextSibling(EPG_XML_ELM_COMPONENT);
     }
@@ -711,7 +780,8 @@ bool cEvent::Deserialise(const TiXmlNode* node)
   const TiXmlNode* contentsNode = elem->FirstChild(EPG_XML_ELM_CONTENTS);
   while (contentsNode != NULL)
   {
-    m_contents.push_back(StringUtils::IntVal(contentsNode->ToElement()->GetText()));
+    if (m_contentsCount < EPG_MAX_CONTENTS)
+      m_contents[m_contentsCount++] = StringUtils::IntVal(contentsNode->ToElement()->GetText());
     contentsNode = contentsNode->NextSibling(EPG_XML_ELM_CONTENTS);
   }
 
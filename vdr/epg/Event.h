@@ -28,18 +28,28 @@
 #include "channels/ChannelID.h"
 #include "channels/ChannelTypes.h"
 #include "utils/DateTime.h"
+#include "utils/InternedString.h"
 #include "utils/Observer.h"
 
 //#include <libsi/si.h> // for SI::RunningStatus
+#include <memory>
 #include <stdint.h>
 #include <string>
 #include <vector>
 
+#define EPG_MAX_CONTENTS  4
+
 class TiXmlElement;
 
 namespace VDR
 {
 
+/*!
+ * Events are kept for every channel for up to several weeks, so their storage
+ * is compact: texts are interned (titles and descriptions repeat across a
+ * series), times are stored as 32-bit UTC timestamps and components are only
+ * allocated when present.
+ */
 class cEvent : public Observable
 {
 public:
@@ -66,19 +76,19 @@ public:
   /*!
    * Title of this event
    */
-  const std::string& Title(void) const { return m_strTitle; }
+  const std::string& Title(void) const { return m_strTitle.Str(); }
   void SetTitle(const std::string& strTitle);
 
   /*!
    * Short description of this event (typically the episode name in case of a series)
    */
-  const std::string& PlotOutline(void) const { return m_strPlotOutline; }
+  const std::string& PlotOutline(void) const { return m_strPlotOutline.Str(); }
   void SetPlotOutline(const std::string& strPlotOutline);
 
   /*!
    * Description of this event
    */
-  const std::string& Plot(void) const { return m_strPlot; }
+  const std::string& Plot(void) const { return m_strPlot.Str(); }
   void SetPlot(const std::string& strPlot);
 
   /*!
@@ -90,22 +100,22 @@ public:
   /*!
    * Start time of this event
    */
-  const CDateTime& StartTime(void) const { return m_startTime; }
-  time_t StartTimeAsTime(void)     const { time_t retval; StartTime().GetAsTime(retval); return retval; }
+  CDateTime StartTime(void)    const { return UnpackTime(m_startTime); }
+  time_t StartTimeAsTime(void) const { return m_startTime; }
   void SetStartTime(const CDateTime& startTime);
 
   /*!
    * End time of this event
    */
-  const CDateTime& EndTime(void) const { return m_endTime; }
-  time_t EndTimeAsTime(void)     const { time_t retval; EndTime().GetAsTime(retval); return retval; }
+  CDateTime EndTime(void)    const { return UnpackTime(m_endTime); }
+  time_t EndTimeAsTime(void) const { return m_endTime; }
   void SetEndTime(const CDateTime& endTime);
 
   /*!
    * Duration (computed from start time and end time)
    */
-  CDateTimeSpan Duration(void)    const { return m_endTime - m_startTime; }
-  unsigned int DurationSecs(void) const { return (m_endTime - m_startTime).GetSecondsTotal(); }
+  CDateTimeSpan Duration(void)    const { return EndTime() - StartTime(); }
+  unsigned int DurationSecs(void) const { return m_endTime - m_startTime; }
 
   /*!
    * Genre and sub-genre
@@ -119,7 +129,7 @@ public:
    * types. Used only if Genre() == EPG_GENRE_CUSTOM. Setting a custom genre
    * will force genre to EPG_GENRE_CUSTOM.
    */
-  const std::string& CustomGenre(void) const { return m_strCustomGenre; }
+  const std::string& CustomGenre(void) const { return m_strCustomGenre.Str(); }
   void SetCustomGenre(const std::string& strCustomGenre);
 
   /*!
@@ -151,22 +161,22 @@ public:
   /*!
    * Video Programming Service timestamp (VPS, aka "Programme Identification Label", PIL)
    */
-  bool HasVps(void) const            { return m_vps.IsValid(); }
-  const CDateTime& Vps(void) const   { return m_vps; }
-  std::string VpsString(void) const  { return m_vps.GetAsSaveString(); }
+  bool HasVps(void) const            { return m_vps != 0; }
+  CDateTime Vps(void) const          { return UnpackTime(m_vps); }
+  std::string VpsString(void) const  { return Vps().GetAsSaveString(); }
   void SetVps(const CDateTime& vps);
 
   /*!
    * The stream components of this event
    */
-  const std::vector<CEpgComponent>& Components(void) const { return m_components; }
+  const std::vector<CEpgComponent>& Components(void) const;
   void SetComponents(const std::vector<CEpgComponent>& components);
 
   /*!
-   * Contents of this event (Max: 4 contents)
+   * Contents of this event (Max: EPG_MAX_CONTENTS contents)
    */
-  const std::vector<uint8_t>& Contents(void) const { return m_contents; }
-  uint8_t GetContents(unsigned int i = 0) const    { return i < m_contents.size() ? m_contents[i] : 0; }
+  std::vector<uint8_t> Contents(void) const     { return std::vector<uint8_t>(m_contents, m_contents + m_contentsCount); }
+  uint8_t GetContents(unsigned int i = 0) const { return i < m_contentsCount ? m_contents[i] : 0; }
   void SetContents(const std::vector<uint8_t>& contents);
 
   /*!
@@ -180,29 +190,39 @@ public:
   static bool Deserialise(EventPtr& event, const TiXmlNode* eventNode);
   bool Deserialise(const TiXmlNode* node);
 
+  /*!
+   * Approximate heap usage of this event, excluding interned strings which
+   * are shared with other events
+   */
+  size_t MemoryUsage(void) const;
+
 private:
+  static uint32_t PackTime(const CDateTime& time);
+  static CDateTime UnpackTime(uint32_t time);
+
   // XBMC data
   const unsigned int   m_eventID;
   uint32_t             m_atscSourceId;
   // TODO: ATSC Source ID
-  std::string          m_strTitle;
-  std::string          m_strPlotOutline; // sub title / short text (m_strShortText)
-  std::string          m_strPlot; // description (m_strDescription)
+  cInternedString      m_strTitle;
+  cInternedString      m_strPlotOutline; // sub title / short text (m_strShortText)
+  cInternedString      m_strPlot; // description (m_strDescription)
   cChannelID           m_channelID;
-  CDateTime            m_startTime;
-  CDateTime            m_endTime;
+  uint32_t             m_startTime; // UTC, 0 if invalid
+  uint32_t             m_endTime;   // UTC, 0 if invalid
   EPG_GENRE            m_genreType;
   EPG_SUB_GENRE        m_genreSubType;
-  std::string          m_strCustomGenre; // Used only when m_genreType = EPG_GENRE_CUSTOM
+  cInternedString      m_strCustomGenre; // Used only when m_genreType = EPG_GENRE_CUSTOM
   uint16_t             m_parentalRating;
   uint8_t              m_starRating;
 
   // VDR data
   uint8_t              m_tableID;
   uint8_t              m_version;
-  CDateTime            m_vps;
-  std::vector<CEpgComponent> m_components;
-  std::vector<uint8_t> m_contents;
+  uint8_t              m_contentsCount;
+  uint8_t              m_contents[EPG_MAX_CONTENTS];
+  uint32_t             m_vps;       // UTC, 0 if invalid
+  std::unique_ptr<std::vector<CEpgComponent> > m_components; // NULL if there are none
 
   /*
   // Ephemeral data
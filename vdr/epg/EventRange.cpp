@@ -0,0 +1,112 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "EventRange.h"
+#include "Event.h"
+#include "utils/DateTime.h"
+
+#include <algorithm>
+
+namespace VDR
+{
+
+namespace
+{
+  bool StartsBefore(const EventPtr& event, time_t time)
+  {
+    return event->StartTimeAsTime() < time;
+  }
+
+  time_t AsTime(const CDateTime& time)
+  {
+    time_t retval = 0;
+    if (time.IsValid())
+      time.GetAsTime(retval);
+    return retval;
+  }
+}
+
+cEventRange::cEventRange(void)
+ : m_begin(0),
+   m_end(0)
+{
+}
+
+cEventRange::cEventRange(const EventVectorPtr& events)
+ : m_events(events),
+   m_begin(0),
+   m_end(events ? events->size() : 0)
+{
+}
+
+cEventRange::cEventRange(const EventVectorPtr& events, size_t begin, size_t end)
+ : m_events(events),
+   m_begin(begin),
+   m_end(end)
+{
+}
+
+const EventVector& cEventRange::Array(void) const
+{
+  static const EventVector empty;
+  return m_events ? *m_events : empty;
+}
+
+size_t cEventRange::LowerBound(const CDateTime& time) const
+{
+  return std::lower_bound(begin(), end(), AsTime(time), StartsBefore) - Array().begin();
+}
+
+size_t cEventRange::FirstRunning(const CDateTime& time) const
+{
+  const time_t t = AsTime(time);
+
+  size_t first = LowerBound(time);
+  while (first > m_begin && Array()[first - 1]->EndTimeAsTime() > t)
+    first--;
+
+  return first;
+}
+
+cEventRange cEventRange::Between(const CDateTime& start, const CDateTime& end) const
+{
+  const size_t first = FirstRunning(start);
+  const size_t last  = end.IsValid() ? std::max(first, LowerBound(end)) : m_end;
+
+  return cEventRange(m_events, first, last);
+}
+
+cEventRange cEventRange::From(const CDateTime& time, size_t count) const
+{
+  const size_t first = FirstRunning(time);
+
+  return cEventRange(m_events, first, std::min(m_end, first + count));
+}
+
+EventPtr cEventRange::StartingAt(const CDateTime& startTime) const
+{
+  const size_t first = LowerBound(startTime);
+  if (first < m_end && Array()[first]->StartTimeAsTime() == AsTime(startTime))
+    return Array()[first];
+
+  return cEvent::EmptyEvent;
+}
+
+}
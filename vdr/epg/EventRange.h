@@ -0,0 +1,95 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "EPGTypes.h"
+
+#include <stddef.h>
+
+namespace VDR
+{
+
+class CDateTime;
+
+typedef std::shared_ptr<const EventVector> EventVectorPtr;
+
+/*!
+ * View of a schedule's events, sorted by start time. The view shares the
+ * schedule's array instead of copying it. A schedule never modifies an array
+ * that is still referenced, or the events in it, so a view stays valid (and
+ * unchanged) after the schedule has been updated.
+ */
+class cEventRange
+{
+public:
+  typedef EventVector::const_iterator const_iterator;
+
+  cEventRange(void);
+  cEventRange(const EventVectorPtr& events);
+
+  const_iterator begin(void) const { return Array().begin() + m_begin; }
+  const_iterator end(void)   const { return Array().begin() + m_end; }
+  size_t size(void)          const { return m_end - m_begin; }
+  bool empty(void)           const { return m_end == m_begin; }
+
+  const EventPtr& operator[](size_t index) const { return Array()[m_begin + index]; }
+  const EventPtr& front(void) const { return Array()[m_begin]; }
+  const EventPtr& back(void)  const { return Array()[m_end - 1]; }
+
+  /*!
+   * Events overlapping [start, end). An invalid end time means no upper limit.
+   */
+  cEventRange Between(const CDateTime& start, const CDateTime& end) const;
+
+  /*!
+   * The event running at the given time (if any) and the events following
+   * it, at most count events in total. From(now, 2) is "now/next".
+   */
+  cEventRange From(const CDateTime& time, size_t count) const;
+
+  /*!
+   * First event that starts at the given time, or cEvent::EmptyEvent
+   */
+  EventPtr StartingAt(const CDateTime& startTime) const;
+
+private:
+  cEventRange(const EventVectorPtr& events, size_t begin, size_t end);
+
+  const EventVector& Array(void) const;
+
+  /*!
+   * Index of the first event in the view starting at or after time
+   */
+  size_t LowerBound(const CDateTime& time) const;
+
+  /*!
+   * Index of the first event in the view still running at or after time.
+   * Events are sorted by start time only, so this steps back from
+   * LowerBound() over the events that haven't ended yet. Events of a channel
+   * don't normally overlap, so this is at most one step.
+   */
+  size_t FirstRunning(const CDateTime& time) const;
+
+  EventVectorPtr m_events;
+  size_t         m_begin;
+  size_t         m_end;
+};
+
+}
@@ -24,12 +24,16 @@
 #include "Event.h"
 #include "channels/Channel.h"
 #include "channels/ChannelManager.h"
+#include "filesystem/File.h"
+#include "filesystem/SpecialProtocol.h"
 #include "settings/Settings.h"
 #include "utils/log/Log.h"
 #include "utils/XBMCTinyXML.h"
 #include "Config.h"
 
 #include <algorithm>
+#include <fstream>
+#include <limits>
 
 using namespace std;
 
@@ -38,8 +42,24 @@ namespace VDR
 
 #define RUNNINGSTATUSTIMEOUT 30 // seconds before the running status is considered unknown
 
+// The journal is replaced by a snapshot once it holds more records than half
+// the schedule's events, but never before it holds this many records
+#define JOURNAL_MIN_RECORDS  100
+
+namespace
+{
+  bool StartsBefore(const EventPtr& lhs, const EventPtr& rhs)
+  {
+    return lhs->StartTimeAsTime() < rhs->StartTimeAsTime();
+  }
+}
+
 cSchedule::cSchedule(const cChannelID& channelID)
- : m_channelID(channelID)/*,
+ : m_channelID(channelID),
+   m_events(new EventVector),
+   m_journalRecords(0),
+   m_generation(0),
+   m_bSnapshotRequired(true)/*,
    m_bHasRunning(false)*/
 {
 }
@@ -50,16 +70,6 @@ cSchedule::~cSchedule(void)
     itPair->second->UnregisterObserver(this);
 }
 
-EventVector cSchedule::Events(void) const
-{
-  EventVector events;
-
-  for (map<unsigned int, EventPtr>::const_iterator itPair = m_eventIds.begin(); itPair != m_eventIds.end(); ++itPair)
-    events.push_back(itPair->second);
-
-  return events;
-}
-
 EventPtr cSchedule::GetEvent(unsigned int eventID) const
 {
   if (m_eventIds.find(eventID) != m_eventIds.end())
@@ -71,14 +81,7 @@ EventPtr cSchedule::GetEvent(unsigned int eventID) const
 EventPtr cSchedule::GetEvent(const CDateTime& startTime) const
 {
   if (startTime.IsValid()) // 'StartTime < 0' is apparently used with NVOD channels
-  {
-    for (map<unsigned int, EventPtr>::const_iterator itPair = m_eventIds.begin(); itPair != m_eventIds.end(); ++itPair)
-    {
-      const EventPtr& event = itPair->second;
-      if (event->StartTime() == startTime)
-        return event;
-    }
-  }
+    return Events().StartingAt(startTime);
 
   return cEvent::EmptyEvent;
 }
@@ -88,11 +91,27 @@ void cSchedule::AddEvent(const EventPtr& event)
   EventPtr existingEvent = GetEvent(event->ID());
 
   if (existingEvent)
-    *existingEvent = *event;
+  {
+    // Views share the existing event, so the update goes into a copy
+    EventPtr replacement = EventPtr(new cEvent(existingEvent->ID()));
+    *replacement = *existingEvent;
+    replacement->SetChanged(false);
+    *replacement = *event;
+    if (!replacement->Changed())
+      return;
+
+    existingEvent->UnregisterObserver(this);
+    replacement->RegisterObserver(this);
+    m_eventIds[replacement->ID()] = replacement;
+    ReplaceSorted(existingEvent, replacement);
+  }
   else
   {
     event->RegisterObserver(this);
     m_eventIds[event->ID()] = event;
+    InsertSorted(event);
+    m_changedEvents.insert(event->ID());
+    m_deletedEvents.erase(event->ID());
     SetChanged();
   }
 }
@@ -102,11 +121,64 @@ void cSchedule::DeleteEvent(unsigned int eventID)
   if (m_eventIds.find(eventID) != m_eventIds.end())
   {
     m_eventIds[eventID]->UnregisterObserver(this);
+    RemoveSorted(m_eventIds[eventID]);
     m_eventIds.erase(eventID);
+    m_changedEvents.erase(eventID);
+    m_deletedEvents.insert(eventID);
     SetChanged();
   }
 }
 
+EventVector& cSchedule::MutableEvents(void)
+{
+  if (!m_events.unique())
+    m_events = std::shared_ptr<EventVector>(new EventVector(*m_events));
+
+  return *m_events;
+}
+
+void cSchedule::InsertSorted(const EventPtr& event)
+{
+  EventVector& events = MutableEvents();
+  events.insert(std::upper_bound(events.begin(), events.end(), event, StartsBefore), event);
+}
+
+void cSchedule::RemoveSorted(const EventPtr& event)
+{
+  EventVector& events = MutableEvents();
+
+  EventVector::iterator it = FindSorted(events, event);
+  if (it != events.end())
+    events.erase(it);
+}
+
+void cSchedule::ReplaceSorted(const EventPtr& event, const EventPtr& replacement)
+{
+  if (event->StartTimeAsTime() != replacement->StartTimeAsTime())
+  {
+    RemoveSorted(event);
+    InsertSorted(replacement);
+  }
+  else
+  {
+    EventVector& events = MutableEvents();
+
+    EventVector::iterator it = FindSorted(events, event);
+    if (it != events.end())
+      *it = replacement;
+  }
+}
+
+EventVector::iterator cSchedule::FindSorted(EventVector& events, const EventPtr& event)
+{
+  pair<EventVector::iterator, EventVector::iterator> range = std::equal_range(events.begin(), events.end(), event, StartsBefore);
+  EventVector::iterator it = std::find(range.first, range.second, event);
+  if (it == range.second)
+    it = std::find(events.begin(), events.end(), event);
+
+  return it;
+}
+
 /*
 void cSchedule::SetRunningStatus(const EventPtr& event, int RunningStatus, cChannel *Channel)
 {
@@ -238,8 +310,13 @@ void cSchedule::Notify(const Observable &obs, const ObservableMessage msg)
   switch (msg)
   {
   case ObservableMessageEventChanged:
+  {
+    const cEvent* event = dynamic_cast<const cEvent*>(&obs);
+    if (event)
+      m_changedEvents.insert(event->ID());
     SetChanged();
     break;
+  }
   default:
     break;
   }
@@ -251,18 +328,30 @@ void cSchedule::NotifyObservers(void)
     itPair->second->NotifyObservers(ObservableMessageEventChanged);
 
   if (Changed())
-  {
     Observable::NotifyObservers(ObservableMessageEventChanged);
-    Save();
-  }
 }
 
 bool cSchedule::Load(void)
+{
+  map<unsigned int, EventPtr> events;
+  unsigned int journalRecords;
+  unsigned int generation;
+  if (!Read(events, journalRecords, generation))
+    return false;
+
+  Merge(events, journalRecords, generation);
+  return true;
+}
+
+bool cSchedule::Read(map<unsigned int, EventPtr>& events, unsigned int& journalRecords, unsigned int& generation) const
 {
   assert(!cSettings::Get().m_EPGDirectory.empty());
 
+  journalRecords = 0;
+  generation = 0;
+
   CXBMCTinyXML xmlDoc;
-  std::string strFilename = cSettings::Get().m_EPGDirectory + "/epg_" + m_channelID.ToString() + ".xml";
+  std::string strFilename = Filename(m_channelID);
   if (!xmlDoc.LoadFile(strFilename.c_str()))
   {
     esyslog("failed to open '%s'", strFilename.c_str());
@@ -279,7 +368,10 @@ bool cSchedule::Load(void)
     return false;
   }
 
-  map<unsigned int, EventPtr> events;
+  // Files written before generations were introduced are generation 0
+  const char* strGeneration = root->Attribute(EPG_XML_ATTR_GENERATION);
+  if (strGeneration != NULL)
+    generation = StringUtils::IntVal(strGeneration);
 
   const TiXmlNode* eventNode = root->FirstChild(EPG_XML_ELM_EVENT);
   while (eventNode != NULL)
@@ -292,23 +384,123 @@ bool cSchedule::Load(void)
     eventNode = eventNode->NextSibling(EPG_XML_ELM_EVENT);
   }
 
-  m_eventIds = events;
+  // Replay the changes that were written after the snapshot
+  std::string strJournalFilename = JournalFilename(m_channelID);
+  if (CFile::Exists(strJournalFilename))
+  {
+    CFile journalFile;
+    std::vector<uint8_t> data;
+    CXBMCTinyXML journalDoc;
+    if (!journalFile.LoadFile(strJournalFilename, data) ||
+        !journalDoc.Parse("<" EPG_XML_ELM_JOURNAL ">" + std::string(data.begin(), data.end()) + "</" EPG_XML_ELM_JOURNAL ">"))
+    {
+      // Changes up to the broken record are lost, the next write replaces the journal
+      esyslog("failed to read the EPG journal '%s'", strJournalFilename.c_str());
+      journalRecords = std::numeric_limits<unsigned int>::max();
+      return true;
+    }
+
+    // Records before the first generation tag belong to generation 0
+    bool bCurrent = (generation == 0);
+    for (const TiXmlElement* record = journalDoc.RootElement()->FirstChildElement(); record != NULL; record = record->NextSiblingElement())
+    {
+      if (record->ValueStr() == EPG_XML_ELM_GENERATION)
+      {
+        const char* id = record->Attribute(EPG_XML_ATTR_GENERATION);
+        bCurrent = (id != NULL && (unsigned int)StringUtils::IntVal(id) == generation);
+        continue;
+      }
+
+      // Stale records still count towards the journal's size
+      journalRecords++;
+      if (!bCurrent)
+        continue;
+
+      if (record->ValueStr() == EPG_XML_ELM_EVENT)
+      {
+        EventPtr event;
+        if (cEvent::Deserialise(event, record))
+          events[event->ID()] = event;
+      }
+      else if (record->ValueStr() == EPG_XML_ELM_DELETED)
+      {
+        const char* id = record->Attribute(EPG_XML_ATTR_EVENT_ID);
+        if (id != NULL)
+          events.erase(StringUtils::IntVal(id));
+      }
+    }
+  }
 
   return true;
 }
 
-bool cSchedule::Save(void) const
+void cSchedule::Merge(const map<unsigned int, EventPtr>& events, unsigned int journalRecords /* = 0 */, unsigned int generation /* = 0 */)
 {
-  assert(!cSettings::Get().m_EPGDirectory.empty());
+  EventVector& sorted = MutableEvents();
+  const size_t count = sorted.size();
 
-  CXBMCTinyXML xmlDoc;
+  for (map<unsigned int, EventPtr>::const_iterator itPair = events.begin(); itPair != events.end(); ++itPair)
+  {
+    if (m_eventIds.insert(*itPair).second)
+    {
+      itPair->second->RegisterObserver(this);
+      sorted.push_back(itPair->second);
+    }
+  }
+
+  // Sort the new events and merge them into the index in one pass
+  std::stable_sort(sorted.begin() + count, sorted.end(), StartsBefore);
+  std::inplace_merge(sorted.begin(), sorted.begin() + count, sorted.end(), StartsBefore);
+
+  // Events added before the schedule was loaded are still in m_changedEvents
+  m_journalRecords = journalRecords;
+  m_generation = generation;
+  m_bSnapshotRequired = false;
+}
+
+bool cSchedule::HasUnsavedChanges(void) const
+{
+  return !m_changedEvents.empty() || !m_deletedEvents.empty() ||
+         (m_bSnapshotRequired && !m_eventIds.empty());
+}
+
+sScheduleChanges cSchedule::GetChanges(void)
+{
+  sScheduleChanges changes;
+  changes.channelID = m_channelID;
+
+  const unsigned int records = m_changedEvents.size() + m_deletedEvents.size();
+  const unsigned int limit = std::max(JOURNAL_MIN_RECORDS, (int)m_eventIds.size() / 2);
+
+  if (m_bSnapshotRequired || m_journalRecords > limit || records > limit - m_journalRecords)
+  {
+    m_generation++;
+    changes.snapshot = Snapshot();
+    m_journalRecords = 0;
+    m_bSnapshotRequired = !changes.snapshot;
+  }
+  else
+  {
+    changes.strJournal = JournalRecords();
+    m_journalRecords += records;
+  }
+
+  m_changedEvents.clear();
+  m_deletedEvents.clear();
+
+  return changes;
+}
+
+std::shared_ptr<CXBMCTinyXML> cSchedule::Snapshot(void) const
+{
+  std::shared_ptr<CXBMCTinyXML> xmlDoc = std::make_shared<CXBMCTinyXML>();
   TiXmlDeclaration *decl = new TiXmlDeclaration("1.0", "", "");
-  xmlDoc.LinkEndChild(decl);
+  xmlDoc->LinkEndChild(decl);
 
   try
   {
     TiXmlElement rootElement(EPG_XML_ELM_SCHEDULE);
-    TiXmlNode* root = xmlDoc.InsertEndChild(rootElement);
+    TiXmlNode* root = xmlDoc->InsertEndChild(rootElement);
     if (root == NULL)
       throw false;
 
@@ -319,6 +511,8 @@ bool cSchedule::Save(void) const
     if (!m_channelID.Serialise(root))
       throw false;
 
+    epgElement->SetAttribute(EPG_XML_ATTR_GENERATION, m_generation);
+
     for (map<unsigned int, EventPtr>::const_iterator itPair = m_eventIds.begin(); itPair != m_eventIds.end(); ++itPair)
     {
       TiXmlElement eventElement(EPG_XML_ELM_EVENT);
@@ -333,22 +527,100 @@ bool cSchedule::Save(void) const
   catch (const bool& bSuccess)
   {
     esyslog("Failed to save schedule for channel %s", m_channelID.ToString().c_str());
-    //delete decl; // TODO: Do we need to delete decl?
-    return bSuccess;
+    return std::shared_ptr<CXBMCTinyXML>();
+  }
+
+  return xmlDoc;
+}
+
+std::string cSchedule::JournalRecords(void) const
+{
+  TiXmlPrinter printer;
+
+  // Every batch starts with the generation of the snapshot it applies to
+  TiXmlElement generationElement(EPG_XML_ELM_GENERATION);
+  generationElement.SetAttribute(EPG_XML_ATTR_GENERATION, m_generation);
+  generationElement.Accept(&printer);
+
+  for (std::set<unsigned int>::const_iterator it = m_changedEvents.begin(); it != m_changedEvents.end(); ++it)
+  {
+    map<unsigned int, EventPtr>::const_iterator itPair = m_eventIds.find(*it);
+    if (itPair == m_eventIds.end())
+      continue;
+
+    TiXmlElement eventElement(EPG_XML_ELM_EVENT);
+    if (itPair->second->Serialise(&eventElement))
+      eventElement.Accept(&printer);
   }
 
-  std::string strFilename = cSettings::Get().m_EPGDirectory + "/epg_" + m_channelID.ToString() + ".xml";
-  if (!xmlDoc.SafeSaveFile(strFilename))
+  for (std::set<unsigned int>::const_iterator it = m_deletedEvents.begin(); it != m_deletedEvents.end(); ++it)
   {
-    esyslog("failed to save the EPG data: could not write to '%s'", strFilename.c_str());
-    return false;
+    TiXmlElement deletedElement(EPG_XML_ELM_DELETED);
+    deletedElement.SetAttribute(EPG_XML_ATTR_EVENT_ID, *it);
+    deletedElement.Accept(&printer);
   }
 
-  ChannelPtr channel = cChannelManager::Get().GetByChannelID(ChannelID());
-  if (channel)
-    dsyslog("EPG for channel '%s' saved", channel->Name().c_str());
+  return printer.Str();
+}
+
+bool cSchedule::WriteChanges(const sScheduleChanges& changes)
+{
+  assert(!cSettings::Get().m_EPGDirectory.empty());
+
+  const std::string strJournalFilename = JournalFilename(changes.channelID);
+
+  if (changes.snapshot)
+  {
+    // The journal is only removed once the snapshot is in place. If that
+    // fails, its records are of an older generation and won't be replayed
+    std::string strFilename = Filename(changes.channelID);
+    if (!changes.snapshot->SafeSaveFile(strFilename))
+    {
+      esyslog("failed to save the EPG data: could not write to '%s'", strFilename.c_str());
+      return false;
+    }
+
+    if (CFile::Exists(strJournalFilename) && !CFile::Delete(strJournalFilename))
+      esyslog("failed to delete the EPG journal '%s'", strJournalFilename.c_str());
+
+    ChannelPtr channel = cChannelManager::Get().GetByChannelID(changes.channelID);
+    if (channel)
+      dsyslog("EPG for channel '%s' saved", channel->Name().c_str());
+  }
+  else if (!changes.strJournal.empty())
+  {
+    std::ofstream journal(CSpecialProtocol::TranslatePath(strJournalFilename).c_str(), std::ios::out | std::ios::app);
+    if (!journal.is_open())
+    {
+      esyslog("failed to save the EPG data: could not open '%s'", strJournalFilename.c_str());
+      return false;
+    }
+
+    // A partly written record makes the journal unreadable, and the failed
+    // write is repeated as a snapshot that replaces it
+    journal << changes.strJournal;
+    journal.flush();
+    const bool bWritten = journal.good();
+    journal.close();
+
+    if (!bWritten || journal.fail())
+    {
+      esyslog("failed to save the EPG data: could not write to '%s'", strJournalFilename.c_str());
+      return false;
+    }
+  }
 
   return true;
 }
 
+std::string cSchedule::Filename(const cChannelID& channelID)
+{
+  return cSettings::Get().m_EPGDirectory + "/epg_" + channelID.ToString() + ".xml";
+}
+
+std::string cSchedule::JournalFilename(const cChannelID& channelID)
+{
+  return cSettings::Get().m_EPGDirectory + "/epg_" + channelID.ToString() + ".journal";
+}
+
 }
@@ -21,18 +21,34 @@
 #pragma once
 
 #include "EPGTypes.h"
+#include "EventRange.h"
 #include "channels/ChannelID.h"
 #include "utils/DateTime.h"
 #include "utils/Observer.h"
 
 #include <map>
+#include <set>
 #include <stdint.h>
+#include <string>
 
 class TiXmlNode;
 
 namespace VDR
 {
 
+class CXBMCTinyXML;
+
+/*!
+ * Unsaved changes of a schedule, either a full snapshot that replaces
+ * epg_<CHANNEL_ID>.xml or records to append to epg_<CHANNEL_ID>.journal
+ */
+struct sScheduleChanges
+{
+  cChannelID                    channelID;
+  std::shared_ptr<CXBMCTinyXML> snapshot;   // Set if the journal is replaced
+  std::string                   strJournal; // Serialised changed and deleted events
+};
+
 class cSchedule : protected Observer, public Observable
 {
 public:
@@ -43,7 +59,11 @@ public:
 
   const cChannelID& ChannelID(void) const { return m_channelID; }
 
-  EventVector Events(void) const;
+  /*!
+   * All events, sorted by start time. Use the view's Between() and From()
+   * for time window queries.
+   */
+  cEventRange Events(void) const { return cEventRange(m_events); }
   EventPtr GetEvent(unsigned int eventID) const;
   EventPtr GetEvent(const CDateTime& startTime) const;
   void AddEvent(const EventPtr& event);
@@ -62,14 +82,58 @@ public:
   virtual void Notify(const Observable &obs, const ObservableMessage msg);
   void NotifyObservers(void);
 
+  /*!
+   * Load() is equivalent to Read() followed by Merge(). Read() only parses the
+   * schedule's files and can be called without holding the owner's lock.
+   * Merge() keeps events that were added before the schedule was loaded.
+   *
+   * Snapshots carry a generation number and journal records are tagged with
+   * the generation of the snapshot they follow. Records of older generations
+   * are skipped, in case the journal couldn't be removed after a snapshot.
+   */
   bool Load(void);
+  bool Read(std::map<unsigned int, EventPtr>& events, unsigned int& journalRecords, unsigned int& generation) const;
+  void Merge(const std::map<unsigned int, EventPtr>& events, unsigned int journalRecords = 0, unsigned int generation = 0);
+
+  /*!
+   * Changed events are collected and written in batches. GetChanges() is
+   * called with the owner's lock held and returns the changes since the last
+   * call as journal records, or as a snapshot once the journal has grown to
+   * half the schedule's size. WriteChanges() does the file I/O without the
+   * lock. If it fails, WriteFailed() makes the next write a snapshot.
+   */
+  bool HasUnsavedChanges(void) const;
+  sScheduleChanges GetChanges(void);
+  static bool WriteChanges(const sScheduleChanges& changes);
+  void WriteFailed(void) { m_bSnapshotRequired = true; }
+
   bool Serialise(TiXmlNode* node) const;
 
 private:
-  bool Save(void) const;
+  std::shared_ptr<CXBMCTinyXML> Snapshot(void) const;
+  std::string JournalRecords(void) const;
+
+  static std::string Filename(const cChannelID& channelID);
+  static std::string JournalFilename(const cChannelID& channelID);
+
+  /*!
+   * Time index maintenance. The array is copied before it's modified if a
+   * view still references it. Events in the array are replaced, not modified.
+   */
+  EventVector& MutableEvents(void);
+  void InsertSorted(const EventPtr& event);
+  void RemoveSorted(const EventPtr& event);
+  void ReplaceSorted(const EventPtr& event, const EventPtr& replacement);
+  static EventVector::iterator FindSorted(EventVector& events, const EventPtr& event);
 
   const cChannelID                 m_channelID;
   std::map<unsigned int, EventPtr> m_eventIds;    // ID -> Event
+  std::shared_ptr<EventVector>     m_events;      // Sorted by start time
+  std::set<unsigned int>           m_changedEvents; // Not saved yet
+  std::set<unsigned int>           m_deletedEvents; // Not saved yet
+  unsigned int                     m_journalRecords;
+  unsigned int                     m_generation;  // Of the last snapshot
+  bool                             m_bSnapshotRequired;
 
   //bool             m_bHasRunning;
 
@@ -26,13 +26,18 @@
 #include "channels/ChannelManager.h"
 #include "settings/Settings.h"
 #include "transponders/Transponder.h"
+#include "utils/InternedString.h"
 #include "utils/log/Log.h"
+#include "utils/metrics/Metrics.h"
 #include "utils/StringUtils.h"
 #include "utils/XBMCTinyXML.h"
 
 using namespace PLATFORM;
 using namespace std;
 
+#define EVENTS_METRIC        "vdr_epg_events"
+#define EVENT_BYTES_METRIC   "vdr_epg_bytes"
+
 namespace VDR
 {
 
@@ -44,6 +49,8 @@ cScheduleManager& cScheduleManager::Get(void)
 
 cScheduleManager::~cScheduleManager(void)
 {
+  Stop();
+
   for (map<cChannelID, SchedulePtr>::iterator itPair = m_schedules.begin(); itPair != m_schedules.end(); ++itPair)
     itPair->second->UnregisterObserver(this);
 }
@@ -71,9 +78,12 @@ void cScheduleManager::AddEvent(const EventPtr& event, const cTransponder& trans
     SchedulePtr schedule = SchedulePtr(new cSchedule(channelId));
     schedule->RegisterObserver(this);
     m_schedules[channelId] = schedule;
+    m_bIndexChanged = true;
   }
 
-  m_schedules[channelId]->AddEvent(event);
+  const SchedulePtr& schedule = m_schedules[channelId];
+  EnsureLoaded(schedule);
+  schedule->AddEvent(event);
 }
 
 EventPtr cScheduleManager::GetEvent(const cChannelID& channelId, unsigned int eventId) const
@@ -83,6 +93,7 @@ EventPtr cScheduleManager::GetEvent(const cChannelID& channelId, unsigned int ev
   if (m_schedules.find(channelId) != m_schedules.end())
   {
     const SchedulePtr& schedule = m_schedules.find(channelId)->second;
+    EnsureLoaded(schedule);
     return schedule->GetEvent(eventId);
   }
 
@@ -113,13 +124,18 @@ void cScheduleManager::CleanTables(void)
 }
 */
 
-EventVector cScheduleManager::GetEvents(const cChannelID& channelID) const
+cEventRange cScheduleManager::GetEvents(const cChannelID& channelID) const
 {
-  EventVector events;
+  cEventRange events;
+
+  CLockObject lock(m_mutex);
 
   map<cChannelID, SchedulePtr>::const_iterator itPair = m_schedules.find(channelID);
   if (itPair != m_schedules.end())
+  {
+    EnsureLoaded(itPair->second);
     events = itPair->second->Events();
+  }
 
   return events;
 }
@@ -179,10 +195,7 @@ void cScheduleManager::NotifyObservers(void)
     itPair->second->NotifyObservers();
 
   if (Changed())
-  {
     Observable::NotifyObservers(ObservableMessageEventChanged);
-    Save();
-  }
 }
 
 bool cScheduleManager::Load(void)
@@ -191,6 +204,8 @@ bool cScheduleManager::Load(void)
 
   isyslog("Reading EPG data from '%s'", cSettings::Get().m_EPGDirectory.c_str());
 
+  m_writer.CreateThread(false);
+
   CXBMCTinyXML xmlDoc;
   std::string strFilename = cSettings::Get().m_EPGDirectory + "/epg.xml";
   if (!xmlDoc.LoadFile(strFilename.c_str()))
@@ -217,20 +232,184 @@ bool cScheduleManager::Load(void)
     if (!channelId.Deserialise(scheduleNode))
       return false;
 
-    SchedulePtr schedule = SchedulePtr(new cSchedule(channelId));
-    if (!schedule->Load())
-      return false;
-    schedules[channelId] = schedule;
+    schedules[channelId] = SchedulePtr(new cSchedule(channelId));
 
     scheduleNode = scheduleNode->NextSibling(EPG_XML_ELM_SCHEDULE);
   }
 
+  {
+    CLockObject lock(m_mutex);
+
+    // Schedules created by the EPG scanner in the meantime are kept, their
+    // saved events are merged when loaded
+    for (map<cChannelID, SchedulePtr>::const_iterator itPair = schedules.begin(); itPair != schedules.end(); ++itPair)
+    {
+      if (m_schedules.insert(*itPair).second)
+        itPair->second->RegisterObserver(this);
+      m_pending.insert(itPair->first);
+    }
+  }
+
+  isyslog("Found %u EPG schedules, loading events in the background", schedules.size());
+
+  m_loader.CreateThread(false);
+  return true;
+}
+
+void cScheduleManager::EnsureLoaded(const SchedulePtr& schedule) const
+{
+  if (m_pending.erase(schedule->ChannelID()) > 0)
+    schedule->Load();
+}
+
+bool cScheduleManager::LoadNextPending(void)
+{
+  SchedulePtr schedule;
+  {
+    CLockObject lock(m_mutex);
+    if (m_pending.empty())
+      return false;
+
+    map<cChannelID, SchedulePtr>::const_iterator itPair = m_schedules.find(*m_pending.begin());
+    if (itPair == m_schedules.end())
+    {
+      m_pending.erase(m_pending.begin());
+      return true;
+    }
+    schedule = itPair->second;
+  }
+
+  // Parse the file without blocking accessors
+  map<unsigned int, EventPtr> events;
+  unsigned int journalRecords;
+  unsigned int generation;
+  bool bRead = schedule->Read(events, journalRecords, generation);
+
   CLockObject lock(m_mutex);
-  m_schedules = schedules;
+  if (m_pending.erase(schedule->ChannelID()) > 0 && bRead)
+    schedule->Merge(events, journalRecords, generation);
+
   return true;
 }
 
-bool cScheduleManager::Save(void) const
+void* cScheduleManager::cScheduleLoader::Process(void)
+{
+  unsigned int count = 0;
+  while (!IsStopped() && m_manager.LoadNextPending())
+    count++;
+
+  dsyslog("Loaded %u EPG schedules", count);
+  m_manager.ReportMemoryUsage();
+  return NULL;
+}
+
+void cScheduleManager::Stop(void)
+{
+  m_loader.StopThread(0);
+  m_writer.Stop();
+  Flush();
+}
+
+void cScheduleManager::Flush(void)
+{
+  CLockObject writeLock(m_writeMutex);
+
+  vector<sScheduleChanges> changes;
+  vector<cChannelID> index;
+  {
+    CLockObject lock(m_mutex);
+
+    for (map<cChannelID, SchedulePtr>::const_iterator itPair = m_schedules.begin(); itPair != m_schedules.end(); ++itPair)
+    {
+      // Schedules that haven't been read yet have nothing to write
+      if (m_pending.find(itPair->first) == m_pending.end() && itPair->second->HasUnsavedChanges())
+        changes.push_back(itPair->second->GetChanges());
+    }
+
+    // The index only changes when a channel gets its first event
+    if (m_bIndexChanged)
+    {
+      index.reserve(m_schedules.size());
+      for (map<cChannelID, SchedulePtr>::const_iterator itPair = m_schedules.begin(); itPair != m_schedules.end(); ++itPair)
+        index.push_back(itPair->first);
+      m_bIndexChanged = false;
+    }
+  }
+
+  if (!index.empty() && !Save(index))
+  {
+    CLockObject lock(m_mutex);
+    m_bIndexChanged = true;
+  }
+
+  vector<cChannelID> failed;
+  for (vector<sScheduleChanges>::const_iterator it = changes.begin(); it != changes.end(); ++it)
+  {
+    if (!cSchedule::WriteChanges(*it))
+      failed.push_back(it->channelID);
+  }
+
+  if (!failed.empty())
+  {
+    CLockObject lock(m_mutex);
+    for (vector<cChannelID>::const_iterator it = failed.begin(); it != failed.end(); ++it)
+    {
+      map<cChannelID, SchedulePtr>::const_iterator itPair = m_schedules.find(*it);
+      if (itPair != m_schedules.end())
+        itPair->second->WriteFailed();
+    }
+  }
+
+  if (!changes.empty())
+    dsyslog("Wrote EPG changes of %u schedules", changes.size() - failed.size());
+}
+
+void cScheduleManager::cScheduleWriter::Stop(void)
+{
+  StopThread(-1);
+  m_stopEvent.Broadcast();
+  StopThread(0);
+}
+
+void* cScheduleManager::cScheduleWriter::Process(void)
+{
+  while (!IsStopped())
+  {
+    m_stopEvent.Wait(std::max(cSettings::Get().m_iEPGSaveInterval, 1) * 1000);
+    if (!IsStopped())
+      m_manager.Flush();
+  }
+  return NULL;
+}
+
+void cScheduleManager::ReportMemoryUsage(void) const
+{
+  size_t events = 0;
+  size_t bytes  = 0;
+  {
+    CLockObject lock(m_mutex);
+    for (map<cChannelID, SchedulePtr>::const_iterator itPair = m_schedules.begin(); itPair != m_schedules.end(); ++itPair)
+    {
+      const cEventRange schedule = itPair->second->Events();
+      events += schedule.size();
+      for (cEventRange::const_iterator itEvent = schedule.begin(); itEvent != schedule.end(); ++itEvent)
+        bytes += (*itEvent)->MemoryUsage();
+    }
+  }
+
+  size_t strings;
+  size_t stringBytes;
+  cInternedString::PoolUsage(strings, stringBytes);
+  bytes += stringBytes;
+
+  isyslog("EPG holds %u events and %u distinct strings, %u bytes per event",
+      events, strings, events ? bytes / events : 0);
+
+  cMetrics::Get().Gauge(EVENTS_METRIC, "Number of EPG events")->Set(events);
+  cMetrics::Get().Gauge(EVENT_BYTES_METRIC, "Approximate memory used by EPG events, including their text")->Set(bytes);
+}
+
+bool cScheduleManager::Save(const vector<cChannelID>& channelIDs)
 {
   assert(!cSettings::Get().m_EPGDirectory.empty());
   bool bReturn(true);
@@ -246,12 +425,12 @@ bool cScheduleManager::Save(void) const
   if (root == NULL)
     return false;
 
-  for (map<cChannelID, SchedulePtr>::const_iterator itPair = m_schedules.begin(); itPair != m_schedules.end(); ++itPair)
+  for (vector<cChannelID>::const_iterator it = channelIDs.begin(); it != channelIDs.end(); ++it)
   {
     TiXmlElement scheduleElement(EPG_XML_ELM_SCHEDULE);
     TiXmlNode* textNode = root->InsertEndChild(scheduleElement);
     if (textNode)
-      itPair->second->ChannelID().Serialise(textNode);
+      it->Serialise(textNode);
   }
 
   if (bReturn)
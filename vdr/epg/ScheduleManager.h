@@ -24,10 +24,12 @@
 #include "Schedule.h"
 #include "channels/ChannelID.h"
 #include "lib/platform/threads/mutex.h"
+#include "lib/platform/threads/threads.h"
 #include "utils/DateTime.h"
 #include "utils/Observer.h"
 
 #include <map>
+#include <set>
 #include <vector>
 
 namespace VDR
@@ -50,7 +52,7 @@ public:
 
   void AddEvent(const EventPtr& event, const cTransponder& transponder);
   EventPtr GetEvent(const cChannelID& channelId, unsigned int eventId) const;
-  EventVector GetEvents(const cChannelID& channelID) const;
+  cEventRange GetEvents(const cChannelID& channelID) const;
   std::vector<cChannelID> GetUpdatedChannels(const std::map<int, CDateTime>& lastUpdated, CChannelFilter& filter) const;
 
   virtual void Notify(const Observable &obs, const ObservableMessage msg);
@@ -61,16 +63,81 @@ public:
    * cScheduleManager saves an index of channel IDs to epg.xml. Each channel ID
    * corresponds to an EPG schedule for that channel. Schedules are saved to
    * their own channel-specific file named epg_<CHANNEL_ID>.xml.
+   *
+   * Load() only reads the index. Schedules are read by a background thread,
+   * or synchronously when one is accessed before the thread got to it.
+   *
+   * Changes are written by a background thread every epg_save_interval
+   * seconds, see cSchedule::GetChanges(). Stop() ends the background threads
+   * and writes the changes that are still pending.
    */
   bool Load(void);
+  void Stop(void);
 
 private:
-  cScheduleManager(void) { }
+  class cScheduleLoader : public PLATFORM::CThread
+  {
+  public:
+    cScheduleLoader(cScheduleManager& manager) : m_manager(manager) { }
+    virtual ~cScheduleLoader(void) { }
 
-  bool Save(void) const;
+    virtual void* Process(void);
+
+  private:
+    cScheduleManager& m_manager;
+  };
+
+  class cScheduleWriter : public PLATFORM::CThread
+  {
+  public:
+    cScheduleWriter(cScheduleManager& manager) : m_manager(manager) { }
+    virtual ~cScheduleWriter(void) { }
+
+    void Stop(void);
+
+    virtual void* Process(void);
+
+  private:
+    cScheduleManager& m_manager;
+    PLATFORM::CEvent  m_stopEvent;
+  };
+
+  cScheduleManager(void) : m_loader(*this), m_writer(*this), m_bIndexChanged(false) { }
+
+  /*!
+   * Write the index of schedules to epg.xml. Called without m_mutex held.
+   */
+  static bool Save(const std::vector<cChannelID>& channelIDs);
+
+  /*!
+   * Write the changes of all loaded schedules, and the index if schedules were
+   * added. The files are written without holding m_mutex.
+   */
+  void Flush(void);
+
+  /*!
+   * Read the schedule's events if this hasn't happened yet. Must be called
+   * with m_mutex held.
+   */
+  void EnsureLoaded(const SchedulePtr& schedule) const;
+
+  /*!
+   * Read the next pending schedule. Returns false if none are left.
+   */
+  bool LoadNextPending(void);
+
+  /*!
+   * Log and export the number of events and the bytes used per event
+   */
+  void ReportMemoryUsage(void) const;
 
   std::map<cChannelID, SchedulePtr> m_schedules;
+  mutable std::set<cChannelID>      m_pending; // Schedules that haven't been read yet
+  cScheduleLoader                   m_loader;
+  cScheduleWriter                   m_writer;
+  bool                              m_bIndexChanged; // A schedule was added since epg.xml was written
   PLATFORM::CMutex                  m_mutex;
+  PLATFORM::CMutex                  m_writeMutex;    // Serialises Flush()
 };
 
 }
@@ -0,0 +1,221 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "epg/Event.h"
+#include "epg/Schedule.h"
+#include "settings/Settings.h"
+#include "utils/DateTime.h"
+
+#include "gtest/gtest.h"
+
+namespace VDR
+{
+
+namespace
+{
+  EventPtr MakeEvent(unsigned int id, int startHour, int endHour)
+  {
+    EventPtr event = EventPtr(new cEvent(id));
+    event->SetStartTime(CDateTime(2014, 1, 1, startHour, 0, 0));
+    event->SetEndTime(CDateTime(2014, 1, 1, endHour, 0, 0));
+    return event;
+  }
+}
+
+TEST(Schedule, TimeIndex)
+{
+  cSchedule schedule(cChannelID(1, 2, 3));
+
+  // Add out of order
+  schedule.AddEvent(MakeEvent(3, 12, 13));
+  schedule.AddEvent(MakeEvent(1, 10, 11));
+  schedule.AddEvent(MakeEvent(2, 11, 12));
+  schedule.AddEvent(MakeEvent(4, 13, 14));
+
+  cEventRange events = schedule.Events();
+  ASSERT_EQ(4, events.size());
+  EXPECT_EQ(1, events[0]->ID());
+  EXPECT_EQ(2, events[1]->ID());
+  EXPECT_EQ(3, events[2]->ID());
+  EXPECT_EQ(4, events[3]->ID());
+
+  EXPECT_EQ(2, schedule.GetEvent(CDateTime(2014, 1, 1, 11, 0, 0))->ID());
+  EXPECT_FALSE(schedule.GetEvent(CDateTime(2014, 1, 1, 11, 30, 0)));
+
+  // Overlapping a window
+  cEventRange window = events.Between(CDateTime(2014, 1, 1, 11, 30, 0), CDateTime(2014, 1, 1, 13, 0, 0));
+  ASSERT_EQ(2, window.size());
+  EXPECT_EQ(2, window.front()->ID());
+  EXPECT_EQ(3, window.back()->ID());
+
+  // Open ended
+  EXPECT_EQ(2, events.Between(CDateTime(2014, 1, 1, 12, 30, 0), CDateTime()).size());
+  EXPECT_TRUE(events.Between(CDateTime(2014, 1, 1, 15, 0, 0), CDateTime()).empty());
+
+  // Now/next
+  cEventRange nowNext = events.From(CDateTime(2014, 1, 1, 10, 30, 0), 2);
+  ASSERT_EQ(2, nowNext.size());
+  EXPECT_EQ(1, nowNext[0]->ID());
+  EXPECT_EQ(2, nowNext[1]->ID());
+  EXPECT_EQ(1, events.From(CDateTime(2014, 1, 1, 13, 30, 0), 2).size());
+}
+
+TEST(Schedule, Updates)
+{
+  cSchedule schedule(cChannelID(1, 2, 3));
+  schedule.AddEvent(MakeEvent(1, 10, 11));
+  schedule.AddEvent(MakeEvent(2, 11, 12));
+
+  cEventRange before = schedule.Events();
+
+  // Moving an event reorders the index, views taken earlier are unaffected
+  schedule.AddEvent(MakeEvent(1, 12, 13));
+  schedule.DeleteEvent(2);
+  schedule.AddEvent(MakeEvent(3, 9, 10));
+
+  cEventRange after = schedule.Events();
+  ASSERT_EQ(2, after.size());
+  EXPECT_EQ(3, after[0]->ID());
+  EXPECT_EQ(1, after[1]->ID());
+
+  ASSERT_EQ(2, before.size());
+  EXPECT_EQ(1, before[0]->ID());
+  EXPECT_EQ(2, before[1]->ID());
+
+  // Loaded events don't replace existing ones
+  std::map<unsigned int, EventPtr> loaded;
+  loaded[1] = MakeEvent(1, 8, 9);
+  loaded[4] = MakeEvent(4, 14, 15);
+  loaded[5] = MakeEvent(5, 7, 8);
+  schedule.Merge(loaded);
+
+  after = schedule.Events();
+  ASSERT_EQ(4, after.size());
+  EXPECT_EQ(5, after[0]->ID());
+  EXPECT_EQ(3, after[1]->ID());
+  EXPECT_EQ(1, after[2]->ID());
+  EXPECT_EQ(4, after[3]->ID());
+}
+
+TEST(Schedule, UpdatesDontChangeViews)
+{
+  cSchedule schedule(cChannelID(1, 2, 3));
+  schedule.AddEvent(MakeEvent(1, 10, 11));
+  schedule.AddEvent(MakeEvent(2, 11, 12));
+  schedule.AddEvent(MakeEvent(3, 12, 13));
+
+  cEventRange before = schedule.Events();
+
+  // Move the first event to the end and retitle the second one
+  schedule.AddEvent(MakeEvent(1, 13, 14));
+  EventPtr retitled = MakeEvent(2, 11, 12);
+  retitled->SetTitle("Retitled");
+  schedule.AddEvent(retitled);
+
+  ASSERT_EQ(3, before.size());
+  EXPECT_EQ(1, before[0]->ID());
+  EXPECT_EQ(2, before[1]->ID());
+  EXPECT_EQ(3, before[2]->ID());
+  EXPECT_EQ(CDateTime(2014, 1, 1, 10, 0, 0), before[0]->StartTime());
+  EXPECT_TRUE(before[1]->Title().empty());
+  for (size_t i = 1; i < before.size(); i++)
+    EXPECT_LE(before[i - 1]->StartTime(), before[i]->StartTime());
+
+  cEventRange after = schedule.Events();
+  ASSERT_EQ(3, after.size());
+  EXPECT_EQ(2, after[0]->ID());
+  EXPECT_EQ(3, after[1]->ID());
+  EXPECT_EQ(1, after[2]->ID());
+  EXPECT_EQ("Retitled", after[0]->Title());
+  EXPECT_EQ(after[2], schedule.GetEvent(1));
+}
+
+TEST(Schedule, UnsavedChanges)
+{
+  cSchedule schedule(cChannelID(1, 2, 3));
+  EXPECT_FALSE(schedule.HasUnsavedChanges());
+
+  // A schedule without a file is written as a snapshot
+  schedule.AddEvent(MakeEvent(1, 10, 11));
+  EXPECT_TRUE(schedule.HasUnsavedChanges());
+  sScheduleChanges changes = schedule.GetChanges();
+  EXPECT_TRUE(changes.snapshot.get() != NULL);
+  EXPECT_FALSE(schedule.HasUnsavedChanges());
+
+  // Small changes are appended to the journal
+  schedule.AddEvent(MakeEvent(2, 11, 12));
+  schedule.DeleteEvent(1);
+  EXPECT_TRUE(schedule.HasUnsavedChanges());
+  changes = schedule.GetChanges();
+  EXPECT_FALSE(changes.snapshot);
+  EXPECT_NE(std::string::npos, changes.strJournal.find("deleted"));
+  EXPECT_FALSE(schedule.HasUnsavedChanges());
+
+  // Unchanged events aren't written again
+  schedule.AddEvent(MakeEvent(2, 11, 12));
+  EXPECT_FALSE(schedule.HasUnsavedChanges());
+
+  // A failed write is repeated as a snapshot
+  schedule.WriteFailed();
+  EXPECT_TRUE(schedule.HasUnsavedChanges());
+  changes = schedule.GetChanges();
+  EXPECT_TRUE(changes.snapshot.get() != NULL);
+}
+
+TEST(Schedule, JournalGenerations)
+{
+  cSettings::Get().m_EPGDirectory = "special://temp";
+  const cChannelID channelID(1, 2, 4);
+
+  cSchedule schedule(channelID);
+  schedule.AddEvent(MakeEvent(1, 10, 11));
+  ASSERT_TRUE(cSchedule::WriteChanges(schedule.GetChanges()));
+
+  schedule.DeleteEvent(1);
+  sScheduleChanges stale = schedule.GetChanges();
+  ASSERT_FALSE(stale.snapshot);
+  ASSERT_TRUE(cSchedule::WriteChanges(stale));
+
+  // The next snapshot replaces the journal
+  schedule.AddEvent(MakeEvent(1, 12, 13));
+  schedule.WriteFailed();
+  sScheduleChanges snapshot = schedule.GetChanges();
+  ASSERT_TRUE(snapshot.snapshot.get() != NULL);
+  ASSERT_TRUE(cSchedule::WriteChanges(snapshot));
+
+  // Records left over from the previous snapshot aren't replayed, records
+  // written after the new one are
+  ASSERT_TRUE(cSchedule::WriteChanges(stale));
+  schedule.AddEvent(MakeEvent(2, 13, 14));
+  ASSERT_TRUE(cSchedule::WriteChanges(schedule.GetChanges()));
+
+  std::map<unsigned int, EventPtr> events;
+  unsigned int journalRecords;
+  unsigned int generation;
+  cSchedule loaded(channelID);
+  ASSERT_TRUE(loaded.Read(events, journalRecords, generation));
+  EXPECT_EQ(2u, generation);
+  EXPECT_EQ(2u, journalRecords);
+  ASSERT_EQ(2u, events.size());
+  EXPECT_EQ(MakeEvent(1, 12, 13)->StartTimeAsTime(), events[1]->StartTimeAsTime());
+  EXPECT_TRUE(events.find(2) != events.end());
+}
+
+}
@@ -264,6 +264,20 @@ int64_t CFile::Truncate(uint64_t size)
   return m_pFileImpl->Truncate(size);
 }
 
+bool CFile::Advise(uint64_t offset, uint64_t length, FileAdvice advice)
+{
+  if (!m_pFileImpl)
+    return false;
+  return m_pFileImpl->Advise(offset, length, advice);
+}
+
+int CFile::GetNativeHandle()
+{
+  if (!m_pFileImpl)
+    return -1;
+  return m_pFileImpl->GetNativeHandle();
+}
+
 void CFile::Close()
 {
   if (!m_pFileImpl)
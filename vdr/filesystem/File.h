@@ -49,6 +49,8 @@ public:
   int64_t Truncate(uint64_t size);
   int64_t GetPosition();
   int64_t GetLength();
+  bool Advise(uint64_t offset, uint64_t length, FileAdvice advice);
+  int GetNativeHandle();
   void Close();
   bool IsOpen(void) const { return m_pFileImpl != NULL; }
 
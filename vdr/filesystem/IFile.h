@@ -70,6 +70,13 @@ enum EIoControl {
 };
 */
 
+// Access pattern hints, see IFile::Advise()
+enum FileAdvice
+{
+  FILE_ADVICE_WILLNEED, // Data will be read soon, start reading it into the cache
+  FILE_ADVICE_DONTNEED, // Data won't be read again, drop it from the cache
+};
+
 class IFile
 {
 public:
@@ -99,6 +106,21 @@ public:
    */
   virtual unsigned int GetChunkSize() { return 0; }
 
+  /*!
+   * @brief Tell the filesystem how a range of the open file will be accessed.
+   *        Hints are optional, implementations that can't use them return false.
+   * @param length The number of bytes from offset, or 0 for the rest of the file
+   */
+  virtual bool Advise(uint64_t offset, uint64_t length, FileAdvice advice) { return false; }
+
+  /*!
+   * @brief Get a descriptor of the open file for zero-copy or positional I/O
+   *        such as sendfile() and pwrite(). It is write-only if the file was
+   *        opened for writing, read-only otherwise, and stays owned by the file.
+   * @return The descriptor, or -1 if the file isn't on a native filesystem
+   */
+  virtual int GetNativeHandle() { return -1; }
+
   virtual bool Exists(const std::string &url) = 0;
   virtual int Stat(const std::string &url, struct __stat64 *buffer)
   {
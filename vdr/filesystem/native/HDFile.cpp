@@ -26,13 +26,17 @@
 #include "utils/url/URL.h"
 #include "filesystem/SpecialProtocol.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 using namespace std;
 
 namespace VDR
 {
 
 CHDFile::CHDFile()
- : m_mode((std::ios_base::openmode)0),
+ : m_nativeFd(-1),
+   m_mode((std::ios_base::openmode)0),
    m_flags(0)
 {
 }
@@ -51,6 +55,8 @@ bool CHDFile::Open(const string &url, unsigned int flags /* = 0 */)
 
   m_mode = ios::in;
   m_file.open(strTranslatedPath.c_str(), m_mode);
+  if (m_file.is_open())
+    m_strPath = strTranslatedPath;
 
   return m_file.is_open();
 }
@@ -66,6 +72,8 @@ bool CHDFile::OpenForWrite(const string &url, bool bOverWrite /* = false */)
 
   m_mode = ios::out;
   m_file.open(strTranslatedPath.c_str(), m_mode);
+  if (m_file.is_open())
+    m_strPath = strTranslatedPath;
 
   return m_file.is_open();
 }
@@ -188,10 +196,41 @@ int64_t CHDFile::GetLength()
   return length;
 }
 
+bool CHDFile::Advise(uint64_t offset, uint64_t length, FileAdvice advice)
+{
+  // Cache advice applies to the file, so a second descriptor is as good as
+  // the stream's
+  int fd = GetNativeHandle();
+  if (fd < 0)
+    return false;
+
+  int fadvice;
+  switch (advice)
+  {
+  case FILE_ADVICE_WILLNEED: fadvice = POSIX_FADV_WILLNEED; break;
+  case FILE_ADVICE_DONTNEED: fadvice = POSIX_FADV_DONTNEED; break;
+  default:
+    return false;
+  }
+
+  return posix_fadvise(fd, offset, length, fadvice) == 0;
+}
+
+int CHDFile::GetNativeHandle()
+{
+  if (m_nativeFd < 0 && !m_strPath.empty())
+    m_nativeFd = open(m_strPath.c_str(), (m_mode & ios::in) ? O_RDONLY : O_WRONLY);
+  return m_nativeFd;
+}
+
 void CHDFile::Close()
 {
   if (m_file.is_open())
     m_file.close();
+  if (m_nativeFd >= 0)
+    close(m_nativeFd);
+  m_nativeFd = -1;
+  m_strPath.clear();
   m_mode = (std::ios_base::openmode)0;
   m_flags = 0;
 }
@@ -48,6 +48,8 @@ public:
   virtual int Truncate(int64_t size);
   virtual int64_t GetPosition();
   virtual int64_t GetLength();
+  virtual bool Advise(uint64_t offset, uint64_t length, FileAdvice advice);
+  virtual int GetNativeHandle();
   virtual void Close();
 
   virtual bool Exists(const std::string &url);
@@ -67,6 +69,8 @@ protected:
   std::string GetLocal(const CURL &url);
 
   std::fstream            m_file;
+  std::string             m_strPath;   // Translated path of the open file
+  int                     m_nativeFd;  // Opened on demand, fstream doesn't expose its own
   std::ios_base::openmode m_mode;
   int                     m_flags;
 };
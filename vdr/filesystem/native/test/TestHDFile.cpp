@@ -26,6 +26,7 @@
 #include "gtest/gtest.h"
 
 #include <string>
+#include <unistd.h>
 
 using namespace std;
 
@@ -201,6 +202,66 @@ TEST(HDFile, GetLength)
 {
 }
 
+TEST(HDFile, Advise)
+{
+  const string path = CSpecialProtocol::TranslatePath("special://temp/HDFile.Advise.txt");
+  const string test = "Test file for test HDFile.Advise";
+
+  {
+    CHDFile file;
+    EXPECT_FALSE(file.Advise(0, 0, FILE_ADVICE_WILLNEED)); // Not open
+    EXPECT_TRUE(file.OpenForWrite(path));
+    EXPECT_EQ(test.length(), file.Write(test.data(), test.length()));
+    file.Close();
+  }
+  {
+    CHDFile file;
+    EXPECT_TRUE(file.Open(path));
+    EXPECT_TRUE(file.Advise(0, 0, FILE_ADVICE_WILLNEED));
+    EXPECT_TRUE(file.Advise(0, test.length(), FILE_ADVICE_DONTNEED));
+    file.Close();
+    EXPECT_FALSE(file.Advise(0, 0, FILE_ADVICE_DONTNEED));
+    EXPECT_TRUE(file.Delete(path));
+  }
+}
+
+TEST(HDFile, GetNativeHandle)
+{
+  const string path = CSpecialProtocol::TranslatePath("special://temp/HDFile.GetNativeHandle.txt");
+  const string test = "Test file for test HDFile.GetNativeHandle";
+
+  {
+    CHDFile file;
+    EXPECT_EQ(-1, file.GetNativeHandle()); // Not open
+    EXPECT_TRUE(file.OpenForWrite(path));
+    EXPECT_EQ(test.length(), file.Write(test.data(), test.length()));
+    file.Flush();
+
+    // A file opened for writing hands out a writable handle
+    int fd = file.GetNativeHandle();
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(4, pwrite(fd, "TEST", 4, 0));
+    file.Close();
+  }
+  {
+    CHDFile file;
+    EXPECT_TRUE(file.Open(path));
+    int fd = file.GetNativeHandle();
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(fd, file.GetNativeHandle());
+
+    // The handle reads independently of the stream's position
+    char buffer[64] = { };
+    EXPECT_EQ(5, file.Read(buffer, 5));
+    EXPECT_EQ((ssize_t)test.length(), pread(fd, buffer, sizeof(buffer), 0));
+    EXPECT_EQ("TEST" + test.substr(4), string(buffer, test.length()));
+
+    file.Close();
+    EXPECT_EQ(-1, file.GetNativeHandle());
+    EXPECT_TRUE(file.Delete(path));
+  }
+}
+
 /*
 TEST(HDFile, Close)
 {
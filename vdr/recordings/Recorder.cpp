@@ -30,6 +30,7 @@
 #include "settings/Settings.h"
 #include "utils/CommonMacros.h"
 #include "utils/log/Log.h"
+#include "utils/metrics/Metrics.h"
 
 using namespace PLATFORM;
 
@@ -42,6 +43,9 @@ using namespace PLATFORM;
 #define MINFREEDISKSPACE    MEGABYTE(512)
 #define DISKCHECKINTERVAL   100 // seconds
 
+#define FILL_METRIC         "vdr_recorder_buffer_bytes"
+#define OVERFLOW_METRIC     "vdr_recorder_overflow_bytes_total"
+
 namespace VDR
 {
 
@@ -50,6 +54,7 @@ namespace VDR
 cRecorder::cRecorder(cRecording* recording)
  : m_recording(recording),
    m_strRecordingPath(recording->URL()),
+   m_strMetricLabels(cMetrics::Label("recording", recording->Foldername() + "/" + recording->Title() + ".ts")),
    m_frameDetector(recording->Channel()),
    m_ringBuffer(RECORDERBUFSIZE, MIN_TS_PACKETS_FOR_FRAME_DETECTOR * TS_SIZE, true, "Recorder"),
    m_fileSize(0),
@@ -61,11 +66,17 @@ cRecorder::cRecorder(cRecording* recording)
   m_ringBuffer.SetIoThrottle();
 
   m_patPmtGenerator.SetChannel(m_recording->Channel());
+
+  m_ringBuffer.SetMetrics(cMetrics::Get().Gauge(FILL_METRIC, "Bytes queued in the recorder's ring buffer", m_strMetricLabels),
+                          cMetrics::Get().Counter(OVERFLOW_METRIC, "Bytes dropped because the recorder's ring buffer was full", m_strMetricLabels));
 }
 
 cRecorder::~cRecorder(void)
 {
   m_recording->UnregisterObserver(this);
+
+  cMetrics::Get().Remove(FILL_METRIC, m_strMetricLabels);
+  cMetrics::Get().Remove(OVERFLOW_METRIC, m_strMetricLabels);
 }
 
 bool cRecorder::RunningLowOnDiskSpace(void)
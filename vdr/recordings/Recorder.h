@@ -63,6 +63,7 @@ private:
 
   cRecording* const  m_recording;
   std::string        m_strRecordingPath;
+  const std::string  m_strMetricLabels; // Folder and file name, titles aren't unique
   cFrameDetector     m_frameDetector;
   CFile              m_file;
   cRingBufferLinear  m_ringBuffer;
@@ -24,10 +24,13 @@
 #include "RecordingDefinitions.h"
 #include "channels/ChannelManager.h"
 #include "devices/DeviceManager.h"
+#include "filesystem/File.h"
+#include "recordings/filesystem/IndexFile.h"
 #include "settings/Settings.h"
 #include "utils/log/Log.h"
 #include "utils/StringUtils.h"
 
+#include <stdlib.h>
 #include <tinyxml.h>
 
 namespace VDR
@@ -39,6 +42,8 @@ cRecording::cRecording(void)
 : m_id(RECORDING_INVALID_ID),
   m_playCount(0),
   m_priority(0),
+  m_fileSize(0),
+  m_frames(0),
   m_recorder(NULL)
 {
 }
@@ -62,6 +67,8 @@ cRecording::cRecording(const std::string&   strFoldername,
   m_resumePosition(resumePosition),
   m_playCount(playCount),
   m_priority(priority),
+  m_fileSize(0),
+  m_frames(0),
   m_recorder(NULL)
 {
 }
@@ -177,6 +184,28 @@ void cRecording::SetPriority(unsigned int priority)
   }
 }
 
+void cRecording::ReadFileStats(const std::string& strUrl, bool bPesRecording, uint64_t& fileSize, unsigned int& frames)
+{
+  struct __stat64 buffer;
+  fileSize = CFile::Stat(strUrl, &buffer) == 0 ? buffer.st_size : 0;
+
+  const int length = cIndexFile::GetLength(strUrl, bPesRecording);
+  frames = length > 0 ? length : 0;
+}
+
+bool cRecording::SetFileStats(uint64_t fileSize, unsigned int frames)
+{
+  if (m_fileSize != fileSize || m_frames != frames)
+  {
+    m_fileSize = fileSize;
+    m_frames = frames;
+    SetChanged();
+    return true;
+  }
+
+  return false;
+}
+
 bool cRecording::IsValid(bool bCheckID /* = true */) const
 {
   return (bCheckID ? m_id != RECORDING_INVALID_ID : true) && // Condition (1)
@@ -289,6 +318,10 @@ bool cRecording::Serialise(TiXmlNode* node) const
     elem->SetAttribute(RECORDING_XML_ATTR_PLAY_COUNT, m_playCount);
   if (m_priority > 0)
     elem->SetAttribute(RECORDING_XML_ATTR_PRIORITY, m_priority);
+  if (m_fileSize > 0)
+    elem->SetAttribute(RECORDING_XML_ATTR_FILE_SIZE, StringUtils::Format("%llu", (unsigned long long)m_fileSize));
+  if (m_frames > 0)
+    elem->SetAttribute(RECORDING_XML_ATTR_FRAMES, m_frames);
 
   return true;
 }
@@ -357,6 +390,16 @@ bool cRecording::Deserialise(const TiXmlNode* node)
     m_priority = attr ? StringUtils::IntVal(attr) : 0;
   }
 
+  {
+    const char* attr = elem->Attribute(RECORDING_XML_ATTR_FILE_SIZE);
+    m_fileSize = attr ? strtoull(attr, NULL, 10) : 0;
+  }
+
+  {
+    const char* attr = elem->Attribute(RECORDING_XML_ATTR_FRAMES);
+    m_frames = attr ? StringUtils::IntVal(attr) : 0;
+  }
+
   if (!IsValid())
   {
     LogInvalidProperties();
@@ -26,6 +26,7 @@
 #include "utils/DateTime.h"
 #include "utils/Observer.h"
 
+#include <stdint.h>
 #include <string>
 
 class TiXmlNode;
@@ -74,6 +75,8 @@ public:
    *   - Priority:        ??? in the interval [0, 100]
    *   - IsPesRecording:  ???
    *   - FramesPerSecond: Set by recorder during recording
+   *   - File size:       Size of the recording's file in bytes (cached)
+   *   - Frames:          Number of frames in the recording's index (cached)
    */
   unsigned int         ID(void) const            { return m_id; }
   const std::string&   Foldername(void) const    { return m_strFoldername; }
@@ -87,6 +90,8 @@ public:
   unsigned int         PlayCount(void) const     { return m_playCount; }
   unsigned int         Priority(void) const      { return m_priority; }
   bool                 IsPesRecording(void) const { return false; } // TODO
+  uint64_t             FileSize(void) const      { return m_fileSize; }
+  unsigned int         Frames(void) const        { return m_frames; }
 
   /*!
    * Set the recording ID. This ID should be unique among recordings.
@@ -116,6 +121,19 @@ public:
   void SetPlayCount(unsigned int playCount);
   void SetPriority(unsigned int priority);
 
+  /*!
+   * The cached file size and number of frames. They aren't copied by
+   * operator=(), they depend on the files and not on the recording's
+   * properties.
+   *
+   * ReadFileStats() reads them from the files of the recording at strUrl, so
+   * it can be called without holding the lock that protects the recording.
+   * SetFileStats() returns true (and marks the recording as changed) if they
+   * were modified.
+   */
+  static void ReadFileStats(const std::string& strUrl, bool bPesRecording, uint64_t& fileSize, unsigned int& frames);
+  bool SetFileStats(uint64_t fileSize, unsigned int frames);
+
   /*!
    * A recording is valid if:
    *   (1) m_id            is a valid ID (i.e. is not RECORDING_INVALID_ID)
@@ -172,6 +190,8 @@ private:
   CDateTimeSpan  m_resumePosition;
   unsigned int   m_playCount;
   unsigned int   m_priority;
+  uint64_t       m_fileSize;
+  unsigned int   m_frames;
   float          m_fps;
   cRecorder*     m_recorder;
   TunerHandlePtr m_tunerHandle;
@@ -48,6 +48,9 @@
 
 #define MARKSFILESUFFIX   "/marks.xml"
 
+#define RECORDFILESUFFIXPES     "/%03d.vdr"
+#define RECORDFILESUFFIXTS      "/%05d.ts"
+
 #define SORTMODEFILE      ".sort"
 
 #define MINDISKSPACE    MEGABYTE(1024)
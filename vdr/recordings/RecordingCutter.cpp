@@ -20,130 +20,51 @@
  */
 
 #include "RecordingCutter.h"
-#include "Recordings.h"
-#include "RecordingUserCommand.h"
-#include "recordings/marks/Marks.h"
+#include "RecordingConfig.h"
 #include "devices/Remux.h"
-#include "filesystem/Directory.h"
-#include "filesystem/FileName.h"
-#include "filesystem/IndexFile.h"
-#include "filesystem/Videodir.h"
-#include "filesystem/VideoFile.h"
+#include "filesystem/File.h"
+#include "filesystem/SpecialProtocol.h"
 #include "lib/platform/threads/throttle.h"
-#include "settings/Settings.h"
+#include "lib/platform/util/timeutils.h"
+#include "filesystem/Directory.h"
+#include "recordings/filesystem/IndexFile.h"
 #include "utils/CommonMacros.h"
 #include "utils/log/Log.h"
+#include "utils/StringUtils.h"
 
-#include <stdint.h>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <map>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace PLATFORM;
 
-namespace VDR
-{
+// Bytes per copy_file_range() call, so stopping and throttling take effect
+#define COPYCHUNKSIZE   MEGABYTE(64)
 
-// --- cPacketBuffer ---------------------------------------------------------
+// Bytes per read/write when copy_file_range() isn't supported
+#define READCHUNKSIZE   MEGABYTE(1)
 
-class cPacketBuffer
-{
-public:
-  cPacketBuffer(void);
-  ~cPacketBuffer(void);
-
-  /*!
-   * Appends Length bytes of Data to this packet buffer.
-   */
-  void Append(uint8_t *Data, int Length);
-
-  /*!
-   * Flushes the content of this packet buffer into the given Data, starting at
-   * position Length, and clears the buffer afterwards. Length will be
-   * incremented accordingly. If Length plus the total length of the stored
-   * packets would exceed MaxLength, nothing is copied.
-   */
-  void Flush(uint8_t *Data, int &Length, int MaxLength);
-
-private:
-  uint8_t* data;
-  int      size;
-  int      length;
-};
-
-cPacketBuffer::cPacketBuffer(void)
-{
-  data = NULL;
-  size = length = 0;
-}
-
-cPacketBuffer::~cPacketBuffer()
-{
-  free(data);
-}
-
-void cPacketBuffer::Append(uint8_t *Data, int Length)
-{
-  if (length + Length >= size) {
-     int NewSize = (length + Length) * 3 / 2;
-     if (uint8_t *p = (uint8_t*)realloc(data, NewSize)) {
-        data = p;
-        size = NewSize;
-        }
-     else
-        return; // out of memory
-     }
-  memcpy(data + length, Data, Length);
-  length += Length;
-}
+// If the first GOP of a sequence is larger, only its first frame is rewritten
+#define MAXCUTINSIZE    MEGABYTE(32)
 
-void cPacketBuffer::Flush(uint8_t *Data, int &Length, int MaxLength)
+namespace VDR
 {
-  if (Data && length > 0 && Length + length <= MaxLength) {
-     memcpy(Data + Length, data, length);
-     Length += length;
-     }
-  length = 0;
-}
 
-// --- cPacketStorage --------------------------------------------------------
+// --- cMpeg2Fixer -------------------------------------------------------------
 
-class cPacketStorage
+class cMpeg2Fixer : private cTsPayload
 {
 public:
-  void Append(int Pid, uint8_t *Data, int Length);
-  void Flush(int Pid, uint8_t *Data, int &Length, int MaxLength);
-
-private:
-  std::map<uint16_t, std::vector<uint8_t> > buffers;
-};
-
-void cPacketStorage::Append(int Pid, uint8_t *Data, int Length)
-{
-  std::vector<uint8_t>& data = buffers[Pid];
-  std::vector<uint8_t> data(Data, Data + Length);
-  buffers[Pid].push_back(data.begin(), data.end());
-}
-
-void cPacketStorage::Flush(int Pid, uint8_t *Data, int &Length, int MaxLength)
-{
-  if ()
-  std::vector<uint8_t>& data = buffers[Pid];
-  memcpy(Data + Length, data.data(), data.size());
-  Length += data.size();
-  data.clear();
-}
-
-// --- cMpeg2Fixer -----------------------------------------------------------
+  cMpeg2Fixer(uint8_t *Data, int Length, int Vpid);
+  void SetBrokenLink(void);
 
-class cMpeg2Fixer : private cTsPayload {
 private:
   bool FindHeader(uint32_t Code, const char *Header);
-public:
-  cMpeg2Fixer(uint8_t *Data, int Length, int Vpid);
-  void SetBrokenLink(void);
-  void SetClosedGop(void);
-  int GetTref(void);
-  void AdjGopTime(int Offset, int FramesPerSecond);
-  void AdjTref(int TrefOffset);
-  };
+};
 
 cMpeg2Fixer::cMpeg2Fixer(uint8_t *Data, int Length, int Vpid)
 {
@@ -177,627 +98,439 @@ void cMpeg2Fixer::SetBrokenLink(void)
      }
 }
 
-void cMpeg2Fixer::SetClosedGop(void)
+// --- cRecordingCutter --------------------------------------------------------
+
+cRecordingCutter::cRecordingCutter(const std::string& strRecording, const std::string& strEditedRecording)
+ : m_strRecording(strRecording),
+   m_strEditedRecording(strEditedRecording),
+   m_strRecordingFile(strRecording + StringUtils::Format(RECORDFILESUFFIXTS, 1)),
+   m_strEditedFile(strEditedRecording + StringUtils::Format(RECORDFILESUFFIXTS, 1)),
+   m_fromIndex(NULL),
+   m_toIndex(NULL),
+   m_fromFd(-1),
+   m_toFd(-1),
+   m_fromSize(0),
+   m_toSize(0),
+   m_toFrames(0),
+   m_numSequences(0),
+   m_bCopyFileRange(true),
+   m_bSuspensionLogged(false),
+   m_error(NULL)
 {
-  if (!FindHeader(0x000001B8, "GOP"))
-     return;
-  SkipBytes(3);
-  uint8_t b = GetByte();
-  b |= 0x40;
-  SetByte(b, GetLastIndex());
 }
 
-int cMpeg2Fixer::GetTref(void)
+cRecordingCutter::~cRecordingCutter(void)
 {
-  if (!FindHeader(0x00000100, "picture"))
-     return 0;
-  int Tref = GetByte() << 2;
-  Tref |= GetByte() >> 6;
-  return Tref;
+  StopThread(0);
+  Close();
 }
 
-void cMpeg2Fixer::AdjGopTime(int Offset, int FramesPerSecond)
-{
-  if (!FindHeader(0x000001B8, "GOP"))
-     return;
-  uint8_t Byte1 = GetByte();
-  int Index1 = GetLastIndex();
-  uint8_t Byte2 =  GetByte();
-  int Index2 = GetLastIndex();
-  uint8_t Byte3 = GetByte();
-  int Index3 = GetLastIndex();
-  uint8_t Byte4 =  GetByte();
-  int Index4 = GetLastIndex();
-  uint8_t Frame = ((Byte3 & 0x1F) << 1) | (Byte4 >> 7);
-  uint8_t Sec   = ((Byte2 & 0x07) << 3) | (Byte3 >> 5);
-  uint8_t Min   = ((Byte1 & 0x03) << 4) | (Byte2 >> 4);
-  uint8_t Hour  = ((Byte1 & 0x7C) >> 2);
-  int GopTime = ((Hour * 60 + Min) * 60 + Sec) * FramesPerSecond + Frame;
-  if (GopTime) { // do not fix when zero
-     GopTime += Offset;
-     if (GopTime < 0)
-        GopTime += 24 * 60 * 60 * FramesPerSecond;
-     Frame = GopTime % FramesPerSecond;
-     GopTime = GopTime / FramesPerSecond;
-     Sec = GopTime % 60;
-     GopTime = GopTime / 60;
-     Min = GopTime % 60;
-     GopTime = GopTime / 60;
-     Hour = GopTime % 24;
-     SetByte((Byte1 & 0x80) | (Hour << 2) | (Min >> 4), Index1);
-     SetByte(((Min & 0x0F) << 4) | 0x08 | (Sec >> 3), Index2);
-     SetByte(((Sec & 0x07) << 3) | (Frame >> 1), Index3);
-     SetByte((Byte4 & 0x7F) | ((Frame & 0x01) << 7), Index4);
-     }
+bool cRecordingCutter::Start(void)
+{
+  if (!m_fromMarks.Load(m_strRecording) || m_fromMarks.Empty())
+  {
+    esyslog("no editing marks found for %s", m_strRecording.c_str());
+    return false;
+  }
+
+  m_numSequences = m_fromMarks.GetNumSequences();
+  if (m_numSequences == 0)
+  {
+    esyslog("no editing sequences found for %s", m_strRecording.c_str());
+    return false;
+  }
+
+  m_fromIndex = new cIndexFile(m_strRecording, false);
+  if (!m_fromIndex->Ok())
+  {
+    esyslog("can't cut %s without an index", m_strRecording.c_str());
+    Close();
+    return false;
+  }
+
+  if (!CDirectory::Exists(m_strEditedRecording) && !CDirectory::Create(m_strEditedRecording))
+  {
+    LOG_ERROR_STR(m_strEditedRecording.c_str());
+    Close();
+    return false;
+  }
+
+  m_fromFd = open(CSpecialProtocol::TranslatePath(m_strRecordingFile).c_str(), O_RDONLY);
+  m_toFd = open(CSpecialProtocol::TranslatePath(m_strEditedFile).c_str(), O_WRONLY | O_CREAT | O_TRUNC, DEFFILEMODE);
+
+  struct stat st;
+  if (m_fromFd < 0 || m_toFd < 0 || fstat(m_fromFd, &st) != 0)
+  {
+    LOG_ERROR_STR(m_fromFd < 0 ? m_strRecordingFile.c_str() : m_strEditedFile.c_str());
+    Close();
+    return false;
+  }
+  m_fromSize = st.st_size;
+
+  m_toIndex = new cIndexFile(m_strEditedRecording, true);
+  m_toMarks.Load(m_strEditedRecording); // doesn't actually load marks, just sets the file name
+
+  isyslog("Cutting %d sequence%s of %s", m_numSequences, m_numSequences > 1 ? "s" : "", m_strRecording.c_str());
+  return CreateThread(true);
 }
 
-void cMpeg2Fixer::AdjTref(int TrefOffset)
+void cRecordingCutter::Stop(void)
 {
-  if (!FindHeader(0x00000100, "picture"))
-     return;
-  int Tref = GetByte() << 2;
-  int Index1 = GetLastIndex();
-  uint8_t Byte2 = GetByte();
-  int Index2 = GetLastIndex();
-  Tref |= Byte2 >> 6;
-  Tref -= TrefOffset;
-  SetByte(Tref >> 2, Index1);
-  SetByte((Tref << 6) | (Byte2 & 0x3F), Index2);
+  StopThread(0);
 }
 
-// --- cCuttingThread --------------------------------------------------------
-
-class cCuttingThread : public CThread {
-private:
-  const char *error;
-  bool isPesRecording;
-  double framesPerSecond;
-  CVideoFile *fromFile, *toFile;
-  cFileName *fromFileName, *toFileName;
-  cIndexFile *fromIndex, *toIndex;
-  cMarks fromMarks, toMarks;
-  int numSequences;
-  off_t maxVideoFileSize;
-  off_t fileSize;
-  bool suspensionLogged;
-  int sequence;          // cutting sequence
-  int delta;             // time between two frames (PTS ticks)
-  int64_t lastVidPts;    // the video PTS of the last frame (in display order)
-  bool multiFramePkt;    // multiple frames within one PES packet
-  int64_t firstPts;      // first valid PTS, for dangling packet stripping
-  int64_t offset;        // offset to add to all timestamps
-  int tRefOffset;        // number of stripped frames in GOP
-  uint8_t counter[MAXPID]; // the TS continuity counter for each PID
-  bool keepPkt[MAXPID];  // flag for each PID to keep packets, for dangling packet stripping
-  int numIFrames;        // number of I-frames without pending packets
-  cPatPmtParser patPmtParser;
-  bool Throttled(void);
-  bool SwitchFile(bool Force = false);
-  bool LoadFrame(int Index, uint8_t *Buffer, bool &Independent, int &Length);
-  bool FramesAreEqual(int Index1, int Index2);
-  void GetPendingPackets(uint8_t *Buffer, int &Length, int Index);
-       // Gather all non-video TS packets from Index upward that either belong to
-       // payloads that started before Index, or have a PTS that is before lastVidPts,
-       // and add them to the end of the given Data.
-  bool FixFrame(uint8_t *Data, int &Length, bool Independent, int Index, bool CutIn, bool CutOut);
-  bool ProcessSequence(int LastEndIndex, int BeginIndex, int EndIndex, int NextBeginIndex);
-protected:
-  virtual void* Process(void);
-public:
-  cCuttingThread(const std::string& strFromFileName, const std::string& strToFileName);
-  virtual ~cCuttingThread();
-  const char *Error(void) { return error; }
-  };
-
-cCuttingThread::cCuttingThread(const std::string& strFromFileName, const std::string& strToFileName)
-:CThread()
+void cRecordingCutter::Close(void)
 {
-  error = NULL;
-  fromFile = toFile = NULL;
-  fromFileName = toFileName = NULL;
-  fromIndex = toIndex = NULL;
-  cRecording Recording(strFromFileName);
-  isPesRecording = Recording.IsPesRecording();
-  framesPerSecond = Recording.FramesPerSecond();
-  suspensionLogged = false;
-  fileSize = 0;
-  sequence = 0;
-  delta = int(round(PTSTICKS / framesPerSecond));
-  lastVidPts = -1;
-  multiFramePkt = false;
-  firstPts = -1;
-  offset = 0;
-  tRefOffset = 0;
-  memset(counter, 0x00, sizeof(counter));
-  numIFrames = 0;
-  if (fromMarks.Load(strFromFileName.c_str(), framesPerSecond, isPesRecording) && !fromMarks.Empty()) {
-     numSequences = fromMarks.GetNumSequences();
-     if (numSequences > 0) {
-        fromFileName = new cFileName(strFromFileName, false, true, isPesRecording);
-        toFileName = new cFileName(strToFileName, true, true, isPesRecording);
-        fromIndex = new cIndexFile(strFromFileName, false, isPesRecording);
-        toIndex = new cIndexFile(strToFileName, true, isPesRecording);
-        toMarks.Load(strToFileName.c_str(), framesPerSecond, isPesRecording); // doesn't actually load marks, just sets the file name
-        maxVideoFileSize = MEGABYTE(cSettings::Get().m_iMaxVideoFileSizeMB);
-        if (isPesRecording && maxVideoFileSize > MEGABYTE(MAXVIDEOFILESIZEPES))
-           maxVideoFileSize = MEGABYTE(MAXVIDEOFILESIZEPES);
-        CreateThread();
-        }
-     else
-        esyslog("no editing sequences found for %s", strFromFileName.c_str());
-     }
-  else
-     esyslog("no editing marks found for %s", strFromFileName.c_str());
-}
+  if (m_fromFd >= 0)
+    close(m_fromFd);
+  if (m_toFd >= 0)
+    close(m_toFd);
+  m_fromFd = m_toFd = -1;
 
-cCuttingThread::~cCuttingThread()
-{
-  StopThread(3000);
-  delete fromFileName;
-  delete toFileName;
-  delete fromIndex;
-  delete toIndex;
+  SAFE_DELETE(m_fromIndex);
+  SAFE_DELETE(m_toIndex);
 }
 
-bool cCuttingThread::Throttled(void)
-{
-  if (PLATFORM::cIoThrottle::Engaged()) {
-     if (!suspensionLogged) {
-        dsyslog("suspending cutter thread");
-        suspensionLogged = true;
-        }
-     return true;
-     }
-  else if (suspensionLogged) {
-     dsyslog("resuming cutter thread");
-     suspensionLogged = false;
-     }
+bool cRecordingCutter::Throttled(void)
+{
+  if (cIoThrottle::Engaged())
+  {
+    if (!m_bSuspensionLogged)
+    {
+      dsyslog("suspending cutter thread");
+      m_bSuspensionLogged = true;
+    }
+    return true;
+  }
+  else if (m_bSuspensionLogged)
+  {
+    dsyslog("resuming cutter thread");
+    m_bSuspensionLogged = false;
+  }
   return false;
 }
 
-bool cCuttingThread::LoadFrame(int Index, uint8_t *Buffer, bool &Independent, int &Length)
-{
-  uint16_t FileNumber;
-  off_t FileOffset;
-  if (fromIndex->Get(Index, &FileNumber, &FileOffset, &Independent, &Length)) {
-     fromFile = fromFileName->SetOffset(FileNumber, FileOffset);
-     if (fromFile) {
-        fromFile->SetReadAhead(MEGABYTE(20));
-        int len = cRecording::ReadFrame(fromFile, Buffer,  Length, MAXFRAMESIZE);
-        if (len < 0)
-           error = "ReadFrame";
-        else if (len != Length)
-           Length = len;
-        return error == NULL;
-        }
-     else
-        error = "fromFile";
-     }
-  return false;
+void* cRecordingCutter::Process(void)
+{
+  const int64_t startMs = GetTimeMs();
+
+  cMark* beginMark = m_fromMarks.GetNextBegin();
+  while (beginMark && !IsStopped())
+  {
+    // Determine the actual end mark, skipping any marks at the same position
+    cMark* endMark = m_fromMarks.GetNextEnd(beginMark);
+    int endIndex = endMark ? endMark->Position() : m_fromIndex->Last() + 1;
+
+    // Mark the editing points in the edited recording
+    if (m_numSequences > 1)
+    {
+      if (!m_toMarks.Empty())
+        m_toMarks.Add(m_toFrames);
+      m_toMarks.Add(m_toFrames);
+    }
+
+    if (!ProcessSequence(beginMark->Position(), endIndex))
+      break;
+
+    if (!endMark)
+      break; // reached EOF
+
+    beginMark = m_fromMarks.GetNextBegin(endMark);
+  }
+
+  if (m_error == NULL && !IsStopped())
+  {
+    if (m_numSequences > 1)
+      m_toMarks.Save();
+
+    if (fsync(m_toFd) != 0)
+    {
+      LOG_ERROR_STR(m_strEditedFile.c_str());
+      m_error = "fsync";
+    }
+  }
+
+  if (m_error != NULL || IsStopped())
+  {
+    if (m_error != NULL)
+      esyslog("ERROR: '%s' during editing process", m_error);
+    else
+      isyslog("editing process has been interrupted");
+
+    m_toIndex->Delete();
+    CFile::Delete(m_strEditedFile);
+  }
+  else
+  {
+    isyslog("Edited %s (%" PRId64 " MB) in %" PRId64 " ms", m_strEditedRecording.c_str(),
+        (int64_t)(m_toSize / MEGABYTE(1)), GetTimeMs() - startMs);
+  }
+
+  // The edited recording is complete once the cutter is no longer active
+  Close();
+
+  return NULL;
 }
 
-bool cCuttingThread::SwitchFile(bool Force)
+bool cRecordingCutter::GetOffset(int index, off_t& offset, bool* bIndependent /* = NULL */)
 {
-  if (fileSize > maxVideoFileSize || Force) {
-     toFile = toFileName->NextFile();
-     if (!toFile) {
-        error = "toFile";
-        return false;
-        }
-     fileSize = 0;
-     }
-  return true;
-}
+  uint16_t fileNumber;
+  if (index > m_fromIndex->Last())
+  {
+    offset = m_fromSize;
+    return true;
+  }
 
-class cHeapBuffer {
-private:
-  uint8_t *buffer;
-public:
-  cHeapBuffer(int Size) { buffer = MALLOC(uint8_t, Size); }
-  ~cHeapBuffer() { free(buffer); }
-  operator uint8_t*() { return buffer; }
-  };
+  if (m_fromIndex->Get(index, &fileNumber, &offset, bIndependent))
+    return true;
 
-bool cCuttingThread::FramesAreEqual(int Index1, int Index2)
-{
-  cHeapBuffer Buffer1(MAXFRAMESIZE);
-  cHeapBuffer Buffer2(MAXFRAMESIZE);
-  if (!Buffer1 || !Buffer2)
-     return false;
-  bool Independent;
-  int Length1;
-  int Length2;
-  if (LoadFrame(Index1, Buffer1, Independent, Length1) && LoadFrame(Index2, Buffer2, Independent, Length2)) {
-     if (Length1 == Length2) {
-        int Diffs = 0;
-        for (int i = 0; i < Length1; i++) {
-            if (Buffer1[i] != Buffer2[i]) {
-               if (Diffs++ > 10) // the continuity counters of the PAT/PMT packets may differ
-                  return false;
-               }
-            }
-        return true;
-        }
-     }
+  m_error = "fromIndex";
   return false;
 }
 
-void cCuttingThread::GetPendingPackets(uint8_t *Data, int &Length, int Index)
-{
-  cHeapBuffer Buffer(MAXFRAMESIZE);
-  if (!Buffer)
-     return;
-  bool Processed[MAXPID] = { false };
-  cPacketStorage PacketStorage;
-  int64_t LastPts = lastVidPts + delta;// adding one frame length to fully cover the very last frame
-  Processed[patPmtParser.Vpid()] = true; // we only want non-video packets
-  for (int NumIndependentFrames = 0; NumIndependentFrames < 2; Index++) {
-      bool Independent;
-      int len;
-      if (LoadFrame(Index, Buffer, Independent, len)) {
-         if (Independent)
-            NumIndependentFrames++;
-         for (uint8_t *p = Buffer; len >= TS_SIZE && *p == TS_SYNC_BYTE; len -= TS_SIZE, p += TS_SIZE) {
-             int Pid = TsPid(p);
-             if (Pid != PATPID && !patPmtParser.IsPmtPid(Pid) && !Processed[Pid]) {
-                int64_t Pts = TsGetPts(p, TS_SIZE);
-                if (Pts >= 0) {
-                   int64_t d = PtsDiff(LastPts, Pts);
-                   if (d < 0) // Pts is before LastPts
-                      PacketStorage.Flush(Pid, Data, Length, MAXFRAMESIZE);
-                   else { // Pts is at or after LastPts
-                      NumIndependentFrames = 0; // we search until we find two consecutive I-frames without any more pending packets
-                      Processed[Pid] = true;
-                      }
-                   }
-                if (!Processed[Pid])
-                   PacketStorage.Append(Pid, p, TS_SIZE);
-                }
-             }
-         }
-      else
-         break;
-      }
+bool cRecordingCutter::ProcessSequence(int beginIndex, int endIndex)
+{
+  endIndex = std::min(endIndex, m_fromIndex->Last() + 1);
+  if (beginIndex >= endIndex)
+    return true;
+
+  // The first GOP is rewritten, the rest of the sequence is copied as is
+  int gopEndIndex = m_fromIndex->GetNextIFrame(beginIndex, true);
+  if (gopEndIndex < 0 || gopEndIndex > endIndex)
+    gopEndIndex = endIndex;
+
+  off_t beginOffset;
+  off_t gopEndOffset;
+  off_t endOffset;
+  if (!GetOffset(beginIndex, beginOffset) || !GetOffset(gopEndIndex, gopEndOffset) || !GetOffset(endIndex, endOffset))
+    return false;
+
+  if (gopEndOffset - beginOffset > MAXCUTINSIZE)
+  {
+    gopEndIndex = beginIndex + 1;
+    if (!GetOffset(gopEndIndex, gopEndOffset))
+      return false;
+  }
+
+  std::vector<uint8_t> gop(gopEndOffset - beginOffset);
+  if (pread(m_fromFd, gop.data(), gop.size(), beginOffset) != (ssize_t)gop.size())
+  {
+    LOG_ERROR_STR(m_strRecordingFile.c_str());
+    m_error = "read";
+    return false;
+  }
+
+  std::vector<size_t> frameOffsets;
+  std::vector<bool> independent;
+  for (int index = beginIndex; index < gopEndIndex; index++)
+  {
+    off_t offset;
+    bool bIndependent;
+    if (!GetOffset(index, offset, &bIndependent))
+      return false;
+    frameOffsets.push_back(offset - beginOffset);
+    independent.push_back(bIndependent);
+  }
+
+  std::vector<uint8_t> cutIn = FixCutIn(gop, frameOffsets);
+  PadCutIn(cutIn, m_toSize, gopEndOffset);
+  if (pwrite(m_toFd, cutIn.data(), cutIn.size(), m_toSize) != (ssize_t)cutIn.size())
+  {
+    LOG_ERROR_STR(m_strEditedFile.c_str());
+    m_error = "write";
+    return false;
+  }
+
+  for (size_t i = 0; i < frameOffsets.size(); i++)
+  {
+    if (!WriteIndex(independent[i], m_toSize + frameOffsets[i]))
+      return false;
+  }
+  m_toSize += cutIn.size();
+
+  // Index entries of the copied frames keep their distance to the GOP end,
+  // which is now aligned like the source within a block
+  const off_t copyBase = m_toSize;
+  if (!CopyRange(gopEndOffset, endOffset - gopEndOffset))
+    return false;
+
+  for (int index = gopEndIndex; index < endIndex; index++)
+  {
+    off_t offset;
+    bool bIndependent;
+    if (!GetOffset(index, offset, &bIndependent) || !WriteIndex(bIndependent, copyBase + offset - gopEndOffset))
+      return false;
+  }
+
+  return true;
 }
 
-bool cCuttingThread::FixFrame(uint8_t *Data, int &Length, bool Independent, int Index, bool CutIn, bool CutOut)
-{
-  if (!patPmtParser.Vpid()) {
-     if (!patPmtParser.ParsePatPmt(Data, Length))
-        return false;
-     }
-  if (CutIn) {
-     sequence++;
-     memset(keepPkt, false, sizeof(keepPkt));
-     numIFrames = 0;
-     firstPts = TsGetPts(Data, Length);
-     // Determine the PTS offset at the beginning of each sequence (except the first one):
-     if (sequence != 1) {
-        if (firstPts >= 0)
-           offset = (lastVidPts + delta - firstPts) & MAX33BIT;
-        }
-     }
-  if (CutOut)
-     GetPendingPackets(Data, Length, Index + 1);
-  if (Independent) {
-     numIFrames++;
-     tRefOffset = 0;
-     }
-  // Fix MPEG-2:
-  if (patPmtParser.Vtype() == 2) {
-     cMpeg2Fixer Mpeg2fixer(Data, Length, patPmtParser.Vpid());
-     if (CutIn) {
-        if (sequence == 1 || multiFramePkt)
-           Mpeg2fixer.SetBrokenLink();
-        else {
-           Mpeg2fixer.SetClosedGop();
-           tRefOffset = Mpeg2fixer.GetTref();
-           }
+bool cRecordingCutter::CopyRange(off_t offset, off_t length)
+{
+  loff_t fromOffset = offset;
+  loff_t toOffset = m_toSize;
+
+  while (length > 0)
+  {
+    if (IsStopped())
+      return false;
+
+    if (Throttled())
+    {
+      CEvent::Sleep(100);
+      continue;
+    }
+
+    ssize_t copied = -1;
+
+#if defined(HAVE_COPY_FILE_RANGE)
+    if (m_bCopyFileRange)
+    {
+      copied = copy_file_range(m_fromFd, &fromOffset, m_toFd, &toOffset, std::min(length, (off_t)COPYCHUNKSIZE), 0);
+      if (copied < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP))
+      {
+        dsyslog("copy_file_range() not supported (%s), copying through user space", strerror(errno));
+        m_bCopyFileRange = false;
+        continue;
+      }
+    }
+    else
+#endif
+    {
+      if (m_buffer.empty())
+        m_buffer.resize(READCHUNKSIZE);
+
+      copied = pread(m_fromFd, m_buffer.data(), std::min(length, (off_t)m_buffer.size()), fromOffset);
+      if (copied > 0)
+      {
+        if (pwrite(m_toFd, m_buffer.data(), copied, toOffset) != copied)
+          copied = -1;
+        else
+        {
+          fromOffset += copied;
+          toOffset += copied;
         }
-     if (tRefOffset)
-        Mpeg2fixer.AdjTref(tRefOffset);
-     if (sequence > 1 && Independent)
-        Mpeg2fixer.AdjGopTime((offset - MAX33BIT) / delta, round(framesPerSecond));
-     }
-  bool DeletedFrame = false;
-  bool GotVidPts = false;
-  bool StripVideo = sequence > 1 && tRefOffset;
-  uint8_t *p;
-  int len;
-  for (p = Data, len = Length; len >= TS_SIZE && *p == TS_SYNC_BYTE; p += TS_SIZE, len -= TS_SIZE) {
-      int Pid = TsPid(p);
-      // Strip dangling packets:
-      if (numIFrames < 2 && Pid != PATPID && !patPmtParser.IsPmtPid(Pid)) {
-         if (Pid != patPmtParser.Vpid() || StripVideo) {
-            int64_t Pts = TsGetPts(p, TS_SIZE);
-            if (Pts >= 0)
-               keepPkt[Pid] = PtsDiff(firstPts, Pts) >= 0; // Pts is at or after FirstPts
-            if (!keepPkt[Pid]) {
-               TsHidePayload(p);
-               numIFrames = 0; // we search until we find two consecutive I-frames without any more dangling packets
-               if (Pid == patPmtParser.Vpid())
-                  DeletedFrame = true;
-               }
-            }
-         }
-      // Adjust the TS continuity counter:
-      if (sequence > 1) {
-         if (TsHasPayload(p))
-            counter[Pid] = (counter[Pid] + 1) & TS_CONT_CNT_MASK;
-         TsSetContinuityCounter(p, counter[Pid]);
-         }
-      else
-         counter[Pid] = TsGetContinuityCounter(p); // collect initial counters
-      // Adjust PTS:
-      int64_t Pts = TsGetPts(p, TS_SIZE);
-      if (Pts >= 0) {
-         if (sequence > 1) {
-            Pts = PtsAdd(Pts, offset);
-            TsSetPts(p, TS_SIZE, Pts);
-            }
-         // Keep track of the highest video PTS - in case of multiple fields per frame, take the first one
-         if (!GotVidPts && Pid == patPmtParser.Vpid()) {
-            GotVidPts = true;
-            if (lastVidPts < 0 || PtsDiff(lastVidPts, Pts) > 0)
-               lastVidPts = Pts;
-            }
-         }
-      // Adjust DTS:
-      if (sequence > 1) {
-         int64_t Dts = TsGetDts(p, TS_SIZE);
-         if (Dts >= 0) {
-            Dts = PtsAdd(Dts, offset);
-            if (CutIn)
-               Dts = PtsAdd(Dts, tRefOffset * delta);
-            TsSetDts(p, TS_SIZE, Dts);
-            }
-         int64_t Pcr = TsGetPcr(p);
-         if (Pcr >= 0) {
-            Pcr = Pcr + offset * PCRFACTOR;
-            if (Pcr > MAX27MHZ)
-               Pcr -= MAX27MHZ + 1;
-            TsSetPcr(p, Pcr);
-            }
-         }
       }
-  if (!DeletedFrame && !GotVidPts) {
-     // Adjust PTS for multiple frames within a single PES packet:
-     lastVidPts = (lastVidPts + delta) & MAX33BIT;
-     multiFramePkt = true;
-     }
-  return DeletedFrame;
-}
+    }
 
-bool cCuttingThread::ProcessSequence(int LastEndIndex, int BeginIndex, int EndIndex, int NextBeginIndex)
-{
-  // Check for seamless connections:
-  bool SeamlessBegin = LastEndIndex >= 0 && FramesAreEqual(LastEndIndex, BeginIndex);
-  bool SeamlessEnd = NextBeginIndex >= 0 && FramesAreEqual(EndIndex, NextBeginIndex);
-  // Process all frames from BeginIndex (included) to EndIndex (excluded):
-  cHeapBuffer Buffer(MAXFRAMESIZE);
-  if (!Buffer) {
-     error = "malloc";
-     return false;
-     }
-  for (int Index = BeginIndex; !IsStopped() && Index < EndIndex; Index++) {
-      bool Independent;
-      int Length;
-      if (LoadFrame(Index, Buffer, Independent, Length)) {
-         // Make sure there is enough disk space:
-         Recordings.AssertFreeDiskSpace(-1);
-         bool CutIn = !SeamlessBegin && Index == BeginIndex;
-         bool CutOut = !SeamlessEnd && Index == EndIndex - 1;
-         bool DeletedFrame = false;
-         if (!isPesRecording) {
-            DeletedFrame = FixFrame(Buffer, Length, Independent, Index, CutIn, CutOut);
-            }
-         else if (CutIn)
-            cRemux::SetBrokenLink(Buffer, Length);
-         // Every file shall start with an independent frame:
-         if (Independent) {
-            if (!SwitchFile())
-               return false;
-            }
-         // Write index:
-         if (!DeletedFrame && !toIndex->Write(Independent, toFileName->Number(), fileSize)) {
-            error = "toIndex";
-            return false;
-            }
-         // Write data:
-         if (toFile->Write(Buffer, Length) < 0) {
-            error = "safe_write";
-            return false;
-            }
-         fileSize += Length;
-         // Generate marks at the editing points in the edited recording:
-         if (numSequences > 1 && Index == BeginIndex) {
-            if (!toMarks.Empty())
-               toMarks.Add(toIndex->Last());
-            toMarks.Add(toIndex->Last());
-            toMarks.Save();
-            }
-         }
-      else
-         return false;
-      }
-  return true;
-}
+    if (copied <= 0)
+    {
+      LOG_ERROR_STR(m_strEditedFile.c_str());
+      m_error = "copy";
+      return false;
+    }
 
-void* cCuttingThread::Process(void)
-{
-  if (cMark *BeginMark = fromMarks.GetNextBegin()) {
-     fromFile = fromFileName->Open();
-     toFile = toFileName->Open();
-     if (!fromFile || !toFile)
-        return NULL;
-     int LastEndIndex = -1;
-     while (BeginMark && !IsStopped()) {
-           // Suspend cutting if we have severe throughput problems:
-           if (Throttled()) {
-             CEvent::Sleep(100);
-              continue;
-              }
-           // Determine the actual begin and end marks, skipping any marks at the same position:
-           cMark *EndMark = fromMarks.GetNextEnd(BeginMark);
-           // Process the current sequence:
-           int EndIndex = EndMark ? EndMark->Position() : fromIndex->Last() + 1;
-           int NextBeginIndex = -1;
-           if (EndMark) {
-              if (cMark *NextBeginMark = fromMarks.GetNextBegin(EndMark))
-                 NextBeginIndex = NextBeginMark->Position();
-              }
-           if (!ProcessSequence(LastEndIndex, BeginMark->Position(), EndIndex, NextBeginIndex))
-              break;
-           if (!EndMark)
-              break; // reached EOF
-           LastEndIndex = EndIndex;
-           // Switch to the next sequence:
-           BeginMark = fromMarks.GetNextBegin(EndMark);
-           if (BeginMark) {
-              // Split edited files:
-              if (cSettings::Get().m_bSplitEditedFiles) {
-                 if (!SwitchFile(true))
-                    break;
-                 }
-              }
-           }
-     Recordings.TouchUpdate();
-     }
-  else
-     esyslog("no editing marks found!");
+    length -= copied;
+  }
 
-  return NULL;
+  m_toSize = toOffset;
+  return true;
 }
 
-// --- cCutter ---------------------------------------------------------------
-
-CMutex cCutter::mutex;
-std::string cCutter::originalVersionName;
-std::string cCutter::editedVersionName;
-cCuttingThread *cCutter::cuttingThread = NULL;
-bool cCutter::error = false;
-bool cCutter::ended = false;
-
-bool cCutter::Start(const char *FileName)
+bool cRecordingCutter::WriteIndex(bool bIndependent, off_t offset)
 {
-  CLockObject lock(mutex);
-  if (!cuttingThread) {
-     error = false;
-     ended = false;
-     originalVersionName = FileName;
-     cRecording Recording(FileName);
-
-     cMarks FromMarks;
-     FromMarks.Load(FileName, Recording.FramesPerSecond(), Recording.IsPesRecording());
-     if (cMark *First = FromMarks.GetNextBegin())
-        Recording.SetStartTime(Recording.Start() + (int(First->Position() / Recording.FramesPerSecond() + 30) / 60) * 60);
-
-     std::string strEvent = Recording.PrefixFileName('%');
-     if (!strEvent.empty() && RemoveVideoFile(strEvent) && MakeDirs(strEvent, true)) {
-        // XXX this can be removed once RenameVideoFile() follows symlinks (see videodir.c)
-        // remove a possible deleted recording with the same name to avoid symlink mixups:
-        char *s = strdup(strEvent.c_str());
-        char *e = strrchr(s, '.');
-        if (e) {
-           if (strcmp(e, ".rec") == 0) {
-              strcpy(e, ".del");
-              RemoveVideoFile(s);
-              }
-           }
-        free(s);
-        // XXX
-        editedVersionName = strEvent;
-        Recording.WriteInfo();
-        Recordings.AddByName(editedVersionName, false);
-        cuttingThread = new cCuttingThread(FileName, editedVersionName);
-        return true;
-        }
-     }
-  return false;
-}
+  const uint16_t fileNumber = 0; // Recordings are a single file
+  if (!m_toIndex->Write(bIndependent, fileNumber, offset))
+  {
+    m_error = "toIndex";
+    return false;
+  }
 
-void cCutter::Stop(void)
-{
-  CLockObject lock(mutex);
-  bool Interrupted = cuttingThread && cuttingThread->IsRunning();
-  const char *Error = cuttingThread ? cuttingThread->Error() : NULL;
-  delete cuttingThread;
-  cuttingThread = NULL;
-  if ((Interrupted || Error) && !editedVersionName.empty()) {
-     if (Interrupted)
-        isyslog("editing process has been interrupted");
-     if (Error)
-        esyslog("ERROR: '%s' during editing process", Error);
-//     if (cReplayControl::NowReplaying() && strcmp(cReplayControl::NowReplaying(), editedVersionName) == 0)
-//        cControl::Shutdown();
-     RemoveVideoFile(editedVersionName);
-     Recordings.DelByName(editedVersionName);
-     }
+  m_toFrames++;
+  return true;
 }
 
-bool cCutter::Active(const char *FileName)
-{
-  CLockObject lock(mutex);
-  if (cuttingThread) {
-     if (cuttingThread->IsRunning())
-        return !FileName || strcmp(FileName, originalVersionName.c_str()) == 0 || strcmp(FileName, editedVersionName.c_str()) == 0;
-     error = cuttingThread->Error();
-     Stop();
-     if (!error)
-        cRecordingUserCommand::Get().InvokeCommand(RUC_EDITEDRECORDING, editedVersionName, originalVersionName);
-     originalVersionName.clear();
-     editedVersionName.clear();
-     ended = true;
-     }
-  return false;
-}
+std::vector<uint8_t> cRecordingCutter::FixCutIn(const std::vector<uint8_t>& gop, std::vector<size_t>& frameOffsets)
+{
+  const size_t packets = gop.size() / TS_SIZE;
+
+  // Drop payload until each PID starts a new PES packet or section. The first
+  // kept packet's continuity counter determines the counter of its marker.
+  std::vector<bool> keep(packets, false);
+  std::map<uint16_t, uint8_t> firstCounters;
+  std::vector<uint16_t> pids; // In order of appearance
+  for (size_t i = 0; i < packets; i++)
+  {
+    const uint8_t* p = gop.data() + i * TS_SIZE;
+    if (p[0] != TS_SYNC_BYTE)
+      continue;
+
+    const uint16_t pid = TsPid(p);
+    if (pid == 0x1FFF) // null packets
+      continue;
+
+    if (firstCounters.find(pid) == firstCounters.end())
+    {
+      if (TsHasPayload(p) && !TsPayloadStart(p))
+        continue;
+
+      // Adaptation-only packets repeat the previous counter, others increment it
+      firstCounters[pid] = (TsGetContinuityCounter(p) - (TsHasPayload(p) ? 1 : 0)) & TS_CONT_CNT_MASK;
+      pids.push_back(pid);
+    }
+    keep[i] = true;
+  }
+
+  std::vector<uint8_t> result;
+  result.reserve((pids.size() + packets) * TS_SIZE);
+
+  for (std::vector<uint16_t>::const_iterator it = pids.begin(); it != pids.end(); ++it)
+  {
+    uint8_t marker[TS_SIZE];
+    marker[0] = TS_SYNC_BYTE;
+    marker[1] = (*it >> 8) & TS_PID_MASK_HI;
+    marker[2] = *it & 0xFF;
+    marker[3] = TS_ADAPT_FIELD_EXISTS | firstCounters[*it];
+    marker[4] = TS_SIZE - 5;
+    marker[5] = TS_ADAPT_DISCONT;
+    memset(marker + 6, 0xFF, TS_SIZE - 6);
+    result.insert(result.end(), marker, marker + TS_SIZE);
+  }
+
+  // The markers belong to the first frame
+  std::vector<size_t>::iterator itFrame = frameOffsets.begin();
+  if (itFrame != frameOffsets.end())
+    *itFrame++ = 0;
+
+  for (size_t i = 0; i < packets; i++)
+  {
+    while (itFrame != frameOffsets.end() && *itFrame <= i * TS_SIZE)
+      *itFrame++ = result.size();
+
+    if (keep[i])
+      result.insert(result.end(), gop.begin() + i * TS_SIZE, gop.begin() + (i + 1) * TS_SIZE);
+  }
+
+  for (; itFrame != frameOffsets.end(); ++itFrame)
+    *itFrame = result.size();
+
+  cPatPmtParser patPmtParser;
+  if (patPmtParser.ParsePatPmt(result.data(), result.size()) && patPmtParser.Vtype() == STREAM_TYPE_13818_VIDEO)
+  {
+    // B-frames that reference the previous GOP can't be decoded
+    cMpeg2Fixer mpeg2Fixer(result.data(), result.size(), patPmtParser.Vpid());
+    mpeg2Fixer.SetBrokenLink();
+  }
 
-bool cCutter::Error(void)
-{
-  CLockObject lock(mutex);
-  bool result = error;
-  error = false;
   return result;
 }
 
-bool cCutter::Ended(void)
+void cRecordingCutter::PadCutIn(std::vector<uint8_t>& data, off_t toOffset, off_t fromOffset)
 {
-  CLockObject lock(mutex);
-  bool result = ended;
-  ended = false;
-  return result;
-}
+  // TS packets are 188 = 4 * 47 bytes, so only offsets that are a multiple of
+  // 4 apart can be aligned. It takes at most CUTTER_BLOCK_SIZE / 4 packets.
+  if ((toOffset - fromOffset) % 4 != 0)
+    return;
 
-#define CUTTINGCHECKINTERVAL 500 // ms between checks for the active cutting process
+  uint8_t nullPacket[TS_SIZE];
+  nullPacket[0] = TS_SYNC_BYTE;
+  nullPacket[1] = 0x1F;
+  nullPacket[2] = 0xFF;
+  nullPacket[3] = TS_PAYLOAD_EXISTS;
+  memset(nullPacket + 4, 0xFF, TS_SIZE - 4);
 
-bool CutRecording(const char *FileName)
-{
-  if (CDirectory::CanWrite(FileName)) {
-     cRecording Recording(FileName);
-     if (!Recording.Name().empty()) {
-        cMarks Marks;
-        if (Marks.Load(FileName, Recording.FramesPerSecond(), Recording.IsPesRecording()) && !Marks.Empty()) {
-           if (Marks.GetNumSequences()) {
-              if (cCutter::Start(FileName)) {
-                 while (cCutter::Active())
-                   CEvent::Sleep(CUTTINGCHECKINTERVAL);
-                 return true;
-                 }
-              else
-                 fprintf(stderr, "can't start editing process\n");
-              }
-           else
-              fprintf(stderr, "'%s' has no editing sequences\n", FileName);
-           }
-        else
-           fprintf(stderr, "'%s' has no editing marks\n", FileName);
-        }
-     else
-        fprintf(stderr, "'%s' is not a recording\n", FileName);
-     }
-  else
-     fprintf(stderr, "'%s' is not a directory\n", FileName);
-  return false;
+  while ((toOffset + (off_t)data.size() - fromOffset) % CUTTER_BLOCK_SIZE != 0)
+    data.insert(data.end(), nullPacket, nullPacket + TS_SIZE);
 }
 
 }
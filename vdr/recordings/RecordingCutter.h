@@ -20,32 +20,95 @@
  */
 #pragma once
 
+#include "recordings/marks/Marks.h"
 #include "lib/platform/threads/threads.h"
 
+#include <stddef.h>
+#include <stdint.h>
 #include <string>
+#include <sys/types.h>
+#include <vector>
+
+#define CUTTER_BLOCK_SIZE  4096 // Extents are shared in filesystem blocks
 
 namespace VDR
 {
-class cCuttingThread;
+class cIndexFile;
 
-class cCutter {
-private:
-  static PLATFORM::CMutex mutex;
-  static std::string originalVersionName;
-  static std::string editedVersionName;
-  static cCuttingThread *cuttingThread;
-  static bool error;
-  static bool ended;
+/*!
+ * Cuts a recording along its editing marks into an edited recording. Both are
+ * recording directories that hold a single TS file, the index and the marks.
+ *
+ * The index tells where each frame and GOP starts, so the bulk of every
+ * sequence is copied with copy_file_range(). Filesystems that support it
+ * share the extents (reflink), others copy in the kernel. Only the first GOP
+ * of each sequence is read and rewritten, see FixCutIn(). The rewritten GOP is
+ * padded with null packets until the copy lands on the same offset within a
+ * filesystem block as its source, otherwise no extent could be shared.
+ * Timestamps are left unchanged; decoders see the discontinuity flagged
+ * instead.
+ */
+class cRecordingCutter : protected PLATFORM::CThread
+{
 public:
-  static bool Start(const char *FileName);
-  static void Stop(void);
-  static bool Active(const char *FileName = NULL);
-         ///< Returns true if the cutter is currently active.
-         ///< If a FileName is given, true is only returned if either the
-         ///< original or the edited file name is equal to FileName.
-  static bool Error(void);
-  static bool Ended(void);
-  };
-
-bool CutRecording(const char *FileName);
+  cRecordingCutter(const std::string& strRecording, const std::string& strEditedRecording);
+  virtual ~cRecordingCutter(void);
+
+  bool Start(void);
+  void Stop(void);
+  bool Active(void) { return IsRunning(); }
+
+  /*!
+   * The step that failed, or NULL if cutting succeeded (so far)
+   */
+  const char* Error(void) const { return m_error; }
+
+  /*!
+   * Rewrite the first GOP after a cut. Payload that continues a PES packet or
+   * section from before the cut is dropped, and each PID is preceded by an
+   * adaptation-only packet with the discontinuity indicator set, so the jumps
+   * in continuity counters and timestamps are legal. The broken_link flag is
+   * set on MPEG-2 video. frameOffsets holds the offset of each frame in gop
+   * and is updated to the frame offsets in the result.
+   */
+  static std::vector<uint8_t> FixCutIn(const std::vector<uint8_t>& gop, std::vector<size_t>& frameOffsets);
+
+  /*!
+   * Append null packets to data, which is to be written at toOffset, until
+   * the data following it is aligned like fromOffset within a block of
+   * CUTTER_BLOCK_SIZE bytes. Both offsets must be multiples of 4.
+   */
+  static void PadCutIn(std::vector<uint8_t>& data, off_t toOffset, off_t fromOffset);
+
+protected:
+  virtual void* Process(void);
+
+private:
+  bool ProcessSequence(int beginIndex, int endIndex);
+  bool GetOffset(int index, off_t& offset, bool* bIndependent = NULL);
+  bool CopyRange(off_t offset, off_t length);
+  bool WriteIndex(bool bIndependent, off_t offset);
+  bool Throttled(void);
+  void Close(void);
+
+  std::string          m_strRecording;
+  std::string          m_strEditedRecording;
+  std::string          m_strRecordingFile;
+  std::string          m_strEditedFile;
+  cMarks               m_fromMarks;
+  cMarks               m_toMarks;
+  cIndexFile*          m_fromIndex;
+  cIndexFile*          m_toIndex;
+  int                  m_fromFd;
+  int                  m_toFd;
+  off_t                m_fromSize;
+  off_t                m_toSize;         // Bytes written to the edited recording
+  int                  m_toFrames;       // Frames written to the edited recording's index
+  int                  m_numSequences;
+  bool                 m_bCopyFileRange; // Cleared if the kernel or filesystem lacks support
+  bool                 m_bSuspensionLogged;
+  std::vector<uint8_t> m_buffer;         // For reading when copy_file_range() isn't available
+  const char*          m_error;
+};
+
 }
@@ -32,3 +32,5 @@
 #define RECORDING_XML_ATTR_RESUME_POS  "resume"
 #define RECORDING_XML_ATTR_PLAY_COUNT  "play_count"
 #define RECORDING_XML_ATTR_PRIORITY    "priority"
+#define RECORDING_XML_ATTR_FILE_SIZE   "size"
+#define RECORDING_XML_ATTR_FRAMES      "frames"
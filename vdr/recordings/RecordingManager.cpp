@@ -22,17 +22,64 @@
 #include "RecordingManager.h"
 #include "Recording.h"
 #include "RecordingDefinitions.h"
+#include "filesystem/Poller.h"
+#include "filesystem/SpecialProtocol.h"
+#include "recordings/filesystem/IndexFile.h"
+#include "settings/Settings.h"
+#include "utils/CommonMacros.h"
 #include "utils/log/Log.h"
 #include "utils/StringUtils.h"
 #include "utils/XBMCTinyXML.h"
 
+#include <dirent.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
 #include <utility>
 
+// Files are reported when they're written and closed, or moved or deleted.
+// Directories are watched as they're created.
+#define WATCH_MASK          (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF)
+
+#define WATCH_POLL_TIMEOUT  1000 // ms
+
+using namespace PLATFORM;
+
 namespace VDR
 {
 
+static uint64_t Duration(const cRecording& recording)
+{
+  return (recording.EndTime() - recording.StartTime()).GetSecondsTotal();
+}
+
+// Add an inotify watch for strDirectory and its subdirectories
+static void WatchDirectory(int fd, const std::string& strDirectory, std::map<int, std::string>& watches)
+{
+  int wd = inotify_add_watch(fd, strDirectory.c_str(), WATCH_MASK | IN_ONLYDIR);
+  if (wd < 0)
+  {
+    LOG_ERROR_STR(strDirectory.c_str());
+    return;
+  }
+  watches[wd] = strDirectory;
+
+  DIR* dir = opendir(strDirectory.c_str());
+  if (!dir)
+    return;
+
+  while (struct dirent* entry = readdir(dir))
+  {
+    if (entry->d_type == DT_DIR && strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+      WatchDirectory(fd, strDirectory + "/" + entry->d_name, watches);
+  }
+  closedir(dir);
+}
+
 cRecordingManager::cRecordingManager(void)
- : m_maxID(RECORDING_INVALID_ID)
+ : m_maxID(RECORDING_INVALID_ID),
+   m_totalFileSize(0),
+   m_totalDuration(0)
 {
 }
 
@@ -92,12 +139,20 @@ bool cRecordingManager::AddRecording(const RecordingPtr& newRecording)
 {
   if (newRecording && newRecording->IsValid(false))
   {
+    // Don't block other threads while the files are examined
+    uint64_t fileSize;
+    unsigned int frames;
+    cRecording::ReadFileStats(newRecording->URL(), newRecording->IsPesRecording(), fileSize, frames);
+
     PLATFORM::CLockObject lock(m_mutex);
 
     newRecording->SetID(++m_maxID);
     newRecording->RegisterObserver(this);
     m_recordings.insert(std::make_pair(newRecording->ID(), newRecording));
 
+    newRecording->SetFileStats(fileSize, frames);
+    AddFileStats(*newRecording);
+
     SetChanged();
 
     const CDateTime now = CDateTime::GetUTCDateTime();
@@ -112,12 +167,21 @@ bool cRecordingManager::AddRecording(const RecordingPtr& newRecording)
 
 bool cRecordingManager::UpdateRecording(unsigned int id, const cRecording& updatedRecording)
 {
+  // The recording's files may have been renamed
+  uint64_t fileSize;
+  unsigned int frames;
+  cRecording::ReadFileStats(updatedRecording.URL(), updatedRecording.IsPesRecording(), fileSize, frames);
+
   PLATFORM::CLockObject lock(m_mutex);
 
   RecordingPtr recording = GetByID(id);
   if (recording)
   {
+    RemoveFileStats(*recording);
     *recording = updatedRecording;
+    recording->SetFileStats(fileSize, frames);
+    AddFileStats(*recording);
+
     recording->NotifyObservers();
     return true;
   }
@@ -134,6 +198,7 @@ bool cRecordingManager::RemoveRecording(unsigned int id)
   {
     it->second->Interrupt();
     it->second->UnregisterObserver(this);
+    RemoveFileStats(*it->second);
     m_recordings.erase(it);
 
     SetChanged();
@@ -144,6 +209,205 @@ bool cRecordingManager::RemoveRecording(unsigned int id)
   return false;
 }
 
+size_t cRecordingManager::TotalFileSizeMB(bool bDeletedRecordings /* = false */) const
+{
+  if (bDeletedRecordings)
+    return 0;
+
+  CLockObject lock(m_mutex);
+  return m_totalFileSize / MEGABYTE(1);
+}
+
+double cRecordingManager::MBperMinute(void) const
+{
+  CLockObject lock(m_mutex);
+
+  if (m_totalDuration == 0)
+    return -1;
+
+  return ((double)m_totalFileSize / MEGABYTE(1)) / ((double)m_totalDuration / 60);
+}
+
+void cRecordingManager::AddFileStats(const cRecording& recording)
+{
+  const std::string strUrl = CSpecialProtocol::TranslatePath(recording.URL());
+  m_files[strUrl] = recording.ID();
+  m_files[cIndexFile::IndexFileName(strUrl, recording.IsPesRecording())] = recording.ID();
+
+  if (recording.FileSize() > 0)
+  {
+    m_totalFileSize += recording.FileSize();
+    m_totalDuration += Duration(recording);
+  }
+}
+
+void cRecordingManager::RemoveFileStats(const cRecording& recording)
+{
+  const std::string strUrl = CSpecialProtocol::TranslatePath(recording.URL());
+  m_files.erase(strUrl);
+  m_files.erase(cIndexFile::IndexFileName(strUrl, recording.IsPesRecording()));
+
+  if (recording.FileSize() > 0)
+  {
+    m_totalFileSize -= recording.FileSize();
+    m_totalDuration -= Duration(recording);
+  }
+}
+
+bool cRecordingManager::UpdateFileStats(const RecordingPtr& recording)
+{
+  std::string strUrl;
+  bool bPesRecording;
+  {
+    CLockObject lock(m_mutex);
+    if (!Contains(recording))
+      return false;
+
+    strUrl = recording->URL();
+    bPesRecording = recording->IsPesRecording();
+  }
+
+  uint64_t fileSize;
+  unsigned int frames;
+  cRecording::ReadFileStats(strUrl, bPesRecording, fileSize, frames);
+
+  CLockObject lock(m_mutex);
+
+  // Removed or renamed in the meantime, UpdateRecording() read the new files
+  if (!Contains(recording) || recording->URL() != strUrl)
+    return false;
+
+  RemoveFileStats(*recording);
+  bool bChanged = recording->SetFileStats(fileSize, frames);
+  AddFileStats(*recording);
+
+  if (bChanged)
+    SetChanged();
+
+  return bChanged;
+}
+
+bool cRecordingManager::Contains(const RecordingPtr& recording) const
+{
+  RecordingMap::const_iterator it = m_recordings.find(recording->ID());
+  return it != m_recordings.end() && it->second == recording;
+}
+
+RecordingPtr cRecordingManager::GetByFile(const std::string& strPath) const
+{
+  CLockObject lock(m_mutex);
+
+  std::map<std::string, unsigned int>::const_iterator it = m_files.find(strPath);
+  if (it != m_files.end())
+    return GetByID(it->second);
+
+  return cRecording::EmptyRecording;
+}
+
+bool cRecordingManager::FileChanged(const std::string& strPath)
+{
+  RecordingPtr recording = GetByFile(strPath);
+  return recording && UpdateFileStats(recording);
+}
+
+void cRecordingManager::Start(void)
+{
+  CreateThread(false);
+}
+
+void cRecordingManager::Stop(void)
+{
+  StopThread(0);
+}
+
+void* cRecordingManager::Process(void)
+{
+  // Recordings loaded without cached values are scanned once
+  bool bChanged = false;
+  RecordingVector recordings = GetRecordings();
+  for (RecordingVector::const_iterator it = recordings.begin(); it != recordings.end() && !IsStopped(); ++it)
+  {
+    if ((*it)->FileSize() == 0)
+      bChanged |= UpdateFileStats(*it);
+  }
+  if (bChanged)
+    NotifyObservers();
+
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0)
+  {
+    LOG_ERROR_STR("inotify_init1");
+    return NULL;
+  }
+
+  std::map<int, std::string> watches;
+  WatchDirectory(fd, CSpecialProtocol::TranslatePath(cSettings::Get().m_VideoDirectory), watches);
+
+  cPoller poller(fd);
+  char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+  while (!IsStopped())
+  {
+    if (!poller.Poll(WATCH_POLL_TIMEOUT))
+      continue;
+
+    bool bOverflow = false;
+    bChanged = false;
+
+    ssize_t len;
+    while ((len = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+      const struct inotify_event* event;
+      for (char* ptr = buffer; ptr < buffer + len; ptr += sizeof(struct inotify_event) + event->len)
+      {
+        event = (const struct inotify_event*)ptr;
+
+        if (event->mask & IN_Q_OVERFLOW)
+        {
+          bOverflow = true;
+          continue;
+        }
+
+        if (event->mask & IN_IGNORED)
+        {
+          watches.erase(event->wd);
+          continue;
+        }
+
+        std::map<int, std::string>::const_iterator dir = watches.find(event->wd);
+        if (dir == watches.end() || event->len == 0)
+          continue;
+
+        const std::string strPath = dir->second + "/" + event->name;
+        if (event->mask & IN_ISDIR)
+        {
+          if (event->mask & (IN_CREATE | IN_MOVED_TO))
+            WatchDirectory(fd, strPath, watches);
+        }
+        else
+        {
+          bChanged |= FileChanged(strPath);
+        }
+      }
+    }
+
+    if (bOverflow)
+    {
+      // Events were lost, check all recordings
+      dsyslog("recordings watch queue overflowed, refreshing all recordings");
+      recordings = GetRecordings();
+      for (RecordingVector::const_iterator it = recordings.begin(); it != recordings.end(); ++it)
+        bChanged |= UpdateFileStats(*it);
+    }
+
+    if (bChanged)
+      NotifyObservers();
+  }
+
+  close(fd);
+  return NULL;
+}
+
 void cRecordingManager::Notify(const Observable& obs, const ObservableMessage msg)
 {
   switch (msg)
@@ -182,6 +446,9 @@ bool cRecordingManager::Load(const std::string& file)
   PLATFORM::CLockObject lock(m_mutex);
 
   m_recordings.clear();
+  m_files.clear();
+  m_totalFileSize = 0;
+  m_totalDuration = 0;
 
   CXBMCTinyXML xmlDoc;
   if (!xmlDoc.LoadFile(file.c_str()))
@@ -220,6 +487,7 @@ bool cRecordingManager::Load(const std::string& file)
       m_maxID = recording->ID();
 
     m_recordings.insert(std::make_pair(recording->ID(), recording));
+    AddFileStats(*recording);
 
     node = node->NextSibling(RECORDING_XML_ELM_RECORDING);
   }
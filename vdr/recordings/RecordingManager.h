@@ -23,8 +23,11 @@
 #include "RecordingTypes.h"
 #include "channels/ChannelTypes.h"
 #include "lib/platform/threads/mutex.h"
+#include "lib/platform/threads/threads.h"
 #include "utils/Observer.h"
 
+#include <map>
+#include <stdint.h>
 #include <string>
 
 namespace VDR
@@ -32,7 +35,7 @@ namespace VDR
 
 class CDateTime;
 
-class cRecordingManager : public Observer, public Observable
+class cRecordingManager : public Observer, public Observable, protected PLATFORM::CThread
 {
 public:
   static cRecordingManager& Get(void);
@@ -44,6 +47,12 @@ public:
   RecordingVector GetRecordings(void) const;
   size_t          RecordingCount(void) const;
 
+  /*!
+   * The recording that the file (its TS or index file, as a translated path)
+   * belongs to, or cRecording::EmptyRecording
+   */
+  RecordingPtr    GetByFile(const std::string& strPath) const;
+
   /*!
    * Add a recording and assign it an ID. Fails if newRecording already has a
    * valid ID or if newRecording is invalid (IsValid(false) returns false).
@@ -71,9 +80,22 @@ public:
   void ResumeRecording(const RecordingPtr& recording);
   void InterruptRecording(const RecordingPtr& recording);
 
-  // TODO
-  size_t TotalFileSizeMB(bool bDeletedRecordings = false) { return 0; }
-  double MBperMinute(void) { return -1; }
+  /*!
+   * Statistics over the recordings' cached file sizes. They're maintained as
+   * recordings are added, removed or their files change, so they don't touch
+   * the disk. Deleted recordings aren't kept, so their size is always 0.
+   * MBperMinute() returns -1 if no recording has a known size.
+   */
+  size_t TotalFileSizeMB(bool bDeletedRecordings = false) const;
+  double MBperMinute(void) const;
+
+  /*!
+   * Keep the recordings' cached file sizes and frame counts current by
+   * watching the video directory. Recordings without cached values (e.g.
+   * from an older recordings.xml) are scanned once when started.
+   */
+  void Start(void);
+  void Stop(void);
 
   virtual void Notify(const Observable& obs, const ObservableMessage msg);
   void NotifyObservers(void);
@@ -82,12 +104,41 @@ public:
   bool Load(const std::string& file);
   bool Save(const std::string& file = "");
 
+protected:
+  virtual void* Process(void);
+
 private:
   cRecordingManager(void);
 
+  // Add or subtract the recording's cached values from the totals, and its
+  // files from m_files. Must be called with m_mutex held.
+  void AddFileStats(const cRecording& recording);
+  void RemoveFileStats(const cRecording& recording);
+
+  /*!
+   * Refresh the cached values of the recording. The files are examined
+   * without holding m_mutex. Returns true if they changed.
+   */
+  bool UpdateFileStats(const RecordingPtr& recording);
+
+  /*!
+   * True if the recording hasn't been removed. Must be called with m_mutex
+   * held.
+   */
+  bool Contains(const RecordingPtr& recording) const;
+
+  /*!
+   * Called by the watcher for a changed file. Returns true if it belongs to
+   * a recording whose cached values changed.
+   */
+  bool FileChanged(const std::string& strPath);
+
   RecordingMap     m_recordings;
-  unsigned int     m_maxID;       // Monotonically increasing recording ID
-  std::string      m_strFilename; // recordings.xml filename
+  unsigned int     m_maxID;         // Monotonically increasing recording ID
+  std::string      m_strFilename;   // recordings.xml filename
+  std::map<std::string, unsigned int> m_files; // Recording and index file paths -> ID
+  uint64_t         m_totalFileSize; // Sum of the cached file sizes
+  uint64_t         m_totalDuration; // Seconds recorded in recordings with a known size
   PLATFORM::CMutex m_mutex;
 };
 
@@ -22,6 +22,7 @@
 #include "FileName.h"
 #include "Config.h"
 #include "devices/Remux.h"
+#include "recordings/RecordingConfig.h"
 #include "utils/log/Log.h"
 #include "utils/StringUtils.h"
 
@@ -30,9 +31,7 @@
 #include <unistd.h>
 
 #define MAXFILESPERRECORDINGPES 255
-#define RECORDFILESUFFIXPES     "/%03d.vdr"
 #define MAXFILESPERRECORDINGTS  65535
-#define RECORDFILESUFFIXTS      "/%05d.ts"
 #define RECORDFILESUFFIXLEN 20 // some additional bytes for safety...
 
 namespace VDR
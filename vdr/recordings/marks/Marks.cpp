@@ -150,7 +150,7 @@ void cMarks::Sort(void)
   {
     for (std::vector<cMark* >::const_iterator it2 = m_marks.begin(); it2 != m_marks.end(); ++it2)
     {
-      if ((*it2)->Position() < (*it1)->Position())
+      if ((*it1)->Position() < (*it2)->Position())
       {
         std::swap((*it1)->m_iPosition, (*it2)->m_iPosition);
         std::swap((*it1)->m_strComment, (*it2)->m_strComment);
@@ -161,7 +161,7 @@ void cMarks::Sort(void)
 
 void cMarks::Add(int Position)
 {
-  m_marks.push_back(new cMark(Position, NULL, framesPerSecond));
+  m_marks.push_back(new cMark(Position, "", framesPerSecond));
   Sort();
 }
 
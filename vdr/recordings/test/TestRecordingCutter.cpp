@@ -0,0 +1,235 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "devices/Remux.h"
+#include "filesystem/Directory.h"
+#include "filesystem/File.h"
+#include "lib/platform/threads/mutex.h"
+#include "recordings/RecordingConfig.h"
+#include "recordings/RecordingCutter.h"
+#include "recordings/filesystem/IndexFile.h"
+#include "recordings/marks/Marks.h"
+#include "utils/StringUtils.h"
+
+#include "gtest/gtest.h"
+
+#include <string.h>
+#include <vector>
+
+#define RECORDING         "special://temp/TestRecordingCutter.rec"
+#define EDITED_RECORDING  "special://temp/%TestRecordingCutter.rec"
+#define FRAME_PACKETS     2
+#define GOP_FRAMES        3
+#define FRAMES            30
+#define CUT_TIMEOUT_MS    10000
+
+namespace VDR
+{
+
+namespace
+{
+  void AppendPacket(std::vector<uint8_t>& data, uint16_t pid, bool bPayloadStart, uint8_t counter)
+  {
+    uint8_t packet[TS_SIZE];
+    memset(packet, 0xFF, TS_SIZE);
+    packet[0] = TS_SYNC_BYTE;
+    packet[1] = ((pid >> 8) & TS_PID_MASK_HI) | (bPayloadStart ? TS_PAYLOAD_START : 0);
+    packet[2] = pid & 0xFF;
+    packet[3] = TS_PAYLOAD_EXISTS | counter;
+    data.insert(data.end(), packet, packet + TS_SIZE);
+  }
+
+  std::string DataFile(const std::string& strRecording)
+  {
+    return strRecording + StringUtils::Format(RECORDFILESUFFIXTS, 1);
+  }
+
+  void DeleteRecording(const std::string& strRecording)
+  {
+    CFile::Delete(DataFile(strRecording));
+    CFile::Delete(cIndexFile::IndexFileName(strRecording, false));
+    CFile::Delete(strRecording + MARKSFILESUFFIX);
+    CDirectory::Remove(strRecording);
+  }
+
+  // Video frames of FRAME_PACKETS packets each, every GOP_FRAMES frames is
+  // independent. The payload holds the frame number.
+  bool WriteRecording(std::vector<uint8_t>& data)
+  {
+    cIndexFile index(RECORDING, true);
+    for (unsigned int frame = 0; frame < FRAMES; frame++)
+    {
+      if (!index.Write(frame % GOP_FRAMES == 0, 0, data.size()))
+        return false;
+
+      for (unsigned int i = 0; i < FRAME_PACKETS; i++)
+      {
+        AppendPacket(data, 0x100, i == 0, (frame * FRAME_PACKETS + i) & TS_CONT_CNT_MASK);
+        data[data.size() - TS_SIZE + 4] = frame;
+      }
+    }
+
+    CFile file;
+    return file.OpenForWrite(DataFile(RECORDING), true) && file.Write(data.data(), data.size()) == (int64_t)data.size();
+  }
+
+  bool ReadFile(const std::string& strPath, std::vector<uint8_t>& data)
+  {
+    CFile file;
+    if (!file.Open(strPath))
+      return false;
+
+    data.resize(file.GetLength());
+    return file.Read(data.data(), data.size()) == (int64_t)data.size();
+  }
+}
+
+TEST(RecordingCutter, FixCutIn)
+{
+  std::vector<uint8_t> gop;
+  AppendPacket(gop, 0x000, true,  5); // PAT
+  AppendPacket(gop, 0x101, false, 3); // audio continued from before the cut
+  AppendPacket(gop, 0x100, true,  7); // video, second frame starts here
+  AppendPacket(gop, 0x101, true,  4); // audio
+
+  std::vector<size_t> frameOffsets;
+  frameOffsets.push_back(0);
+  frameOffsets.push_back(2 * TS_SIZE);
+
+  std::vector<uint8_t> result = cRecordingCutter::FixCutIn(gop, frameOffsets);
+  ASSERT_EQ(6 * TS_SIZE, result.size());
+
+  // One marker per PID, in order of appearance
+  const uint16_t pids[] = { 0x000, 0x100, 0x101 };
+  const uint8_t counters[] = { 4, 6, 3 };
+  for (unsigned int i = 0; i < 3; i++)
+  {
+    const uint8_t* p = result.data() + i * TS_SIZE;
+    EXPECT_EQ(pids[i], TsPid(p));
+    EXPECT_FALSE(TsHasPayload(p));
+    EXPECT_TRUE(TsHasAdaptationField(p));
+    EXPECT_EQ(TS_ADAPT_DISCONT, p[5]);
+    EXPECT_EQ(counters[i], TsGetContinuityCounter(p));
+  }
+
+  // The dangling audio packet is dropped
+  EXPECT_EQ(0x000, TsPid(result.data() + 3 * TS_SIZE));
+  EXPECT_EQ(0x100, TsPid(result.data() + 4 * TS_SIZE));
+  EXPECT_EQ(0x101, TsPid(result.data() + 5 * TS_SIZE));
+  EXPECT_EQ(4, TsGetContinuityCounter(result.data() + 5 * TS_SIZE));
+
+  ASSERT_EQ(2, frameOffsets.size());
+  EXPECT_EQ(0, frameOffsets[0]);
+  EXPECT_EQ(4 * TS_SIZE, frameOffsets[1]);
+}
+
+TEST(RecordingCutter, PadCutIn)
+{
+  std::vector<uint8_t> data(7 * TS_SIZE);
+
+  cRecordingCutter::PadCutIn(data, 0, 6 * 2 * TS_SIZE);
+  EXPECT_EQ(6 * 2 * TS_SIZE, data.size());
+  EXPECT_EQ(0x1FFF, TsPid(data.data() + 7 * TS_SIZE));
+
+  // Already aligned
+  data.resize(3 * TS_SIZE);
+  cRecordingCutter::PadCutIn(data, CUTTER_BLOCK_SIZE - 3 * TS_SIZE, 2 * CUTTER_BLOCK_SIZE);
+  EXPECT_EQ(3 * TS_SIZE, data.size());
+
+  // The result follows any earlier output
+  data.resize(TS_SIZE);
+  cRecordingCutter::PadCutIn(data, 100 * TS_SIZE, 1000 * TS_SIZE);
+  EXPECT_EQ(0, (100 * TS_SIZE + (off_t)data.size() - 1000 * TS_SIZE) % CUTTER_BLOCK_SIZE);
+  EXPECT_LE(data.size(), TS_SIZE + CUTTER_BLOCK_SIZE / 4 * TS_SIZE);
+}
+
+TEST(RecordingCutter, Cut)
+{
+  DeleteRecording(RECORDING);
+  DeleteRecording(EDITED_RECORDING);
+  ASSERT_TRUE(CDirectory::Create(RECORDING));
+
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(WriteRecording(data));
+
+  // Frames 3 to 11, and from 18 to the end
+  {
+    cMarks marks;
+    marks.Load(RECORDING);
+    marks.Add(3);
+    marks.Add(12);
+    marks.Add(18);
+    ASSERT_TRUE(marks.Save());
+  }
+
+  cRecordingCutter cutter(RECORDING, EDITED_RECORDING);
+  ASSERT_TRUE(cutter.Start());
+  for (unsigned int i = 0; i < CUT_TIMEOUT_MS / 10 && cutter.Active(); i++)
+    PLATFORM::CEvent::Sleep(10);
+  ASSERT_FALSE(cutter.Active());
+  EXPECT_TRUE(cutter.Error() == NULL);
+
+  std::vector<unsigned int> frames;
+  for (unsigned int frame = 3; frame < 12; frame++)
+    frames.push_back(frame);
+  for (unsigned int frame = 18; frame < FRAMES; frame++)
+    frames.push_back(frame);
+
+  std::vector<uint8_t> edited;
+  ASSERT_TRUE(ReadFile(DataFile(EDITED_RECORDING), edited));
+
+  cIndexFile index(EDITED_RECORDING, false);
+  ASSERT_TRUE(index.Ok());
+  ASSERT_EQ((int)frames.size() - 1, index.Last());
+
+  const size_t frameSize = FRAME_PACKETS * TS_SIZE;
+  for (int i = 0; i <= index.Last(); i++)
+  {
+    const unsigned int frame = frames[i];
+
+    uint16_t fileNumber;
+    off_t offset;
+    bool bIndependent;
+    ASSERT_TRUE(index.Get(i, &fileNumber, &offset, &bIndependent));
+    EXPECT_EQ(frame % GOP_FRAMES == 0, bIndependent);
+
+    // The first frame of a sequence starts with the discontinuity marker
+    if (i == 0 || frames[i - 1] + 1 != frame)
+    {
+      ASSERT_LE(offset + TS_SIZE, (off_t)edited.size());
+      EXPECT_EQ(0x100, TsPid(edited.data() + offset));
+      EXPECT_FALSE(TsHasPayload(edited.data() + offset));
+      offset += TS_SIZE;
+    }
+
+    // The frame itself is unchanged
+    ASSERT_LE(offset + frameSize, edited.size());
+    EXPECT_EQ(0, memcmp(edited.data() + offset, data.data() + frame * frameSize, frameSize)) << "frame " << frame;
+
+    // Copied GOPs keep their alignment within a block
+    if (frame % GOP_FRAMES == 0 && i > 0 && frames[i - 1] + 1 == frame)
+      EXPECT_EQ((frame * frameSize) % CUTTER_BLOCK_SIZE, offset % CUTTER_BLOCK_SIZE) << "frame " << frame;
+  }
+
+  DeleteRecording(RECORDING);
+  DeleteRecording(EDITED_RECORDING);
+}
+
+}
@@ -0,0 +1,119 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "channels/Channel.h"
+#include "filesystem/Directory.h"
+#include "filesystem/File.h"
+#include "filesystem/SpecialProtocol.h"
+#include "recordings/Recording.h"
+#include "recordings/RecordingManager.h"
+#include "recordings/filesystem/IndexFile.h"
+#include "settings/Settings.h"
+#include "utils/CommonMacros.h"
+#include "utils/DateTime.h"
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+#define VIDEO_DIRECTORY  "special://temp/TestRecordingManager"
+#define FOLDER           "Folder"
+
+namespace VDR
+{
+
+namespace
+{
+  bool WriteFile(const std::string& strUrl, size_t size)
+  {
+    CFile file;
+    if (!file.OpenForWrite(strUrl, true))
+      return false;
+
+    std::vector<uint8_t> data(size);
+    return file.Write(data.data(), data.size()) == (int64_t)data.size();
+  }
+
+  std::string Translated(const cRecording& recording)
+  {
+    return CSpecialProtocol::TranslatePath(recording.URL());
+  }
+}
+
+TEST(RecordingManager, FileStats)
+{
+  const std::string strVideoDirectory = cSettings::Get().m_VideoDirectory;
+  cSettings::Get().m_VideoDirectory = VIDEO_DIRECTORY;
+  ASSERT_TRUE(CDirectory::Create(VIDEO_DIRECTORY));
+  ASSERT_TRUE(CDirectory::Create(VIDEO_DIRECTORY "/" FOLDER));
+
+  cRecordingManager& manager = cRecordingManager::Get();
+  const size_t totalFileSizeMB = manager.TotalFileSizeMB();
+
+  ChannelPtr channel = ChannelPtr(new cChannel);
+  channel->SetId(cChannelID(1, 2, 3));
+
+  // An hour long, finished a day ago
+  const CDateTime startTime = CDateTime::GetUTCDateTime() - CDateTimeSpan(1, 1, 0, 0);
+  const CDateTime endTime = startTime + CDateTimeSpan(0, 1, 0, 0);
+
+  RecordingPtr recording = RecordingPtr(new cRecording(FOLDER, "Before", channel, startTime, endTime,
+                                                       CDateTime(), CDateTimeSpan(), 0, 50));
+  ASSERT_TRUE(WriteFile(recording->URL(), MEGABYTE(1)));
+
+  // Add
+  ASSERT_TRUE(manager.AddRecording(recording));
+  EXPECT_EQ((uint64_t)MEGABYTE(1), recording->FileSize());
+  EXPECT_EQ(totalFileSizeMB + 1, manager.TotalFileSizeMB());
+  EXPECT_LT(0, manager.MBperMinute());
+  EXPECT_EQ(recording, manager.GetByFile(Translated(*recording)));
+  EXPECT_EQ(recording, manager.GetByFile(cIndexFile::IndexFileName(Translated(*recording), false)));
+
+  // Rename, the files are examined at their new location
+  cRecording renamed;
+  renamed = *recording;
+  renamed.SetTitle("After");
+  ASSERT_TRUE(WriteFile(renamed.URL(), MEGABYTE(3)));
+
+  const std::string strOldPath = Translated(*recording);
+  ASSERT_TRUE(manager.UpdateRecording(recording->ID(), renamed));
+  EXPECT_EQ((uint64_t)MEGABYTE(3), recording->FileSize());
+  EXPECT_EQ(totalFileSizeMB + 3, manager.TotalFileSizeMB());
+  EXPECT_FALSE(manager.GetByFile(strOldPath));
+  EXPECT_EQ(recording, manager.GetByFile(Translated(*recording)));
+
+  // Delete
+  const std::string strNewPath = Translated(*recording);
+  ASSERT_TRUE(manager.RemoveRecording(recording->ID()));
+  EXPECT_EQ(totalFileSizeMB, manager.TotalFileSizeMB());
+  EXPECT_FALSE(manager.GetByFile(strNewPath));
+  if (totalFileSizeMB == 0)
+  {
+    EXPECT_EQ(-1, manager.MBperMinute());
+  }
+
+  CFile::Delete(strOldPath);
+  CFile::Delete(strNewPath);
+  CDirectory::Remove(VIDEO_DIRECTORY "/" FOLDER);
+  CDirectory::Remove(VIDEO_DIRECTORY);
+  cSettings::Get().m_VideoDirectory = strVideoDirectory;
+}
+
+}
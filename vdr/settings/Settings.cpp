@@ -56,6 +56,7 @@ namespace VDR
 // for easier orientation, this is column 80|
 #define MSG_HELP "Usage: vdr [OPTIONS]\n\n" \
                  "  -c DIR,   --config=DIR   read config files from DIR (default: %s)\n" \
+                 "  -C PATH,  --capture=PATH replay the TS file or directory PATH as a device\n" \
                  "  -d,       --daemon       run in daemon mode\n" \
                  "  -h,       --help         print this help and exit\n" \
                  "  -V,       --version      print version information and exit\n" \
@@ -73,6 +74,8 @@ cSettings::cSettings()
 
   m_ListenPort              = LISTEN_PORT;
   m_StreamTimeout           = 10;
+  m_iServerWorkers          = 0;
+  m_iStreamBatchTime        = 5;
   m_PmtTimeout              = 5;
   m_TimeshiftMode           = (int)TS_MODE_NONE;
   m_TimeshiftBufferSize     = 5;
@@ -82,6 +85,7 @@ cSettings::cSettings()
   m_iLnbFreqLow             =  9750;
   m_iLnbFreqHigh            = 10600;
   m_bDiSEqC                 = false;
+  m_bWarmNeighbours         = false;
   m_bSetSystemTime          = false;
   m_iTimeTransponder        = 0;
   m_iStandardCompliance     = STANDARD_DVB;
@@ -90,6 +94,7 @@ cSettings::cSettings()
   m_iEPGScanTimeout         = 5;
   m_iEPGBugfixLevel         = 3;
   m_iEPGLinger              = 0;
+  m_iEPGSaveInterval        = 60;
   m_iDefaultPriority        = 50;
   m_iDefaultLifetime        = MAXLIFETIME;
   m_bRecordSubtitleName     = true;
@@ -101,6 +106,10 @@ cSettings::cSettings()
   m_EPGLanguages[0]         = -1;
   m_SysLogLevel             = SYS_LOG_DEBUG;
   m_SysLogType              = SYS_LOG_TYPE_CONSOLE;
+  m_bCaptureRealtime        = true;
+  m_bCaptureLoop            = true;
+  m_bCapturePathFromCmdLine = false;
+  m_iMetricsInterval        = 15;
 
   // TODO: Load these paths from settings (assuming they are even used)
   m_VideoDirectory  = "special://home/video";
@@ -238,6 +247,12 @@ bool cSettings::Load(const std::string& strFilename)
   if (GetSettingInt(root, SETTINGS_XML_ELM_STREAM_TIMEOUT, iValue) && iValue > 0)
     m_StreamTimeout = iValue;
 
+  if (GetSettingInt(root, SETTINGS_XML_ELM_SERVER_WORKERS, iValue) && iValue >= 0)
+    m_iServerWorkers = iValue;
+
+  if (GetSettingInt(root, SETTINGS_XML_ELM_STREAM_BATCH_TIME, iValue) && iValue >= 0)
+    m_iStreamBatchTime = iValue;
+
   GetSettingInt(root,      SETTINGS_XML_ELM_PMT_TIMEOUT,                m_PmtTimeout);
   GetSettingInt(root,      SETTINGS_XML_ELM_INSTANT_RECORD_TIME,        m_iInstantRecordTime);
   GetSettingInt(root,      SETTINGS_XML_ELM_DEFAULT_RECORDING_PRIORITY, m_iDefaultPriority);
@@ -253,6 +268,7 @@ bool cSettings::Load(const std::string& strFilename)
   GetSettingInt(root,      SETTINGS_XML_ELM_LNB_FREQ_LOW,               m_iLnbFreqLow);
   GetSettingInt(root,      SETTINGS_XML_ELM_LNB_FREQ_HIGH,              m_iLnbFreqHigh);
   GetSettingBool(root,     SETTINGS_XML_ELM_DISEQC,                     m_bDiSEqC);
+  GetSettingBool(root,     SETTINGS_XML_ELM_WARM_NEIGHBOURS,            m_bWarmNeighbours);
 
   GetSettingBool(root,     SETTINGS_XML_ELM_SET_SYSTEM_TIME,            m_bSetSystemTime);
   GetSettingInt(root,      SETTINGS_XML_ELM_TIME_TRANSPONDER,           m_iTimeTransponder);
@@ -266,6 +282,7 @@ bool cSettings::Load(const std::string& strFilename)
   GetSettingInt(root,      SETTINGS_XML_ELM_EPG_SCAN_TIMEOUT,           m_iEPGScanTimeout);
   GetSettingInt(root,      SETTINGS_XML_ELM_EPG_BUGFIX_LEVEL,           m_iEPGBugfixLevel);
   GetSettingInt(root,      SETTINGS_XML_ELM_EPG_LINGER_TIME,            m_iEPGLinger);
+  GetSettingInt(root,      SETTINGS_XML_ELM_EPG_SAVE_INTERVAL,          m_iEPGSaveInterval);
   if (GetSettingString(root, SETTINGS_XML_ELM_EPG_LANGUAGES, strValue))
     ParseLanguages(strValue.c_str(), m_EPGLanguages);
 
@@ -274,6 +291,16 @@ bool cSettings::Load(const std::string& strFilename)
   GetSettingInt(root,      SETTINGS_XML_ELM_TIMESHIFT_BUFFER_FILE_SIZE, m_TimeshiftBufferFileSize);
   GetSettingString(root,   SETTINGS_XML_ELM_TIMESHIFT_BUFFER_FILE,      m_TimeshiftBufferDir);
 
+  GetSettingString(root,   SETTINGS_XML_ELM_CAPTURE_PATH,               m_CapturePathSetting);
+  if (!m_bCapturePathFromCmdLine)
+    m_CapturePath = m_CapturePathSetting;
+  GetSettingBool(root,     SETTINGS_XML_ELM_CAPTURE_REALTIME,           m_bCaptureRealtime);
+  GetSettingBool(root,     SETTINGS_XML_ELM_CAPTURE_LOOP,               m_bCaptureLoop);
+
+  GetSettingString(root,   SETTINGS_XML_ELM_METRICS_FILE,               m_MetricsFile);
+  GetSettingString(root,   SETTINGS_XML_ELM_METRICS_SOCKET,             m_MetricsSocket);
+  GetSettingInt(root,      SETTINGS_XML_ELM_METRICS_INTERVAL,           m_iMetricsInterval);
+
   if (GetSettingInt(root,  SETTINGS_XML_ELM_SYSLOG_TYPE,                iValue))
     m_SysLogType = (sys_log_type_t)iValue;
 
@@ -296,6 +323,8 @@ bool cSettings::Save(const std::string& strFilename)
 
   SaveSetting(root, SETTINGS_XML_ELM_LISTEN_PORT, (int)m_ListenPort);
   SaveSetting(root, SETTINGS_XML_ELM_STREAM_TIMEOUT, (int)m_StreamTimeout);
+  SaveSetting(root, SETTINGS_XML_ELM_SERVER_WORKERS,             m_iServerWorkers);
+  SaveSetting(root, SETTINGS_XML_ELM_STREAM_BATCH_TIME,          m_iStreamBatchTime);
   SaveSetting(root, SETTINGS_XML_ELM_PMT_TIMEOUT,                m_PmtTimeout);
   SaveSetting(root, SETTINGS_XML_ELM_INSTANT_RECORD_TIME,        m_iInstantRecordTime);
   SaveSetting(root, SETTINGS_XML_ELM_DEFAULT_RECORDING_PRIORITY, m_iDefaultPriority);
@@ -313,6 +342,7 @@ bool cSettings::Save(const std::string& strFilename)
   SaveSetting(root, SETTINGS_XML_ELM_LNB_FREQ_LOW,               m_iLnbFreqLow);
   SaveSetting(root, SETTINGS_XML_ELM_LNB_FREQ_HIGH,              m_iLnbFreqHigh);
   SaveSetting(root, SETTINGS_XML_ELM_DISEQC,                     m_bDiSEqC);
+  SaveSetting(root, SETTINGS_XML_ELM_WARM_NEIGHBOURS,            m_bWarmNeighbours);
 
   SaveSetting(root, SETTINGS_XML_ELM_SET_SYSTEM_TIME,            m_bSetSystemTime);
   SaveSetting(root, SETTINGS_XML_ELM_TIME_TRANSPONDER,           m_iTimeTransponder);
@@ -325,6 +355,7 @@ bool cSettings::Save(const std::string& strFilename)
   SaveSetting(root, SETTINGS_XML_ELM_EPG_SCAN_TIMEOUT,           m_iEPGScanTimeout);
   SaveSetting(root, SETTINGS_XML_ELM_EPG_BUGFIX_LEVEL,           m_iEPGBugfixLevel);
   SaveSetting(root, SETTINGS_XML_ELM_EPG_LINGER_TIME,            m_iEPGLinger);
+  SaveSetting(root, SETTINGS_XML_ELM_EPG_SAVE_INTERVAL,          m_iEPGSaveInterval);
   SaveSetting(root, SETTINGS_XML_ELM_EPG_LANGUAGES,              StoreLanguages(m_EPGLanguages));
 
   SaveSetting(root, SETTINGS_XML_ELM_TIMESHIFT_MODE,             m_TimeshiftMode);
@@ -332,6 +363,14 @@ bool cSettings::Save(const std::string& strFilename)
   SaveSetting(root, SETTINGS_XML_ELM_TIMESHIFT_BUFFER_FILE_SIZE, m_TimeshiftBufferFileSize);
   SaveSetting(root, SETTINGS_XML_ELM_TIMESHIFT_BUFFER_FILE,      m_TimeshiftBufferDir);
 
+  SaveSetting(root, SETTINGS_XML_ELM_CAPTURE_PATH,               m_bCapturePathFromCmdLine ? m_CapturePathSetting : m_CapturePath);
+  SaveSetting(root, SETTINGS_XML_ELM_CAPTURE_REALTIME,           m_bCaptureRealtime);
+  SaveSetting(root, SETTINGS_XML_ELM_CAPTURE_LOOP,               m_bCaptureLoop);
+
+  SaveSetting(root, SETTINGS_XML_ELM_METRICS_FILE,               m_MetricsFile);
+  SaveSetting(root, SETTINGS_XML_ELM_METRICS_SOCKET,             m_MetricsSocket);
+  SaveSetting(root, SETTINGS_XML_ELM_METRICS_INTERVAL,           m_iMetricsInterval);
+
   if (!strFilename.empty())
     m_strFilename = strFilename;
 
@@ -360,6 +399,7 @@ bool cSettings::LoadFromCmdLine(int argc, char *argv[])
   static struct option long_options[] =
     {
       { "config",    required_argument, NULL, 'c' },
+      { "capture",   required_argument, NULL, 'C' },
       { "daemon",    no_argument,       NULL, 'd' },
       { "help",      no_argument,       NULL, 'h' },
       { "version",   no_argument,       NULL, 'V' },
@@ -367,7 +407,7 @@ bool cSettings::LoadFromCmdLine(int argc, char *argv[])
     };
 
   int c;
-  while ((c = getopt_long(argc, argv, "c:d:h:V",
+  while ((c = getopt_long(argc, argv, "c:C:d:h:V",
       long_options, NULL)) != -1)
   {
     switch (c)
@@ -376,6 +416,11 @@ bool cSettings::LoadFromCmdLine(int argc, char *argv[])
     case 'c':
       m_ConfigDirectory = optarg;
       break;
+    // capture
+    case 'C':
+      m_CapturePath = optarg;
+      m_bCapturePathFromCmdLine = true;
+      break;
     // daemon
     case 'd':
       m_DaemonMode = true;
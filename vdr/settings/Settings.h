@@ -76,6 +76,8 @@ public:
   // Remote server settings
   uint16_t            m_ListenPort;         // Port of remote server
   uint16_t            m_StreamTimeout;      // timeout in seconds for stream data
+  int                 m_iServerWorkers;     // serve clients from an epoll loop with this many threads, 0 = one thread per client
+  int                 m_iStreamBatchTime;   // ms small stream packets may wait to share a write, 0 = send each right away
 
   int                 m_PmtTimeout;
   int                 m_TimeshiftMode;
@@ -94,6 +96,7 @@ public:
   int                 m_iLnbFreqLow;
   int                 m_iLnbFreqHigh;
   bool                m_bDiSEqC;
+  bool                m_bWarmNeighbours;    // keep idle tuners locked to the channels next to the ones being watched
 
   bool                m_bSetSystemTime;
   int                 m_iTimeTransponder;
@@ -110,6 +113,17 @@ public:
   int                 m_iEPGScanTimeout;
   int                 m_iEPGBugfixLevel;
   int                 m_iEPGLinger;
+  int                 m_iEPGSaveInterval;   // seconds to collect EPG changes before they're written
+
+  // File-backed capture device (replays TS files instead of /dev/dvb)
+  std::string         m_CapturePath;        // TS file, or directory with one capture per transponder
+  bool                m_bCaptureRealtime;   // throttle playback to the capture's PCR clock
+  bool                m_bCaptureLoop;       // restart from the beginning at EOF
+
+  // Runtime metrics in Prometheus text format
+  std::string         m_MetricsFile;        // file rewritten every interval, or empty
+  std::string         m_MetricsSocket;      // local socket serving a snapshot per connection, or empty
+  int                 m_iMetricsInterval;   // seconds between updates of the metrics file
 private:
   cSettings();
   bool SetKeepCaps(bool On);
@@ -133,6 +147,8 @@ private:
   bool           m_HasStdin;
   struct termios m_savedTm;
   std::string    m_strFilename;
+  std::string    m_CapturePathSetting;        // m_CapturePath as stored in the settings file
+  bool           m_bCapturePathFromCmdLine;   // --capture overrides it for this run only
 };
 
 }
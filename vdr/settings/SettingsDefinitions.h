@@ -30,6 +30,8 @@
 #define SETTINGS_XML_ELM_TIME_TRANSPONDER              "time_transponder"
 #define SETTINGS_XML_ELM_UPDATE_CHANNELS_LEVEL         "update_channels"
 #define SETTINGS_XML_ELM_STREAM_TIMEOUT                "stream_timeout"
+#define SETTINGS_XML_ELM_SERVER_WORKERS                "server_workers"
+#define SETTINGS_XML_ELM_STREAM_BATCH_TIME             "stream_batch_time"
 #define SETTINGS_XML_ELM_PMT_TIMEOUT                   "pmt_timeout"
 #define SETTINGS_XML_ELM_STANDARD_COMPLIANCE           "standard_compliance"
 #define SETTINGS_XML_ELM_RESUME_ID                     "resume_id"
@@ -51,10 +53,12 @@
 #define SETTINGS_XML_ELM_LNB_FREQ_LOW                  "lnb_freq_low"
 #define SETTINGS_XML_ELM_LNB_FREQ_HIGH                 "lnb_freq_high"
 #define SETTINGS_XML_ELM_DISEQC                        "diseqc"
+#define SETTINGS_XML_ELM_WARM_NEIGHBOURS               "warm_neighbours"
 
 #define SETTINGS_XML_ELM_EPG_SCAN_TIMEOUT              "epg_scan_timeout"
 #define SETTINGS_XML_ELM_EPG_BUGFIX_LEVEL              "epg_bugfix_level"
 #define SETTINGS_XML_ELM_EPG_LINGER_TIME               "epg_linger_time"
+#define SETTINGS_XML_ELM_EPG_SAVE_INTERVAL             "epg_save_interval"
 #define SETTINGS_XML_ELM_EPG_LANGUAGES                 "epg_languages"
 
 #define SETTINGS_XML_ELM_TIMESHIFT_MODE                "timeshift_mode"
@@ -62,6 +66,14 @@
 #define SETTINGS_XML_ELM_TIMESHIFT_BUFFER_FILE_SIZE    "timeshift_buffer_file_size"
 #define SETTINGS_XML_ELM_TIMESHIFT_BUFFER_FILE         "timeshift_buffer_dir"
 
+#define SETTINGS_XML_ELM_CAPTURE_PATH                  "capture_path"
+#define SETTINGS_XML_ELM_CAPTURE_REALTIME              "capture_realtime"
+#define SETTINGS_XML_ELM_CAPTURE_LOOP                  "capture_loop"
+
+#define SETTINGS_XML_ELM_METRICS_FILE                  "metrics_file"
+#define SETTINGS_XML_ELM_METRICS_SOCKET                "metrics_socket"
+#define SETTINGS_XML_ELM_METRICS_INTERVAL              "metrics_interval"
+
 #define HOSTS_XML_ROOT                                 "hosts"
 #define HOSTS_XML_ELM_HOST                             "host"
 #define HOSTS_XML_ATTR_IP                              "ip"
@@ -0,0 +1,112 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "BenchmarkStage.h"
+#include "utils/StringUtils.h"
+
+#include <algorithm>
+#include <time.h>
+
+namespace VDR
+{
+
+cBenchmarkStage::cBenchmarkStage(const std::string& strName)
+ : m_strName(strName),
+   m_strSampleName("latency"),
+   m_packets(0),
+   m_bytes(0),
+   m_wallStart(0),
+   m_cpuStart(0),
+   m_wallNs(0),
+   m_cpuNs(0),
+   m_bSorted(true)
+{
+}
+
+void cBenchmarkStage::Start(void)
+{
+  m_wallStart = MonotonicNs();
+  m_cpuStart  = CpuNs();
+}
+
+void cBenchmarkStage::Stop(void)
+{
+  Stop(MonotonicNs());
+}
+
+void cBenchmarkStage::Stop(uint64_t wallEndNs)
+{
+  m_wallNs += wallEndNs - m_wallStart;
+  m_cpuNs  += CpuNs() - m_cpuStart;
+}
+
+uint64_t cBenchmarkStage::Percentile(double fraction)
+{
+  if (m_samples.empty())
+    return 0;
+
+  if (!m_bSorted)
+  {
+    std::sort(m_samples.begin(), m_samples.end());
+    m_bSorted = true;
+  }
+
+  size_t index = (size_t)(fraction * (m_samples.size() - 1) + 0.5);
+  return m_samples[std::min(index, m_samples.size() - 1)];
+}
+
+std::string cBenchmarkStage::ToJson(void)
+{
+  const double wall  = WallSeconds();
+  const double cpu   = CpuSeconds();
+  const double mbits = m_bytes * 8 / 1e6;
+
+  std::string json = StringUtils::Format("{ \"name\": %s, ", StringUtils::Paramify(m_strName).c_str());
+  if (!m_strError.empty())
+    json += StringUtils::Format("\"error\": %s, ", StringUtils::Paramify(m_strError).c_str());
+
+  json += StringUtils::Format("\"packets\": %llu, \"bytes\": %llu, \"wall_s\": %.6f, \"cpu_s\": %.6f, ",
+      (unsigned long long)m_packets, (unsigned long long)m_bytes, wall, cpu);
+  json += StringUtils::Format("\"packets_per_s\": %.1f, \"bytes_per_s\": %.1f, \"cpu_ms_per_mbit\": %.6f, ",
+      wall > 0 ? m_packets / wall : 0.0,
+      wall > 0 ? m_bytes / wall : 0.0,
+      mbits > 0 ? cpu * 1000 / mbits : 0.0);
+  json += StringUtils::Format("\"%s_us\": { \"samples\": %llu, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f } }",
+      m_strSampleName.c_str(), (unsigned long long)m_samples.size(),
+      Percentile(0.50) / 1e3, Percentile(0.90) / 1e3, Percentile(0.99) / 1e3, Percentile(1.0) / 1e3);
+
+  return json;
+}
+
+uint64_t cBenchmarkStage::MonotonicNs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+uint64_t cBenchmarkStage::CpuNs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+}
@@ -0,0 +1,100 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace VDR
+{
+
+/*!
+ * \brief Measures one stage of the TS pipeline
+ *
+ * A stage is timed between Start() and Stop(). Wall clock and process CPU time
+ * are taken at both ends, so CPU spent on helper threads (receiver, recorder)
+ * is included. Individual calls into the stage are recorded with AddSample()
+ * and reported as latency percentiles, unless the samples measure something
+ * else and were renamed with SetSampleName().
+ */
+class cBenchmarkStage
+{
+public:
+  cBenchmarkStage(const std::string& strName);
+
+  const std::string& Name(void) const { return m_strName; }
+
+  void Start(void);
+  void Stop(void);
+
+  /*!
+   * \brief Stop the stage at an earlier time, e.g. to exclude idle polling
+   * \param wallEndNs End of the stage as returned by MonotonicNs(). CPU time is
+   *        still taken now.
+   */
+  void Stop(uint64_t wallEndNs);
+
+  void AddPackets(uint64_t packets, uint64_t bytes) { m_packets += packets; m_bytes += bytes; }
+  void AddSample(uint64_t latencyNs) { m_samples.push_back(latencyNs); m_bSorted = false; }
+
+  /*!
+   * \brief Name the samples are reported as, "latency" by default
+   */
+  void SetSampleName(const std::string& strName) { m_strSampleName = strName; }
+
+  /*!
+   * \brief Note a problem with the stage. Failed stages are still reported.
+   */
+  void SetError(const std::string& strError) { m_strError = strError; }
+
+  double WallSeconds(void) const { return m_wallNs / 1e9; }
+  double CpuSeconds(void) const { return m_cpuNs / 1e9; }
+
+  /*!
+   * \brief Get the latency below which the given fraction of samples fall
+   * \param fraction Value in the range [0.0, 1.0]
+   * \return The latency in nanoseconds, or 0 if no samples were taken
+   */
+  uint64_t Percentile(double fraction);
+
+  /*!
+   * \brief Serialise the results as a JSON object
+   */
+  std::string ToJson(void);
+
+  static uint64_t MonotonicNs(void);
+  static uint64_t CpuNs(void);
+
+private:
+  const std::string     m_strName;
+  std::string           m_strError;
+  std::string           m_strSampleName;
+  uint64_t              m_packets;
+  uint64_t              m_bytes;
+  uint64_t              m_wallStart;
+  uint64_t              m_cpuStart;
+  uint64_t              m_wallNs;
+  uint64_t              m_cpuNs;
+  std::vector<uint64_t> m_samples;
+  bool                  m_bSorted;
+};
+
+}
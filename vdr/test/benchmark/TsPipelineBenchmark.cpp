@@ -0,0 +1,676 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Throughput benchmark for the TS pipeline. A capture is replayed through each
+ * stage separately and the results are written as JSON, so they can be compared
+ * between commits:
+ *
+ *   bench-vdr.bin [--output=results.json] [--label=<commit>] capture.ts
+ *
+ * Stages:
+ *   dispatch           cFileDevice -> cDeviceReceiverSubsystem -> iReceiver
+ *   parser             cTSStream/cParser* for every stream of the first program
+ *   frame_detector     cFrameDetector::Analyze()
+ *   recorder           cRecorder, including its ring buffer and file writes
+ *   videobuffer_simple cVideoBufferSimple ReceivePacket() and Read()
+ *   videobuffer_ram    cVideoBufferRAM Receive() and Read()
+ *   videobuffer_file   cVideoBufferFile Receive() and Read()
+ */
+
+#include "BenchmarkStage.h"
+#include "channels/Channel.h"
+#include "devices/Receiver.h"
+#include "devices/Remux.h"
+#include "devices/file/FileDevice.h"
+#include "devices/file/subsystems/FileReceiverSubsystem.h"
+#include "devices/subsystems/DeviceReceiverSubsystem.h"
+#include "filesystem/File.h"
+#include "lib/platform/threads/mutex.h"
+#include "recordings/Recorder.h"
+#include "recordings/Recording.h"
+#include "settings/Settings.h"
+#include "utils/CommonMacros.h"
+#include "utils/DateTime.h"
+#include "utils/StringUtils.h"
+#include "utils/log/Log.h"
+#include "utils/url/URLUtils.h"
+#include "vnsi/video/VideoBuffer.h"
+#include "vnsi/video/parser/Parser.h"
+
+#include <getopt.h>
+#include <libsi/si.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace PLATFORM;
+using namespace VDR;
+
+#define DEFAULT_STAGES        "dispatch,parser,frame_detector,recorder,videobuffer_simple,videobuffer_ram,videobuffer_file"
+#define DEFAULT_WORKDIR       "/tmp"
+
+#define BENCHMARK_CLIENT_ID   0xBE
+#define DISPATCH_TIMEOUT_MS   120000
+#define RECORDER_POLL_MS      10
+#define RECORDER_IDLE_POLLS   20     // Recorder is drained after 200ms without writes
+#define RECORDER_CHUNK        348    // Packets per burst, same as a file device read
+#define VIDEOBUFFER_IN_FLIGHT ((size_t)(MEGABYTE(4) / TS_SIZE)) // Unread packets, half the file buffer's staging
+#define VIDEOBUFFER_POLL_MS   1
+#define VIDEOBUFFER_IDLE_MS   500    // Video buffer is drained after 500ms without reads
+
+namespace
+{
+
+struct sCapture
+{
+  std::string          strPath;
+  std::vector<uint8_t> data;     // Synchronised TS packets
+  ChannelPtr           channel;  // Streams of the first program in the PMT
+
+  size_t Packets(void) const { return data.size() / TS_SIZE; }
+  const uint8_t* Packet(size_t i) const { return data.data() + i * TS_SIZE; }
+};
+
+// --- Capture -----------------------------------------------------------------
+
+bool LoadCapture(const std::string& strPath, sCapture& capture)
+{
+  std::vector<uint8_t> buffer;
+  CFile file;
+  if (!file.LoadFile(strPath, buffer))
+  {
+    fprintf(stderr, "failed to read capture '%s'\n", strPath.c_str());
+    return false;
+  }
+
+  size_t offset = 0;
+  while (offset + TS_SIZE < buffer.size() &&
+         !(buffer[offset] == TS_SYNC_BYTE && buffer[offset + TS_SIZE] == TS_SYNC_BYTE))
+    offset++;
+
+  const size_t packets = (buffer.size() - offset) / TS_SIZE;
+  if (packets == 0)
+  {
+    fprintf(stderr, "capture '%s' doesn't contain any TS packets\n", strPath.c_str());
+    return false;
+  }
+
+  capture.strPath = strPath;
+  capture.data.assign(buffer.begin() + offset, buffer.begin() + offset + packets * TS_SIZE);
+
+  cPatPmtParser patPmtParser;
+  if (!patPmtParser.ParsePatPmt(capture.data.data(), capture.data.size()))
+  {
+    fprintf(stderr, "capture '%s' doesn't contain a PAT and PMT\n", strPath.c_str());
+    return false;
+  }
+
+  VideoStream videoStream;
+  videoStream.vpid  = patPmtParser.Vpid();
+  videoStream.vtype = patPmtParser.Vtype();
+  videoStream.ppid  = patPmtParser.Ppid();
+
+  std::vector<AudioStream> audioStreams;
+  for (int i = 0; patPmtParser.Apid(i); i++)
+  {
+    AudioStream stream;
+    stream.apid  = patPmtParser.Apid(i);
+    stream.atype = patPmtParser.Atype(i);
+    stream.alang = patPmtParser.Alang(i);
+    audioStreams.push_back(stream);
+  }
+
+  std::vector<DataStream> dataStreams;
+  for (int i = 0; patPmtParser.Dpid(i); i++)
+  {
+    DataStream stream;
+    stream.dpid  = patPmtParser.Dpid(i);
+    stream.dtype = patPmtParser.Dtype(i);
+    stream.dlang = patPmtParser.Dlang(i);
+    dataStreams.push_back(stream);
+  }
+
+  std::vector<SubtitleStream> subtitleStreams;
+  for (int i = 0; patPmtParser.Spid(i); i++)
+  {
+    SubtitleStream stream;
+    stream.spid              = patPmtParser.Spid(i);
+    stream.slang             = patPmtParser.Slang(i);
+    stream.subtitlingType    = patPmtParser.SubtitlingType(i);
+    stream.compositionPageId = patPmtParser.CompositionPageId(i);
+    stream.ancillaryPageId   = patPmtParser.AncillaryPageId(i);
+    subtitleStreams.push_back(stream);
+  }
+
+  capture.channel = ChannelPtr(new cChannel);
+  capture.channel->SetStreams(videoStream, audioStreams, dataStreams, subtitleStreams, TeletextStream());
+
+  return true;
+}
+
+// --- cCountingReceiver -------------------------------------------------------
+
+/*!
+ * Counts the packets dispatched by a file device and records the time from
+ * reading each packet out of the capture until it arrived
+ */
+class cCountingReceiver : public iReceiver
+{
+public:
+  cCountingReceiver(cBenchmarkStage& stage, const cFileReceiverSubsystem* source, uint64_t expected)
+   : m_stage(stage),
+     m_source(source),
+     m_expected(expected),
+     m_received(0),
+     m_bDone(false)
+  {
+  }
+
+  virtual bool Start(void) { return true; }
+  virtual void Stop(void) { }
+
+  virtual void Receive(const uint16_t pid, const uint8_t* data, const size_t len, ts_crc_check_t& crcvalid)
+  {
+    // Called on the receiver thread, right after the packet was read
+    m_stage.AddSample(cBenchmarkStage::MonotonicNs() - m_source->PacketReadNs());
+    m_stage.AddPackets(1, len);
+    if (++m_received == m_expected)
+    {
+      CLockObject lock(m_mutex);
+      m_bDone = true;
+      m_condition.Signal();
+    }
+  }
+
+  bool WaitForPackets(uint32_t iTimeoutMs)
+  {
+    CLockObject lock(m_mutex);
+    return m_condition.Wait(m_mutex, m_bDone, iTimeoutMs);
+  }
+
+private:
+  cBenchmarkStage&              m_stage;
+  const cFileReceiverSubsystem* m_source;
+  const uint64_t                m_expected;
+  uint64_t                      m_received;
+  CMutex                        m_mutex;
+  CCondition<bool>              m_condition;
+  bool                          m_bDone;
+};
+
+// --- Stages ------------------------------------------------------------------
+
+bool RunDispatch(const sCapture& capture, cBenchmarkStage& stage)
+{
+  const std::set<uint16_t> pids = capture.channel->GetPids();
+
+  uint64_t expected = 0;
+  for (size_t i = 0; i < capture.Packets(); i++)
+  {
+    if (pids.find(TsPid(capture.Packet(i))) != pids.end())
+      expected++;
+  }
+
+  if (expected == 0)
+  {
+    stage.SetError("capture doesn't contain any packets of the first program");
+    return false;
+  }
+
+  cFileDevice device(capture.strPath, false, false);
+  if (!device.Initialise(0))
+  {
+    stage.SetError("failed to initialise the capture device");
+    return false;
+  }
+
+  // The samples are the dispatch latency, from reading a packet to Receive()
+  device.FileReceiver()->SetTimestamps(true);
+  cCountingReceiver receiver(stage, device.FileReceiver(), expected);
+  for (std::set<uint16_t>::const_iterator it = pids.begin(); it != pids.end(); ++it)
+    device.Receiver()->AttachMultiplexedReceiver(&receiver, *it);
+  device.Receiver()->SyncPids(true);
+
+  stage.Start();
+  device.FileReceiver()->SetCapture(capture.strPath);
+  const bool bFinished = receiver.WaitForPackets(DISPATCH_TIMEOUT_MS);
+  stage.Stop();
+
+  device.Receiver()->DetachAllReceivers(true);
+  device.Deinitialise();
+
+  if (!bFinished)
+    stage.SetError("timed out waiting for the capture to be dispatched");
+
+  return bFinished;
+}
+
+bool RunParser(const sCapture& capture, cBenchmarkStage& stage)
+{
+  const ChannelPtr& channel = capture.channel;
+
+  sPtsWrap ptsWrap;
+  memset(&ptsWrap, 0, sizeof(sPtsWrap));
+
+  std::vector<cTSStream*> streams(MAXPID, NULL);
+
+  if (channel->GetVideoStream().vpid)
+  {
+    const VideoStream& stream = channel->GetVideoStream();
+    streams[stream.vpid] = new cTSStream(stream.vtype == STREAM_TYPE_14496_H264_VIDEO ? stH264 : stMPEG2VIDEO, stream.vpid, &ptsWrap);
+  }
+
+  for (std::vector<DataStream>::const_iterator it = channel->GetDataStreams().begin(); it != channel->GetDataStreams().end(); ++it)
+  {
+    eStreamType type = (it->dtype == (STREAM_TYPE)SI::EnhancedAC3DescriptorTag) ? stEAC3 : stAC3;
+    streams[it->dpid] = new cTSStream(type, it->dpid, &ptsWrap);
+  }
+
+  for (std::vector<AudioStream>::const_iterator it = channel->GetAudioStreams().begin(); it != channel->GetAudioStreams().end(); ++it)
+  {
+    eStreamType type = stMPEG2AUDIO;
+    if (it->atype == STREAM_TYPE_13818_AUDIO_ADTS)
+      type = stAACADTS;
+    else if (it->atype == STREAM_TYPE_14496_AUDIO_LATM)
+      type = stAACLATM;
+    streams[it->apid] = new cTSStream(type, it->apid, &ptsWrap);
+  }
+
+  for (std::vector<SubtitleStream>::const_iterator it = channel->GetSubtitleStreams().begin(); it != channel->GetSubtitleStreams().end(); ++it)
+    streams[it->spid] = new cTSStream(stDVBSUB, it->spid, &ptsWrap);
+
+  // Parsers take a mutable packet
+  std::vector<uint8_t> data(capture.data);
+  sStreamPacket        packet;
+  unsigned int         frames = 0;
+  unsigned int         errors = 0;
+
+  stage.Start();
+  for (size_t i = 0; i < capture.Packets(); i++)
+  {
+    uint8_t* ts = data.data() + i * TS_SIZE;
+    cTSStream* stream = streams[TsPid(ts)];
+    if (!stream)
+      continue;
+
+    const uint64_t start = cBenchmarkStage::MonotonicNs();
+    memset(&packet, 0, sizeof(sStreamPacket));
+    int result = stream->ProcessTSPacket(ts, &packet, false);
+    stage.AddSample(cBenchmarkStage::MonotonicNs() - start);
+    stage.AddPackets(1, TS_SIZE);
+
+    if (result == 0)
+      frames++;
+    else if (result < 0)
+      errors++;
+  }
+  stage.Stop();
+
+  for (std::vector<cTSStream*>::iterator it = streams.begin(); it != streams.end(); ++it)
+    delete *it;
+
+  dsyslog("parser: %u frames, %u errors", frames, errors);
+  if (frames == 0)
+    stage.SetError("no frames were parsed");
+
+  return frames > 0;
+}
+
+bool RunFrameDetector(const sCapture& capture, cBenchmarkStage& stage)
+{
+  cFrameDetector frameDetector(capture.channel);
+
+  const uint8_t* data   = capture.data.data();
+  const int      length = capture.data.size();
+  int            pos    = 0;
+  unsigned int   frames = 0;
+
+  stage.Start();
+  while (length - pos >= MIN_TS_PACKETS_FOR_FRAME_DETECTOR * TS_SIZE)
+  {
+    const uint64_t start = cBenchmarkStage::MonotonicNs();
+    int count = frameDetector.Analyze(data + pos, length - pos);
+    stage.AddSample(cBenchmarkStage::MonotonicNs() - start);
+    if (count <= 0)
+      break;
+
+    if (frameDetector.NewFrame())
+      frames++;
+
+    stage.AddPackets(count / TS_SIZE, count);
+    pos += count;
+  }
+  stage.Stop();
+
+  dsyslog("frame_detector: %u frames", frames);
+  if (!frameDetector.Synced())
+    stage.SetError("frame detector didn't sync");
+
+  return frameDetector.Synced();
+}
+
+bool RunRecorder(const sCapture& capture, const std::string& strWorkDir, cBenchmarkStage& stage)
+{
+  cSettings::Get().m_VideoDirectory = strWorkDir;
+
+  const CDateTime now = CDateTime::GetUTCDateTime();
+  cRecording recording("", StringUtils::Format("benchmark-%d", getpid()), capture.channel, now, now + CDateTimeSpan(0, 1, 0, 0));
+
+  const std::string strRecording = recording.URL();
+  bool bSuccess = true;
+
+  {
+    cRecorder recorder(&recording);
+
+    stage.Start();
+    if (!recorder.Start())
+    {
+      stage.Stop();
+      stage.SetError("failed to start the recorder");
+      return false;
+    }
+
+    ts_crc_check_t crcCheck = TS_CRC_NOT_CHECKED;
+    for (size_t i = 0; i < capture.Packets(); i += RECORDER_CHUNK)
+    {
+      const uint64_t start = cBenchmarkStage::MonotonicNs();
+      for (size_t j = i; j < i + RECORDER_CHUNK && j < capture.Packets(); j++)
+        recorder.Receive(TsPid(capture.Packet(j)), capture.Packet(j), TS_SIZE, crcCheck);
+      stage.AddSample(cBenchmarkStage::MonotonicNs() - start);
+    }
+
+    // Wait until the recorder thread stops writing
+    int64_t lastSize = -1;
+    unsigned int idlePolls = 0;
+    uint64_t lastWrite = cBenchmarkStage::MonotonicNs();
+    while (idlePolls < RECORDER_IDLE_POLLS)
+    {
+      usleep(RECORDER_POLL_MS * 1000);
+
+      struct __stat64 st;
+      int64_t size = CFile::Stat(strRecording, &st) == 0 ? st.st_size : 0;
+      if (size != lastSize)
+      {
+        lastSize = size;
+        lastWrite = cBenchmarkStage::MonotonicNs();
+        idlePolls = 0;
+      }
+      else
+        idlePolls++;
+    }
+
+    // Don't count the idle polls after the last write
+    stage.Stop(lastWrite);
+
+    recorder.Stop();
+
+    stage.AddPackets(lastSize / TS_SIZE, lastSize);
+    dsyslog("recorder: last write seen %.3f s before the recorder was stopped",
+        (cBenchmarkStage::MonotonicNs() - lastWrite) / 1e9);
+
+    if (lastSize <= 0)
+    {
+      stage.SetError("recorder didn't write any data");
+      bSuccess = false;
+    }
+  }
+
+  CFile::Delete(strRecording);
+
+  return bSuccess;
+}
+
+// Read the packets the video buffer has available, but no more than the
+// unread ones it received: the live buffer waits 100ms for more when empty
+size_t ReadVideoBuffer(cVideoBuffer& buffer, cBenchmarkStage& stage, size_t unread)
+{
+  uint8_t* data;
+  time_t endTime = 0;
+  time_t wrapTime = 0;
+  size_t count = 0;
+  while (count < unread && buffer.Read(&data, TS_SIZE, endTime, wrapTime) == TS_SIZE)
+  {
+    stage.AddPackets(1, TS_SIZE);
+    count++;
+  }
+  return count;
+}
+
+// Read until target of the received packets were read, or until no packet
+// arrived for VIDEOBUFFER_IDLE_MS. Returns false in the latter case.
+bool WaitForVideoBuffer(cVideoBuffer& buffer, cBenchmarkStage& stage, size_t target, size_t received, size_t& read, uint64_t& lastRead)
+{
+  while (read < target)
+  {
+    const size_t count = ReadVideoBuffer(buffer, stage, received - read);
+    if (count > 0)
+    {
+      read += count;
+      lastRead = cBenchmarkStage::MonotonicNs();
+    }
+    else if (cBenchmarkStage::MonotonicNs() - lastRead > VIDEOBUFFER_IDLE_MS * 1000000ULL)
+      return false;
+    else
+      usleep(VIDEOBUFFER_POLL_MS * 1000);
+  }
+  return true;
+}
+
+bool RunVideoBuffer(const sCapture& capture, int timeshiftMode, const std::string& strWorkDir, cBenchmarkStage& stage)
+{
+  cSettings::Get().m_TimeshiftMode           = timeshiftMode;
+  cSettings::Get().m_TimeshiftBufferSize     = 1; // 100 MB
+  cSettings::Get().m_TimeshiftBufferFileSize = 1; // 1 GB
+  cSettings::Get().m_TimeshiftBufferDir      = strWorkDir;
+
+  cVideoBuffer* buffer = cVideoBuffer::Create(BENCHMARK_CLIENT_ID, 1);
+  if (!buffer)
+  {
+    stage.SetError("failed to create the video buffer");
+    return false;
+  }
+
+  ts_crc_check_t crcCheck = TS_CRC_NOT_CHECKED;
+  TsPacketBlockPtr block;
+  size_t read = 0;
+  uint64_t lastRead = 0;
+
+  // The file buffer writes on its own thread and packets can only be read
+  // once they're on disk. The feed waits while too many packets are unread,
+  // so its staging buffer doesn't overflow, and the stage ends with the last
+  // packet that was read back, so writes are measured end to end.
+  stage.Start();
+  lastRead = cBenchmarkStage::MonotonicNs();
+  for (size_t i = 0; i < capture.Packets(); i++)
+  {
+    const uint64_t start = cBenchmarkStage::MonotonicNs();
+    if (buffer->ReceivesPackets())
+    {
+      // Share the packet like the receiver subsystem does
+      if (!block || block->Full())
+        block = cTsPacketBlockPool::Get().Allocate();
+      buffer->ReceivePacket(TsPid(capture.Packet(i)), cTsPacketRef(block, block->Append(capture.Packet(i))));
+    }
+    else
+    {
+      buffer->Receive(TsPid(capture.Packet(i)), capture.Packet(i), TS_SIZE, crcCheck);
+    }
+
+    const size_t count = ReadVideoBuffer(*buffer, stage, i + 1 - read);
+    if (count > 0)
+    {
+      read += count;
+      lastRead = cBenchmarkStage::MonotonicNs();
+    }
+    if (i + 1 - read > VIDEOBUFFER_IN_FLIGHT && !WaitForVideoBuffer(*buffer, stage, i + 1 - VIDEOBUFFER_IN_FLIGHT, i + 1, read, lastRead))
+    {
+      stage.Stop();
+      stage.SetError("video buffer stopped returning packets");
+      delete buffer;
+      return false;
+    }
+    stage.AddSample(cBenchmarkStage::MonotonicNs() - start);
+  }
+
+  // The buffers keep a margin of unread data, so the last packets may never
+  // be returned
+  WaitForVideoBuffer(*buffer, stage, capture.Packets(), capture.Packets(), read, lastRead);
+  stage.Stop(lastRead);
+
+  dsyslog("videobuffer: %lu of %lu packets read back", (unsigned long)read, (unsigned long)capture.Packets());
+
+  delete buffer;
+
+  return true;
+}
+
+// --- main --------------------------------------------------------------------
+
+void DisplayHelp(const char* strExecutable)
+{
+  printf("Usage: %s [OPTIONS] CAPTURE\n\n", strExecutable);
+  printf("Replays the MPEG-TS file CAPTURE through the TS pipeline and reports the\n");
+  printf("throughput of every stage as JSON\n\n");
+  printf("  -o FILE,  --output=FILE   write the results to FILE instead of stdout\n");
+  printf("  -s LIST,  --stages=LIST   comma separated list of stages to run\n");
+  printf("                            (default: %s)\n", DEFAULT_STAGES);
+  printf("  -w DIR,   --workdir=DIR   directory for recordings and timeshift buffers\n");
+  printf("                            (default: %s)\n", DEFAULT_WORKDIR);
+  printf("  -l LABEL, --label=LABEL   label to include in the results, e.g. a commit\n");
+  printf("  -v,       --verbose       log debug messages\n");
+  printf("  -h,       --help          display this help and exit\n");
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+  std::string strOutput;
+  std::string strStages = DEFAULT_STAGES;
+  std::string strWorkDir = DEFAULT_WORKDIR;
+  std::string strLabel;
+  bool        bVerbose = false;
+
+  static struct option long_options[] =
+    {
+      { "output",    required_argument, NULL, 'o' },
+      { "stages",    required_argument, NULL, 's' },
+      { "workdir",   required_argument, NULL, 'w' },
+      { "label",     required_argument, NULL, 'l' },
+      { "verbose",   no_argument,       NULL, 'v' },
+      { "help",      no_argument,       NULL, 'h' },
+      { NULL,        no_argument,       NULL, 0 }
+    };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "o:s:w:l:vh", long_options, NULL)) != -1)
+  {
+    switch (c)
+    {
+    case 'o': strOutput  = optarg; break;
+    case 's': strStages  = optarg; break;
+    case 'w': strWorkDir = optarg; break;
+    case 'l': strLabel   = optarg; break;
+    case 'v': bVerbose   = true;   break;
+    case 'h':
+      DisplayHelp(argv[0]);
+      return 0;
+    default:
+      DisplayHelp(argv[0]);
+      return 2;
+    }
+  }
+
+  if (optind != argc - 1)
+  {
+    DisplayHelp(argv[0]);
+    return 2;
+  }
+
+  // Log messages go to stdout, keep them out of the results
+  cSettings::Get().m_SysLogLevel = bVerbose ? SYS_LOG_DEBUG : SYS_LOG_ERROR;
+
+  sCapture capture;
+  if (!LoadCapture(argv[optind], capture))
+    return 1;
+
+  std::vector<std::string> stages;
+  StringUtils::Tokenize(strStages, stages, ",");
+
+  std::vector<cBenchmarkStage*> results;
+  bool bSuccess = true;
+  for (std::vector<std::string>::const_iterator it = stages.begin(); it != stages.end(); ++it)
+  {
+    cBenchmarkStage* stage = new cBenchmarkStage(*it);
+    results.push_back(stage);
+
+    if (*it == "dispatch")
+      bSuccess &= RunDispatch(capture, *stage);
+    else if (*it == "parser")
+      bSuccess &= RunParser(capture, *stage);
+    else if (*it == "frame_detector")
+      bSuccess &= RunFrameDetector(capture, *stage);
+    else if (*it == "recorder")
+      bSuccess &= RunRecorder(capture, strWorkDir, *stage);
+    else if (*it == "videobuffer_simple")
+      bSuccess &= RunVideoBuffer(capture, TS_MODE_NONE, strWorkDir, *stage);
+    else if (*it == "videobuffer_ram")
+      bSuccess &= RunVideoBuffer(capture, TS_MODE_RAM, strWorkDir, *stage);
+    else if (*it == "videobuffer_file")
+      bSuccess &= RunVideoBuffer(capture, TS_MODE_FILE, strWorkDir, *stage);
+    else
+    {
+      stage->SetError("unknown stage");
+      bSuccess = false;
+    }
+  }
+
+  std::string json = "{\n";
+  json += StringUtils::Format("  \"label\": %s,\n", StringUtils::Paramify(strLabel).c_str());
+  json += StringUtils::Format("  \"capture\": %s,\n", StringUtils::Paramify(URLUtils::GetFileName(capture.strPath)).c_str());
+  json += StringUtils::Format("  \"packets\": %lu,\n", (unsigned long)capture.Packets());
+  json += StringUtils::Format("  \"bytes\": %lu,\n", (unsigned long)capture.data.size());
+  json += "  \"stages\": [\n";
+  for (std::vector<cBenchmarkStage*>::iterator it = results.begin(); it != results.end(); ++it)
+  {
+    json += "    " + (*it)->ToJson();
+    json += (it + 1 != results.end()) ? ",\n" : "\n";
+    delete *it;
+  }
+  json += "  ]\n}\n";
+
+  if (strOutput.empty())
+  {
+    fputs(json.c_str(), stdout);
+  }
+  else
+  {
+    CFile output;
+    if (!output.OpenForWrite(strOutput, true) || output.Write(json.c_str(), json.size()) != (int64_t)json.size())
+    {
+      fprintf(stderr, "failed to write results to '%s'\n", strOutput.c_str());
+      return 1;
+    }
+  }
+
+  return bSuccess ? 0 : 1;
+}
@@ -22,6 +22,8 @@
 #include "TimerManager.h"
 #include "Timer.h"
 #include "TimerDefinitions.h"
+#include "channels/Channel.h"
+#include "devices/DeviceManager.h"
 #include "utils/DateTime.h"
 #include "utils/log/Log.h"
 #include "utils/StringUtils.h"
@@ -30,6 +32,10 @@
 #include <algorithm>
 #include <assert.h>
 #include <limits.h>
+#include <utility>
+
+// Time until a timer whose recording couldn't be started is tried again
+#define TIMER_RETRY_INTERVAL  30 // seconds
 
 using namespace PLATFORM;
 using namespace std;
@@ -37,6 +43,23 @@ using namespace std;
 namespace VDR
 {
 
+namespace
+{
+  struct sOccurrenceEdge
+  {
+    sOccurrenceEdge(const CDateTime& time, int delta, int transponder) : time(time), delta(delta), transponder(transponder) { }
+
+    CDateTime time;
+    int       delta;       // 1 at the start of an occurrence, -1 at its end
+    int       transponder;
+
+    bool operator<(const sOccurrenceEdge& rhs) const
+    {
+      return time < rhs.time || (time == rhs.time && delta < rhs.delta);
+    }
+  };
+}
+
 cTimerManager::cTimerManager(void)
  : m_maxID(TIMER_INVALID_ID)
 {
@@ -73,27 +96,49 @@ void* cTimerManager::Process(void)
   {
     const CDateTime now = CDateTime::GetUTCDateTime();
 
-    TimerVector idleTimers = GetIdleTimers(now);
-    if (idleTimers.empty())
+    // Take the timers that are due off the heap
+    TimerVector dueTimers;
     {
-      m_timerNotifyEvent.Wait();
-      continue;
+      CLockObject lock(m_mutex);
+      std::vector<unsigned int> due = m_schedule.PopDue(now);
+      for (std::vector<unsigned int>::const_iterator it = due.begin(); it != due.end(); ++it)
+        dueTimers.push_back(GetByID(*it));
     }
 
-    // Sort timers for greedy processing
-    std::sort(idleTimers.begin(), idleTimers.end(), cTimerSorter(now));
-
     // Start occurring timers
-    TimerVector::iterator itTimer = idleTimers.begin();
-    while (itTimer != idleTimers.end() && (*itTimer)->IsOccurring(now))
-      (*itTimer++)->StartRecording();
+    for (TimerVector::const_iterator it = dueTimers.begin(); it != dueTimers.end(); ++it)
+      (*it)->StartRecording();
 
-    // Sleep until first pending timer
-    if (itTimer != idleTimers.end())
+    bool bIdle = true;
+    CDateTimeSpan waitTime;
     {
-      CDateTimeSpan waitTime = (*itTimer)->GetSortOccurrence(now) - now;
-      m_timerNotifyEvent.Wait(std::min(ULONG_MAX, (unsigned long)waitTime.GetSecondsTotal() * 1000));
+      CLockObject lock(m_mutex);
+
+      // Schedule the next time these timers need attention, unless they were
+      // changed or removed meanwhile
+      for (TimerVector::const_iterator it = dueTimers.begin(); it != dueTimers.end(); ++it)
+      {
+        const TimerPtr& timer = *it;
+        if (GetByID(timer->ID()) != timer || m_schedule.IsScheduled(timer->ID()))
+          continue;
+
+        if (timer->IsActive() && timer->IsOccurring(now) && !timer->IsRecording(now))
+          m_schedule.Schedule(timer->ID(), now + CDateTimeSpan(0, 0, 0, TIMER_RETRY_INTERVAL));
+        else
+          ScheduleTimer(timer, now);
+      }
+
+      CDateTime due;
+      bIdle = !m_schedule.NextDue(due);
+      if (!bIdle)
+        waitTime = due - now;
     }
+
+    // Sleep until the next timer is due
+    if (bIdle)
+      m_timerNotifyEvent.Wait();
+    else if (waitTime.GetSecondsTotal() > 0)
+      m_timerNotifyEvent.Wait(std::min(ULONG_MAX, (unsigned long)waitTime.GetSecondsTotal() * 1000));
   }
   return NULL;
 }
@@ -104,14 +149,16 @@ bool cTimerManager::AddTimer(const TimerPtr& newTimer)
   {
     CLockObject lock(m_mutex);
 
-    for (TimerMap::const_iterator it = m_timers.begin(); it != m_timers.end(); ++it)
-      if (it->second->Conflicts(*newTimer))
-        return false;
+    if (newTimer->IsActive() && HasConflict(*newTimer))
+      return false;
 
     newTimer->SetID(++m_maxID);
     newTimer->RegisterObserver(this);
     m_timers.insert(std::make_pair(newTimer->ID(), newTimer));
 
+    ScheduleTimer(newTimer, CDateTime::GetUTCDateTime());
+    m_timerNotifyEvent.Broadcast();
+
     SetChanged();
 
     return true;
@@ -155,15 +202,14 @@ bool cTimerManager::UpdateTimer(unsigned int id, const cTimer& updatedTimer)
   TimerPtr timer = GetByID(id);
   if (timer)
   {
-    // If timer is being enabled, check for conflicts
-    if (!timer->IsActive() && updatedTimer.IsActive())
-    {
-      for (TimerMap::const_iterator it = m_timers.begin(); it != m_timers.end(); ++it)
-        if (it->second->Conflicts(updatedTimer))
-          return false;
-    }
+    // If timer is being enabled, check that a tuner is left for it
+    if (!timer->IsActive() && updatedTimer.IsActive() && HasConflict(updatedTimer, id))
+      return false;
 
     *timer = updatedTimer;
+    ScheduleTimer(timer, CDateTime::GetUTCDateTime());
+    m_timerNotifyEvent.Broadcast();
+
     timer->NotifyObservers();
     return true;
   }
@@ -186,6 +232,7 @@ bool cTimerManager::RemoveTimer(unsigned int id, bool bInterruptRecording)
     }
 
     it->second->UnregisterObserver(this);
+    m_schedule.Unschedule(it->first);
     m_timers.erase(it);
 
     SetChanged();
@@ -196,27 +243,122 @@ bool cTimerManager::RemoveTimer(unsigned int id, bool bInterruptRecording)
   return false;
 }
 
-TimerVector cTimerManager::GetIdleTimers(const CDateTime& now) const
+bool cTimerManager::HasConflict(const cTimer& timer) const
 {
-  CLockObject lock(m_mutex);
+  return HasConflict(timer, timer.ID());
+}
 
-  TimerVector idleTimers;
-  for (TimerMap::const_iterator it = m_timers.begin(); it != m_timers.end(); ++it)
+bool cTimerManager::HasConflict(const cTimer& timer, unsigned int id) const
+{
+  const size_t tuners = std::max((size_t)1, cDeviceManager::Get().DeviceCount());
+
+  TimerVector others;
   {
-    const TimerPtr& timer = it->second;
-    if (  // (1) Timer is active
-          timer->IsActive() &&
-          // (2) Timer is idle
-          !timer->IsRecording(now) &&
-          // (3) Timer is not expired
-          !timer->IsExpired(now)
-       )
+    CLockObject lock(m_mutex);
+    for (TimerMap::const_iterator it = m_timers.begin(); it != m_timers.end(); ++it)
     {
-      idleTimers.push_back(it->second);
+      if (it->first != id)
+        others.push_back(it->second);
     }
   }
 
-  return idleTimers;
+  return HasConflict(timer, others, tuners, CDateTime::GetUTCDateTime());
+}
+
+bool cTimerManager::HasConflict(const cTimer& timer, const TimerVector& timers, size_t tuners, const CDateTime& now)
+{
+  if (!timer.Channel() || timer.IsExpired(now))
+    return false;
+
+  const cTransponder& transponder = timer.Channel()->GetTransponder();
+
+  // Start and end of every occurrence. Occurrences of timer are marked with
+  // transponder -1, other timers with the index of their transponder.
+  std::vector<sOccurrenceEdge> edges;
+
+  const CDateTime first = timer.GetSortOccurrence(now);
+  CDateTime horizon;
+  for (cTimer::const_iterator occurrence(first, first + timer.Duration(), timer.Expires(), timer.WeekdayMask());
+       occurrence != timer.end(); ++occurrence)
+  {
+    edges.push_back(sOccurrenceEdge(occurrence.StartTime(), 1, -1));
+    edges.push_back(sOccurrenceEdge(occurrence.EndTime(), -1, -1));
+    horizon = occurrence.EndTime();
+  }
+
+  std::vector<const cTransponder*> transponders;
+  for (TimerVector::const_iterator it = timers.begin(); it != timers.end(); ++it)
+  {
+    const cTimer& other = **it;
+    if (!other.IsActive() || !other.Channel() || other.IsExpired(now))
+      continue;
+
+    // Timers on the same transponder as timer can share its tuner
+    const cTransponder& otherTransponder = other.Channel()->GetTransponder();
+    if (otherTransponder == transponder)
+      continue;
+
+    int index = 0;
+    while (index < (int)transponders.size() && !(*transponders[index] == otherTransponder))
+      index++;
+    if (index == (int)transponders.size())
+      transponders.push_back(&otherTransponder);
+
+    const CDateTime otherFirst = other.GetSortOccurrence(now);
+    for (cTimer::const_iterator occurrence(otherFirst, otherFirst + other.Duration(), other.Expires(), other.WeekdayMask());
+         occurrence != other.end() && occurrence.StartTime() < horizon; ++occurrence)
+    {
+      edges.push_back(sOccurrenceEdge(occurrence.StartTime(), 1, index));
+      edges.push_back(sOccurrenceEdge(occurrence.EndTime(), -1, index));
+    }
+  }
+
+  if (transponders.size() < tuners)
+    return false;
+
+  // Recordings ending at a time free their tuner before others start
+  std::sort(edges.begin(), edges.end());
+
+  std::vector<int> recordings(transponders.size(), 0);
+  size_t busyTuners = 0;
+  int    occurring  = 0;
+  for (std::vector<sOccurrenceEdge>::const_iterator edge = edges.begin(); edge != edges.end(); ++edge)
+  {
+    if (edge->transponder < 0)
+    {
+      occurring += edge->delta;
+    }
+    else
+    {
+      int& count = recordings[edge->transponder];
+      if (edge->delta > 0 && count++ == 0)
+        busyTuners++;
+      else if (edge->delta < 0 && --count == 0)
+        busyTuners--;
+    }
+
+    if (edge->delta > 0 && occurring > 0 && busyTuners >= tuners)
+      return true;
+  }
+
+  return false;
+}
+
+void cTimerManager::ScheduleTimer(const TimerPtr& timer, const CDateTime& now)
+{
+  if (!timer->IsActive() || timer->IsExpired(now))
+  {
+    m_schedule.Unschedule(timer->ID());
+    return;
+  }
+
+  const CDateTime occurrence = timer->GetSortOccurrence(now);
+  if (occurrence > now)
+    m_schedule.Schedule(timer->ID(), occurrence);
+  else if (timer->IsRecording(now))
+    m_schedule.Schedule(timer->ID(), occurrence + timer->Duration());
+  else
+    m_schedule.Schedule(timer->ID(), now);
 }
 
 void cTimerManager::Notify(const Observable& obs, const ObservableMessage msg)
@@ -224,8 +366,22 @@ void cTimerManager::Notify(const Observable& obs, const ObservableMessage msg)
   switch (msg)
   {
   case ObservableMessageTimerChanged:
+  {
+    // A timer was modified through its setters
+    const cTimer* timer = dynamic_cast<const cTimer*>(&obs);
+    if (timer)
+    {
+      CLockObject lock(m_mutex);
+      TimerPtr changedTimer = GetByID(timer->ID());
+      if (changedTimer)
+      {
+        ScheduleTimer(changedTimer, CDateTime::GetUTCDateTime());
+        m_timerNotifyEvent.Broadcast();
+      }
+    }
     SetChanged();
     break;
+  }
   default:
     break;
   }
@@ -259,6 +415,7 @@ bool cTimerManager::LoadTimers(const std::string& file)
 {
   CLockObject lock(m_mutex);
   m_timers.clear();
+  m_schedule.Clear();
 
   CXBMCTinyXML xmlDoc;
   if (!xmlDoc.LoadFile(file.c_str()))
@@ -287,6 +444,7 @@ bool cTimerManager::LoadTimers(const std::string& file)
         m_maxID = timer->ID();
 
       m_timers.insert(make_pair(timer->ID(), timer));
+      ScheduleTimer(timer, CDateTime::GetUTCDateTime());
     }
 
     node = node->NextSibling(TIMER_XML_ELM_TIMER);
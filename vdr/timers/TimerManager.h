@@ -20,17 +20,20 @@
  */
 #pragma once
 
+#include "TimerSchedule.h"
 #include "TimerTypes.h"
 #include "lib/platform/threads/threads.h"
 #include "lib/platform/threads/mutex.h"
+#include "utils/DateTime.h"
 #include "utils/Observer.h"
+
+#include <map>
 #include <string>
+#include <vector>
 
 namespace VDR
 {
 
-class CDateTime;
-
 class cTimerManager : protected PLATFORM::CThread,
                       public Observer,
                       public Observable
@@ -44,9 +47,8 @@ public:
 
   /*!
    * Add a timer and assign it an ID. Fails if newTimer already has a valid
-   * ID, if newTimer's properties are invalid, or if newTimer has a time
-   * conflict with an active timer. (TODO: Allow conflicting timers to support
-   * multiple devices.)
+   * ID, if newTimer's properties are invalid, or if there's no tuner left to
+   * record newTimer, see HasConflict().
    *
    * Returns true if newTimer is added. As a side effect, newTimer will be
    * assigned a valid ID.
@@ -64,7 +66,7 @@ public:
    * Update the timer with the given ID. The ID of updatedTimer is ignored.
    *
    * Returns false if there is no timer with the given ID, or an attempt to
-   * activate a disabled timer causes a time conflict with another active timer.
+   * activate a disabled timer leaves no tuner to record it.
    * Returns true otherwise (even if no properties are modified).
    */
   bool UpdateTimer(unsigned int id, const cTimer& updatedTimer);
@@ -76,13 +78,23 @@ public:
    */
   bool RemoveTimer(unsigned int id, bool bInterruptRecording);
 
+  /*!
+   * Returns true if timer can't be recorded because, during one of its
+   * remaining occurrences, active timers already occupy all tuners. Timers on
+   * the same transponder share a tuner, timers without a channel are ignored.
+   * The occurrences of all timers from now on are swept once, in time order.
+   */
+  bool HasConflict(const cTimer& timer) const;
+  static bool HasConflict(const cTimer& timer, const TimerVector& timers, size_t tuners, const CDateTime& now);
+
   virtual void Notify(const Observable& obs, const ObservableMessage msg);
   void NotifyObservers(void);
 
 protected:
   /*!
-   * Start recordings when timers are triggered. Timers are sorted in order of
-   * increasing start time and processed greedily.
+   * Start recordings when timers are triggered. Timers are kept in a heap
+   * ordered by the time they need attention next, so each wake-up only
+   * touches the timers that are due.
    */
   virtual void* Process(void);
 
@@ -94,17 +106,25 @@ private:
   cTimerManager(void);
 
   /*!
-   * Get a vector of timers for processing. Includes timers that are:
-   *   (1) Active
-   *   (2) Idle (not recording)
-   *   (3) Not expired
+   * (Re)schedule the timer for the next time it needs attention:
+   *   - Pending:   start of the next occurrence
+   *   - Occurring: now, or the end of the occurrence if already recording
+   *   - Expired or inactive: never
+   * Must be called with m_mutex held.
    */
-  TimerVector GetIdleTimers(const CDateTime& now) const;
+  void ScheduleTimer(const TimerPtr& timer, const CDateTime& now);
+
+  /*!
+   * HasConflict() for a timer that replaces the timer with the given ID
+   */
+  bool HasConflict(const cTimer& timer, unsigned int id) const;
 
   TimerMap         m_timers;      // ID -> timer
   unsigned int     m_maxID;       // Monotonically increasing timer ID
   std::string      m_strFilename; // timers.xml filename
 
+  cTimerSchedule   m_schedule;
+
   PLATFORM::CMutex m_mutex;
   PLATFORM::CEvent m_timerNotifyEvent;
 };
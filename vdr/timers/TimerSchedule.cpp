@@ -0,0 +1,108 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "TimerSchedule.h"
+
+#include <algorithm>
+
+namespace VDR
+{
+
+void cTimerSchedule::Schedule(unsigned int id, const CDateTime& due)
+{
+  // Invalidates the timer's previous event
+  sTimerEvent event = { due, id, ++m_generation };
+  m_generations[id] = event.generation;
+
+  m_events.push_back(event);
+  std::push_heap(m_events.begin(), m_events.end());
+
+  // Drop stale events once they outnumber the valid ones
+  if (m_events.size() > 2 * m_generations.size() + 16)
+  {
+    std::vector<sTimerEvent> events;
+    for (std::vector<sTimerEvent>::const_iterator it = m_events.begin(); it != m_events.end(); ++it)
+    {
+      if (IsCurrent(*it))
+        events.push_back(*it);
+    }
+    std::make_heap(events.begin(), events.end());
+    m_events.swap(events);
+  }
+}
+
+void cTimerSchedule::Unschedule(unsigned int id)
+{
+  m_generations.erase(id);
+}
+
+bool cTimerSchedule::IsScheduled(unsigned int id) const
+{
+  return m_generations.find(id) != m_generations.end();
+}
+
+std::vector<unsigned int> cTimerSchedule::PopDue(const CDateTime& now)
+{
+  std::vector<unsigned int> due;
+  while (!m_events.empty() && m_events.front().due <= now)
+  {
+    const sTimerEvent event = m_events.front();
+    Pop();
+
+    if (IsCurrent(event))
+    {
+      m_generations.erase(event.id);
+      due.push_back(event.id);
+    }
+  }
+  return due;
+}
+
+bool cTimerSchedule::NextDue(CDateTime& due)
+{
+  while (!m_events.empty() && !IsCurrent(m_events.front()))
+    Pop();
+
+  if (m_events.empty())
+    return false;
+
+  due = m_events.front().due;
+  return true;
+}
+
+void cTimerSchedule::Clear(void)
+{
+  m_events.clear();
+  m_generations.clear();
+}
+
+bool cTimerSchedule::IsCurrent(const sTimerEvent& event) const
+{
+  std::map<unsigned int, unsigned int>::const_iterator it = m_generations.find(event.id);
+  return it != m_generations.end() && it->second == event.generation;
+}
+
+void cTimerSchedule::Pop(void)
+{
+  std::pop_heap(m_events.begin(), m_events.end());
+  m_events.pop_back();
+}
+
+}
@@ -0,0 +1,86 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "utils/DateTime.h"
+
+#include <map>
+#include <vector>
+
+namespace VDR
+{
+
+/*!
+ * Timer IDs ordered by the time they need attention next. Events aren't
+ * removed from the heap when a timer is rescheduled or unscheduled; the old
+ * event is recognised as stale by its generation and skipped. Not thread
+ * safe, the owner serialises access.
+ */
+class cTimerSchedule
+{
+public:
+  cTimerSchedule(void) : m_generation(0) { }
+
+  /*!
+   * Schedule the timer at due, replacing its previous event
+   */
+  void Schedule(unsigned int id, const CDateTime& due);
+  void Unschedule(unsigned int id);
+  bool IsScheduled(unsigned int id) const;
+
+  /*!
+   * Take the timers that are due at now off the heap, earliest first. They
+   * are no longer scheduled afterwards.
+   */
+  std::vector<unsigned int> PopDue(const CDateTime& now);
+
+  /*!
+   * Time of the earliest scheduled event. Returns false if no timer is
+   * scheduled.
+   */
+  bool NextDue(CDateTime& due);
+
+  void Clear(void);
+
+  /*!
+   * Number of events in the heap, including stale ones
+   */
+  size_t Size(void) const { return m_events.size(); }
+
+private:
+  struct sTimerEvent
+  {
+    CDateTime    due;
+    unsigned int id;
+    unsigned int generation;
+
+    // Earliest event on top of the heap
+    bool operator<(const sTimerEvent& rhs) const { return due > rhs.due; }
+  };
+
+  bool IsCurrent(const sTimerEvent& event) const;
+  void Pop(void);
+
+  std::vector<sTimerEvent>             m_events;      // Heap of timer events
+  std::map<unsigned int, unsigned int> m_generations; // ID -> generation of the timer's valid event
+  unsigned int                         m_generation;
+};
+
+}
@@ -0,0 +1,101 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "channels/Channel.h"
+#include "timers/Timer.h"
+#include "timers/TimerManager.h"
+#include "transponders/Transponder.h"
+#include "utils/DateTime.h"
+
+#include "gtest/gtest.h"
+
+namespace VDR
+{
+
+namespace
+{
+  const CDateTimeSpan TEST_ONE_HOUR = CDateTimeSpan(0, 1, 0, 0);
+  const CDateTimeSpan TEST_ONE_DAY  = CDateTimeSpan(1, 0, 0, 0);
+
+  ChannelPtr MakeChannel(unsigned int frequencyMHz)
+  {
+    cTransponder transponder(TRANSPONDER_ATSC);
+    transponder.SetFrequencyMHz(frequencyMHz);
+
+    ChannelPtr channel = ChannelPtr(new cChannel);
+    channel->SetTransponder(transponder);
+    return channel;
+  }
+
+  TimerPtr MakeTimer(const CDateTime& start, int hours, const ChannelPtr& channel, bool bActive = true)
+  {
+    return TimerPtr(new cTimer(start, start + CDateTimeSpan(0, hours, 0, 0), 0, start, channel, "", bActive));
+  }
+}
+
+TEST(TimerManager, HasConflict)
+{
+  const CDateTime now   = CDateTime::GetUTCDateTime();
+  const CDateTime start = now + TEST_ONE_HOUR;
+
+  const ChannelPtr channelA = MakeChannel(500);
+  const ChannelPtr channelB = MakeChannel(600);
+  const ChannelPtr channelC = MakeChannel(700);
+
+  const cTimer timer(start, start + CDateTimeSpan(0, 2, 0, 0), 0, start, channelA);
+
+  // Recordings on timer's transponder share its tuner
+  TimerVector timers;
+  timers.push_back(MakeTimer(start, 2, channelA));
+  EXPECT_FALSE(cTimerManager::HasConflict(timer, timers, 1, now));
+
+  // Recordings on another transponder need one tuner between them
+  timers.push_back(MakeTimer(start, 1, channelB));
+  timers.push_back(MakeTimer(start, 2, channelB));
+  EXPECT_TRUE(cTimerManager::HasConflict(timer, timers, 1, now));
+  EXPECT_FALSE(cTimerManager::HasConflict(timer, timers, 2, now));
+
+  // A third transponder only counts while timer is occurring
+  timers.push_back(MakeTimer(start + CDateTimeSpan(0, 2, 0, 0), 1, channelC));
+  EXPECT_FALSE(cTimerManager::HasConflict(timer, timers, 2, now));
+  timers.push_back(MakeTimer(start + TEST_ONE_HOUR, 1, channelC));
+  EXPECT_TRUE(cTimerManager::HasConflict(timer, timers, 2, now));
+  EXPECT_FALSE(cTimerManager::HasConflict(timer, timers, 3, now));
+
+  // Disabled timers, timers without a channel and past occurrences don't
+  // occupy a tuner
+  timers.clear();
+  timers.push_back(MakeTimer(start, 2, channelB, false));
+  timers.push_back(MakeTimer(start, 2, ChannelPtr()));
+  timers.push_back(MakeTimer(now - CDateTimeSpan(0, 3, 0, 0), 2, channelB));
+  EXPECT_FALSE(cTimerManager::HasConflict(timer, timers, 1, now));
+
+  // Later occurrences of a repeating timer are checked too
+  const cTimer daily(start, start + TEST_ONE_HOUR, 0x7f, start + CDateTimeSpan(6, 0, 0, 0), channelA);
+  timers.clear();
+  timers.push_back(MakeTimer(start + CDateTimeSpan(3, 0, 0, 0), 1, channelB));
+  EXPECT_TRUE(cTimerManager::HasConflict(daily, timers, 1, now));
+  EXPECT_FALSE(cTimerManager::HasConflict(daily, timers, 2, now));
+
+  // Timers without a channel can't be recorded, but don't conflict either
+  EXPECT_FALSE(cTimerManager::HasConflict(cTimer(), timers, 1, now));
+}
+
+}
@@ -0,0 +1,83 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "timers/TimerSchedule.h"
+#include "utils/DateTime.h"
+
+#include "gtest/gtest.h"
+
+namespace VDR
+{
+
+TEST(TimerSchedule, Order)
+{
+  const CDateTime now = CDateTime::GetUTCDateTime();
+
+  cTimerSchedule schedule;
+  CDateTime due;
+  EXPECT_FALSE(schedule.NextDue(due));
+
+  schedule.Schedule(1, now + CDateTimeSpan(0, 0, 0, 3));
+  schedule.Schedule(2, now + CDateTimeSpan(0, 0, 0, 1));
+  schedule.Schedule(3, now + CDateTimeSpan(0, 0, 0, 2));
+  ASSERT_TRUE(schedule.NextDue(due));
+  EXPECT_TRUE(due == now + CDateTimeSpan(0, 0, 0, 1));
+
+  // Due timers come off the heap earliest first
+  std::vector<unsigned int> ids = schedule.PopDue(now + CDateTimeSpan(0, 0, 0, 2));
+  ASSERT_EQ(2u, ids.size());
+  EXPECT_EQ(2u, ids[0]);
+  EXPECT_EQ(3u, ids[1]);
+  EXPECT_FALSE(schedule.IsScheduled(2));
+  EXPECT_TRUE(schedule.IsScheduled(1));
+}
+
+TEST(TimerSchedule, Generations)
+{
+  const CDateTime now = CDateTime::GetUTCDateTime();
+
+  cTimerSchedule schedule;
+  CDateTime due;
+
+  // Rescheduling invalidates the previous event
+  schedule.Schedule(1, now + CDateTimeSpan(0, 0, 0, 1));
+  schedule.Schedule(1, now + CDateTimeSpan(0, 0, 0, 5));
+  EXPECT_TRUE(schedule.PopDue(now + CDateTimeSpan(0, 0, 0, 2)).empty());
+  ASSERT_TRUE(schedule.NextDue(due));
+  EXPECT_TRUE(due == now + CDateTimeSpan(0, 0, 0, 5));
+
+  // So does unscheduling
+  schedule.Unschedule(1);
+  EXPECT_FALSE(schedule.IsScheduled(1));
+  EXPECT_FALSE(schedule.NextDue(due));
+  EXPECT_TRUE(schedule.PopDue(now + CDateTimeSpan(0, 0, 0, 10)).empty());
+
+  // Stale events are dropped before they pile up
+  for (int i = 0; i < 1000; i++)
+  {
+    schedule.Schedule(7, now + CDateTimeSpan(0, 0, 0, i));
+    EXPECT_GE(18u, schedule.Size());
+  }
+  std::vector<unsigned int> ids = schedule.PopDue(now + CDateTimeSpan(0, 0, 0, 1000));
+  ASSERT_EQ(1u, ids.size());
+  EXPECT_EQ(7u, ids[0]);
+}
+
+}
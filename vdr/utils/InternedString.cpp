@@ -0,0 +1,147 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "InternedString.h"
+#include "lib/platform/threads/mutex.h"
+
+#include <unordered_map>
+
+using namespace PLATFORM;
+
+namespace VDR
+{
+
+struct cInternedString::sEntry
+{
+  const std::string* str;  // The pool's key
+  unsigned int       refs;
+};
+
+namespace
+{
+  typedef std::unordered_map<std::string, cInternedString::sEntry> StringPool;
+
+  // Node size of the pool: key, entry, cached hash and next pointer
+  const size_t POOL_NODE_OVERHEAD = sizeof(StringPool::value_type) + 2 * sizeof(void*);
+
+  // The pool and its mutex are never freed. Static owners of interned
+  // strings, like the schedule manager, can be destroyed after them at exit
+  StringPool& Pool(void)
+  {
+    static StringPool* pool = new StringPool;
+    return *pool;
+  }
+
+  CMutex& PoolMutex(void)
+  {
+    static CMutex* mutex = new CMutex;
+    return *mutex;
+  }
+}
+
+cInternedString::cInternedString(const std::string& str)
+ : m_entry(Acquire(str))
+{
+}
+
+cInternedString::cInternedString(const cInternedString& other)
+ : m_entry(other.m_entry)
+{
+  Acquire(m_entry);
+}
+
+cInternedString::~cInternedString(void)
+{
+  Release(m_entry);
+}
+
+cInternedString& cInternedString::operator=(const cInternedString& rhs)
+{
+  if (m_entry != rhs.m_entry)
+  {
+    Acquire(rhs.m_entry);
+    Release(m_entry);
+    m_entry = rhs.m_entry;
+  }
+  return *this;
+}
+
+cInternedString& cInternedString::operator=(const std::string& rhs)
+{
+  if (Str() != rhs)
+  {
+    sEntry* entry = Acquire(rhs);
+    Release(m_entry);
+    m_entry = entry;
+  }
+  return *this;
+}
+
+const std::string& cInternedString::Str(void) const
+{
+  static const std::string empty;
+  return m_entry ? *m_entry->str : empty;
+}
+
+void cInternedString::PoolUsage(size_t& count, size_t& bytes)
+{
+  CLockObject lock(PoolMutex());
+
+  const StringPool& pool = Pool();
+  count = pool.size();
+  bytes = pool.bucket_count() * sizeof(void*);
+  for (StringPool::const_iterator it = pool.begin(); it != pool.end(); ++it)
+    bytes += POOL_NODE_OVERHEAD + it->first.capacity();
+}
+
+cInternedString::sEntry* cInternedString::Acquire(const std::string& str)
+{
+  if (str.empty())
+    return NULL;
+
+  CLockObject lock(PoolMutex());
+
+  // Elements of an unordered_map keep their address until they're erased
+  StringPool::value_type& node = *Pool().insert(std::make_pair(str, sEntry())).first;
+  node.second.str = &node.first;
+  node.second.refs++;
+  return &node.second;
+}
+
+void cInternedString::Acquire(sEntry* entry)
+{
+  if (entry)
+  {
+    CLockObject lock(PoolMutex());
+    entry->refs++;
+  }
+}
+
+void cInternedString::Release(sEntry* entry)
+{
+  if (entry)
+  {
+    CLockObject lock(PoolMutex());
+    if (--entry->refs == 0)
+      Pool().erase(Pool().find(*entry->str));
+  }
+}
+
+}
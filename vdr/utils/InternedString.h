@@ -0,0 +1,66 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+namespace VDR
+{
+
+/*!
+ * Reference counted handle to a string stored once in a global pool. Used for
+ * EPG text, where titles and descriptions repeat across a series and reruns.
+ * A handle is the size of a pointer, the empty string doesn't use the pool.
+ */
+class cInternedString
+{
+public:
+  cInternedString(void) : m_entry(NULL) { }
+  cInternedString(const std::string& str);
+  cInternedString(const cInternedString& other);
+  ~cInternedString(void);
+
+  cInternedString& operator=(const cInternedString& rhs);
+  cInternedString& operator=(const std::string& rhs);
+
+  bool operator==(const cInternedString& rhs) const { return m_entry == rhs.m_entry; }
+  bool operator!=(const cInternedString& rhs) const { return m_entry != rhs.m_entry; }
+
+  const std::string& Str(void) const;
+  bool empty(void) const { return m_entry == NULL; }
+
+  /*!
+   * \brief Number of distinct strings in the pool and their approximate size
+   *        in bytes, including the pool's overhead
+   */
+  static void PoolUsage(size_t& count, size_t& bytes);
+
+  struct sEntry;
+
+private:
+  static sEntry* Acquire(const std::string& str);
+  static void Acquire(sEntry* entry);
+  static void Release(sEntry* entry);
+
+  sEntry* m_entry;
+};
+
+}
@@ -60,6 +60,10 @@ cRingBuffer::~cRingBuffer()
 
 void cRingBuffer::UpdatePercentage(int Fill)
 {
+  if (fillMetric)
+     fillMetric->Set(Fill);
+  if (!statistics)
+     return;
   if (Fill > maxFill)
      maxFill = Fill;
   int percent = Fill * 100 / (Size() - 1) / PERCENTAGEDELTA * PERCENTAGEDELTA; // clamp down to nearest quantum
@@ -113,8 +117,16 @@ void cRingBuffer::SetIoThrottle(void)
      ioThrottle = new PLATFORM::cIoThrottle;
 }
 
+void cRingBuffer::SetMetrics(const MetricGaugePtr &Fill, const MetricCounterPtr &Overflow)
+{
+  fillMetric = Fill;
+  overflowMetric = Overflow;
+}
+
 void cRingBuffer::ReportOverflow(int Bytes)
 {
+  if (overflowMetric)
+     overflowMetric->Add(Bytes);
   overflowCount++;
   overflowBytes += Bytes;
   if (time(NULL) - lastOverflowReport > OVERFLOWREPORTDELTA) {
@@ -259,7 +271,7 @@ int cRingBufferLinear::Read(int FileHandle, int Max)
         if (Head >= Size())
            Head = margin;
         head = Head;
-        if (statistics) {
+        if (statistics || fillMetric) {
            int fill = head - Tail;
            if (fill < 0)
               fill = Size() + fill;
@@ -297,7 +309,7 @@ int cRingBufferLinear::Read(CFile& File, int Max)
         if (Head >= Size())
            Head = margin;
         head = Head;
-        if (statistics) {
+        if (statistics || fillMetric) {
            int fill = head - Tail;
            if (fill < 0)
               fill = Size() + fill;
@@ -324,7 +336,7 @@ int cRingBufferLinear::Put(const uint8_t *Data, int Count)
      int rest = Size() - head;
      int diff = Tail - head;
      int free = ((Tail < margin) ? rest : (diff > 0) ? diff : Size() + diff - margin) - 1;
-     if (statistics) {
+     if (statistics || fillMetric) {
         int fill = Size() - free - 1 + Count;
         if (fill >= Size())
            fill = Size() - 1;
@@ -22,6 +22,7 @@
 
 #include "lib/platform/threads/mutex.h"
 #include "lib/platform/threads/throttle.h"
+#include "utils/metrics/Metrics.h"
 
 namespace VDR
 {
@@ -37,7 +38,9 @@ private:
   int overflowCount;
   int overflowBytes;
   PLATFORM::cIoThrottle *ioThrottle;
+  MetricCounterPtr overflowMetric;
 protected:
+  MetricGaugePtr fillMetric;
   int maxFill;//XXX
   int lastPercent;
   bool statistics;//XXX
@@ -56,6 +59,9 @@ public:
   void SetTimeouts(int PutTimeout, int GetTimeout);
   void SetIoThrottle(void);
   void ReportOverflow(int Bytes);
+  void SetMetrics(const MetricGaugePtr &Fill, const MetricCounterPtr &Overflow);
+       ///< Publishes the number of bytes in the buffer (as of the last Put()) to
+       ///< Fill and counts dropped bytes in Overflow. Either may be empty.
   };
 
 class cRingBufferLinear : public cRingBuffer {
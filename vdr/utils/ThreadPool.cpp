@@ -0,0 +1,116 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ThreadPool.h"
+
+using namespace PLATFORM;
+
+namespace VDR
+{
+
+cThreadPool::cThreadPool(unsigned int threads)
+ : m_active(0),
+   m_bStop(false),
+   m_bHasWork(false),
+   m_bIdle(true)
+{
+  for (unsigned int i = 0; i < threads; i++)
+  {
+    cWorker* worker = new cWorker(*this);
+    if (worker->CreateThread(false))
+      m_workers.push_back(worker);
+    else
+      delete worker;
+  }
+}
+
+cThreadPool::~cThreadPool(void)
+{
+  Wait();
+
+  {
+    CLockObject lock(m_mutex);
+    m_bStop = m_bHasWork = true;
+    m_workCondition.Broadcast();
+  }
+
+  for (std::vector<cWorker*>::iterator it = m_workers.begin(); it != m_workers.end(); ++it)
+    delete *it;
+}
+
+void cThreadPool::Submit(const Job& job)
+{
+  if (m_workers.empty())
+  {
+    // No threads could be created, run the job synchronously
+    job();
+    return;
+  }
+
+  CLockObject lock(m_mutex);
+  m_jobs.push_back(job);
+  m_bHasWork = true;
+  m_bIdle = false;
+  m_workCondition.Signal();
+}
+
+void cThreadPool::Wait(void)
+{
+  CLockObject lock(m_mutex);
+  m_idleCondition.Wait(m_mutex, m_bIdle);
+}
+
+bool cThreadPool::NextJob(Job& job)
+{
+  CLockObject lock(m_mutex);
+  m_workCondition.Wait(m_mutex, m_bHasWork);
+
+  if (m_bStop)
+    return false;
+
+  job = m_jobs.front();
+  m_jobs.pop_front();
+  m_bHasWork = !m_jobs.empty();
+  m_active++;
+  return true;
+}
+
+void cThreadPool::JobFinished(void)
+{
+  CLockObject lock(m_mutex);
+  m_active--;
+  m_bIdle = m_jobs.empty() && m_active == 0;
+  if (m_bIdle)
+    m_idleCondition.Broadcast();
+}
+
+void* cThreadPool::cWorker::Process(void)
+{
+  Job job;
+  while (m_pool.NextJob(job))
+  {
+    job();
+    job = Job();
+    m_pool.JobFinished();
+  }
+  return NULL;
+}
+
+}
@@ -0,0 +1,82 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "lib/platform/threads/mutex.h"
+#include "lib/platform/threads/threads.h"
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace VDR
+{
+
+/*!
+ * Fixed-size pool of threads running queued jobs. Used to run independent
+ * tasks (e.g. loading configuration files at startup) concurrently.
+ */
+class cThreadPool
+{
+public:
+  typedef std::function<void(void)> Job;
+
+  cThreadPool(unsigned int threads);
+
+  /*!
+   * \brief Waits for all queued jobs, then stops the threads
+   */
+  ~cThreadPool(void);
+
+  void Submit(const Job& job);
+
+  /*!
+   * \brief Block until the queue is empty and no job is running
+   */
+  void Wait(void);
+
+private:
+  class cWorker : public PLATFORM::CThread
+  {
+  public:
+    cWorker(cThreadPool& pool) : m_pool(pool) { }
+    virtual ~cWorker(void) { }
+
+    virtual void* Process(void);
+
+  private:
+    cThreadPool& m_pool;
+  };
+
+  bool NextJob(Job& job);
+  void JobFinished(void);
+
+  std::vector<cWorker*>      m_workers;
+  std::deque<Job>            m_jobs;
+  unsigned int               m_active;    // Number of jobs being run
+  bool                       m_bStop;
+  bool                       m_bHasWork;  // m_bStop || !m_jobs.empty()
+  bool                       m_bIdle;     // m_jobs.empty() && m_active == 0
+  PLATFORM::CMutex           m_mutex;
+  PLATFORM::CCondition<bool> m_workCondition;
+  PLATFORM::CCondition<bool> m_idleCondition;
+};
+
+}
@@ -35,8 +35,10 @@
 #include "Tools.h"
 #include "XSocket.h"
 #include "filesystem/Poller.h"
+#include "utils/CommonMacros.h"
 #include "utils/log/Log.h"
 
+#include <algorithm>
 #include <errno.h>
 #include <net/if.h>
 #include <netinet/tcp.h>
@@ -44,8 +46,14 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <sys/ioctl.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Size of the chunks copied when sendfile() isn't supported for a file
+#define SENDFILE_COPY_SIZE  KILOBYTE(64)
 
 using namespace PLATFORM;
 
@@ -129,6 +137,120 @@ ssize_t cxSocket::write(const void *buffer, size_t size, int timeout_ms, bool mo
   return written;
 }
 
+ssize_t cxSocket::writev(struct iovec *iov, int count, int timeout_ms)
+{
+  CLockObject lock(m_MutexWrite);
+
+  if(m_fd == -1)
+    return -1;
+
+  ssize_t written = 0;
+
+  while (count > 0)
+  {
+    if(!m_pollerWrite->Poll(timeout_ms))
+    {
+      esyslog("cxSocket::writev: poll() failed");
+      return written;
+    }
+
+    ssize_t p = ::writev(m_fd, iov, count);
+
+    if (p < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      else if (errno != EPIPE)
+        esyslog("cxSocket::writev: writev() error");
+      return p;
+    }
+
+    written += p;
+
+    // Skip what was written, the kernel may stop in the middle of a buffer
+    while (count > 0 && (size_t)p >= iov->iov_len)
+    {
+      p -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0)
+    {
+      iov->iov_base = (uint8_t*)iov->iov_base + p;
+      iov->iov_len -= p;
+    }
+  }
+
+  return written;
+}
+
+ssize_t cxSocket::sendfile(const void *header, size_t headerSize, int fd, off_t offset, size_t size, int timeout_ms)
+{
+  CLockObject lock(m_MutexWrite);
+
+  if (write(header, headerSize, timeout_ms, size > 0) != (ssize_t)headerSize)
+    return -1;
+
+  size_t missing = size;
+  bool bCopy = false;
+
+  while (missing > 0)
+  {
+    if (!bCopy)
+    {
+      if(!m_pollerWrite->Poll(timeout_ms))
+      {
+        esyslog("cxSocket::sendfile: poll() failed");
+        return -1;
+      }
+
+      ssize_t p = ::sendfile(m_fd, fd, &offset, missing);
+
+      if (p < 0)
+      {
+        if (errno == EINTR || errno == EAGAIN)
+          continue;
+        if (errno == EINVAL || errno == ENOSYS)
+        {
+          dsyslog("cxSocket::sendfile: sendfile() not supported for this file, copying");
+          bCopy = true;
+          continue;
+        }
+        if (errno != EPIPE)
+          esyslog("cxSocket::sendfile: sendfile() error");
+        return -1;
+      }
+      else if (p == 0)
+      {
+        esyslog("cxSocket::sendfile: file ended %u bytes early", (unsigned int)missing);
+        return -1;
+      }
+
+      missing -= p;
+    }
+    else
+    {
+      uint8_t buffer[SENDFILE_COPY_SIZE];
+      ssize_t p = pread(fd, buffer, std::min(missing, sizeof(buffer)), offset);
+
+      if (p < 0 && errno == EINTR)
+        continue;
+      if (p <= 0)
+      {
+        esyslog("cxSocket::sendfile: read error with %u bytes left", (unsigned int)missing);
+        return -1;
+      }
+      if (write(buffer, p, timeout_ms, missing > (size_t)p) != p)
+        return -1;
+
+      offset  += p;
+      missing -= p;
+    }
+  }
+
+  return headerSize + size;
+}
+
 ssize_t cxSocket::read(void *buffer, size_t size, int timeout_ms)
 {
   int retryCounter = 0;
@@ -175,6 +297,55 @@ ssize_t cxSocket::read(void *buffer, size_t size, int timeout_ms)
   return size;
 }
 
+ssize_t cxSocket::readAvailable(void *buffer, size_t size)
+{
+  if(m_fd == -1)
+    return -1;
+
+  for (;;)
+  {
+    ssize_t p = ::read(m_fd, buffer, size);
+
+    if (p < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return 0;
+      esyslog("cxSocket::readAvailable: read() error");
+      return -1;
+    }
+    else if (p == 0 && size > 0)
+    {
+      isyslog("cxSocket::readAvailable: eof, connection closed");
+      return -1;
+    }
+
+    return p;
+  }
+}
+
+bool cxSocket::sendQueue(int &queued, int &size) const
+{
+  if(m_fd == -1)
+    return false;
+
+  socklen_t len = sizeof(size);
+  if (ioctl(m_fd, TIOCOUTQ, &queued) < 0 ||
+      getsockopt(m_fd, SOL_SOCKET, SO_SNDBUF, &size, &len) < 0 || size <= 0)
+    return false;
+
+  return true;
+}
+
+bool cxSocket::waitForData(int timeout_ms)
+{
+  if(m_fd == -1)
+    return false;
+
+  return m_pollerRead->Poll(timeout_ms);
+}
+
 void cxSocket::SetHandle(int h) {
   CLockObject lock(m_MutexWrite);
   if(h != m_fd) {
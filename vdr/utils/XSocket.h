@@ -28,6 +28,9 @@
 #include <inttypes.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <sys/types.h>
+
+struct iovec;
 
 namespace VDR
 {
@@ -45,12 +48,37 @@ class cxSocket
   cxSocket() : m_fd(-1), m_pollerRead(NULL), m_pollerWrite(NULL) {}
   ~cxSocket();
   void SetHandle(int h);
+  int GetHandle(void) const { return m_fd; }
   void close(void);
   void Shutdown(void);
   void LockWrite();
   void UnlockWrite();
   ssize_t read(void *buffer, size_t size, int timeout_ms = -1);
+  /*!
+   * Read whatever is available without waiting. Returns the number of bytes
+   * read, 0 if no data is pending or -1 if the connection was closed.
+   */
+  ssize_t readAvailable(void *buffer, size_t size);
+  bool waitForData(int timeout_ms = -1);
   ssize_t write(const void *buffer, size_t size, int timeout_ms = -1, bool more_data = false);
+  /*!
+   * Write count buffers in as few system calls as possible. Nothing else is
+   * written in between. iov is advanced past the data that was written.
+   * Returns the number of bytes written.
+   */
+  ssize_t writev(struct iovec *iov, int count, int timeout_ms = -1);
+  /*!
+   * Write header, followed by size bytes of the file fd at offset, without
+   * copying the file through userspace. Falls back to copying if the kernel
+   * can't sendfile() from fd. Nothing else is written in between. Returns the
+   * number of bytes written, or -1 if the packet couldn't be sent completely.
+   */
+  ssize_t sendfile(const void *header, size_t headerSize, int fd, off_t offset, size_t size, int timeout_ms = -1);
+  /*!
+   * Bytes written but not yet acknowledged by the peer, and the size of the
+   * kernel's send buffer they queue in. Returns false if either is unknown.
+   */
+  bool sendQueue(int &queued, int &size) const;
   static char *ip2txt(uint32_t ip, unsigned int port, char *str);
 };
 }
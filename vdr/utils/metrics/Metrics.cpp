@@ -0,0 +1,214 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Metrics.h"
+#include "utils/StringUtils.h"
+#include "utils/log/Log.h"
+
+#include <time.h>
+
+using namespace PLATFORM;
+
+namespace VDR
+{
+
+namespace
+{
+  std::string SeriesName(const std::string& strName, const std::string& strLabels)
+  {
+    return strLabels.empty() ? strName : strName + "{" + strLabels + "}";
+  }
+
+  const char* TypeToString(METRIC_TYPE type)
+  {
+    switch (type)
+    {
+    case METRIC_TYPE_COUNTER:   return "counter";
+    case METRIC_TYPE_GAUGE:     return "gauge";
+    case METRIC_TYPE_HISTOGRAM: return "histogram";
+    default:                    return "untyped";
+    }
+  }
+}
+
+// --- cMetricCounter ----------------------------------------------------------
+
+void cMetricCounter::Serialise(const std::string& strName, const std::string& strLabels, std::string& output) const
+{
+  output += StringUtils::Format("%s %llu\n", SeriesName(strName, strLabels).c_str(), (unsigned long long)Value());
+}
+
+// --- cMetricGauge ------------------------------------------------------------
+
+void cMetricGauge::Serialise(const std::string& strName, const std::string& strLabels, std::string& output) const
+{
+  output += StringUtils::Format("%s %lld\n", SeriesName(strName, strLabels).c_str(), (long long)Value());
+}
+
+// --- cMetricHistogram --------------------------------------------------------
+
+cMetricHistogram::cMetricHistogram(const std::vector<uint64_t>& buckets, double scale /* = 1.0 */)
+ : m_bounds(buckets),
+   m_scale(scale > 0 ? scale : 1.0),
+   m_buckets(new std::atomic<uint64_t>[buckets.size() + 1]),
+   m_count(0),
+   m_sum(0)
+{
+  for (size_t i = 0; i <= m_bounds.size(); i++)
+    m_buckets[i].store(0, std::memory_order_relaxed);
+}
+
+void cMetricHistogram::Observe(uint64_t value)
+{
+  size_t bucket = 0;
+  while (bucket < m_bounds.size() && value > m_bounds[bucket])
+    bucket++;
+
+  m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(value, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void cMetricHistogram::Serialise(const std::string& strName, const std::string& strLabels, std::string& output) const
+{
+  const std::string strPrefix = strLabels.empty() ? "" : strLabels + ",";
+
+  // Buckets are cumulative in the exposition format
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < m_bounds.size(); i++)
+  {
+    cumulative += m_buckets[i].load(std::memory_order_relaxed);
+    output += StringUtils::Format("%s_bucket{%sle=\"%g\"} %llu\n", strName.c_str(), strPrefix.c_str(),
+        m_bounds[i] / m_scale, (unsigned long long)cumulative);
+  }
+  cumulative += m_buckets[m_bounds.size()].load(std::memory_order_relaxed);
+  output += StringUtils::Format("%s_bucket{%sle=\"+Inf\"} %llu\n", strName.c_str(), strPrefix.c_str(),
+      (unsigned long long)cumulative);
+
+  output += StringUtils::Format("%s %g\n", SeriesName(strName + "_sum", strLabels).c_str(), Sum() / m_scale);
+  output += StringUtils::Format("%s %llu\n", SeriesName(strName + "_count", strLabels).c_str(), (unsigned long long)cumulative);
+}
+
+// --- cMetrics ----------------------------------------------------------------
+
+cMetrics& cMetrics::Get(void)
+{
+  static cMetrics _instance;
+  return _instance;
+}
+
+MetricPtr cMetrics::Register(const std::string& strName, const std::string& strHelp, const std::string& strLabels,
+                             METRIC_TYPE type, const MetricPtr& metric)
+{
+  CLockObject lock(m_mutex);
+
+  std::map<std::string, sFamily>::iterator itFamily = m_families.find(strName);
+  if (itFamily == m_families.end())
+  {
+    sFamily family;
+    family.type    = type;
+    family.strHelp = strHelp;
+    itFamily = m_families.insert(std::make_pair(strName, family)).first;
+  }
+  else if (itFamily->second.type != type)
+  {
+    esyslog("metric %s is already registered as a %s", strName.c_str(), TypeToString(itFamily->second.type));
+    return metric; // Usable, but not exported
+  }
+
+  std::map<std::string, MetricPtr>::iterator itSeries = itFamily->second.series.find(strLabels);
+  if (itSeries != itFamily->second.series.end())
+    return itSeries->second;
+
+  itFamily->second.series[strLabels] = metric;
+  return metric;
+}
+
+MetricCounterPtr cMetrics::Counter(const std::string& strName, const std::string& strHelp, const std::string& strLabels /* = "" */)
+{
+  return std::static_pointer_cast<cMetricCounter>(
+      Register(strName, strHelp, strLabels, METRIC_TYPE_COUNTER, MetricPtr(new cMetricCounter)));
+}
+
+MetricGaugePtr cMetrics::Gauge(const std::string& strName, const std::string& strHelp, const std::string& strLabels /* = "" */)
+{
+  return std::static_pointer_cast<cMetricGauge>(
+      Register(strName, strHelp, strLabels, METRIC_TYPE_GAUGE, MetricPtr(new cMetricGauge)));
+}
+
+MetricHistogramPtr cMetrics::Histogram(const std::string& strName, const std::string& strHelp, const std::vector<uint64_t>& buckets,
+                                       double scale /* = 1.0 */, const std::string& strLabels /* = "" */)
+{
+  return std::static_pointer_cast<cMetricHistogram>(
+      Register(strName, strHelp, strLabels, METRIC_TYPE_HISTOGRAM, MetricPtr(new cMetricHistogram(buckets, scale))));
+}
+
+void cMetrics::Remove(const std::string& strName, const std::string& strLabels)
+{
+  CLockObject lock(m_mutex);
+
+  std::map<std::string, sFamily>::iterator itFamily = m_families.find(strName);
+  if (itFamily != m_families.end())
+  {
+    itFamily->second.series.erase(strLabels);
+    if (itFamily->second.series.empty())
+      m_families.erase(itFamily);
+  }
+}
+
+std::string cMetrics::ToPrometheus(void) const
+{
+  std::string output;
+
+  CLockObject lock(m_mutex);
+  for (std::map<std::string, sFamily>::const_iterator itFamily = m_families.begin(); itFamily != m_families.end(); ++itFamily)
+  {
+    output += StringUtils::Format("# HELP %s %s\n", itFamily->first.c_str(), itFamily->second.strHelp.c_str());
+    output += StringUtils::Format("# TYPE %s %s\n", itFamily->first.c_str(), TypeToString(itFamily->second.type));
+
+    for (std::map<std::string, MetricPtr>::const_iterator itSeries = itFamily->second.series.begin(); itSeries != itFamily->second.series.end(); ++itSeries)
+      itSeries->second->Serialise(itFamily->first, itSeries->first, output);
+  }
+
+  return output;
+}
+
+std::string cMetrics::Label(const std::string& strKey, const std::string& strValue)
+{
+  std::string strEscaped(strValue);
+  StringUtils::Replace(strEscaped, "\\", "\\\\");
+  StringUtils::Replace(strEscaped, "\"", "\\\"");
+  StringUtils::Replace(strEscaped, "\n", "\\n");
+  return strKey + "=\"" + strEscaped + "\"";
+}
+
+std::string cMetrics::Label(const std::string& strKey, int value)
+{
+  return StringUtils::Format("%s=\"%d\"", strKey.c_str(), value);
+}
+
+uint64_t cMetrics::MonotonicUs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+}
@@ -0,0 +1,193 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "lib/platform/threads/mutex.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace VDR
+{
+
+class cMetric;
+class cMetricCounter;
+class cMetricGauge;
+class cMetricHistogram;
+
+typedef std::shared_ptr<cMetric>          MetricPtr;
+typedef std::shared_ptr<cMetricCounter>   MetricCounterPtr;
+typedef std::shared_ptr<cMetricGauge>     MetricGaugePtr;
+typedef std::shared_ptr<cMetricHistogram> MetricHistogramPtr;
+
+enum METRIC_TYPE
+{
+  METRIC_TYPE_COUNTER,
+  METRIC_TYPE_GAUGE,
+  METRIC_TYPE_HISTOGRAM
+};
+
+/*!
+ * \brief Base class for a single time series
+ *
+ * Updates are lock-free and safe to call from receiver threads. Only the
+ * registration of a new time series in cMetrics takes a lock, so hot paths
+ * should register once and hold on to the returned pointer.
+ */
+class cMetric
+{
+public:
+  virtual ~cMetric(void) { }
+
+  virtual METRIC_TYPE Type(void) const = 0;
+
+  /*!
+   * \brief Append the samples of this time series in Prometheus text format
+   */
+  virtual void Serialise(const std::string& strName, const std::string& strLabels, std::string& output) const = 0;
+};
+
+class cMetricCounter : public cMetric
+{
+public:
+  cMetricCounter(void) : m_value(0) { }
+
+  void Increment(void) { m_value.fetch_add(1, std::memory_order_relaxed); }
+  void Add(uint64_t value) { m_value.fetch_add(value, std::memory_order_relaxed); }
+  uint64_t Value(void) const { return m_value.load(std::memory_order_relaxed); }
+
+  virtual METRIC_TYPE Type(void) const { return METRIC_TYPE_COUNTER; }
+  virtual void Serialise(const std::string& strName, const std::string& strLabels, std::string& output) const;
+
+private:
+  std::atomic<uint64_t> m_value;
+};
+
+class cMetricGauge : public cMetric
+{
+public:
+  cMetricGauge(void) : m_value(0) { }
+
+  void Set(int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+  void Add(int64_t value) { m_value.fetch_add(value, std::memory_order_relaxed); }
+  int64_t Value(void) const { return m_value.load(std::memory_order_relaxed); }
+
+  virtual METRIC_TYPE Type(void) const { return METRIC_TYPE_GAUGE; }
+  virtual void Serialise(const std::string& strName, const std::string& strLabels, std::string& output) const;
+
+private:
+  std::atomic<int64_t> m_value;
+};
+
+/*!
+ * \brief Histogram with fixed bucket boundaries
+ *
+ * Observations are integers (e.g. microseconds) so buckets can be updated with
+ * atomic adds. The scale converts them to the unit of the metric name when the
+ * histogram is serialised, e.g. a scale of 1000000 reports microseconds as
+ * seconds.
+ */
+class cMetricHistogram : public cMetric
+{
+public:
+  /*!
+   * \param buckets Upper bounds of the buckets in ascending order. A +Inf
+   *                bucket is added implicitly.
+   */
+  cMetricHistogram(const std::vector<uint64_t>& buckets, double scale = 1.0);
+
+  void Observe(uint64_t value);
+
+  uint64_t Count(void) const { return m_count.load(std::memory_order_relaxed); }
+  uint64_t Sum(void) const { return m_sum.load(std::memory_order_relaxed); }
+
+  virtual METRIC_TYPE Type(void) const { return METRIC_TYPE_HISTOGRAM; }
+  virtual void Serialise(const std::string& strName, const std::string& strLabels, std::string& output) const;
+
+private:
+  const std::vector<uint64_t>              m_bounds;
+  const double                             m_scale;
+  std::unique_ptr<std::atomic<uint64_t>[]> m_buckets; // m_bounds.size() + 1 buckets
+  std::atomic<uint64_t>                    m_count;
+  std::atomic<uint64_t>                    m_sum;
+};
+
+/*!
+ * \brief Registry of all runtime metrics
+ *
+ * Metrics are grouped in families by name. Each family holds one time series
+ * per label set, e.g. vdr_device_packets_total{device="0"}. Asking for an
+ * existing name and label set returns the registered time series.
+ */
+class cMetrics
+{
+public:
+  static cMetrics& Get(void);
+  ~cMetrics(void) { }
+
+  MetricCounterPtr   Counter(const std::string& strName, const std::string& strHelp, const std::string& strLabels = "");
+  MetricGaugePtr     Gauge(const std::string& strName, const std::string& strHelp, const std::string& strLabels = "");
+  MetricHistogramPtr Histogram(const std::string& strName, const std::string& strHelp, const std::vector<uint64_t>& buckets,
+                               double scale = 1.0, const std::string& strLabels = "");
+
+  /*!
+   * \brief Stop exporting a time series, e.g. when a client disconnects.
+   *        Pointers that are still held remain valid.
+   */
+  void Remove(const std::string& strName, const std::string& strLabels);
+
+  /*!
+   * \brief Serialise all metrics in the Prometheus text exposition format
+   */
+  std::string ToPrometheus(void) const;
+
+  /*!
+   * \brief Format a label for use as strLabels, e.g. device="0"
+   */
+  static std::string Label(const std::string& strKey, const std::string& strValue);
+  static std::string Label(const std::string& strKey, int value);
+
+  /*!
+   * \brief Monotonic clock for latency observations, in microseconds
+   */
+  static uint64_t MonotonicUs(void);
+
+private:
+  cMetrics(void) { }
+
+  struct sFamily
+  {
+    METRIC_TYPE                      type;
+    std::string                      strHelp;
+    std::map<std::string, MetricPtr> series; // label set -> time series
+  };
+
+  MetricPtr Register(const std::string& strName, const std::string& strHelp, const std::string& strLabels,
+                     METRIC_TYPE type, const MetricPtr& metric);
+
+  std::map<std::string, sFamily> m_families;
+  mutable PLATFORM::CMutex       m_mutex;
+};
+
+}
@@ -0,0 +1,220 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "MetricsExporter.h"
+#include "Metrics.h"
+#include "filesystem/File.h"
+#include "lib/platform/util/timeutils.h"
+#include "settings/Settings.h"
+#include "utils/log/Log.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define MIN_EXPORT_INTERVAL_S  1
+#define SOCKET_WRITE_TIMEOUT   1000 // ms
+
+using namespace PLATFORM;
+
+namespace VDR
+{
+
+cMetricsExporter& cMetricsExporter::Get(void)
+{
+  static cMetricsExporter _instance;
+  return _instance;
+}
+
+cMetricsExporter::cMetricsExporter(void)
+ : m_intervalMs(0),
+   m_socketFd(-1)
+{
+}
+
+cMetricsExporter::~cMetricsExporter(void)
+{
+  Stop();
+}
+
+bool cMetricsExporter::Start(void)
+{
+  if (IsRunning())
+    return true;
+
+  m_strFile    = cSettings::Get().m_MetricsFile;
+  m_strSocket  = cSettings::Get().m_MetricsSocket;
+  m_intervalMs = std::max(cSettings::Get().m_iMetricsInterval, MIN_EXPORT_INTERVAL_S) * 1000;
+
+  if (m_strFile.empty() && m_strSocket.empty())
+    return false;
+
+  if (!m_strSocket.empty() && !OpenSocket())
+    return false;
+
+  isyslog("exporting metrics%s%s%s%s", m_strFile.empty() ? "" : " to ", m_strFile.c_str(),
+      m_strSocket.empty() ? "" : " on socket ", m_strSocket.c_str());
+
+  return CreateThread(true);
+}
+
+void cMetricsExporter::Stop(void)
+{
+  StopThread(0);
+  CloseSocket();
+}
+
+void* cMetricsExporter::Process(void)
+{
+  CTimeout nextWrite;
+
+  while (!IsStopped())
+  {
+    if (!m_strFile.empty() && nextWrite.TimeLeft() == 0)
+    {
+      WriteFile();
+      nextWrite.Init(m_intervalMs);
+    }
+
+    const uint32_t timeoutMs = m_strFile.empty() ? m_intervalMs : std::max(nextWrite.TimeLeft(), (uint32_t)1);
+
+    if (m_socketFd >= 0)
+    {
+      // Limit the poll so that StopThread() is noticed in time
+      pollfd pfd = { m_socketFd, POLLIN, 0 };
+      if (poll(&pfd, 1, std::min(timeoutMs, (uint32_t)1000)) > 0 && (pfd.revents & POLLIN))
+        ServeClient();
+    }
+    else
+    {
+      Sleep(timeoutMs);
+    }
+  }
+
+  return NULL;
+}
+
+bool cMetricsExporter::OpenSocket(void)
+{
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (m_strSocket.size() >= sizeof(addr.sun_path))
+  {
+    esyslog("metrics socket path is too long: %s", m_strSocket.c_str());
+    return false;
+  }
+  strncpy(addr.sun_path, m_strSocket.c_str(), sizeof(addr.sun_path) - 1);
+
+  m_socketFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (m_socketFd < 0)
+  {
+    LOG_ERROR;
+    return false;
+  }
+
+  fcntl(m_socketFd, F_SETFD, fcntl(m_socketFd, F_GETFD) | FD_CLOEXEC);
+
+  // Remove a stale socket left behind by a previous instance
+  unlink(m_strSocket.c_str());
+
+  if (bind(m_socketFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(m_socketFd, 5) < 0)
+  {
+    esyslog("unable to open metrics socket %s: %s", m_strSocket.c_str(), strerror(errno));
+    CloseSocket();
+    return false;
+  }
+
+  return true;
+}
+
+void cMetricsExporter::CloseSocket(void)
+{
+  if (m_socketFd >= 0)
+  {
+    close(m_socketFd);
+    m_socketFd = -1;
+    unlink(m_strSocket.c_str());
+  }
+}
+
+void cMetricsExporter::ServeClient(void)
+{
+  int fd = accept(m_socketFd, NULL, NULL);
+  if (fd < 0)
+    return;
+
+  const std::string strMetrics = cMetrics::Get().ToPrometheus();
+
+  const char* ptr = strMetrics.c_str();
+  size_t remaining = strMetrics.size();
+  while (remaining > 0)
+  {
+    // Don't let a stalled reader block the exporter
+    pollfd pfd = { fd, POLLOUT, 0 };
+    if (poll(&pfd, 1, SOCKET_WRITE_TIMEOUT) <= 0)
+      break;
+
+    ssize_t written = send(fd, ptr, remaining, MSG_NOSIGNAL);
+    if (written <= 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      break;
+    }
+    ptr       += written;
+    remaining -= written;
+  }
+
+  close(fd);
+}
+
+bool cMetricsExporter::WriteFile(void)
+{
+  const std::string strMetrics = cMetrics::Get().ToPrometheus();
+
+  // Write to a temporary file first, readers must never see a partial dump
+  const std::string strTempFile = m_strFile + ".tmp";
+
+  CFile file;
+  if (!file.OpenForWrite(strTempFile, true))
+  {
+    esyslog("failed to write metrics to %s", strTempFile.c_str());
+    return false;
+  }
+
+  bool bSuccess = file.Write(strMetrics.c_str(), strMetrics.size()) == (int64_t)strMetrics.size();
+  file.Close();
+
+  if (bSuccess)
+    bSuccess = CFile::Rename(strTempFile, m_strFile);
+
+  if (!bSuccess)
+    esyslog("failed to write metrics to %s", m_strFile.c_str());
+
+  return bSuccess;
+}
+
+}
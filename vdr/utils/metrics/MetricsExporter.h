@@ -0,0 +1,67 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "lib/platform/threads/threads.h"
+
+#include <string>
+
+namespace VDR
+{
+
+/*!
+ * \brief Publishes the contents of cMetrics in Prometheus text format
+ *
+ * When a metrics file is configured, it is rewritten atomically every interval
+ * so it can be picked up by node_exporter's textfile collector. When a metrics
+ * socket is configured, a local (AF_UNIX) socket is created at that path and a
+ * snapshot is written to every client that connects, e.g.
+ * socat - UNIX-CONNECT:/run/vdr/metrics.sock
+ */
+class cMetricsExporter : protected PLATFORM::CThread
+{
+public:
+  static cMetricsExporter& Get(void);
+  virtual ~cMetricsExporter(void);
+
+  /*!
+   * \brief Start exporting, if a metrics file or socket has been configured
+   */
+  bool Start(void);
+  void Stop(void);
+
+protected:
+  virtual void* Process(void);
+
+private:
+  cMetricsExporter(void);
+
+  bool OpenSocket(void);
+  void CloseSocket(void);
+  void ServeClient(void);
+  bool WriteFile(void);
+
+  std::string  m_strFile;
+  std::string  m_strSocket;
+  unsigned int m_intervalMs;
+  int          m_socketFd;
+};
+
+}
@@ -0,0 +1,102 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "utils/metrics/Metrics.h"
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace VDR
+{
+
+TEST(TestMetrics, Counter)
+{
+  MetricCounterPtr counter = cMetrics::Get().Counter("test_counter_total", "Test counter", cMetrics::Label("id", 1));
+  ASSERT_TRUE(counter.get() != NULL);
+
+  counter->Increment();
+  counter->Add(41);
+  EXPECT_EQ(42u, counter->Value());
+
+  // Registering the same series again returns the existing one
+  MetricCounterPtr same = cMetrics::Get().Counter("test_counter_total", "Test counter", cMetrics::Label("id", 1));
+  EXPECT_EQ(counter.get(), same.get());
+
+  string output = cMetrics::Get().ToPrometheus();
+  EXPECT_NE(string::npos, output.find("# TYPE test_counter_total counter\n"));
+  EXPECT_NE(string::npos, output.find("test_counter_total{id=\"1\"} 42\n"));
+
+  cMetrics::Get().Remove("test_counter_total", cMetrics::Label("id", 1));
+  output = cMetrics::Get().ToPrometheus();
+  EXPECT_EQ(string::npos, output.find("test_counter_total"));
+}
+
+TEST(TestMetrics, Gauge)
+{
+  MetricGaugePtr gauge = cMetrics::Get().Gauge("test_gauge", "Test gauge");
+  gauge->Set(10);
+  gauge->Add(-15);
+  EXPECT_EQ(-5, gauge->Value());
+
+  EXPECT_NE(string::npos, cMetrics::Get().ToPrometheus().find("test_gauge -5\n"));
+
+  // A name can't be registered with another type
+  MetricCounterPtr counter = cMetrics::Get().Counter("test_gauge", "Test counter");
+  counter->Increment();
+  EXPECT_NE(string::npos, cMetrics::Get().ToPrometheus().find("test_gauge -5\n"));
+
+  cMetrics::Get().Remove("test_gauge", "");
+}
+
+TEST(TestMetrics, Histogram)
+{
+  vector<uint64_t> buckets;
+  buckets.push_back(1000);
+  buckets.push_back(10000);
+
+  MetricHistogramPtr histogram = cMetrics::Get().Histogram("test_seconds", "Test histogram", buckets, 1000000.0);
+  histogram->Observe(500);
+  histogram->Observe(1000);
+  histogram->Observe(5000);
+  histogram->Observe(20000);
+  EXPECT_EQ(4u, histogram->Count());
+  EXPECT_EQ(26500u, histogram->Sum());
+
+  string output = cMetrics::Get().ToPrometheus();
+  EXPECT_NE(string::npos, output.find("test_seconds_bucket{le=\"0.001\"} 2\n"));
+  EXPECT_NE(string::npos, output.find("test_seconds_bucket{le=\"0.01\"} 3\n"));
+  EXPECT_NE(string::npos, output.find("test_seconds_bucket{le=\"+Inf\"} 4\n"));
+  EXPECT_NE(string::npos, output.find("test_seconds_sum 0.0265\n"));
+  EXPECT_NE(string::npos, output.find("test_seconds_count 4\n"));
+
+  cMetrics::Get().Remove("test_seconds", "");
+}
+
+TEST(TestMetrics, Label)
+{
+  EXPECT_STREQ("device=\"0\"", cMetrics::Label("device", 0).c_str());
+  EXPECT_STREQ("name=\"a\\\"b\\\\c\"", cMetrics::Label("name", "a\"b\\c").c_str());
+}
+
+}
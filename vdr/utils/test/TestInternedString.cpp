@@ -0,0 +1,80 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "utils/InternedString.h"
+
+#include "gtest/gtest.h"
+
+#include <stdlib.h>
+#include <vector>
+
+namespace VDR
+{
+
+TEST(InternedString, Pool)
+{
+  size_t count, bytes;
+  cInternedString::PoolUsage(count, bytes);
+  const size_t initialCount = count;
+
+  {
+    cInternedString empty;
+    EXPECT_TRUE(empty.empty());
+    EXPECT_EQ(std::string(), empty.Str());
+
+    cInternedString a(std::string("Series title"));
+    cInternedString b(std::string("Series title"));
+    cInternedString c(std::string("Another title"));
+    EXPECT_EQ(a, b);
+    EXPECT_NE(a, c);
+    EXPECT_EQ(&a.Str(), &b.Str());
+    EXPECT_EQ("Series title", a.Str());
+
+    cInternedString::PoolUsage(count, bytes);
+    EXPECT_EQ(initialCount + 2, count);
+
+    c = a;
+    EXPECT_EQ(a, c);
+    cInternedString::PoolUsage(count, bytes);
+    EXPECT_EQ(initialCount + 1, count);
+
+    b = std::string("");
+    EXPECT_TRUE(b.empty());
+  }
+
+  cInternedString::PoolUsage(count, bytes);
+  EXPECT_EQ(initialCount, count);
+}
+
+TEST(InternedString, ReleasedAtExit)
+{
+  // Runs in a new process, so the owner below is constructed before the pool
+  // and destroyed after it at exit, like the schedule manager's instance
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  EXPECT_EXIT(
+  {
+    static std::vector<cInternedString> owner;
+    for (unsigned int i = 0; i < 100; i++)
+      owner.push_back(cInternedString(std::string("Interned at exit ") + (char)('a' + i % 26)));
+    exit(0);
+  }, ::testing::ExitedWithCode(0), "");
+}
+
+}
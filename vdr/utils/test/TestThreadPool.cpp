@@ -0,0 +1,61 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "utils/ThreadPool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <unistd.h>
+
+using namespace PLATFORM;
+
+namespace VDR
+{
+
+TEST(ThreadPool, Wait)
+{
+  std::atomic<unsigned int> count(0);
+
+  cThreadPool pool(3);
+  for (unsigned int i = 0; i < 10; i++)
+    pool.Submit([&count]() { usleep(1000); count++; });
+
+  pool.Wait();
+  EXPECT_EQ(count, 10);
+
+  // The pool can be reused after waiting
+  pool.Submit([&count]() { count++; });
+  pool.Wait();
+  EXPECT_EQ(count, 11);
+}
+
+TEST(ThreadPool, Destructor)
+{
+  std::atomic<unsigned int> count(0);
+  {
+    cThreadPool pool(2);
+    for (unsigned int i = 0; i < 4; i++)
+      pool.Submit([&count]() { usleep(1000); count++; });
+  }
+  EXPECT_EQ(count, 4);
+}
+
+}
@@ -50,11 +50,21 @@
 #include "utils/log/Log.h"
 #include "utils/StringUtils.h"
 #include "utils/TimeUtils.h"
+#include "utils/metrics/Metrics.h"
 
+#include <algorithm>
 #include <map>
 #include <netinet/in.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#define REQUEST_HEADER_SIZE         16      // channel ID, request ID, opcode, data length
+#define REQUEST_BUFFER_SIZE         4096
+#define REQUEST_TIMEOUT             10000   // ms
+#define MAX_REQUEST_DATA_LENGTH     200000  // a random sanity limit
+#define MAX_RETAINED_RESPONSE_SIZE  MEGABYTE(1)
+#define MAX_STREAM_BATCH_TIME       200     // ms, unless stream_batch_time allows more
 
 using namespace PLATFORM;
 
@@ -63,7 +73,13 @@ namespace VDR
 
 CMutex cVNSIClient::m_timerLock;
 
-cVNSIClient::cVNSIClient(int fd, unsigned int id, const char *ClientAdr)
+cVNSIClient::cVNSIClient(int fd, unsigned int id, const char *ClientAdr, bool bEventDriven /* = false */)
+ : m_bEventDriven(bEventDriven),
+   m_bDisconnected(false),
+   m_inBuffer(NULL),
+   m_inSize(0),
+   m_inStart(0),
+   m_inEnd(0)
 {
   m_Id                      = id;
   m_Streamer                = NULL;
@@ -78,7 +94,10 @@ cVNSIClient::cVNSIClient(int fd, unsigned int id, const char *ClientAdr)
 
   m_socket.SetHandle(fd);
 
-  CreateThread();
+  if (m_bEventDriven)
+    cTimerManager::Get().RegisterObserver(this);
+  else
+    CreateThread();
 }
 
 cVNSIClient::~cVNSIClient()
@@ -86,80 +105,161 @@ cVNSIClient::~cVNSIClient()
   dsyslog("%s", __FUNCTION__);
   StopChannelStreaming();
   m_socket.close(); // force closing connection
-  StopThread(10000);
+  if (m_bEventDriven)
+    cTimerManager::Get().UnregisterObserver(this);
+  else
+    StopThread(10000);
+  free(m_inBuffer);
   dsyslog("done");
 }
 
-void* cVNSIClient::Process(void)
+bool cVNSIClient::IsDisconnected(void)
 {
-  uint32_t channelID;
-  uint32_t requestID;
-  uint32_t opcode;
-  uint32_t dataLength;
-  uint8_t* data;
+  if (!m_bEventDriven)
+    return !IsRunning();
 
-  cTimerManager::Get().RegisterObserver(this);
+  CLockObject lock(m_msgLock);
+  return m_bDisconnected;
+}
 
-  while (!IsStopped())
+bool cVNSIClient::HandleRequest(uint32_t channelID, uint32_t requestID, uint32_t opcode, uint8_t* data, uint32_t dataLength)
+{
+  //dsyslog("Received channel='%s' (%u), ser=%u, opcode='%s' (%u), edl=%u", ChannelToString(channelID), channelID, requestID, OpcodeToString(opcode), opcode, dataLength);
+
+  if (!m_loggedIn && (opcode != VNSI_LOGIN))
+  {
+    esyslog("Clients must be logged in before sending commands! Aborting.");
+    return false;
+  }
+
+  // The data stays in the receive buffer
+  cRequestPacket req(requestID, opcode, data, dataLength, false);
+
+  processRequest(&req);
+  return true;
+}
+
+bool cVNSIClient::ReserveInBuffer(uint32_t size)
+{
+  // Move the unprocessed data to the front before growing the buffer
+  if (m_inStart > 0)
   {
-    if (!m_socket.read((uint8_t*)&channelID, sizeof(uint32_t))) break;
-    channelID = ntohl(channelID);
+    memmove(m_inBuffer, m_inBuffer + m_inStart, m_inEnd - m_inStart);
+    m_inEnd  -= m_inStart;
+    m_inStart = 0;
+  }
+
+  if (size <= m_inSize)
+    return true;
+
+  uint32_t newSize = std::max(size, std::max(m_inSize * 2, (uint32_t)REQUEST_BUFFER_SIZE));
+  uint8_t* newBuffer = (uint8_t*)realloc(m_inBuffer, newSize);
+  if (!newBuffer)
+  {
+    esyslog("Extra data buffer malloc error");
+    return false;
+  }
 
-    if (channelID == 1)
+  m_inBuffer = newBuffer;
+  m_inSize   = newSize;
+  return true;
+}
+
+bool cVNSIClient::ParseRequests(void)
+{
+  while (m_inEnd - m_inStart >= REQUEST_HEADER_SIZE)
+  {
+    uint32_t header[4]; // channel ID, request ID, opcode, data length
+    memcpy(header, m_inBuffer + m_inStart, sizeof(header));
+
+    const uint32_t channelID  = ntohl(header[0]);
+    const uint32_t requestID  = ntohl(header[1]);
+    const uint32_t opcode     = ntohl(header[2]);
+    const uint32_t dataLength = ntohl(header[3]);
+
+    if (channelID != VNSI_CHANNEL_REQUEST_RESPONSE)
     {
-      if (!m_socket.read((uint8_t*)&requestID, sizeof(uint32_t), 10000)) break;
-      requestID = ntohl(requestID);
-
-      if (!m_socket.read((uint8_t*)&opcode, sizeof(uint32_t), 10000)) break;
-      opcode = ntohl(opcode);
-
-      if (!m_socket.read((uint8_t*)&dataLength, sizeof(uint32_t), 10000)) break;
-      dataLength = ntohl(dataLength);
-      if (dataLength > 200000) // a random sanity limit
-      {
-        esyslog("dataLength > 200000!");
-        break;
-      }
-
-      if (dataLength)
-      {
-        data = (uint8_t*)malloc(dataLength);
-        if (!data)
-        {
-          esyslog("Extra data buffer malloc error");
-          break;
-        }
-
-        if (!m_socket.read(data, dataLength, 10000))
-        {
-          esyslog("Could not read data");
-          free(data);
-          break;
-        }
-      }
-      else
-      {
-        data = NULL;
-      }
-
-      //dsyslog("Received channel='%s' (%u), ser=%u, opcode='%s' (%u), edl=%u", ChannelToString(channelID), channelID, requestID, OpcodeToString(opcode), opcode, dataLength);
-
-      if (!m_loggedIn && (opcode != VNSI_LOGIN))
-      {
-        esyslog("Clients must be logged in before sending commands! Aborting.");
-        if (data) free(data);
-        break;
-      }
-
-      cRequestPacket* req = new cRequestPacket(requestID, opcode, data, dataLength);
-
-      processRequest(req);
+      esyslog("Incoming channel number unknown");
+      return false;
     }
-    else
+
+    if (dataLength > MAX_REQUEST_DATA_LENGTH)
     {
-      esyslog("Incoming channel number unknown");
+      esyslog("dataLength > %d!", MAX_REQUEST_DATA_LENGTH);
+      return false;
+    }
+
+    const uint32_t requestSize = REQUEST_HEADER_SIZE + dataLength;
+    if (m_inEnd - m_inStart < requestSize)
+    {
+      // Make sure the rest of the request fits in the buffer
+      if (m_inStart + requestSize > m_inSize && !ReserveInBuffer(requestSize))
+        return false;
+      break;
+    }
+
+    uint8_t* data = dataLength ? m_inBuffer + m_inStart + REQUEST_HEADER_SIZE : NULL;
+    m_inStart += requestSize;
+
+    if (!HandleRequest(channelID, requestID, opcode, data, dataLength))
+      return false;
+  }
+
+  if (m_inStart == m_inEnd)
+    m_inStart = m_inEnd = 0;
+
+  return true;
+}
+
+bool cVNSIClient::ReadRequests(void)
+{
+  for (;;)
+  {
+    if (m_inEnd == m_inSize && !ReserveInBuffer(m_inEnd - m_inStart + 1))
+      return false;
+
+    ssize_t p = m_socket.readAvailable(m_inBuffer + m_inEnd, m_inSize - m_inEnd);
+    if (p < 0)
+      return false;
+    if (p == 0)
+      return true;
+
+    m_inEnd += p;
+    if (!ParseRequests())
+      return false;
+  }
+}
+
+bool cVNSIClient::ProcessAvailable(void)
+{
+  if (ReadRequests())
+    return true;
+
+  StopChannelStreaming();
+  cTimerManager::Get().UnregisterObserver(this);
+
+  CLockObject lock(m_msgLock);
+  m_bDisconnected = true;
+  return false;
+}
+
+void* cVNSIClient::Process(void)
+{
+  cTimerManager::Get().RegisterObserver(this);
+
+  while (!IsStopped())
+  {
+    // Don't wait forever for the rest of a request that was partially received
+    const bool bPartial = m_inEnd > m_inStart;
+    if (!m_socket.waitForData(bPartial ? REQUEST_TIMEOUT : -1))
+    {
+      if (bPartial)
+        esyslog("Could not read data");
       break;
     }
+
+    if (!ReadRequests())
+      break;
   }
 
   /* If thread is ended due to closed connection delete a
@@ -171,9 +271,9 @@ void* cVNSIClient::Process(void)
   return NULL;
 }
 
-bool cVNSIClient::StartChannelStreaming(ChannelPtr channel, uint8_t timeshift, uint32_t timeout)
+bool cVNSIClient::StartChannelStreaming(ChannelPtr channel, uint8_t timeshift, uint32_t timeout, int batchTime)
 {
-  m_Streamer    = new cLiveStreamer(m_Id, timeshift, timeout);
+  m_Streamer    = new cLiveStreamer(m_Id, timeshift, timeout, batchTime);
   m_isStreaming = m_Streamer->StreamChannel(channel, &m_socket, m_resp);
   if (!m_isStreaming)
   {
@@ -369,12 +469,10 @@ bool cVNSIClient::processRequest(cRequestPacket* req)
   CLockObject lock(m_msgLock);
 
   m_req = req;
-  m_resp = new cResponsePacket();
+  m_resp = &m_response;
   if (!m_resp->init(m_req->getRequestID()))
   {
     esyslog("Response packet init fail");
-    delete m_resp;
-    delete m_req;
     m_resp = NULL;
     m_req = NULL;
     return false;
@@ -408,6 +506,10 @@ bool cVNSIClient::processRequest(cRequestPacket* req)
       result = process_StoreSetup();
       break;
 
+    case VNSI_GETMETRICS:
+      result = process_GetMetrics();
+      break;
+
     /** OPCODE 20 - 39: VNSI network functions for live streaming */
     case VNSI_CHANNELSTREAM_OPEN:
       result = processChannelStream_Open();
@@ -574,10 +676,8 @@ bool cVNSIClient::processRequest(cRequestPacket* req)
       break;
   }
 
-  delete m_resp;
+  m_resp->trim(MAX_RETAINED_RESPONSE_SIZE);
   m_resp = NULL;
-
-  delete m_req;
   m_req = NULL;
 
   return result;
@@ -702,6 +802,15 @@ bool cVNSIClient::process_StoreSetup() /* OPCODE 9 */
   return true;
 }
 
+bool cVNSIClient::process_GetMetrics() /* OPCODE 10 */
+{
+  m_resp->add_U32(VNSI_RET_OK);
+  m_resp->add_String(cMetrics::Get().ToPrometheus());
+  m_resp->finalise();
+  m_socket.write(m_resp->getPtr(), m_resp->getLen());
+  return true;
+}
+
 /** OPCODE 20 - 39: VNSI network functions for live streaming */
 
 bool cVNSIClient::processChannelStream_Open() /* OPCODE 20 */
@@ -710,6 +819,14 @@ bool cVNSIClient::processChannelStream_Open() /* OPCODE 20 */
   int32_t priority = m_req->extract_S32(); // Unused
   uint8_t timeshift = m_req->extract_U8();
   uint32_t timeout = m_req->extract_U32();
+  // Optional: how long (ms) small packets may wait to be sent together. A
+  // client can't make the server hold back its stream for long.
+  int batchTime = -1;
+  if (!m_req->end())
+  {
+    const uint32_t maxBatchTime = std::max(cSettings::Get().m_iStreamBatchTime, MAX_STREAM_BATCH_TIME);
+    batchTime = (int)std::min(m_req->extract_U32(), maxBatchTime);
+  }
 
   if(timeout == 0)
     timeout = cSettings::Get().m_StreamTimeout;
@@ -726,7 +843,7 @@ bool cVNSIClient::processChannelStream_Open() /* OPCODE 20 */
   }
   else
   {
-    if (StartChannelStreaming(channel, timeshift, timeout))
+    if (StartChannelStreaming(channel, timeshift, timeout, batchTime))
     {
       isyslog("Started streaming of channel %s (timeout %i seconds)", channel->Name().c_str(), timeout);
       // return here without sending the response
@@ -833,6 +950,25 @@ bool cVNSIClient::processRecStream_GetBlock() /* OPCODE 42 */
   uint64_t position  = m_req->extract_U64();
   uint32_t amount    = m_req->extract_U32();
 
+  // send the block straight from the recording if it's on a native
+  // filesystem, the header goes first
+  int fd;
+  uint64_t filePosition;
+  int length = m_RecPlayer->getBlockRange(position, amount, &fd, &filePosition);
+  if (length > 0)
+  {
+    m_resp->finalise(length);
+    if (m_socket.sendfile(m_resp->getPtr(), m_resp->getLen(), fd, filePosition, length) < 0)
+    {
+      // the client can't tell where the next response starts anymore
+      esyslog("%s - failed to send block, closing connection", __FUNCTION__);
+      m_socket.Shutdown();
+      return false;
+    }
+    m_RecPlayer->blockSent(filePosition, length);
+    return true;
+  }
+
   uint8_t* p = m_resp->reserve(amount);
   uint32_t amountReceived = m_RecPlayer->getBlock(p, position, amount);
 
@@ -958,8 +1094,8 @@ bool cVNSIClient::processCHANNELS_GetChannels() /* OPCODE 63 */
   int caid;
   int caid_idx;
 
-  ChannelVector channels = cChannelManager::Get().GetCurrent();
-  for (ChannelVector::const_iterator it = channels.begin(); it != channels.end(); ++it)
+  ChannelVectorPtr channels = cChannelManager::Get().GetCurrent();
+  for (ChannelVector::const_iterator it = channels->begin(); it != channels->end(); ++it)
   {
     const ChannelPtr& channel = *it;
     if (radio != CChannelFilter::IsRadio(channel))
@@ -1058,8 +1194,8 @@ bool cVNSIClient::processCHANNELS_GetGroupMembers()
   bool automatic = group->Automatic();
   std::string name;
 
-  ChannelVector channels = cChannelManager::Get().GetCurrent();
-  for (ChannelVector::const_iterator it = channels.begin(); it != channels.end(); ++it)
+  ChannelVectorPtr channels = cChannelManager::Get().GetCurrent();
+  for (ChannelVector::const_iterator it = channels->begin(); it != channels->end(); ++it)
   {
     ChannelPtr channel = *it;
 
@@ -1631,8 +1767,8 @@ bool cVNSIClient::processEPG_GetForChannel() /* OPCODE 120 */
 
   m_epgUpdate[channelUID].Reset();
 
-  EventVector events = cScheduleManager::Get().GetEvents(channel->ID());
-  if (events.empty())
+  cEventRange schedule = cScheduleManager::Get().GetEvents(channel->ID());
+  if (schedule.empty())
   {
     m_resp->add_U32(0);
     m_resp->finalise();
@@ -1645,8 +1781,6 @@ bool cVNSIClient::processEPG_GetForChannel() /* OPCODE 120 */
   bool atLeastOneEvent = false;
 
   uint32_t    thisEventID;
-  CDateTime   thisEventStart;
-  CDateTime   thisEventEnd;
   uint32_t    thisEventDuration;
   uint32_t    thisEventContent;
   uint32_t    thisEventRating;
@@ -1654,7 +1788,11 @@ bool cVNSIClient::processEPG_GetForChannel() /* OPCODE 120 */
   const char* thisEventSubTitle;
   const char* thisEventDescription;
 
-  for (EventVector::const_iterator itEvent = events.begin(); itEvent != events.end(); ++itEvent)
+  // Skip events in the past and outside of the requested time window
+  const CDateTime now = CDateTime::GetCurrentDateTime().GetAsUTCDateTime();
+  cEventRange events = schedule.Between(std::max(startTime, now), duration != 0 ? endTime : CDateTime());
+
+  for (cEventRange::const_iterator itEvent = events.begin(); itEvent != events.end(); ++itEvent)
   {
     const EventPtr& event = *itEvent;
 
@@ -1662,21 +1800,10 @@ bool cVNSIClient::processEPG_GetForChannel() /* OPCODE 120 */
     thisEventTitle        = event->Title().c_str();
     thisEventSubTitle     = event->PlotOutline().c_str();
     thisEventDescription  = event->Plot().c_str();
-    thisEventStart        = event->StartTime();
-    thisEventEnd          = event->EndTime();
     thisEventDuration     = event->DurationSecs();
     thisEventContent      = event->Genre() & event->SubGenre(); // TODO
     thisEventRating       = event->ParentalRating();
 
-    //in the past filter
-    if (thisEventEnd < CDateTime::GetCurrentDateTime().GetAsUTCDateTime()) continue;
-
-    //start time filter
-    if (thisEventEnd <= startTime) continue;
-
-    //duration filter
-    if (duration != 0 && thisEventStart >= endTime) continue;
-
     if (!thisEventTitle)        thisEventTitle        = "";
     if (!thisEventSubTitle)     thisEventSubTitle     = "";
     if (!thisEventDescription)  thisEventDescription  = "";
@@ -1707,13 +1834,8 @@ bool cVNSIClient::processEPG_GetForChannel() /* OPCODE 120 */
   m_resp->finalise();
   m_socket.write(m_resp->getPtr(), m_resp->getLen());
 
-  CDateTime epgUpdate;
-  for (EventVector::const_iterator itEvent = events.begin(); itEvent != events.end(); ++itEvent)
-  {
-    if (!epgUpdate.IsValid() || (*itEvent)->StartTime() > epgUpdate)
-      epgUpdate = (*itEvent)->StartTime();
-  }
-
+  // The schedule is sorted, its last event starts last
+  CDateTime epgUpdate = schedule.back()->StartTime();
   if (epgUpdate.IsValid())
     m_epgUpdate[channelUID] = epgUpdate;
 
@@ -1825,6 +1947,8 @@ const char* cVNSIClient::OpcodeToString(uint8_t opcode)
     return "get setup";
   case VNSI_STORESETUP:
     return "store setup";
+  case VNSI_GETMETRICS:
+    return "get metrics";
   case VNSI_CHANNELSTREAM_OPEN:
     return "channel stream open";
   case VNSI_CHANNELSTREAM_CLOSE:
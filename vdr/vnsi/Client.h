@@ -34,6 +34,7 @@
 #include "utils/Observer.h"
 
 #include "utils/XSocket.h"
+#include "vnsi/net/ResponsePacket.h"
 
 #include <map>
 #include <string>
@@ -71,9 +72,24 @@ private:
 //  cVnsiOsdProvider *m_Osd;
   std::map<int, CDateTime> m_epgUpdate;
 
+  const bool       m_bEventDriven;
+  bool             m_bDisconnected;
+
+  // Receive buffer of the connection. Requests are parsed in place and the
+  // buffer and response packet are reused for all requests
+  uint8_t         *m_inBuffer;
+  uint32_t         m_inSize;
+  uint32_t         m_inStart;       // first byte of the next unprocessed request
+  uint32_t         m_inEnd;         // end of the received data
+  cResponsePacket  m_response;
+
 protected:
 
   bool processRequest(cRequestPacket* req);
+  bool HandleRequest(uint32_t channelID, uint32_t requestID, uint32_t opcode, uint8_t* data, uint32_t dataLength);
+  bool ReadRequests(void);
+  bool ParseRequests(void);
+  bool ReserveInBuffer(uint32_t size);
 
   virtual void* Process(void);
 
@@ -82,9 +98,23 @@ protected:
 
 public:
 
-  cVNSIClient(int fd, unsigned int id, const char *ClientAdr);
+  /*!
+   * @param bEventDriven Don't start a thread for this client. Requests are read
+   *                     by calling ProcessAvailable() when the socket is readable.
+   */
+  cVNSIClient(int fd, unsigned int id, const char *ClientAdr, bool bEventDriven = false);
   virtual ~cVNSIClient();
 
+  /*!
+   * Read the data that is pending on the socket without blocking and process
+   * the request once it's complete. Event-driven mode only.
+   * @return false if the connection was closed or is broken
+   */
+  bool ProcessAvailable(void);
+
+  int GetHandle(void) const { return m_socket.GetHandle(); }
+  bool IsDisconnected(void);
+
   void ChannelChange();
   void RecordingsChange();
   void TimerChange();
@@ -98,7 +128,7 @@ protected:
 
   void SetLoggedIn(bool yesNo) { m_loggedIn = yesNo; }
   void SetStatusInterface(bool yesNo) { m_StatusInterfaceEnabled = yesNo; }
-  bool StartChannelStreaming(ChannelPtr channel, uint8_t timeshift, uint32_t timeout);
+  bool StartChannelStreaming(ChannelPtr channel, uint8_t timeshift, uint32_t timeout, int batchTime);
   void StopChannelStreaming();
 
 private:
@@ -115,6 +145,7 @@ private:
   bool process_Ping();
   bool process_GetSetup();
   bool process_StoreSetup();
+  bool process_GetMetrics();
 
   bool processChannelStream_Open();
   bool processChannelStream_Close();
@@ -70,6 +70,7 @@ cVNSIServer::cVNSIServer(int listenPort)
   m_bEventsModified = false;
   m_bTimersModified = false;
   m_bRecordingsModified = false;
+  m_bEventDriven = false;
 
   m_ServerFD = socket(AF_INET, SOCK_STREAM, 0);
   if(m_ServerFD == -1)
@@ -96,12 +97,20 @@ cVNSIServer::cVNSIServer(int listenPort)
 
   listen(m_ServerFD, 10);
 
+  if (cSettings::Get().m_iServerWorkers > 0)
+  {
+    m_bEventDriven = m_workerPool.Start(cSettings::Get().m_iServerWorkers);
+    if (!m_bEventDriven)
+      esyslog("Failed to start VNSI worker threads, falling back to one thread per client");
+  }
+
   CreateThread();
 }
 
 cVNSIServer::~cVNSIServer()
 {
   StopThread(-1);
+  m_workerPool.Stop();
   for (ClientList::iterator i = m_clients.begin(); i != m_clients.end(); i++)
   {
     delete (*i);
@@ -178,10 +187,15 @@ void cVNSIServer::NewClientConnected(int fd)
   setsockopt(fd, SOL_TCP, TCP_NODELAY, &val, sizeof(val));
 
   isyslog("Client with ID %d connected: %s", m_IdCnt, cxSocket::ip2txt(sin.sin_addr.s_addr, sin.sin_port, buf));
-  cVNSIClient *connection = new cVNSIClient(fd, m_IdCnt, cxSocket::ip2txt(sin.sin_addr.s_addr, sin.sin_port, buf));
+  cVNSIClient *connection = new cVNSIClient(fd, m_IdCnt, cxSocket::ip2txt(sin.sin_addr.s_addr, sin.sin_port, buf), m_bEventDriven);
   PLATFORM::CLockObject lock(m_mutex);
-  m_clients.push_back(connection);
   m_IdCnt++;
+  if (m_bEventDriven && !m_workerPool.Add(connection))
+  {
+    delete connection;
+    return;
+  }
+  m_clients.push_back(connection);
 }
 
 void* cVNSIServer::Process(void)
@@ -240,7 +254,7 @@ void* cVNSIServer::Process(void)
       // remove disconnected clients
       for (ClientList::iterator i = m_clients.begin(); i != m_clients.end();)
       {
-        if (!(*i)->IsRunning())
+        if ((*i)->IsDisconnected())
         {
           isyslog("Client with ID %u seems to be disconnected, removing from client list", (*i)->GetID());
           delete (*i);
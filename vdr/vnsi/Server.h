@@ -24,6 +24,7 @@
  */
 #pragma once
 
+#include "WorkerPool.h"
 #include "lib/platform/threads/threads.h"
 #include "utils/Observer.h"
 
@@ -55,6 +56,8 @@ protected:
   bool             m_bEventsModified;
   bool             m_bTimersModified;
   bool             m_bRecordingsModified;
+  bool             m_bEventDriven;
+  cVNSIWorkerPool  m_workerPool;
   PLATFORM::CMutex m_mutex;
 };
 
@@ -0,0 +1,145 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "WorkerPool.h"
+#include "Client.h"
+#include "utils/log/Log.h"
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+using namespace PLATFORM;
+
+// Time after which idle workers check whether they should stop
+#define WORKER_POLL_TIMEOUT  250 // ms
+
+namespace VDR
+{
+
+cVNSIWorkerPool::cVNSIWorkerPool(void)
+ : m_epollFd(-1)
+{
+}
+
+cVNSIWorkerPool::~cVNSIWorkerPool(void)
+{
+  Stop();
+}
+
+bool cVNSIWorkerPool::Start(unsigned int workers)
+{
+  if (m_epollFd >= 0)
+    return true;
+
+  m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (m_epollFd < 0)
+  {
+    LOG_ERROR;
+    return false;
+  }
+
+  for (unsigned int i = 0; i < workers; i++)
+  {
+    cWorker* worker = new cWorker(*this);
+    if (!worker->CreateThread(false))
+    {
+      esyslog("failed to start VNSI worker thread %u", i);
+      delete worker;
+      break;
+    }
+    m_workers.push_back(worker);
+  }
+
+  if (m_workers.empty())
+  {
+    close(m_epollFd);
+    m_epollFd = -1;
+    return false;
+  }
+
+  isyslog("Serving VNSI clients with %u worker threads", (unsigned int)m_workers.size());
+  return true;
+}
+
+void cVNSIWorkerPool::Stop(void)
+{
+  // Signal all workers first so they wind down in parallel
+  for (std::vector<cWorker*>::iterator it = m_workers.begin(); it != m_workers.end(); ++it)
+    (*it)->StopThread(-1);
+  for (std::vector<cWorker*>::iterator it = m_workers.begin(); it != m_workers.end(); ++it)
+    delete *it;
+  m_workers.clear();
+
+  if (m_epollFd >= 0)
+  {
+    close(m_epollFd);
+    m_epollFd = -1;
+  }
+}
+
+bool cVNSIWorkerPool::Add(cVNSIClient* client)
+{
+  return Arm(client, EPOLL_CTL_ADD);
+}
+
+bool cVNSIWorkerPool::Arm(cVNSIClient* client, int op)
+{
+  struct epoll_event event = { };
+  event.events   = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+  event.data.ptr = client;
+
+  if (epoll_ctl(m_epollFd, op, client->GetHandle(), &event) < 0)
+  {
+    esyslog("failed to watch socket of client %u: %m", client->GetID());
+    return false;
+  }
+  return true;
+}
+
+void* cVNSIWorkerPool::cWorker::Process(void)
+{
+  while (!IsStopped())
+  {
+    struct epoll_event event;
+    int ret = epoll_wait(m_pool.m_epollFd, &event, 1, WORKER_POLL_TIMEOUT);
+    if (ret < 0)
+    {
+      if (errno != EINTR)
+      {
+        LOG_ERROR;
+        Sleep(WORKER_POLL_TIMEOUT);
+      }
+      continue;
+    }
+    if (ret == 0)
+      continue;
+
+    // The socket is disarmed until the request has been handled. A client
+    // that disconnected is left for the server to clean up
+    cVNSIClient* client = static_cast<cVNSIClient*>(event.data.ptr);
+    if (client->ProcessAvailable())
+      m_pool.Arm(client, EPOLL_CTL_MOD);
+  }
+
+  return NULL;
+}
+
+}
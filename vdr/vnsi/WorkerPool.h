@@ -0,0 +1,74 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "lib/platform/threads/threads.h"
+
+#include <vector>
+
+namespace VDR
+{
+
+class cVNSIClient;
+
+/*!
+ * \brief Serves the requests of all event-driven clients from a fixed number of
+ *        threads
+ *
+ * Client sockets are registered one-shot with a shared epoll instance. The
+ * worker that receives the event owns the client until it re-arms the socket,
+ * so a client never has two requests in flight and idle connections don't
+ * cost a thread.
+ */
+class cVNSIWorkerPool
+{
+public:
+  cVNSIWorkerPool(void);
+  ~cVNSIWorkerPool(void);
+
+  bool Start(unsigned int workers);
+  void Stop(void);
+
+  /*!
+   * \brief Start serving a client. The client must remain valid until it
+   *        reports IsDisconnected() or the pool is stopped.
+   */
+  bool Add(cVNSIClient* client);
+
+private:
+  class cWorker : public PLATFORM::CThread
+  {
+  public:
+    cWorker(cVNSIWorkerPool& pool) : m_pool(pool) { }
+    virtual ~cWorker(void) { }
+
+    virtual void* Process(void);
+
+  private:
+    cVNSIWorkerPool& m_pool;
+  };
+
+  bool Arm(cVNSIClient* client, int op);
+
+  int                   m_epollFd;
+  std::vector<cWorker*> m_workers;
+};
+
+}
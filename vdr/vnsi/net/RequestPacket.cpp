@@ -36,11 +36,11 @@
 namespace VDR
 {
 
-cRequestPacket::cRequestPacket(uint32_t requestID, uint32_t opcode, uint8_t* data, uint32_t dataLength)
+cRequestPacket::cRequestPacket(uint32_t requestID, uint32_t opcode, uint8_t* data, uint32_t dataLength, bool ownData /* = true */)
  : userData(data), userDataLength(dataLength), opCode(opcode), requestID(requestID)
 {
   packetPos       = 0;
-  ownBlock        = true;
+  ownBlock        = ownData;
   channelID       = 0;
   streamID        = 0;
   flag            = 0;
@@ -138,6 +138,14 @@ int32_t cRequestPacket::extract_S32()
 
 uint8_t* cRequestPacket::getData()
 {
+  if (!ownBlock)
+  {
+    if (!userData) return NULL;
+    uint8_t* copy = (uint8_t*)malloc(userDataLength);
+    if (copy) memcpy(copy, userData, userDataLength);
+    return copy;
+  }
+
   ownBlock = false;
   return userData;
 }
@@ -29,7 +29,11 @@ namespace VDR
 class cRequestPacket
 {
 public:
-  cRequestPacket(uint32_t requestID, uint32_t opcode, uint8_t* data, uint32_t dataLength);
+  /*!
+   * @param ownData Free the data with free() when the packet is destroyed. Pass
+   *                false for data in a buffer that is owned by the connection.
+   */
+  cRequestPacket(uint32_t requestID, uint32_t opcode, uint8_t* data, uint32_t dataLength, bool ownData = true);
   ~cRequestPacket();
 
   int  serverError();
@@ -51,7 +55,8 @@ public:
 
   bool      end();
 
-  // If you call this, the memory becomes yours. Free with free()
+  // If you call this, the memory becomes yours. Free with free(). Data that
+  // isn't owned by the packet is copied
   uint8_t* getData();
 
 private:
@@ -156,6 +156,12 @@ void cResponsePacket::finalise()
   memcpy(&buffer[userDataLenPos], &ul, sizeof(uint32_t));
 }
 
+void cResponsePacket::finalise(uint32_t dataLen)
+{
+  uint32_t ul = htonl(bufUsed - headerLength + dataLen);
+  memcpy(&buffer[userDataLenPos], &ul, sizeof(uint32_t));
+}
+
 void cResponsePacket::finaliseStream()
 {
   uint32_t ul = htonl(bufUsed - headerLengthStream);
@@ -245,14 +251,27 @@ bool cResponsePacket::add_double(double d)
 }
 
 
+void cResponsePacket::trim(uint32_t maxSize)
+{
+  if (bufSize > maxSize)
+  {
+    free(buffer);
+    buffer = NULL;
+    bufSize = 0;
+  }
+  bufUsed = 0;
+}
+
 bool cResponsePacket::checkExtend(uint32_t by)
 {
   if ((bufUsed + by) < bufSize) return true;
-  if (512 > by) by = 512;
-  uint8_t* newBuf = (uint8_t*)realloc(buffer, bufSize + by);
+  // Grow geometrically, so long lists don't realloc every few entries
+  uint32_t newSize = bufSize * 2;
+  if (newSize < bufUsed + by + 512) newSize = bufUsed + by + 512;
+  uint8_t* newBuf = (uint8_t*)realloc(buffer, newSize);
   if (!newBuf) return false;
   buffer = newBuf;
-  bufSize += by;
+  bufSize = newSize;
   return true;
 }
 
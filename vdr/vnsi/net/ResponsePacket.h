@@ -43,6 +43,8 @@ public:
   bool initStatus(uint32_t opCode);
   bool initStream(uint32_t opCode, uint32_t streamID, uint32_t duration, int64_t pts, int64_t dts, uint32_t serial);
   void finalise();
+  // Finalise a packet that is followed by dataLen bytes sent separately
+  void finalise(uint32_t dataLen);
   void finaliseStream();
   void finaliseOSD();
   bool copyin(const uint8_t* src, uint32_t len);
@@ -62,6 +64,10 @@ public:
   uint32_t getOSDHeaderLength() { return headerLengthOSD; } ;
   void     setLen(uint32_t len) { bufUsed = len; }
 
+  // Packets are reused by calling one of the init methods again. This frees
+  // the buffer if an exceptionally large response made it grow beyond maxSize
+  void     trim(uint32_t maxSize);
+
 private:
   uint8_t* buffer;
   uint32_t bufSize;
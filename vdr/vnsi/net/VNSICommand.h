@@ -52,6 +52,7 @@
 #define VNSI_PING                  7
 #define VNSI_GETSETUP              8
 #define VNSI_STORESETUP            9
+#define VNSI_GETMETRICS            10
 
 /* OPCODE 20 - 39: VNSI network functions for live streaming */
 #define VNSI_CHANNELSTREAM_OPEN     20
@@ -30,10 +30,14 @@
 #include "Streamer.h"
 #include "timers/TimerManager.h"
 #include "utils/log/Log.h"
+#include "utils/metrics/Metrics.h"
 
 #include <assert.h>
 #include <libsi/si.h>
 
+#define PARSER_ERROR_METRIC  "vdr_parser_errors_total"
+#define SKIP_PACKETS_UNKNOWN ((uint64_t)-1) // overlap with the cached GOP not known yet
+
 using namespace PLATFORM;
 
 namespace VDR
@@ -50,13 +54,20 @@ cVNSIDemuxer::cVNSIDemuxer(int clientID, uint8_t timeshift) :
     m_SetRefTime(true),
     m_refTime(0),
     m_endTime(0),
-    m_wrapTime(0)
+    m_wrapTime(0),
+    m_parserErrorMetric(cMetrics::Get().Counter(PARSER_ERROR_METRIC, "Errors reported by the stream parsers",
+                                                cMetrics::Label("client", clientID))),
+    m_gopCacheReceiver(NULL),
+    m_cachedGOPPos(0),
+    m_cachedGOPEnd(0),
+    m_skipPackets(0)
 {
   memset(&m_PtsWrap, 0, sizeof(sPtsWrap));
 }
 
 cVNSIDemuxer::~cVNSIDemuxer()
 {
+  cMetrics::Get().Remove(PARSER_ERROR_METRIC, cMetrics::Label("client", m_clientID));
 }
 
 bool cVNSIDemuxer::Open(const ChannelPtr& channel, int serial)
@@ -94,11 +105,22 @@ bool cVNSIDemuxer::Open(const ChannelPtr& channel, int serial)
   if (!recording)
   {
     isyslog("Open channel %d-%d: %s", channel->Number(), channel->SubNumber(), channel->Name().c_str());
-    if (!(m_tunerHandle = cDeviceManager::Get().OpenVideoInput(m_VideoBuffer, TUNING_TYPE_LIVE_TV, channel)))
+    m_gopCache = cGOPCache::Get(channel);
+    m_gopCacheReceiver = new cGOPCacheReceiver(m_VideoBuffer, m_gopCache);
+    if (!(m_tunerHandle = cDeviceManager::Get().OpenVideoInput(m_gopCacheReceiver, TUNING_TYPE_LIVE_TV, channel)))
     {
       esyslog("Can't switch to channel %i - %s", channel->Number(), channel->Name().c_str());
       return false;
     }
+
+    // If somebody else is watching the channel, start with its last GOP. The
+    // packets our receiver got before the GOP ended are in both, they're
+    // skipped in the live data once we know how many there are.
+    m_cachedGOPEnd = m_gopCache->GetGOP(m_cachedGOP);
+    m_cachedGOPPos = 0;
+    m_skipPackets = m_cachedGOP.empty() ? 0 : SKIP_PACKETS_UNKNOWN;
+    if (!m_cachedGOP.empty())
+      dsyslog("Starting channel %s with a cached GOP of %u bytes", channel->Name().c_str(), (unsigned int)m_cachedGOP.size());
   }
 
   m_CurrentChannel = channel;
@@ -106,6 +128,13 @@ bool cVNSIDemuxer::Open(const ChannelPtr& channel, int serial)
 
   PidsChanged();
 
+  // Let the client know the streams right away, not only after parsing them
+  if (m_gopCache)
+  {
+    for (std::list<cTSStream*>::iterator it = m_Streams.begin(); it != m_Streams.end(); ++it)
+      m_gopCache->GetStreamInfo(*it);
+  }
+
   return true;
 }
 
@@ -118,6 +147,14 @@ void cVNSIDemuxer::Close()
     m_tunerHandle = cTunerHandle::EmptyHandle;
   }
 
+  delete m_gopCacheReceiver;
+  m_gopCacheReceiver = NULL;
+  m_gopCache.reset();
+  std::vector<uint8_t>().swap(m_cachedGOP);
+  m_cachedGOPPos = 0;
+  m_cachedGOPEnd = 0;
+  m_skipPackets = 0;
+
   if (m_VideoBuffer)
   {
     delete m_VideoBuffer;
@@ -180,14 +217,43 @@ int cVNSIDemuxer::Read(sStreamPacket *packet)
   // clear packet
   memset(packet, 0, sizeof(sStreamPacket));
 
-  // read TS Packet from buffer
-  len = m_VideoBuffer->Read(&buf, TS_SIZE, m_endTime, m_wrapTime);
+  if (m_cachedGOPPos < m_cachedGOP.size())
+  {
+    // replay the cached GOP first
+    buf = &m_cachedGOP[m_cachedGOPPos];
+    m_cachedGOPPos += TS_SIZE;
+  }
+  else
+  {
+    // read TS Packet from buffer
+    len = m_VideoBuffer->Read(&buf, TS_SIZE, m_endTime, m_wrapTime);
+
+    // eof
+    if (len == VIDEOBUFFER_EOF)
+      return VIDEOBUFFER_EOF;
+    else if (len != TS_SIZE)
+      return VIDEOBUFFER_NO_DATA;
 
-  // eof
-  if (len == VIDEOBUFFER_EOF)
-    return VIDEOBUFFER_EOF;
-  else if (len != TS_SIZE)
-    return VIDEOBUFFER_NO_DATA;
+    if (m_skipPackets == SKIP_PACKETS_UNKNOWN)
+    {
+      // buf is the first packet forwarded to our receiver
+      uint64_t overlap;
+      m_skipPackets = m_gopCacheReceiver->Overlap(m_cachedGOPEnd, overlap) ? overlap : 0;
+      if (!m_skipPackets)
+        std::vector<uint8_t>().swap(m_cachedGOP);
+    }
+
+    if (m_skipPackets)
+    {
+      // the cached GOP ends with packets we received too
+      m_skipPackets--;
+      if (!m_skipPackets)
+        std::vector<uint8_t>().swap(m_cachedGOP);
+      return 0;
+    }
+    else if (!m_cachedGOP.empty())
+      std::vector<uint8_t>().swap(m_cachedGOP);
+  }
 
   m_Error &= ~ERROR_DEMUX_NODATA;
 
@@ -214,6 +280,9 @@ int cVNSIDemuxer::Read(sStreamPacket *packet)
       if (packet->pts < m_FirstFramePTS)
         return 0;
 
+      if (packet->streamChange && m_gopCache)
+        m_gopCache->SetStreamInfo(stream);
+
 
       packet->serial = m_MuxPacketSerial;
       if (m_SetRefTime)
@@ -227,6 +296,7 @@ int cVNSIDemuxer::Read(sStreamPacket *packet)
     else if (error < 0)
     {
       m_Error |= abs(error);
+      m_parserErrorMetric->Increment();
     }
   }
 
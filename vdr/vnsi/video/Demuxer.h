@@ -24,14 +24,17 @@
  */
 #pragma once
 
+#include "GOPCache.h"
 #include "parser/Parser.h"
 #include "channels/ChannelTypes.h"
 #include "devices/Remux.h"
 #include "utils/Observer.h"
+#include "utils/metrics/Metrics.h"
 
 #include <list>
 #include <stdint.h>
 #include <set>
+#include <vector>
 
 namespace VDR
 {
@@ -111,6 +114,13 @@ protected:
   time_t m_refTime, m_endTime, m_wrapTime;
   uint8_t m_timeshift;
   TunerHandlePtr m_tunerHandle;
+  MetricCounterPtr m_parserErrorMetric;
+  GOPCachePtr m_gopCache;
+  cGOPCacheReceiver *m_gopCacheReceiver;
+  std::vector<uint8_t> m_cachedGOP;     // replayed before the live packets
+  size_t m_cachedGOPPos;
+  uint64_t m_cachedGOPEnd;              // cache position m_cachedGOP ends at
+  uint64_t m_skipPackets;               // live packets that are in m_cachedGOP too
 };
 
 }
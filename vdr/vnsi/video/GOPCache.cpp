@@ -0,0 +1,276 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "GOPCache.h"
+#include "channels/Channel.h"
+#include "devices/Remux.h"
+#include "utils/CommonMacros.h"
+#include "vnsi/video/parser/Parser.h"
+
+using namespace PLATFORM;
+
+// A GOP that doesn't fit isn't cached at all
+#define GOPCACHE_MAXSIZE  (MEGABYTE(8) / TS_SIZE * TS_SIZE)
+
+namespace VDR
+{
+
+GOPCachePtr cGOPCache::Get(const ChannelPtr& channel)
+{
+  static CMutex mutex;
+  static std::map<cChannelID, std::weak_ptr<cGOPCache> > caches;
+
+  CLockObject lock(mutex);
+
+  for (std::map<cChannelID, std::weak_ptr<cGOPCache> >::iterator it = caches.begin(); it != caches.end(); )
+  {
+    if (it->second.expired())
+      caches.erase(it++);
+    else
+      ++it;
+  }
+
+  GOPCachePtr cache = caches[channel->ID()].lock();
+  if (!cache)
+  {
+    cache = GOPCachePtr(new cGOPCache(channel));
+    caches[channel->ID()] = cache;
+  }
+  return cache;
+}
+
+cGOPCache::cGOPCache(const ChannelPtr& channel)
+ : m_videoPid(channel->GetVideoStream().vpid),
+   m_isH264(channel->GetVideoStream().vtype == STREAM_TYPE_14496_H264_VIDEO),
+   m_feeder(NULL),
+   m_received(0),
+   m_hasLastPacket(false),
+   m_synced(false)
+{
+}
+
+void cGOPCache::Put(const iReceiver* source, const uint8_t* data, size_t len)
+{
+  CLockObject lock(m_mutex);
+
+  if (source != m_feeder)
+  {
+    if (m_feeder)
+      return;
+
+    // The new feeder may have missed packets of the current GOP
+    m_feeder = source;
+    m_hasLastPacket = false;
+    Reset();
+  }
+
+  for (; len >= TS_SIZE; data += TS_SIZE, len -= TS_SIZE)
+  {
+    m_received++;
+
+    if (len < 2 * TS_SIZE)
+    {
+      memcpy(m_lastPacket, data, TS_SIZE);
+      m_hasLastPacket = true;
+    }
+
+    if (m_videoPid && TsPid(data) == m_videoPid && IsRandomAccessPoint(data))
+    {
+      m_gop.clear();
+      m_synced = true;
+    }
+
+    if (!m_synced)
+      continue;
+
+    if (m_gop.size() + TS_SIZE > GOPCACHE_MAXSIZE)
+    {
+      Reset();
+      continue;
+    }
+
+    m_gop.insert(m_gop.end(), data, data + TS_SIZE);
+  }
+}
+
+void cGOPCache::Detach(const iReceiver* source)
+{
+  CLockObject lock(m_mutex);
+  if (source == m_feeder)
+    m_feeder = NULL;
+}
+
+uint64_t cGOPCache::Received(void) const
+{
+  CLockObject lock(m_mutex);
+  return m_received;
+}
+
+uint64_t cGOPCache::Position(const uint8_t* data) const
+{
+  CLockObject lock(m_mutex);
+  if (m_hasLastPacket && memcmp(data, m_lastPacket, TS_SIZE) == 0)
+    return m_received - 1;
+  return m_received;
+}
+
+uint64_t cGOPCache::GetGOP(std::vector<uint8_t>& gop) const
+{
+  CLockObject lock(m_mutex);
+  gop = m_gop;
+  return m_received;
+}
+
+void cGOPCache::SetStreamInfo(cTSStream* stream)
+{
+  sStreamProperties props = { };
+  props.type = stream->Type();
+  stream->GetVideoInformation(props.fpsScale, props.fpsRate, props.height, props.width, props.aspect);
+  stream->GetAudioInformation(props.channels, props.sampleRate, props.bitRate, props.bitsPerSample, props.blockAlign);
+
+  CLockObject lock(m_mutex);
+  m_streams[stream->GetPID()] = props;
+}
+
+bool cGOPCache::GetStreamInfo(cTSStream* stream) const
+{
+  CLockObject lock(m_mutex);
+
+  std::map<int, sStreamProperties>::const_iterator it = m_streams.find(stream->GetPID());
+  if (it == m_streams.end() || it->second.type != stream->Type())
+    return false;
+
+  const sStreamProperties& props = it->second;
+  if (props.height && props.width)
+    stream->SetVideoInformation(props.fpsScale, props.fpsRate, props.height, props.width, props.aspect);
+  else if (props.sampleRate)
+    stream->SetAudioInformation(props.channels, props.sampleRate, props.bitRate, props.bitsPerSample, props.blockAlign);
+  else
+    return false;
+
+  return true;
+}
+
+bool cGOPCache::IsRandomAccessPoint(const uint8_t* data) const
+{
+  if (!TsPayloadStart(data) || !TsHasPayload(data) || TsIsScrambled(data))
+    return false;
+
+  // The broadcaster may flag it in the adaptation field
+  if (TsHasAdaptationField(data) && data[4] > 0 && (data[5] & 0x40))
+    return true;
+
+  const int offset = TsPayloadOffset(data);
+  const uint8_t* pes = data + offset;
+  const int pesLength = TS_SIZE - offset;
+  if (pesLength < 9 || pes[0] != 0x00 || pes[1] != 0x00 || pes[2] != 0x01)
+    return false;
+
+  // Look at the start codes at the beginning of the frame
+  for (int i = PesPayloadOffset(pes); i + 5 < pesLength; i++)
+  {
+    if (pes[i] != 0x00 || pes[i + 1] != 0x00 || pes[i + 2] != 0x01)
+      continue;
+
+    const uint8_t code = pes[i + 3];
+    if (m_isH264)
+    {
+      const uint8_t nalType = code & 0x1F;
+      if (nalType == 7 || nalType == 5) // SPS or IDR slice
+        return true;
+      if (nalType >= 1 && nalType <= 4) // other slice
+        return false;
+    }
+    else
+    {
+      if (code == 0xB3 || code == 0xB8) // sequence or GOP header
+        return true;
+      if (code == 0x00) // picture, check its coding type
+        return ((pes[i + 5] >> 3) & 0x07) == PKT_I_FRAME;
+    }
+  }
+
+  return false;
+}
+
+void cGOPCache::Reset(void)
+{
+  m_gop.clear();
+  m_synced = false;
+}
+
+// --- cGOPCacheReceiver -------------------------------------------------------
+
+cGOPCacheReceiver::cGOPCacheReceiver(iReceiver* receiver, const GOPCachePtr& cache)
+ : m_receiver(receiver),
+   m_cache(cache),
+   m_attached(false),
+   m_attachedAt(0)
+{
+}
+
+cGOPCacheReceiver::~cGOPCacheReceiver(void)
+{
+  m_cache->Detach(this);
+}
+
+void cGOPCacheReceiver::Stop(void)
+{
+  m_cache->Detach(this);
+  m_receiver->Stop();
+}
+
+void cGOPCacheReceiver::Receive(const uint16_t pid, const uint8_t* data, const size_t len, ts_crc_check_t& crcvalid)
+{
+  Forwarding(data);
+  m_receiver->Receive(pid, data, len, crcvalid);
+  m_cache->Put(this, data, len);
+}
+
+void cGOPCacheReceiver::ReceivePacket(const uint16_t pid, const cTsPacketRef& packet)
+{
+  Forwarding(packet.Data());
+  m_receiver->ReceivePacket(pid, packet);
+  m_cache->Put(this, packet.Data(), TS_SIZE);
+}
+
+bool cGOPCacheReceiver::Overlap(uint64_t gopEnd, uint64_t& packets) const
+{
+  CLockObject lock(m_mutex);
+  if (!m_attached)
+    return false;
+
+  packets = gopEnd > m_attachedAt ? gopEnd - m_attachedAt : 0;
+  return true;
+}
+
+void cGOPCacheReceiver::Forwarding(const uint8_t* data)
+{
+  // Only the first packet is of interest, and it's recorded before the
+  // receiver can pass it on
+  CLockObject lock(m_mutex);
+  if (!m_attached)
+  {
+    m_attachedAt = m_cache->Position(data);
+    m_attached = true;
+  }
+}
+
+}
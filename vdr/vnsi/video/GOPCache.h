@@ -0,0 +1,157 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "channels/ChannelID.h"
+#include "channels/ChannelTypes.h"
+#include "devices/Receiver.h"
+#include "devices/Remux.h"
+#include "lib/platform/threads/mutex.h"
+
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+namespace VDR
+{
+
+class cTSStream;
+
+class cGOPCache;
+typedef std::shared_ptr<cGOPCache> GOPCachePtr;
+
+/*!
+ * Keeps the most recent group of pictures of a channel, starting at its last
+ * random access point, and the stream properties the parsers found. A client
+ * that tunes to a channel somebody is already watching replays the GOP instead
+ * of waiting for the next I-frame. A cache lives as long as clients hold it.
+ */
+class cGOPCache
+{
+public:
+  /*!
+   * Get the cache of a channel, or a new one if nobody is receiving it
+   */
+  static GOPCachePtr Get(const ChannelPtr& channel);
+
+  /*!
+   * Add TS packets. Only one receiver feeds the cache at a time, the packets
+   * of others are ignored until it detaches.
+   */
+  void Put(const iReceiver* source, const uint8_t* data, size_t len);
+  void Detach(const iReceiver* source);
+
+  /*!
+   * The number of packets fed to the cache so far
+   */
+  uint64_t Received(void) const;
+
+  /*!
+   * The number of packets fed to the cache before the TS packet at data. All
+   * receivers of a device get a packet in turn, so the feeder may have put it
+   * already.
+   */
+  uint64_t Position(const uint8_t* data) const;
+
+  /*!
+   * Copy the cached GOP to gop, which is left empty if the cache hasn't seen a
+   * random access point yet. Returns the value of Received() the GOP ends at.
+   */
+  uint64_t GetGOP(std::vector<uint8_t>& gop) const;
+
+  /*!
+   * Remember the properties of a stream, or preset a new stream with them.
+   * GetStreamInfo() returns false if nothing is known about the stream.
+   */
+  void SetStreamInfo(cTSStream* stream);
+  bool GetStreamInfo(cTSStream* stream) const;
+
+private:
+  struct sStreamProperties
+  {
+    int      type;
+    uint32_t fpsScale;
+    uint32_t fpsRate;
+    uint32_t height;
+    uint32_t width;
+    double   aspect;
+    uint32_t channels;
+    uint32_t sampleRate;
+    uint32_t bitRate;
+    uint32_t bitsPerSample;
+    uint32_t blockAlign;
+  };
+
+  cGOPCache(const ChannelPtr& channel);
+
+  bool IsRandomAccessPoint(const uint8_t* data) const;
+  void Reset(void);
+
+  const uint16_t                  m_videoPid;
+  const bool                      m_isH264;
+  const iReceiver*                m_feeder;
+  uint64_t                        m_received;
+  uint8_t                         m_lastPacket[TS_SIZE]; // Put by m_feeder
+  bool                            m_hasLastPacket;
+  bool                            m_synced;   // m_gop starts at a random access point
+  std::vector<uint8_t>            m_gop;
+  std::map<int, sStreamProperties> m_streams; // by PID
+  PLATFORM::CMutex                m_mutex;
+};
+
+/*!
+ * Attached to a device in place of a client's receiver, forwards the packets
+ * to it and feeds them to the channel's cache
+ */
+class cGOPCacheReceiver : public iReceiver
+{
+public:
+  cGOPCacheReceiver(iReceiver* receiver, const GOPCachePtr& cache);
+  virtual ~cGOPCacheReceiver(void);
+
+  virtual bool Start(void) { return m_receiver->Start(); }
+  virtual void Stop(void);
+  virtual void Receive(const uint16_t pid, const uint8_t* data, const size_t len, ts_crc_check_t& crcvalid);
+  virtual bool ReceivesPackets(void) const { return m_receiver->ReceivesPackets(); }
+  virtual void ReceivePacket(const uint16_t pid, const cTsPacketRef& packet);
+
+  virtual void LockAcquired(void) { m_receiver->LockAcquired(); }
+  virtual void LockLost(void) { m_receiver->LockLost(); }
+  virtual void LostPriority(void) { m_receiver->LostPriority(); }
+
+  /*!
+   * The number of packets up to gopEnd (see cGOPCache::GetGOP()) that were
+   * forwarded to the receiver too. Returns false if no packet was forwarded
+   * yet.
+   */
+  bool Overlap(uint64_t gopEnd, uint64_t& packets) const;
+
+private:
+  void Forwarding(const uint8_t* data);
+
+  iReceiver* const        m_receiver;
+  const GOPCachePtr       m_cache;
+  bool                    m_attached;
+  uint64_t                m_attachedAt; // Cache position of the first forwarded packet
+  PLATFORM::CMutex        m_mutex;
+};
+
+}
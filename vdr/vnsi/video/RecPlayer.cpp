@@ -33,23 +33,160 @@
 #include "recordings/filesystem/IndexFile.h"
 #include "utils/log/Log.h"
 #include "utils/StringUtils.h"
+#include "utils/ThreadPool.h"
 
+#include <algorithm>
 #include <fcntl.h>
+#include <functional>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 using namespace std;
+using namespace PLATFORM;
+
+// Size of the blocks requested by the client is capped at this
+#define MAXBLOCKSIZE      (512*1024)
+
+// After this many blocks read in order, playback is considered sequential
+// and the following blocks are read ahead
+#define SEQUENTIALREADS   2
+
+// Number of blocks read ahead in one go
+#define READAHEADBLOCKS   8
+
+// Threads shared by all playbacks to read ahead. Kept small so concurrent
+// playbacks on a spinning disk are served with large reads instead of seeks.
+#define READAHEADTHREADS  2
 
 namespace VDR
 {
 
+static cThreadPool& ReadaheadPool(void)
+{
+  static cThreadPool pool(READAHEADTHREADS);
+  return pool;
+}
+
+// --- cReadahead --------------------------------------------------------------
+
+/*!
+ * Window of a segment file that is filled ahead of the client on the
+ * readahead pool. The segment is opened a second time so the pool never
+ * shares a file position with the client thread. Jobs hold a reference, so
+ * the window stays valid when the player closes the segment meanwhile.
+ */
+class cReadahead : public std::enable_shared_from_this<cReadahead>
+{
+public:
+  cReadahead(const std::string& strFileName)
+   : m_strFileName(strFileName),
+     m_position(0),
+     m_bIdle(true),
+     m_pendingPosition(0),
+     m_pendingLength(0)
+  {
+  }
+
+  /*!
+   * \brief Copy up to amount bytes at position from the window. Waits for a
+   *        pending fill that covers position.
+   * \return The number of bytes copied, 0 if position isn't in the window
+   */
+  int Read(unsigned char* buffer, uint64_t position, int amount);
+
+  /*!
+   * \brief Fill the window with length bytes at position on the pool, unless
+   *        a fill is pending or the window still holds half of that range
+   */
+  void Schedule(uint64_t position, unsigned int length);
+
+private:
+  void Fill(uint64_t position, unsigned int length);
+
+  const std::string    m_strFileName;
+  CFile                m_file;            // Only used by the (single) pending fill
+  std::vector<uint8_t> m_window;
+  uint64_t             m_position;        // Offset of m_window in the segment
+  bool                 m_bIdle;           // No fill is pending
+  uint64_t             m_pendingPosition;
+  unsigned int         m_pendingLength;
+  CMutex               m_mutex;
+  CCondition<bool>     m_condition;
+};
+
+int cReadahead::Read(unsigned char* buffer, uint64_t position, int amount)
+{
+  CLockObject lock(m_mutex);
+
+  if (!m_bIdle && m_pendingPosition <= position && position < m_pendingPosition + m_pendingLength)
+    m_condition.Wait(m_mutex, m_bIdle);
+
+  if (position < m_position || position >= m_position + m_window.size())
+    return 0;
+
+  size_t available = m_position + m_window.size() - position;
+  size_t count = std::min((size_t)amount, available);
+  memcpy(buffer, m_window.data() + (position - m_position), count);
+  return count;
+}
+
+void cReadahead::Schedule(uint64_t position, unsigned int length)
+{
+  CLockObject lock(m_mutex);
+
+  if (!m_bIdle)
+    return;
+
+  if (m_position <= position && position + length / 2 <= m_position + m_window.size())
+    return;
+
+  m_bIdle           = false;
+  m_pendingPosition = position;
+  m_pendingLength   = length;
+  ReadaheadPool().Submit(std::bind(&cReadahead::Fill, shared_from_this(), position, length));
+}
+
+void cReadahead::Fill(uint64_t position, unsigned int length)
+{
+  std::vector<uint8_t> data(length);
+  size_t bytesRead = 0;
+
+  if (m_file.IsOpen() || m_file.Open(m_strFileName))
+  {
+    m_file.Advise(position, length, FILE_ADVICE_WILLNEED);
+
+    if (m_file.Seek(position, SEEK_SET) == (int64_t)position)
+    {
+      while (bytesRead < length)
+      {
+        int64_t n = m_file.Read(data.data() + bytesRead, length - bytesRead);
+        if (n <= 0)
+          break;
+        bytesRead += n;
+      }
+    }
+  }
+  data.resize(bytesRead);
+
+  CLockObject lock(m_mutex);
+  m_window.swap(data);
+  m_position = position;
+  m_bIdle    = true;
+  m_condition.Broadcast();
+}
+
+// --- cRecPlayer --------------------------------------------------------------
+
 cRecPlayer::cRecPlayer(const RecordingPtr& rec, bool inProgress)
 {
   m_file          = NULL;
   m_fileOpen      = -1;
   m_recordingFilename = rec->URL();
   m_inProgress = inProgress;
+  m_nextPosition    = 0;
+  m_sequentialReads = 0;
 
   // FIXME find out max file path / name lengths
   m_pesrecording = rec->IsPesRecording();
@@ -163,9 +300,11 @@ bool cRecPlayer::openFile(int index)
     esyslog("file '%s' failed to open", m_fileName.c_str());
     m_fileOpen = -1;
     delete m_file;
+    m_file = NULL;
     return false;
   }
-  m_fileOpen = index;
+  m_fileOpen  = index;
+  m_readahead = std::make_shared<cReadahead>(m_fileName);
   return true;
 }
 
@@ -180,6 +319,7 @@ void cRecPlayer::closeFile()
     delete m_file;
   m_file     = NULL;
   m_fileOpen = -1;
+  m_readahead.reset();
 }
 
 uint64_t cRecPlayer::getLengthBytes()
@@ -192,11 +332,11 @@ uint32_t cRecPlayer::getLengthFrames()
   return m_totalFrames;
 }
 
-int cRecPlayer::getBlock(unsigned char* buffer, uint64_t position, int amount)
+int cRecPlayer::prepareBlock(uint64_t position, int& amount)
 {
-  // dont let the block be larger than 256 kb
-  if (amount > 512*1024)
-    amount = 512*1024;
+  // dont let the block be larger than 512 kb
+  if (amount > MAXBLOCKSIZE)
+    amount = MAXBLOCKSIZE;
 
   if ((uint64_t)amount > m_totalLength)
     amount = m_totalLength;
@@ -206,7 +346,7 @@ int cRecPlayer::getBlock(unsigned char* buffer, uint64_t position, int amount)
     reScan();
     if (position >= m_totalLength)
     {
-      return 0;
+      return -1;
     }
   }
 
@@ -214,35 +354,50 @@ int cRecPlayer::getBlock(unsigned char* buffer, uint64_t position, int amount)
     amount = m_totalLength - position;
 
   // work out what block "position" is in
-  int segmentNumber = -1;
-  for (int i = 0; i < m_segments.size(); i++)
-  {
-    if ((position >= m_segments[i]->start) && (position < m_segments[i]->end)) {
-      segmentNumber = i;
-      break;
-    }
-  }
+  int segmentNumber = segmentFromPosition(position);
 
   // segment not found / invalid position
   if (segmentNumber == -1)
-    return 0;
+    return -1;
 
   // open file (if not already open)
   if (!openFile(segmentNumber))
+    return -1;
+
+  return segmentNumber;
+}
+
+int cRecPlayer::getBlock(unsigned char* buffer, uint64_t position, int amount)
+{
+  int segmentNumber = prepareBlock(position, amount);
+  if (segmentNumber == -1)
     return 0;
 
   // work out position in current file
   uint64_t filePosition = position - m_segments[segmentNumber]->start;
 
-  // seek to position
-  if(m_file->Seek(filePosition, SEEK_SET) == -1)
+  if (position == m_nextPosition)
+    m_sequentialReads++;
+  else
+    m_sequentialReads = 0;
+
+  // serve the block from the readahead window if it's there
+  int bytes_read = m_readahead->Read(buffer, filePosition, amount);
+
+  if (bytes_read < amount)
   {
-    esyslog("unable to seek to position: %llu", filePosition);
-    return 0;
-  }
+    // seek to position
+    if(m_file->Seek(filePosition + bytes_read, SEEK_SET) == -1)
+    {
+      esyslog("unable to seek to position: %llu", filePosition + bytes_read);
+      return 0;
+    }
 
-  // try to read the block
-  int bytes_read = m_file->Read(buffer, amount);
+    // try to read the (rest of the) block
+    int ret = m_file->Read(buffer + bytes_read, amount - bytes_read);
+    if (ret > 0)
+      bytes_read += ret;
+  }
 
   // we may got stuck at end of segment
   if ((bytes_read == 0) && (position < m_totalLength))
@@ -253,16 +408,63 @@ int cRecPlayer::getBlock(unsigned char* buffer, uint64_t position, int amount)
     return 0;
   }
 
-  if (!m_inProgress)
+  m_nextPosition = position + bytes_read;
+
+  // playing sequentially, read the next blocks while the client is busy
+  // with this one
+  if (m_sequentialReads >= SEQUENTIALREADS && m_readahead)
+    m_readahead->Schedule(filePosition + bytes_read, READAHEADBLOCKS * amount);
+
+  if (!m_inProgress && m_file)
   {
     // Tell linux not to bother keeping the data in the FS cache
-//    XXX move to fs abstraction layer
-//    posix_fadvise(m_file, filePosition, bytes_read, POSIX_FADV_DONTNEED);
+    m_file->Advise(filePosition, bytes_read, FILE_ADVICE_DONTNEED);
   }
 
   return bytes_read;
 }
 
+int cRecPlayer::getBlockRange(uint64_t position, int amount, int* rfd, uint64_t* rfilePosition)
+{
+  int segmentNumber = prepareBlock(position, amount);
+  if (segmentNumber == -1)
+    return 0;
+
+  int fd = m_file->GetNativeHandle();
+  if (fd < 0)
+    return 0;
+
+  // the range can't span segments, the client asks again for the rest
+  const cSegment* segment = m_segments[segmentNumber];
+  if (position + amount > segment->end)
+    amount = segment->end - position;
+
+  *rfd           = fd;
+  *rfilePosition = position - segment->start;
+
+  if (position == m_nextPosition)
+    m_sequentialReads++;
+  else
+    m_sequentialReads = 0;
+  m_nextPosition = position + amount;
+
+  // playing sequentially, let the kernel read the next blocks while this one
+  // is sent. the readahead window isn't needed, no data passes through here.
+  if (m_sequentialReads >= SEQUENTIALREADS)
+    m_file->Advise(*rfilePosition + amount, READAHEADBLOCKS * amount, FILE_ADVICE_WILLNEED);
+
+  return amount;
+}
+
+void cRecPlayer::blockSent(uint64_t filePosition, int length)
+{
+  if (!m_inProgress && m_file)
+  {
+    // Tell linux not to bother keeping the data in the FS cache
+    m_file->Advise(filePosition, length, FILE_ADVICE_DONTNEED);
+  }
+}
+
 uint64_t cRecPlayer::positionFromFrameNumber(uint32_t frameNumber)
 {
   if (!m_indexFile) return 0;
@@ -292,15 +494,7 @@ uint32_t cRecPlayer::frameNumberFromPosition(uint64_t position)
     return m_totalFrames;
   }
 
-  int segmentNumber = -1;
-  for(int i = 0; i < m_segments.size(); i++)
-  {
-    if ((position >= m_segments[i]->start) && (position < m_segments[i]->end)) {
-      segmentNumber = i;
-      break;
-    }
-  }
-
+  int segmentNumber = segmentFromPosition(position);
   if(segmentNumber == -1) {
     return m_totalFrames;
   }
@@ -310,6 +504,23 @@ uint32_t cRecPlayer::frameNumberFromPosition(uint64_t position)
 }
 
 
+int cRecPlayer::segmentFromPosition(uint64_t position) const
+{
+  // segments are contiguous and ordered by start, find the last one that
+  // starts at or before position
+  vector<cSegment*>::const_iterator it = std::upper_bound(m_segments.begin(), m_segments.end(), position,
+      [](uint64_t pos, const cSegment* segment) { return pos < segment->start; });
+
+  if (it == m_segments.begin())
+    return -1;
+
+  --it;
+  if (position >= (*it)->end)
+    return -1;
+
+  return it - m_segments.begin();
+}
+
 bool cRecPlayer::getNextIFrame(uint32_t frameNumber, uint32_t direction, uint64_t* rfilePosition, uint32_t* rframeNumber, uint32_t* rframeLength)
 {
   // 0 = backwards
@@ -32,6 +32,7 @@
 
 #include "recordings/RecordingTypes.h"
 
+#include <memory>
 #include <stdint.h>
 #include <stdio.h>
 #include <string>
@@ -42,6 +43,7 @@ namespace VDR
 
 class CFile;
 class cIndexFile;
+class cReadahead;
 
 class cSegment
 {
@@ -59,6 +61,13 @@ public:
   uint32_t getLengthFrames();
   int getBlock(unsigned char* buffer, uint64_t position, int amount);
 
+  // Map the block at position to a range of the open segment's native file
+  // descriptor, so it can be sent without copying it. Returns the length of
+  // the range, or 0 if the block has to be read with getBlock(). The range
+  // is released with blockSent() once it went out.
+  int getBlockRange(uint64_t position, int amount, int* rfd, uint64_t* rfilePosition);
+  void blockSent(uint64_t filePosition, int length);
+
   bool openFile(int index);
   void closeFile();
 
@@ -72,6 +81,8 @@ private:
   void cleanup();
   std::string fileNameFromIndex(int index);
   void checkBufferSize(int s);
+  int prepareBlock(uint64_t position, int& amount);
+  int segmentFromPosition(uint64_t position) const;
 
   std::string m_fileName;
   cIndexFile *m_indexFile;
@@ -83,6 +94,9 @@ private:
   std::string m_recordingFilename;
   bool        m_pesrecording;
   bool        m_inProgress;
+  std::shared_ptr<cReadahead> m_readahead; // Reads ahead in the open segment
+  uint64_t    m_nextPosition;    // Position following the last block read
+  unsigned int m_sequentialReads; // Number of consecutive blocks read in order
 };
 
 }
@@ -29,6 +29,7 @@
 #include "vnsi/net/ResponsePacket.h"
 #include "recordings/Recordings.h"
 #include "settings/Settings.h"
+#include "utils/CommonMacros.h"
 #include "utils/log/Log.h"
 #include "utils/StringUtils.h"
 #include "utils/XSocket.h"
@@ -37,17 +38,54 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <time.h>
 
+#define SEND_LATENCY_METRIC  "vdr_client_send_seconds"
+#define SENT_BYTES_METRIC    "vdr_client_sent_bytes_total"
+#define DROPPED_METRIC       "vdr_client_dropped_frames_total"
+
+// A client falls behind when the socket's send queue fills up or writes start
+// to block. B-frames are shed first, then P-frames. Fill is in percent of the
+// send buffer, latency is the moving average of a write in microseconds.
+#define CONGESTION_FILL_B         50
+#define CONGESTION_FILL_P         85
+#define CONGESTION_LATENCY_B      10000
+#define CONGESTION_LATENCY_P      40000
+#define CONGESTION_HOLD           2000 // ms without congestion before shedding less
+
+// Audio, subtitle and teletext packets smaller than this are held back
+// (for at most the client's batch time) to go out with the next video frame
+#define BATCH_PACKET_SIZE         KILOBYTE(4)
+#define BATCH_QUEUE_SIZE          KILOBYTE(64)
+
 namespace VDR
 {
 
+namespace
+{
+  // Microseconds, from a local socket to a congested wireless link
+  std::vector<uint64_t> SendLatencyBuckets(void)
+  {
+    static const uint64_t buckets[] = { 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000 };
+    return std::vector<uint64_t>(buckets, buckets + sizeof(buckets) / sizeof(buckets[0]));
+  }
+}
+
 // --- cLiveStreamer -------------------------------------------------
 
-cLiveStreamer::cLiveStreamer(int clientID, uint8_t timeshift, uint32_t timeout)
- : m_Demuxer(clientID, timeshift)
- , m_scanTimeout(timeout)
+cLiveStreamer::cLiveStreamer(int clientID, uint8_t timeshift, uint32_t timeout, int batchTime)
+ : m_scanTimeout(timeout)
+ , m_BatchTime(batchTime)
+ , m_Demuxer(clientID, timeshift)
+ , m_clientID(clientID)
 {
+  const std::string strLabels = cMetrics::Label("client", clientID);
+  m_sendLatencyMetric = cMetrics::Get().Histogram(SEND_LATENCY_METRIC, "Time to write a stream packet to the client",
+                                                  SendLatencyBuckets(), 1000000.0, strLabels);
+  m_sentBytesMetric   = cMetrics::Get().Counter(SENT_BYTES_METRIC, "Stream bytes written to the client", strLabels);
+  m_droppedFramesMetric = cMetrics::Get().Counter(DROPPED_METRIC, "Video frames not sent because the client fell behind", strLabels);
+
   m_Channel         = cChannel::EmptyChannel;
   m_Socket          = NULL;
   m_IsAudioOnly     = false;
@@ -55,9 +93,14 @@ cLiveStreamer::cLiveStreamer(int clientID, uint8_t timeshift, uint32_t timeout)
   m_startup         = true;
   m_SignalLost      = false;
   m_IFrameSeen      = false;
+  m_DropLevel       = 0;
+  m_WaitIFrame      = false;
+  m_SendLatency     = 0;
 
   if(m_scanTimeout == 0)
     m_scanTimeout = cSettings::Get().m_StreamTimeout;
+  if(m_BatchTime < 0)
+    m_BatchTime = cSettings::Get().m_iStreamBatchTime;
 }
 
 cLiveStreamer::~cLiveStreamer()
@@ -67,6 +110,11 @@ cLiveStreamer::~cLiveStreamer()
   StopThread(5000);
   Close();
 
+  const std::string strLabels = cMetrics::Label("client", m_clientID);
+  cMetrics::Get().Remove(SEND_LATENCY_METRIC, strLabels);
+  cMetrics::Get().Remove(SENT_BYTES_METRIC, strLabels);
+  cMetrics::Get().Remove(DROPPED_METRIC, strLabels);
+
   dsyslog("Finished to delete live streamer");
 }
 
@@ -79,6 +127,9 @@ bool cLiveStreamer::Open(int serial)
   if (serial >= 0)
     m_Demuxer.SetSerial(serial);
 
+  // The parsers wait for an I-frame after opening anyway
+  m_WaitIFrame = false;
+
   return true;
 }
 
@@ -136,10 +187,14 @@ void* cLiveStreamer::Process(void)
         sendBufferStatus();
         bufferStatsTimer.Set(1000);
       }
+
+      if (!m_SendQueue.empty() && m_BatchTimer.TimedOut())
+        flushStreamPackets();
     }
     else if (ret == VIDEOBUFFER_NO_DATA)
     {
       // no data
+      flushStreamPackets();
       usleep(10000);
       if(m_last_tick.Elapsed() >= (uint64_t)(m_scanTimeout*1000))
       {
@@ -208,6 +263,13 @@ void cLiveStreamer::sendStreamPacket(sStreamPacket *pkt)
   if(pkt->size == 0)
     return;
 
+  if (pkt->frameType && DropFrame(pkt->frameType))
+  {
+    m_droppedFramesMetric->Add(1);
+    m_last_tick.Set(0);
+    return;
+  }
+
   if (!m_streamHeader.initStream(VNSI_STREAM_MUXPKT, pkt->id, pkt->duration, pkt->pts, pkt->dts, pkt->serial))
   {
     esyslog("stream response packet init fail");
@@ -216,17 +278,126 @@ void cLiveStreamer::sendStreamPacket(sStreamPacket *pkt)
   m_streamHeader.setLen(m_streamHeader.getStreamHeaderLength() + pkt->size);
   m_streamHeader.finaliseStream();
 
-  m_Socket->LockWrite();
-  m_Socket->write(m_streamHeader.getPtr(), m_streamHeader.getStreamHeaderLength(), -1, true);
-  m_Socket->write(pkt->data, pkt->size);
-  m_Socket->UnlockWrite();
+  uint8_t *header = m_streamHeader.getPtr();
+  const uint32_t headerLength = m_streamHeader.getStreamHeaderLength();
+
+  if (m_BatchTime > 0 && pkt->frameType == 0 && pkt->size < BATCH_PACKET_SIZE)
+  {
+    if (m_SendQueue.empty())
+      m_BatchTimer.Set(m_BatchTime);
+    m_SendQueue.insert(m_SendQueue.end(), header, header + headerLength);
+    m_SendQueue.insert(m_SendQueue.end(), pkt->data, pkt->data + pkt->size);
+    if (m_SendQueue.size() >= BATCH_QUEUE_SIZE)
+      flushStreamPackets();
+  }
+  else
+  {
+    // Whatever is queued goes out in the same write
+    struct iovec iov[3];
+    iov[0].iov_base = m_SendQueue.data();
+    iov[0].iov_len  = m_SendQueue.size();
+    iov[1].iov_base = header;
+    iov[1].iov_len  = headerLength;
+    iov[2].iov_base = pkt->data;
+    iov[2].iov_len  = pkt->size;
+    writeStream(iov, 3);
+  }
 
   m_last_tick.Set(0);
   m_SignalLost = false;
 }
 
+void cLiveStreamer::flushStreamPackets()
+{
+  if (m_SendQueue.empty())
+    return;
+
+  struct iovec iov;
+  iov.iov_base = m_SendQueue.data();
+  iov.iov_len  = m_SendQueue.size();
+  writeStream(&iov, 1);
+}
+
+void cLiveStreamer::writeStream(struct iovec *iov, int count)
+{
+  size_t size = 0;
+  for (int i = 0; i < count; i++)
+    size += iov[i].iov_len;
+
+  const uint64_t start = cMetrics::MonotonicUs();
+
+  m_Socket->writev(iov, count);
+
+  const uint64_t latency = cMetrics::MonotonicUs() - start;
+  m_sendLatencyMetric->Observe(latency);
+  m_SendLatency = (m_SendLatency * 7 + latency) / 8;
+  m_sentBytesMetric->Add(size);
+
+  m_SendQueue.clear();
+}
+
+bool cLiveStreamer::DropFrame(int frameType)
+{
+  UpdateCongestion();
+
+  // Never shed I-frames, they are where the client recovers
+  if (frameType == PKT_I_FRAME)
+  {
+    m_WaitIFrame = false;
+    return false;
+  }
+
+  if (m_WaitIFrame)
+    return true;
+
+  if (frameType == PKT_B_FRAME && m_DropLevel >= 1)
+    return true;
+
+  // Everything up to the next I-frame may reference a dropped P-frame
+  if (frameType == PKT_P_FRAME && m_DropLevel >= 2)
+  {
+    m_WaitIFrame = true;
+    return true;
+  }
+
+  return false;
+}
+
+void cLiveStreamer::UpdateCongestion()
+{
+  int queued, size;
+  int fill = m_Socket->sendQueue(queued, size) ? (int)((int64_t)queued * 100 / size) : 0;
+
+  int level = 0;
+  if (fill >= CONGESTION_FILL_P || m_SendLatency >= CONGESTION_LATENCY_P)
+    level = 2;
+  else if (fill >= CONGESTION_FILL_B || m_SendLatency >= CONGESTION_LATENCY_B)
+    level = 1;
+
+  // Shed more right away, but only back off one step after things calmed down
+  if (level >= m_DropLevel)
+  {
+    if (level > m_DropLevel)
+      dsyslog("client %d falls behind (send queue %d%%, write %llu us), dropping %s",
+              m_clientID, fill, (unsigned long long)m_SendLatency, level == 2 ? "P- and B-frames" : "B-frames");
+    if (level > 0)
+      m_CongestionTimer.Set(CONGESTION_HOLD);
+    m_DropLevel = level;
+  }
+  else if (m_CongestionTimer.TimedOut())
+  {
+    m_DropLevel--;
+    m_CongestionTimer.Set(CONGESTION_HOLD);
+    if (m_DropLevel == 0)
+      dsyslog("client %d caught up, sending all frames again", m_clientID);
+  }
+}
+
 void cLiveStreamer::sendStreamChange()
 {
+  // Messages must not overtake the packets queued before them
+  flushStreamPackets();
+
   cResponsePacket *resp = new cResponsePacket();
   if (!resp->initStream(VNSI_STREAM_CHANGE, 0, 0, 0, 0, 0))
   {
@@ -352,6 +523,8 @@ bool IsFrontendFound(void) { return false; } // TODO
 
 void cLiveStreamer::sendSignalInfo()
 {
+  flushStreamPackets();
+
   signal_quality_info_t info;
   if (!m_Demuxer.SignalQuality(info))
   {
@@ -407,6 +580,8 @@ void cLiveStreamer::sendSignalInfo()
 
 void cLiveStreamer::sendStreamStatus()
 {
+  flushStreamPackets();
+
   cResponsePacket *resp = new cResponsePacket();
   if (!resp->initStream(VNSI_STREAM_STATUS, 0, 0, 0, 0, 0))
   {
@@ -430,6 +605,11 @@ void cLiveStreamer::sendStreamStatus()
     isyslog("Channel: no data %d", error);
     resp->add_String(StringUtils::Format("Channel: no data"));
   }
+  else if (error & ERROR_PES_CONTINUITY)
+  {
+    isyslog("Channel: packets lost %d", error);
+    resp->add_String(StringUtils::Format("Channel: bad reception (%d)", error));
+  }
   else
   {
     isyslog("Channel: unknown error %d", error);
@@ -443,6 +623,8 @@ void cLiveStreamer::sendStreamStatus()
 
 void cLiveStreamer::sendBufferStatus()
 {
+  flushStreamPackets();
+
   cResponsePacket *resp = new cResponsePacket();
   if (!resp->initStream(VNSI_STREAM_BUFFERSTATS, 0, 0, 0, 0, 0))
   {
@@ -466,6 +648,8 @@ void cLiveStreamer::sendRefTime(sStreamPacket *pkt)
   if(pkt == NULL)
     return;
 
+  flushStreamPackets();
+
   cResponsePacket *resp = new cResponsePacket();
   if (!resp->initStream(VNSI_STREAM_REFTIME, 0, 0, 0, 0, 0))
   {
@@ -32,10 +32,14 @@
 #include "devices/Receiver.h"
 #include "lib/platform/threads/threads.h"
 #include "utils/Timer.h"
+#include "utils/metrics/Metrics.h"
 
 #include <linux/dvb/frontend.h>
 #include <linux/videodev2.h>
 #include <list>
+#include <vector>
+
+struct iovec;
 
 namespace VDR
 {
@@ -54,11 +58,15 @@ private:
   friend class cLiveReceiver;
 
   void sendStreamPacket(sStreamPacket *pkt);
+  void flushStreamPackets();
+  void writeStream(struct iovec *iov, int count);
   void sendStreamChange();
   void sendSignalInfo();
   void sendStreamStatus();
   void sendBufferStatus();
   void sendRefTime(sStreamPacket *pkt);
+  bool DropFrame(int frameType);
+  void UpdateCongestion();
 
   ChannelPtr        m_Channel;                      /*!> Channel to stream */
   cxSocket         *m_Socket;                       /*!> The socket class to communicate with client */
@@ -71,8 +79,19 @@ private:
   cTimeMs           m_last_tick;
   bool              m_SignalLost;
   bool              m_IFrameSeen;
+  int               m_DropLevel;                    /*!> Frames shed because the client falls behind: 0 none, 1 B-frames, 2 P- and B-frames */
+  bool              m_WaitIFrame;                   /*!> A reference frame was dropped, video resumes with the next I-frame */
+  uint64_t          m_SendLatency;                  /*!> Moving average of the socket write latency (in microseconds) */
+  cTimeMs           m_CongestionTimer;              /*!> Time left before the drop level may be lowered */
+  std::vector<uint8_t> m_SendQueue;                 /*!> Small stream packets waiting to share a write */
+  int               m_BatchTime;                    /*!> Longest time (in ms) a packet waits in m_SendQueue, 0 to send right away */
+  cTimeMs           m_BatchTimer;                   /*!> Time left before m_SendQueue must be sent */
   cResponsePacket   m_streamHeader;
   cVNSIDemuxer      m_Demuxer;
+  const int          m_clientID;
+  MetricHistogramPtr m_sendLatencyMetric;           /*!> Time to write a stream packet to the socket */
+  MetricCounterPtr   m_sentBytesMetric;             /*!> Stream bytes written to the socket */
+  MetricCounterPtr   m_droppedFramesMetric;         /*!> Video frames shed because of congestion */
 
 protected:
   virtual void* Process(void);
@@ -88,8 +107,11 @@ public:
    *    timeshift - also given to the demuxer
    *    timeout   - streamer thread timeout, or 0 to use default value
    *                (m_StreamTimeout from cSettings)
+   *    batchTime - time in ms small packets may wait to be sent together,
+   *                0 to send each right away, or -1 to use default value
+   *                (m_iStreamBatchTime from cSettings)
    */
-  cLiveStreamer(int clientID, uint8_t timeshift, uint32_t timeout = 0);
+  cLiveStreamer(int clientID, uint8_t timeshift, uint32_t timeout = 0, int batchTime = -1);
   virtual ~cLiveStreamer();
 
   void Activate(bool On);
@@ -28,6 +28,7 @@
 #include "devices/Remux.h"
 #include "filesystem/Directory.h"
 #include "lib/platform/threads/mutex.h"
+#include "lib/platform/threads/threads.h"
 #include "recordings/Recording.h"
 #include "settings/Settings.h"
 #include "utils/CommonMacros.h"
@@ -35,79 +36,107 @@
 #include "utils/Ringbuffer.h"
 #include "utils/StringUtils.h"
 
+#include <deque>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 using namespace PLATFORM;
 
 namespace VDR
 {
 
+#define SIMPLE_BUFFER_PACKETS (MEGABYTE(3) / TS_SIZE)
+#define SIMPLE_BUFFER_BLOCKS  (MEGABYTE(16) / (TS_PACKET_BLOCK_PACKETS * TS_SIZE))
+
+/*!
+ * Live buffer without timeshift. Holds references to the packets in the
+ * device's shared blocks instead of copying them. A block is pinned as long as
+ * one of its packets is queued, so when a receiver only gets a few packets of
+ * each block the number of blocks limits the buffer before its packets do.
+ */
 class cVideoBufferSimple : public cVideoBuffer
 {
 friend class cVideoBuffer;
 public:
   virtual void Receive(const uint16_t pid, const uint8_t* data, const size_t len, ts_crc_check_t& crcvalid);
+  virtual bool ReceivesPackets(void) const { return true; }
+  virtual void ReceivePacket(const uint16_t pid, const cTsPacketRef& packet);
   virtual int ReadBlock(uint8_t **buf, unsigned int size, time_t &endTime, time_t &wrapTime);
 
 protected:
   cVideoBufferSimple();
   virtual ~cVideoBufferSimple();
-  cRingBufferLinear *m_Buffer;
-  int m_BytesConsumed;
+
+  std::deque<cTsPacketRef> m_Packets;
+  size_t                   m_Blocks;   // Distinct blocks m_Packets are in
+  cTsPacketRef             m_Current;  // Returned by the last ReadBlock()
+  TsPacketBlockPtr         m_Block;    // Packets passed to Receive() are copied here
+  bool                     m_HasPackets;
+  CMutex                   m_Mutex;
+  CCondition<bool>         m_Condition;
 };
 
 cVideoBufferSimple::cVideoBufferSimple()
 {
-  m_Buffer = new cRingBufferLinear(MEGABYTE(3), TS_SIZE * 2, false);
-  m_Buffer->SetTimeouts(0, 100);
-  m_BytesConsumed = 0;
+  m_Blocks = 0;
+  m_HasPackets = false;
 }
 
 cVideoBufferSimple::~cVideoBufferSimple()
 {
-  if (m_Buffer)
-    delete m_Buffer;
 }
 
 void cVideoBufferSimple::Receive(const uint16_t pid, const uint8_t* data, const size_t len, ts_crc_check_t& crcvalid)
 {
-  m_Buffer->Put(data, len);
+  for (size_t pos = 0; pos + TS_SIZE <= len; pos += TS_SIZE)
+  {
+    if (!m_Block || m_Block->Full())
+      m_Block = cTsPacketBlockPool::Get().Allocate();
+    ReceivePacket(pid, cTsPacketRef(m_Block, m_Block->Append(data + pos)));
+  }
 }
 
-int cVideoBufferSimple::ReadBlock(uint8_t **buf, unsigned int size, time_t &endTime, time_t &wrapTime)
+void cVideoBufferSimple::ReceivePacket(const uint16_t pid, const cTsPacketRef& packet)
 {
-  int  readBytes;
-  if (m_BytesConsumed)
-  {
-    m_Buffer->Del(m_BytesConsumed);
-  }
-  m_BytesConsumed = 0;
-  *buf = m_Buffer->Get(readBytes);
-  if (!(*buf) || readBytes < TS_SIZE)
-  {
-    usleep(100);
-    return 0;
-  }
-  /* Make sure we are looking at a TS packet */
-  while (readBytes > TS_SIZE)
+  CLockObject lock(m_Mutex);
+
+  // Blocks are filled in order, the queue only moves on to new ones
+  const bool bNewBlock = m_Packets.empty() || m_Packets.back().Block() != packet.Block();
+  if (m_Packets.size() >= SIMPLE_BUFFER_PACKETS || (bNewBlock && m_Blocks >= SIMPLE_BUFFER_BLOCKS))
   {
-    if ((*buf)[0] == TS_SYNC_BYTE && (*buf)[TS_SIZE] == TS_SYNC_BYTE)
-      break;
-    m_BytesConsumed++;
-    (*buf)++;
-    readBytes--;
+    ReportOverflow(TS_SIZE);
+    return;
   }
 
-  if ((*buf)[0] != TS_SYNC_BYTE)
-  {
-    m_Buffer->Del(m_BytesConsumed);
-    m_BytesConsumed = 0;
+  m_Packets.push_back(packet);
+  if (bNewBlock)
+    m_Blocks++;
+  ReportQueue(m_Packets.size() * TS_SIZE);
+
+  m_HasPackets = true;
+  m_Condition.Signal();
+}
+
+int cVideoBufferSimple::ReadBlock(uint8_t **buf, unsigned int size, time_t &endTime, time_t &wrapTime)
+{
+  CLockObject lock(m_Mutex);
+
+  // The packet returned last time has been processed
+  m_Current = cTsPacketRef();
+
+  if (!m_Condition.Wait(m_Mutex, m_HasPackets, 100))
     return 0;
-  }
 
-  m_BytesConsumed += TS_SIZE;
+  m_Current = m_Packets.front();
+  m_Packets.pop_front();
+  m_HasPackets = !m_Packets.empty();
+  if (!m_HasPackets || m_Packets.front().Block() != m_Current.Block())
+    m_Blocks--;
+
+  // The packet is shared with other receivers, the demuxer only reads it
+  *buf = const_cast<uint8_t*>(m_Current.Data());
   endTime = 0;
   wrapTime = 0;
   return TS_SIZE;
@@ -260,6 +289,7 @@ void cVideoBufferRAM::Receive(const uint16_t pid, const uint8_t* data, const siz
 
   if (Available() + MARGIN >= m_BufferSize)
   {
+    ReportOverflow(len);
     return;
   }
 
@@ -288,6 +318,7 @@ void cVideoBufferRAM::Receive(const uint16_t pid, const uint8_t* data, const siz
   }
 
   time(&m_bufferEndTime);
+  ReportQueue(Available());
 }
 
 int cVideoBufferRAM::ReadBlock(uint8_t **buf, unsigned int size, time_t &endTime, time_t &wrapTime)
@@ -343,7 +374,17 @@ int cVideoBufferRAM::ReadBlock(uint8_t **buf, unsigned int size, time_t &endTime
 
 //-----------------------------------------------------------------------------
 
-class cVideoBufferFile : public cVideoBufferTimeshift
+// Receive() runs on the device's dispatch thread, so it only stages packets in
+// memory. A writer thread moves them to the file in chunks. Chunks are whole
+// pages and whole TS packets (47 * 4096 = 1024 * 188), so every write starts
+// at a packet boundary.
+#define STAGINGBUFSIZE    (MEGABYTE(8) / TS_SIZE * TS_SIZE)
+#define STAGINGCHUNKSIZE  (47 * KILOBYTE(4))
+#define STAGINGFLUSHTIME  100 // milliseconds
+
+#define STAGING_METRIC    "vdr_timeshift_staging_bytes"
+
+class cVideoBufferFile : public cVideoBufferTimeshift, protected PLATFORM::CThread
 {
 friend class cVideoBuffer;
 public:
@@ -358,9 +399,13 @@ protected:
   virtual ~cVideoBufferFile();
   virtual bool Init();
   virtual int ReadBytes(uint8_t *buf, off_t pos, unsigned int size);
+  virtual void* Process(void);
+  int WriteStaged(const uint8_t *buf, int size);
   int m_ClientID;
   std::string m_Filename;
   CFile m_file;
+  CFile m_writeFile;
+  cRingBufferLinear *m_Staging;
   uint8_t *m_ReadCache;
   unsigned int m_ReadCachePtr;
   unsigned int m_ReadCacheSize;
@@ -369,6 +414,7 @@ protected:
 
 cVideoBufferFile::cVideoBufferFile()
 {
+  m_Staging = NULL;
   m_ReadCache = NULL;
   m_ReadCachePtr = 0;
   m_ReadCacheSize = 0;
@@ -379,6 +425,7 @@ cVideoBufferFile::cVideoBufferFile()
 cVideoBufferFile::cVideoBufferFile(int clientID)
 {
   m_ClientID = clientID;
+  m_Staging = NULL;
   m_ReadCacheSize = 0;
   m_ReadCache = NULL;
   m_ReadCachePtr = 0;
@@ -387,6 +434,13 @@ cVideoBufferFile::cVideoBufferFile(int clientID)
 
 cVideoBufferFile::~cVideoBufferFile()
 {
+  StopThread(0);
+  if (m_Staging)
+  {
+    delete m_Staging;
+    cMetrics::Get().Remove(STAGING_METRIC, cMetrics::Label("client", m_ClientID));
+  }
+  m_writeFile.Close();
   m_file.Close();
   CFile::Delete(m_Filename);
   free(m_ReadCache);
@@ -402,6 +456,7 @@ bool cVideoBufferFile::Init()
     return false;
 
   m_BufferSize = (off_t)cSettings::Get().m_TimeshiftBufferFileSize*1000*1000*1000;
+  m_BufferSize -= m_BufferSize % STAGINGCHUNKSIZE;
 
   std::string strTimeshiftBufferDir = cSettings::Get().m_TimeshiftBufferDir;
   if (!strTimeshiftBufferDir.empty() && CDirectory::Exists(strTimeshiftBufferDir.c_str()))
@@ -416,28 +471,42 @@ bool cVideoBufferFile::Init()
     m_Filename = m_Filename = StringUtils::Format("%s/Timeshift-%d.vnsi", cSettings::Get().m_VideoDirectory.c_str(), m_ClientID);
   }
 
-  if (m_file.OpenForWrite(m_Filename, true))
+  if (!m_writeFile.OpenForWrite(m_Filename, true))
   {
     esyslog("Could not open file: %s", m_Filename.c_str());
     return false;
   }
-  m_WritePtr = m_file.Seek(m_BufferSize - 1, SEEK_SET);
+  m_WritePtr = m_writeFile.Seek(m_BufferSize - 1, SEEK_SET);
   if (m_WritePtr == -1)
   {
     esyslog("(Init) Could not seek file: %s", m_Filename.c_str());
     return false;
   }
   char tmp = '0';
-  if (m_file.Write(&tmp, 1) < 0)
+  if (m_writeFile.Write(&tmp, 1) < 0)
   {
     esyslog("(Init) Could not write to file: %s", m_Filename.c_str());
     return false;
   }
+  m_writeFile.Flush();
+
+  // The writer thread writes through m_writeFile, reads go through m_file
+  if (!m_file.Open(m_Filename))
+  {
+    esyslog("Could not open file: %s", m_Filename.c_str());
+    return false;
+  }
+
+  m_Staging = new cRingBufferLinear(STAGINGBUFSIZE, TS_SIZE, false, "Timeshift");
+  m_Staging->SetTimeouts(0, STAGINGFLUSHTIME);
+  m_Staging->SetMetrics(cMetrics::Get().Gauge(STAGING_METRIC, "Bytes of timeshift data waiting to be written to disk",
+                                              cMetrics::Label("client", m_ClientID)),
+                        MetricCounterPtr());
 
   m_WritePtr = 0;
   m_ReadPtr = 0;
   m_ReadCacheSize = 0;
-  return true;
+  return CreateThread(false);
 }
 
 void cVideoBufferFile::SetPos(off_t pos)
@@ -463,58 +532,94 @@ off_t cVideoBufferFile::GetPosMax()
 
 void cVideoBufferFile::Receive(const uint16_t pid, const uint8_t* data, const size_t len, ts_crc_check_t& crcvalid)
 {
-  const uint8_t* buf  = data;
-  size_t         size = len;
-
-  if (Available() + MARGIN >= m_BufferSize)
+  // Drop whole packets rather than leaving a fragment in the stream
+  if (m_Staging->Free() < (int)len)
   {
+    m_Staging->ReportOverflow(len);
+    ReportOverflow(len);
     return;
   }
+  m_Staging->Put(data, len);
+}
 
-  if ((m_BufferSize - m_WritePtr) <= size)
+void* cVideoBufferFile::Process(void)
+{
+  cTimeMs flushTimer(STAGINGFLUSHTIME);
+
+  while (!IsStopped())
   {
-    int bytes = m_BufferSize - m_WritePtr;
+    int count;
+    uint8_t* buf = m_Staging->Get(count);
+    if (!buf)
+      continue;
 
-    int p = 0;
-    off_t ptr = m_WritePtr;
-    while(bytes > 0)
+    // Let a trickle of packets collect into a larger write, but don't hold
+    // them back from the reader for long
+    if (count < STAGINGCHUNKSIZE && !flushTimer.TimedOut())
     {
-      m_file.Seek(ptr, SEEK_SET);
-      p = m_file.Write(buf, bytes);
-      if (p < 0)
-      {
-        esyslog("Could not write to file: %s", m_Filename.c_str());
-        return;
-      }
-      size -= p;
-      bytes -= p;
-      buf += p;
-      ptr += p;
+      Sleep(STAGINGFLUSHTIME / 10);
+      continue;
     }
-    CLockObject lock(m_Mutex);
-    m_WritePtr = 0;
+
+    int written = WriteStaged(buf, count);
+    m_Staging->Del(written);
+    flushTimer.Set(STAGINGFLUSHTIME);
+  }
+  return NULL;
+}
+
+int cVideoBufferFile::WriteStaged(const uint8_t *buf, int size)
+{
+  if (Available() + MARGIN >= m_BufferSize)
+  {
+    m_Staging->ReportOverflow(size);
+    ReportOverflow(size);
+    return size;
   }
 
+  // m_WritePtr is only advanced here, so it can be read without the lock
   off_t ptr = m_WritePtr;
   int bytes = size;
-  int p;
-  while(bytes > 0)
+  if (bytes > m_BufferSize - ptr)
+    bytes = m_BufferSize - ptr;
+  // Keep writes on chunk boundaries of the file after the first one
+  if (bytes > STAGINGCHUNKSIZE - ptr % STAGINGCHUNKSIZE)
+    bytes = STAGINGCHUNKSIZE - ptr % STAGINGCHUNKSIZE;
+
+  int fd = m_writeFile.GetNativeHandle();
+  int done = 0;
+  while (done < bytes)
   {
-    m_file.Seek(ptr, SEEK_SET);
-    p = m_file.Write(buf, bytes);
-    if (p < 0)
+    ssize_t p;
+    if (fd >= 0)
+      p = pwrite(fd, buf + done, bytes - done, ptr + done);
+    else if (m_writeFile.Seek(ptr + done, SEEK_SET) == ptr + done)
+      p = m_writeFile.Write(buf + done, bytes - done);
+    else
+      p = -1;
+
+    if (p < 0 && errno == EINTR)
+      continue;
+    if (p <= 0)
     {
-      esyslog("Could not write to file: %s", m_Filename.c_str());
-      return;
+      // Drop the rest of the chunk and the fragment of a packet that was
+      // written, so the next write starts at a packet boundary again
+      LOG_ERROR_STR(m_Filename.c_str());
+      done -= done % TS_SIZE;
+      m_Staging->ReportOverflow(bytes - done);
+      ReportOverflow(bytes - done);
+      break;
     }
-    bytes -= p;
-    buf += p;
-    ptr += p;
+    done += p;
   }
+  if (fd < 0)
+    m_writeFile.Flush();
 
   CLockObject lock(m_Mutex);
 
-  m_WritePtr += size;
+  m_WritePtr = ptr + done;
+  if (m_WritePtr >= m_BufferSize)
+    m_WritePtr = 0;
   if (!m_BufferFull)
   {
     if ((m_WritePtr + 2*MARGIN) > m_BufferSize)
@@ -525,6 +630,8 @@ void cVideoBufferFile::Receive(const uint16_t pid, const uint8_t* data, const si
   }
 
   time(&m_bufferEndTime);
+  ReportQueue(Available());
+  return bytes;
 }
 
 int cVideoBufferFile::ReadBytes(uint8_t *buf, off_t pos, unsigned int size)
@@ -868,12 +975,34 @@ off_t cVideoBufferTest::Available()
 
 //-----------------------------------------------------------------------------
 
+#define QUEUE_METRIC    "vdr_receiver_queue_bytes"
+#define OVERFLOW_METRIC "vdr_receiver_overflow_bytes_total"
+
 cVideoBuffer::cVideoBuffer()
 {
   m_CheckEof = false;
   m_InputAttached = true;
   m_bufferEndTime = 0;
   m_bufferWrapTime = 0;
+  m_metricsClientID = -1;
+}
+
+cVideoBuffer::~cVideoBuffer(void)
+{
+  if (m_metricsClientID >= 0)
+  {
+    const std::string strLabels = cMetrics::Label("client", m_metricsClientID);
+    cMetrics::Get().Remove(QUEUE_METRIC, strLabels);
+    cMetrics::Get().Remove(OVERFLOW_METRIC, strLabels);
+  }
+}
+
+void cVideoBuffer::RegisterMetrics(int clientID)
+{
+  const std::string strLabels = cMetrics::Label("client", clientID);
+  m_metricsClientID = clientID;
+  m_queueMetric     = cMetrics::Get().Gauge(QUEUE_METRIC, "Bytes queued for a client", strLabels);
+  m_overflowMetric  = cMetrics::Get().Counter(OVERFLOW_METRIC, "Bytes dropped because the client's buffer was full", strLabels);
 }
 
 bool cVideoBuffer::Start(void)
@@ -924,6 +1053,7 @@ cVideoBuffer* cVideoBuffer::Create(int clientID, uint8_t timeshift)
   if (cSettings::Get().m_TimeshiftMode == TS_MODE_NONE || timeshift == 0)
   {
     cVideoBufferSimple *buffer = new cVideoBufferSimple();
+    buffer->RegisterMetrics(clientID);
     return buffer;
   }
   // buffer in ram
@@ -935,8 +1065,8 @@ cVideoBuffer* cVideoBuffer::Create(int clientID, uint8_t timeshift)
       delete buffer;
       return NULL;
     }
-    else
-      return buffer;
+    buffer->RegisterMetrics(clientID);
+    return buffer;
   }
   // buffer in file
   else if (cSettings::Get().m_TimeshiftMode == TS_MODE_FILE)
@@ -947,8 +1077,8 @@ cVideoBuffer* cVideoBuffer::Create(int clientID, uint8_t timeshift)
       delete buffer;
       return NULL;
     }
-    else
-      return buffer;
+    buffer->RegisterMetrics(clientID);
+    return buffer;
   }
   else
     return NULL;
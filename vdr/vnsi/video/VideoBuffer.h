@@ -27,6 +27,7 @@
 #include "devices/Receiver.h"
 #include "recordings/RecordingTypes.h"
 #include "utils/Timer.h"
+#include "utils/metrics/Metrics.h"
 
 #include <stdint.h>
 #include <stdlib.h>
@@ -43,7 +44,7 @@ namespace VDR
 class cVideoBuffer : public iReceiver
 {
 public:
-  virtual ~cVideoBuffer(void) { }
+  virtual ~cVideoBuffer(void);
 
   virtual bool Start(void);
   virtual void Stop(void);
@@ -70,11 +71,25 @@ public:
 protected:
   cVideoBuffer(void);
 
+  /*!
+   * Queue depth and dropped bytes of live buffers, exported per client. No-op
+   * for buffers that weren't created for a client.
+   */
+  void ReportQueue(off_t bytes) { if (m_queueMetric) m_queueMetric->Set(bytes); }
+  void ReportOverflow(size_t bytes) { if (m_overflowMetric) m_overflowMetric->Add(bytes); }
+
   cTimeMs m_Timer;
   bool    m_CheckEof;
   bool    m_InputAttached;
   time_t  m_bufferEndTime;
   time_t  m_bufferWrapTime;
+
+private:
+  void RegisterMetrics(int clientID);
+
+  int              m_metricsClientID;
+  MetricGaugePtr   m_queueMetric;
+  MetricCounterPtr m_overflowMetric;
 };
 
 }
@@ -81,6 +81,20 @@ void cParser::Reset()
   m_PesPacketLength = 0;
   m_PesHeaderPtr = 0;
   m_Error = ERROR_PES_GENERAL;
+  m_ContinuityCounter = TS_CONT_CNT_UNKNOWN;
+}
+
+void cParser::Resync()
+{
+  m_PesBufferPtr = 0;
+  m_PesParserPtr = 0;
+  m_PesNextFramePtr = 0;
+  m_FoundFrame = false;
+  m_FrameValid = false;
+  m_PesPacketLength = 0;
+  m_PesHeaderPtr = 0;
+  m_IsPusi = false;
+  m_Error = ERROR_PES_CONTINUITY;
 }
 /*
  * Extract DTS and PTS and update current values in stream
@@ -188,6 +202,20 @@ int cParser::ParsePacketHeader(uint8_t *data)
     return -1;
   }
 
+  if (!TsError(data))
+  {
+    switch (TsCheckContinuity(data, m_ContinuityCounter))
+    {
+    case tcDuplicate:
+      return 0;
+    case tcDiscontinuity:
+      Resync();
+      break;
+    default:
+      break;
+    }
+  }
+
   if (TsPayloadStart(data))
   {
     m_IsPusi = true;
@@ -122,6 +122,7 @@ struct sStreamPacket
   int64_t   dts;
   int64_t   pts;
   int       duration;
+  int       frameType;      // PKT_*_FRAME for video, 0 for other streams
 
   uint8_t   commercial;
   uint8_t   componentindex;
@@ -158,6 +159,13 @@ public:
   int ParsePacketHeader(uint8_t *data);
   int ParsePESHeader(uint8_t *buf, size_t len);
   virtual void Reset();
+
+  /*!
+   * Drop the frame being assembled after packets were lost, and wait for the
+   * start of the next PES packet. Unlike Reset(), the stream's parameters and
+   * timestamps are kept.
+   */
+  void Resync();
   bool IsVideo() {return m_IsVideo; }
   uint16_t GetError() { return m_Error; }
 
@@ -186,6 +194,7 @@ protected:
 
   bool        m_IsPusi;
   uint16_t    m_Error;
+  uint8_t     m_ContinuityCounter;
 
   cTSStream  *m_Stream;
   bool        m_IsVideo;
@@ -61,6 +61,7 @@ cParserH264::cParserH264(int pID, cTSStream *stream, sPtsWrap *ptsWrap, bool obs
   m_FPS               = 25;
   m_FpsScale          = 0;
   m_FrameDuration     = 0;
+  m_FrameType         = 0;
   m_vbvDelay          = -1;
   m_vbvSize           = 0;
   m_PixelAspect.den   = 1;
@@ -129,6 +130,7 @@ void cParserH264::Parse(sStreamPacket *pkt)
       pkt->dts      = m_DTS;
       pkt->pts      = m_PTS;
       pkt->duration = duration;
+      pkt->frameType = m_FrameType;
       pkt->streamChange = streamChange;
     }
     m_StartCode = 0xffffffff;
@@ -180,6 +182,13 @@ int cParserH264::Parse_H264(uint32_t startcode, int buf_ptr, bool &complete)
       return -1;
     }
 
+    // Frames that nothing references are disposable whatever their slices
+    // are, like B-frames in MPEG-2. A frame with mixed slices counts as the
+    // least disposable of them.
+    int frameType = vcl.slice_type == 2 ? PKT_I_FRAME : (vcl.nal_ref_idc ? PKT_P_FRAME : PKT_B_FRAME);
+    if (!m_FoundFrame || frameType < m_FrameType)
+      m_FrameType = frameType;
+
     if (!m_FoundFrame)
     {
       if (buf_ptr - 4 >= m_PesTimePos)
@@ -298,6 +307,7 @@ bool cParserH264::Parse_SLH(uint8_t *buf, int len, h264_private::VCL_NAL &vcl)
 
   if (slice_type > 4)
     slice_type -= 5;  /* Fixed slice type per frame */
+  vcl.slice_type = slice_type;
 
   switch (slice_type)
   {
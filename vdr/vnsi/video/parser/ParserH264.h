@@ -69,6 +69,7 @@ private:
       int delta_pic_order_cnt_1; // slice
       int pic_order_cnt_lsb; // slice
       int idr_pic_id; // slice
+      int slice_type; // slice
       int nal_unit_type;
       int nal_ref_idc; // start code
       int pic_order_cnt_type; // sps
@@ -101,6 +102,7 @@ private:
   int             m_FpsScale;
   mpeg_rational_t m_PixelAspect;
   int             m_FrameDuration;
+  int             m_FrameType;
   h264_private    m_streamData;
   int             m_vbvDelay;       /* -1 if CBR */
   int             m_vbvSize;        /* Video buffer size (in bytes) */
@@ -66,6 +66,7 @@ cParserMPEG2Video::cParserMPEG2Video(int pID, cTSStream *stream, sPtsWrap *ptsWr
   m_Width             = 0;
   m_Dar               = 0.0;
   m_FpsScale          = 0;
+  m_FrameType         = 0;
   m_PesBufferInitialSize  = 80000;
   m_IsVideo = true;
   Reset();
@@ -117,6 +118,7 @@ void cParserMPEG2Video::Parse(sStreamPacket *pkt)
       pkt->dts      = m_DTS;
       pkt->pts      = m_PTS;
       pkt->duration = m_FrameDuration;
+      pkt->frameType = m_FrameType;
       pkt->streamChange = streamChange;
     }
     m_StartCode = 0xffffffff;
@@ -277,6 +279,7 @@ bool cParserMPEG2Video::Parse_MPEG2Video_PicStart(uint8_t *buf)
 
   if (pct == PKT_I_FRAME)
     m_NeedIFrame = false;
+  m_FrameType = pct;
 
   int vbvDelay = bs.readBits(16); /* vbv_delay */
   if (vbvDelay  == 0xffff)
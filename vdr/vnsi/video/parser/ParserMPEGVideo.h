@@ -51,6 +51,7 @@ private:
   int64_t         m_DTS;
   int64_t         m_PTS;
   int64_t         m_AuDTS, m_AuPTS, m_AuPrevDTS;
+  int             m_FrameType;
   int             m_TemporalReference;
   int             m_TrLastTime;
   int             m_PicNumber;
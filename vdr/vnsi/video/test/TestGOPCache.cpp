@@ -0,0 +1,268 @@
+/*
+ *      Copyright (C) 2013-2014 Garrett Brown
+ *      Copyright (C) 2013-2014 Lars Op den Kamp
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this Program; see the file COPYING. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "channels/Channel.h"
+#include "devices/Remux.h"
+#include "utils/CommonMacros.h"
+#include "vnsi/video/GOPCache.h"
+
+#include "gtest/gtest.h"
+
+#include <string.h>
+
+#define VIDEO_PID  0x100
+#define AUDIO_PID  0x101
+
+namespace VDR
+{
+
+class cTestReceiver : public iReceiver
+{
+public:
+  cTestReceiver(void) : m_packets(0) { }
+  virtual bool Start(void) { return true; }
+  virtual void Stop(void) { }
+  virtual void Receive(const uint16_t pid, const uint8_t* data, const size_t len, ts_crc_check_t& crcvalid) { m_packets += len / TS_SIZE; }
+  virtual void LockAcquired(void) { }
+  virtual void LockLost(void) { }
+  virtual void LostPriority(void) { }
+
+  size_t m_packets;
+};
+
+class cTestPacket
+{
+public:
+  /*!
+   * A packet that continues a PES packet, with the given counter in its payload
+   * to tell packets apart
+   */
+  cTestPacket(uint16_t pid, unsigned int counter)
+  {
+    Init(pid, false, counter);
+  }
+
+  /*!
+   * A packet that starts a PES packet with the elementary stream start code
+   * 00 00 01 code, followed by the bytes b4 and b5
+   */
+  cTestPacket(uint16_t pid, uint8_t code, uint8_t b4, uint8_t b5)
+  {
+    Init(pid, true, 0);
+
+    static const uint8_t pesHeader[] = { 0x00, 0x00, 0x01, 0xE0, 0x00, 0x00, 0x80, 0x80, 0x05, 0x21, 0x00, 0x01, 0x00, 0x01 };
+    uint8_t* pes = m_data + 4;
+    memcpy(pes, pesHeader, sizeof(pesHeader));
+
+    uint8_t* es = pes + PesPayloadOffset(pes);
+    es[0] = 0x00;
+    es[1] = 0x00;
+    es[2] = 0x01;
+    es[3] = code;
+    es[4] = b4;
+    es[5] = b5;
+  }
+
+  const uint8_t* Data(void) const { return m_data; }
+
+private:
+  void Init(uint16_t pid, bool payloadStart, unsigned int counter)
+  {
+    memset(m_data, 0xFF, sizeof(m_data));
+    m_data[0] = TS_SYNC_BYTE;
+    m_data[1] = (payloadStart ? TS_PAYLOAD_START : 0x00) | ((pid >> 8) & 0x1F);
+    m_data[2] = pid & 0xFF;
+    m_data[3] = TS_PAYLOAD_EXISTS | (counter & 0x0F);
+    memcpy(m_data + 4, &counter, sizeof(counter));
+  }
+
+  uint8_t m_data[TS_SIZE];
+};
+
+// MPEG-2 picture headers carry the coding type in bits 3-5 of their 6th byte
+#define MPEG2_I_FRAME(pid)  cTestPacket(pid, 0x00, 0x00, 0x08)
+#define MPEG2_P_FRAME(pid)  cTestPacket(pid, 0x00, 0x00, 0x10)
+
+static GOPCachePtr GetCache(uint16_t tsid, STREAM_TYPE vtype)
+{
+  ChannelPtr channel = ChannelPtr(new cChannel);
+  channel->SetId(1, tsid, 1);
+
+  VideoStream videoStream;
+  videoStream.vpid = VIDEO_PID;
+  videoStream.vtype = vtype;
+  channel->SetStreams(videoStream, std::vector<AudioStream>(), std::vector<DataStream>(), std::vector<SubtitleStream>(), TeletextStream());
+
+  return cGOPCache::Get(channel);
+}
+
+static size_t GOPPackets(const GOPCachePtr& cache)
+{
+  std::vector<uint8_t> gop;
+  cache->GetGOP(gop);
+  return gop.size() / TS_SIZE;
+}
+
+TEST(GOPCache, RandomAccessPointMPEG2)
+{
+  GOPCachePtr cache = GetCache(1, STREAM_TYPE_13818_VIDEO);
+  cTestReceiver feeder;
+
+  // Nothing is cached before the first I-frame
+  cache->Put(&feeder, MPEG2_P_FRAME(VIDEO_PID).Data(), TS_SIZE);
+  cache->Put(&feeder, cTestPacket(VIDEO_PID, 1).Data(), TS_SIZE);
+  EXPECT_EQ(0u, GOPPackets(cache));
+
+  cache->Put(&feeder, MPEG2_I_FRAME(VIDEO_PID).Data(), TS_SIZE);
+  cache->Put(&feeder, cTestPacket(VIDEO_PID, 2).Data(), TS_SIZE);
+  cache->Put(&feeder, MPEG2_P_FRAME(VIDEO_PID).Data(), TS_SIZE);
+  EXPECT_EQ(3u, GOPPackets(cache));
+
+  // An I-frame on another PID isn't a random access point
+  cache->Put(&feeder, MPEG2_I_FRAME(AUDIO_PID).Data(), TS_SIZE);
+  EXPECT_EQ(4u, GOPPackets(cache));
+
+  // A sequence header starts a new GOP
+  cache->Put(&feeder, cTestPacket(VIDEO_PID, 0xB3, 0x00, 0x00).Data(), TS_SIZE);
+  EXPECT_EQ(1u, GOPPackets(cache));
+  EXPECT_EQ(7u, cache->Received());
+}
+
+TEST(GOPCache, RandomAccessPointH264)
+{
+  GOPCachePtr cache = GetCache(2, STREAM_TYPE_14496_H264_VIDEO);
+  cTestReceiver feeder;
+
+  // Non-IDR slice
+  cache->Put(&feeder, cTestPacket(VIDEO_PID, 0x41, 0x00, 0x00).Data(), TS_SIZE);
+  EXPECT_EQ(0u, GOPPackets(cache));
+
+  // IDR slice
+  cache->Put(&feeder, cTestPacket(VIDEO_PID, 0x65, 0x00, 0x00).Data(), TS_SIZE);
+  cache->Put(&feeder, cTestPacket(VIDEO_PID, 0x41, 0x00, 0x00).Data(), TS_SIZE);
+  EXPECT_EQ(2u, GOPPackets(cache));
+
+  // SPS
+  cache->Put(&feeder, cTestPacket(VIDEO_PID, 0x67, 0x00, 0x00).Data(), TS_SIZE);
+  EXPECT_EQ(1u, GOPPackets(cache));
+
+  // An MPEG-2 picture header means nothing in H.264
+  cache->Put(&feeder, MPEG2_I_FRAME(VIDEO_PID).Data(), TS_SIZE);
+  EXPECT_EQ(2u, GOPPackets(cache));
+}
+
+TEST(GOPCache, MaxSize)
+{
+  GOPCachePtr cache = GetCache(3, STREAM_TYPE_13818_VIDEO);
+  cTestReceiver feeder;
+
+  const size_t maxPackets = MEGABYTE(8) / TS_SIZE;
+
+  cache->Put(&feeder, MPEG2_I_FRAME(VIDEO_PID).Data(), TS_SIZE);
+  for (unsigned int i = 1; i < maxPackets; i++)
+    cache->Put(&feeder, cTestPacket(VIDEO_PID, i).Data(), TS_SIZE);
+  EXPECT_EQ(maxPackets, GOPPackets(cache));
+
+  // A GOP that doesn't fit is dropped until the next random access point
+  cache->Put(&feeder, cTestPacket(VIDEO_PID, 0).Data(), TS_SIZE);
+  EXPECT_EQ(0u, GOPPackets(cache));
+  cache->Put(&feeder, cTestPacket(VIDEO_PID, 1).Data(), TS_SIZE);
+  EXPECT_EQ(0u, GOPPackets(cache));
+
+  cache->Put(&feeder, MPEG2_I_FRAME(VIDEO_PID).Data(), TS_SIZE);
+  EXPECT_EQ(1u, GOPPackets(cache));
+}
+
+TEST(GOPCache, FeederHandover)
+{
+  GOPCachePtr cache = GetCache(4, STREAM_TYPE_13818_VIDEO);
+  cTestReceiver feeder1;
+  cTestReceiver feeder2;
+
+  cache->Put(&feeder1, MPEG2_I_FRAME(VIDEO_PID).Data(), TS_SIZE);
+  cache->Put(&feeder1, cTestPacket(VIDEO_PID, 1).Data(), TS_SIZE);
+
+  // Only one receiver feeds the cache
+  cache->Put(&feeder2, cTestPacket(VIDEO_PID, 1).Data(), TS_SIZE);
+  EXPECT_EQ(2u, cache->Received());
+  EXPECT_EQ(2u, GOPPackets(cache));
+
+  // The next one may have missed packets, so the GOP is dropped
+  cache->Detach(&feeder1);
+  cache->Put(&feeder2, cTestPacket(VIDEO_PID, 2).Data(), TS_SIZE);
+  EXPECT_EQ(3u, cache->Received());
+  EXPECT_EQ(0u, GOPPackets(cache));
+
+  cache->Put(&feeder2, MPEG2_I_FRAME(VIDEO_PID).Data(), TS_SIZE);
+  cache->Put(&feeder1, cTestPacket(VIDEO_PID, 3).Data(), TS_SIZE);
+  EXPECT_EQ(1u, GOPPackets(cache));
+}
+
+TEST(GOPCache, Overlap)
+{
+  GOPCachePtr cache = GetCache(5, STREAM_TYPE_13818_VIDEO);
+  ts_crc_check_t crc = TS_CRC_NOT_CHECKED;
+
+  cTestReceiver receiver1;
+  cGOPCacheReceiver feeder(&receiver1, cache);
+  feeder.Receive(VIDEO_PID, MPEG2_I_FRAME(VIDEO_PID).Data(), TS_SIZE, crc);
+  feeder.Receive(VIDEO_PID, cTestPacket(VIDEO_PID, 1).Data(), TS_SIZE, crc);
+
+  // Attached after the feeder got the packet
+  cTestReceiver receiver2;
+  cGOPCacheReceiver after(&receiver2, cache);
+  uint64_t overlap;
+  EXPECT_FALSE(after.Overlap(cache->Received(), overlap));
+
+  cTestPacket packet2(VIDEO_PID, 2);
+  feeder.Receive(VIDEO_PID, packet2.Data(), TS_SIZE, crc);
+  after.Receive(VIDEO_PID, packet2.Data(), TS_SIZE, crc);
+
+  std::vector<uint8_t> gop;
+  uint64_t gopEnd = cache->GetGOP(gop);
+  EXPECT_EQ(3u, gop.size() / TS_SIZE);
+  ASSERT_TRUE(after.Overlap(gopEnd, overlap));
+  EXPECT_EQ(1u, overlap);
+
+  // Attached before the feeder got the packet
+  cTestReceiver receiver3;
+  cGOPCacheReceiver before(&receiver3, cache);
+  cTestPacket packet3(VIDEO_PID, 3);
+  before.Receive(VIDEO_PID, packet3.Data(), TS_SIZE, crc);
+  after.Receive(VIDEO_PID, packet3.Data(), TS_SIZE, crc);
+
+  gopEnd = cache->GetGOP(gop);
+  ASSERT_TRUE(before.Overlap(gopEnd, overlap));
+  EXPECT_EQ(0u, overlap);
+
+  feeder.Receive(VIDEO_PID, packet3.Data(), TS_SIZE, crc);
+  gopEnd = cache->GetGOP(gop);
+  ASSERT_TRUE(before.Overlap(gopEnd, overlap));
+  EXPECT_EQ(1u, overlap);
+  ASSERT_TRUE(after.Overlap(gopEnd, overlap));
+  EXPECT_EQ(2u, overlap);
+
+  // All packets reached the wrapped receivers
+  EXPECT_EQ(4u, receiver1.m_packets);
+  EXPECT_EQ(2u, receiver2.m_packets);
+  EXPECT_EQ(1u, receiver3.m_packets);
+}
+
+}